@@ -154,6 +154,8 @@ ResultType ParseCmdLineArgs(LPTSTR &script_filespec)
 			// Default codepage for the script file, NOT the default for commands used by it.
 			g_DefaultScriptCodepage = ATOU(param + 3);
 		}
+		else if (!_tcsnicmp(param, _T("/Worker="), 8)) // Started by a Worker object; see Worker.Parent.
+			g_script.mWorkerChannel = param + 8;
 #endif
 #ifdef CONFIG_DEBUGGER
 		// Allow a debug session to be initiated by command-line.
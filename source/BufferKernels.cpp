@@ -0,0 +1,318 @@
+﻿#include "stdafx.h" // pre-compiled headers
+#include "BufferKernels.h"
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BUFFERKERNELS_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// SSE2 is used where the compiler can't be relied on to vectorize the loop itself: searching for
+// a byte pattern, and the floating-point reductions (which the compiler must not reorder).  The
+// integer loops are simple enough to be vectorized automatically.  SSE2 is always available on the
+// targets which have the intrinsics, so no check of the CPU is needed.
+
+
+NumValue NumLoad(const void *aPtr, NumKind aKind)
+{
+	NumValue v;
+	switch (aKind)
+	{
+	case NumKind::Int8: v.i = *(const INT8 *)aPtr; break;
+	case NumKind::UInt8: v.i = *(const UINT8 *)aPtr; break;
+	case NumKind::Int16: v.i = *(const INT16 *)aPtr; break;
+	case NumKind::UInt16: v.i = *(const UINT16 *)aPtr; break;
+	case NumKind::Int32: v.i = *(const INT32 *)aPtr; break;
+	case NumKind::UInt32: v.i = *(const UINT32 *)aPtr; break;
+	case NumKind::Int64: v.i = *(const INT64 *)aPtr; break;
+	case NumKind::Float32: v.d = *(const float *)aPtr; break;
+	default: v.d = *(const double *)aPtr; break;
+	}
+	return v;
+}
+
+
+
+void NumStore(void *aPtr, NumKind aKind, NumValue aValue)
+{
+	switch (aKind)
+	{
+	case NumKind::Int8:
+	case NumKind::UInt8: *(UINT8 *)aPtr = (UINT8)aValue.i; break;
+	case NumKind::Int16:
+	case NumKind::UInt16: *(UINT16 *)aPtr = (UINT16)aValue.i; break;
+	case NumKind::Int32:
+	case NumKind::UInt32: *(UINT32 *)aPtr = (UINT32)aValue.i; break;
+	case NumKind::Int64: *(UINT64 *)aPtr = (UINT64)aValue.i; break;
+	case NumKind::Float32: *(float *)aPtr = (float)aValue.d; break;
+	default: *(double *)aPtr = aValue.d; break;
+	}
+}
+
+
+
+template<typename T>
+static void FillT(T *aData, size_t aCount, T aValue)
+{
+	for (size_t i = 0; i < aCount; ++i)
+		aData[i] = aValue;
+}
+
+void NumFill(void *aData, size_t aCount, NumKind aKind, NumValue aValue)
+{
+	switch (NumKindSize(aKind))
+	{
+	case 1:
+		memset(aData, (UINT8)aValue.i, aCount);
+		break;
+	case 2:
+		FillT((UINT16 *)aData, aCount, (UINT16)aValue.i);
+		break;
+	case 4:
+		if (aKind == NumKind::Float32)
+		{
+			float f = (float)aValue.d;
+			FillT((float *)aData, aCount, f);
+		}
+		else
+			FillT((UINT32 *)aData, aCount, (UINT32)aValue.i);
+		break;
+	default:
+		if (aKind == NumKind::Float64)
+			FillT((double *)aData, aCount, aValue.d);
+		else
+			FillT((UINT64 *)aData, aCount, (UINT64)aValue.i);
+		break;
+	}
+}
+
+
+
+template<typename T>
+static __int64 SumT(const T *aData, size_t aCount)
+{
+	UINT64 sum = 0; // Unsigned so that overflow is well-defined.
+	for (size_t i = 0; i < aCount; ++i)
+		sum += (UINT64)(__int64)aData[i];
+	return (__int64)sum;
+}
+
+static double SumFloat(const float *aData, size_t aCount)
+{
+	size_t i = 0;
+	double sum = 0;
+#ifdef BUFFERKERNELS_SSE2
+	__m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+	for (; i + 4 <= aCount; i += 4)
+	{
+		__m128 f = _mm_loadu_ps(aData + i);
+		acc0 = _mm_add_pd(acc0, _mm_cvtps_pd(f));
+		acc1 = _mm_add_pd(acc1, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+	}
+	acc0 = _mm_add_pd(acc0, acc1);
+	sum = _mm_cvtsd_f64(_mm_add_sd(acc0, _mm_unpackhi_pd(acc0, acc0)));
+#endif
+	for (; i < aCount; ++i)
+		sum += aData[i];
+	return sum;
+}
+
+static double SumDouble(const double *aData, size_t aCount)
+{
+	size_t i = 0;
+	double sum = 0;
+#ifdef BUFFERKERNELS_SSE2
+	__m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+	for (; i + 4 <= aCount; i += 4)
+	{
+		acc0 = _mm_add_pd(acc0, _mm_loadu_pd(aData + i));
+		acc1 = _mm_add_pd(acc1, _mm_loadu_pd(aData + i + 2));
+	}
+	acc0 = _mm_add_pd(acc0, acc1);
+	sum = _mm_cvtsd_f64(_mm_add_sd(acc0, _mm_unpackhi_pd(acc0, acc0)));
+#endif
+	for (; i < aCount; ++i)
+		sum += aData[i];
+	return sum;
+}
+
+NumValue NumSum(const void *aData, size_t aCount, NumKind aKind)
+{
+	NumValue v;
+	switch (aKind)
+	{
+	case NumKind::Int8: v.i = SumT((const INT8 *)aData, aCount); break;
+	case NumKind::UInt8: v.i = SumT((const UINT8 *)aData, aCount); break;
+	case NumKind::Int16: v.i = SumT((const INT16 *)aData, aCount); break;
+	case NumKind::UInt16: v.i = SumT((const UINT16 *)aData, aCount); break;
+	case NumKind::Int32: v.i = SumT((const INT32 *)aData, aCount); break;
+	case NumKind::UInt32: v.i = SumT((const UINT32 *)aData, aCount); break;
+	case NumKind::Int64: v.i = SumT((const INT64 *)aData, aCount); break;
+	case NumKind::Float32: v.d = SumFloat((const float *)aData, aCount); break;
+	default: v.d = SumDouble((const double *)aData, aCount); break;
+	}
+	return v;
+}
+
+
+
+// This matches the semantics of MINPS/MAXPS, which return the second operand if either is NaN,
+// so that the result doesn't depend on which elements are processed by SSE2.
+template<bool Max, typename T>
+static inline T Pick(T aCurrent, T aNext)
+{
+	return (Max ? aCurrent > aNext : aCurrent < aNext) ? aCurrent : aNext;
+}
+
+template<typename T, bool Max>
+static T MinMaxT(const T *aData, size_t aCount)
+{
+	T m = aData[0];
+	for (size_t i = 1; i < aCount; ++i)
+		m = Pick<Max>(m, aData[i]);
+	return m;
+}
+
+template<bool Max>
+static double MinMaxFloat(const float *aData, size_t aCount)
+{
+	size_t i = 0;
+	float m = aData[0];
+#ifdef BUFFERKERNELS_SSE2
+	if (aCount >= 8)
+	{
+		__m128 acc = _mm_loadu_ps(aData);
+		for (i = 4; i + 4 <= aCount; i += 4)
+		{
+			__m128 f = _mm_loadu_ps(aData + i);
+			acc = Max ? _mm_max_ps(acc, f) : _mm_min_ps(acc, f);
+		}
+		float lane[4];
+		_mm_storeu_ps(lane, acc);
+		m = MinMaxT<float, Max>(lane, 4);
+	}
+	else
+		i = 1;
+#else
+	i = 1;
+#endif
+	for (; i < aCount; ++i)
+		m = Pick<Max>(m, aData[i]);
+	return m;
+}
+
+template<bool Max>
+static double MinMaxDouble(const double *aData, size_t aCount)
+{
+	size_t i = 0;
+	double m = aData[0];
+#ifdef BUFFERKERNELS_SSE2
+	if (aCount >= 4)
+	{
+		__m128d acc = _mm_loadu_pd(aData);
+		for (i = 2; i + 2 <= aCount; i += 2)
+		{
+			__m128d d = _mm_loadu_pd(aData + i);
+			acc = Max ? _mm_max_pd(acc, d) : _mm_min_pd(acc, d);
+		}
+		double lane[2];
+		_mm_storeu_pd(lane, acc);
+		m = MinMaxT<double, Max>(lane, 2);
+	}
+	else
+		i = 1;
+#else
+	i = 1;
+#endif
+	for (; i < aCount; ++i)
+		m = Pick<Max>(m, aData[i]);
+	return m;
+}
+
+template<bool Max>
+static NumValue MinMax(const void *aData, size_t aCount, NumKind aKind)
+{
+	ASSERT(aCount);
+	NumValue v;
+	switch (aKind)
+	{
+	case NumKind::Int8: v.i = MinMaxT<INT8, Max>((const INT8 *)aData, aCount); break;
+	case NumKind::UInt8: v.i = MinMaxT<UINT8, Max>((const UINT8 *)aData, aCount); break;
+	case NumKind::Int16: v.i = MinMaxT<INT16, Max>((const INT16 *)aData, aCount); break;
+	case NumKind::UInt16: v.i = MinMaxT<UINT16, Max>((const UINT16 *)aData, aCount); break;
+	case NumKind::Int32: v.i = MinMaxT<INT32, Max>((const INT32 *)aData, aCount); break;
+	case NumKind::UInt32: v.i = MinMaxT<UINT32, Max>((const UINT32 *)aData, aCount); break;
+	case NumKind::Int64: v.i = MinMaxT<INT64, Max>((const INT64 *)aData, aCount); break;
+	case NumKind::Float32: v.d = MinMaxFloat<Max>((const float *)aData, aCount); break;
+	default: v.d = MinMaxDouble<Max>((const double *)aData, aCount); break;
+	}
+	return v;
+}
+
+NumValue NumMin(const void *aData, size_t aCount, NumKind aKind)
+{
+	return MinMax<false>(aData, aCount, aKind);
+}
+
+NumValue NumMax(const void *aData, size_t aCount, NumKind aKind)
+{
+	return MinMax<true>(aData, aCount, aKind);
+}
+
+
+
+static inline int LowestBit(UINT aValue)
+// Caller must ensure aValue is non-zero.
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, aValue);
+	return (int)index;
+#else
+	return __builtin_ctz(aValue);
+#endif
+}
+
+ptrdiff_t FindBytes(const void *aHaystack, size_t aHaystackSize, const void *aNeedle, size_t aNeedleSize)
+{
+	if (!aNeedleSize)
+		return 0;
+	if (aNeedleSize > aHaystackSize)
+		return -1;
+	auto hay = (const BYTE *)aHaystack, needle = (const BYTE *)aNeedle;
+	size_t last = aNeedleSize - 1; // Offset of the needle's last byte.
+	size_t end = aHaystackSize - last; // One past the last possible match position.
+	size_t i = 0;
+#ifdef BUFFERKERNELS_SSE2
+	// Compare the first and last bytes of the needle at 16 positions at once, and verify the rest of
+	// the needle only at positions where both match.  Checking two bytes rules out most candidates
+	// even when the first byte is common, such as zero in binary data.
+	__m128i first = _mm_set1_epi8((char)needle[0]);
+	__m128i lastb = _mm_set1_epi8((char)needle[last]);
+	for (; i + 16 <= end; i += 16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i *)(hay + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(hay + i + last));
+		UINT mask = (UINT)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, lastb)));
+		for (; mask; mask &= mask - 1)
+		{
+			size_t pos = i + LowestBit(mask);
+			if (aNeedleSize <= 2 || !memcmp(hay + pos + 1, needle + 1, aNeedleSize - 2))
+				return (ptrdiff_t)pos;
+		}
+	}
+#endif
+	// Search the remainder (or all of it, if SSE2 isn't available).  memchr() is typically vectorized.
+	while (i < end)
+	{
+		auto found = (const BYTE *)memchr(hay + i, needle[0], end - i);
+		if (!found)
+			break;
+		i = found - hay;
+		if (!memcmp(found + 1, needle + 1, last))
+			return (ptrdiff_t)i;
+		++i;
+	}
+	return -1;
+}
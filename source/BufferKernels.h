@@ -0,0 +1,35 @@
+﻿#pragma once
+
+// Bulk operations on packed arrays of numbers, such as those accessed through a BufferView.
+// Integer arithmetic wraps around on overflow, the same as the script's own integer arithmetic.
+// This has no dependencies on the OS.
+
+enum class NumKind : BYTE { Int8, UInt8, Int16, UInt16, Int32, UInt32, Int64, Float32, Float64 };
+
+inline size_t NumKindSize(NumKind aKind)
+{
+	static const BYTE sSize[] = { 1, 1, 2, 2, 4, 4, 8, 4, 8 };
+	return sSize[(int)aKind];
+}
+inline bool NumKindIsFloat(NumKind aKind) { return aKind >= NumKind::Float32; }
+
+// A number loaded from or to be stored in an array: d if the kind is Float32 or Float64, otherwise i.
+union NumValue
+{
+	__int64 i;
+	double d;
+};
+
+NumValue NumLoad(const void *aPtr, NumKind aKind);
+void NumStore(void *aPtr, NumKind aKind, NumValue aValue);
+
+// Sets aCount elements to aValue.
+void NumFill(void *aData, size_t aCount, NumKind aKind, NumValue aValue);
+// Returns the sum of aCount elements, or 0 if there are none.  Float32 elements are summed as doubles.
+NumValue NumSum(const void *aData, size_t aCount, NumKind aKind);
+// Return the lowest or highest of aCount elements.  aCount must be non-zero.
+NumValue NumMin(const void *aData, size_t aCount, NumKind aKind);
+NumValue NumMax(const void *aData, size_t aCount, NumKind aKind);
+
+// Returns the offset of the first occurrence of aNeedle within aHaystack, or -1 if there is none.
+ptrdiff_t FindBytes(const void *aHaystack, size_t aHaystackSize, const void *aNeedle, size_t aNeedleSize);
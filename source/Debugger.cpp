@@ -184,10 +184,18 @@ int Debugger::PreExecLine(Line *aLine)
 	// Such commands may also be detected via the AHK_CHECK_DEBUGGER message,
 	// but if the program is checking for messages infrequently or not at all,
 	// the check here is needed to ensure the debugger is responsive.
-	if (HasPendingCommand())
+	// Since checking the socket requires a system call, which costs far more than executing
+	// a typical line, it's done at most once per timer tick (typically 10-16ms).  This keeps
+	// the debugger responsive while greatly reducing the overhead of running with it attached.
+	DWORD tick_now = GetTickCount();
+	if (tick_now != mLastPollTick)
 	{
-		// A command was sent asynchronously.
-		return ProcessCommands();
+		mLastPollTick = tick_now;
+		if (HasPendingCommand())
+		{
+			// A command was sent asynchronously.
+			return ProcessCommands();
+		}
 	}
 	
 	return DEBUGGER_E_OK;
@@ -502,7 +510,8 @@ DEBUGGER_COMMAND(Debugger::feature_get)
 	else if (!strcmp(feature_name, "protocol_version")
 			|| !strcmp(feature_name, "supports_async"))
 		setting = "1";
-	// Not supported: data_encoding - assume base64.
+	else if (!strcmp(feature_name, "data_encoding"))
+		setting = mDataEncodingNone ? "none" : "base64";
 	// Not supported: breakpoint_languages - assume only %language_name% is supported.
 	else if (!strcmp(feature_name, "breakpoint_types"))
 		setting = "line exception";
@@ -559,9 +568,17 @@ DEBUGGER_COMMAND(Debugger::feature_set)
 
 	bool success = false;
 
-	// Since all supported features are positive integers:
+	// Except for data_encoding, all supported features are positive integers:
 	int ival = atoi(feature_value);
-	if (ival < 0)
+	if (!strcmp(feature_name, "data_encoding"))
+	{
+		// "none" avoids the size and processing overhead of base64 for property data.  Values which
+		// can't be represented in XML text (such as those containing control characters) are still
+		// sent as base64, so the client must check the encoding attribute of each property.
+		if (success = !strcmp(feature_value, "none") || !strcmp(feature_value, "base64"))
+			mDataEncodingNone = *feature_value == 'n';
+	}
+	else if (ival < 0)
 	{
 		// Since this value is invalid, return success="0" to indicate the error.
 		// Setting the feature to a negative value might cause instability elsewhere.
@@ -1271,9 +1288,17 @@ void Debugger::PropertyWriter::WriteEnumItems(IObject *aEnumerable, int aStart,
 	
 	if (mProp.max_depth)
 	{
+		// Rather than calling the enumerator for every item preceding the requested page, which made
+		// viewing later pages of a large Map or Array very slow, skip directly to the first item if
+		// the enumerator supports it.
+		int i = 0;
+		if (aStart > 0)
+			if (auto ie = dynamic_cast<IndexEnumerator *>(enumerator))
+				if (ie->Seek((UINT)aStart))
+					i = aStart;
 		auto vkey = new VarRef(), vval = new VarRef();
 		ExprTokenType tparam[] = { vkey, vval }, *param[] = { tparam, tparam + 1 };
-		for (int i = 0; i < aEnd; ++i)
+		for ( ; i < aEnd; ++i)
 		{
 			result = CallEnumerator(enumerator, param, 2, false);
 			if (result != CONDITION_TRUE)
@@ -1327,7 +1352,7 @@ int Debugger::WritePropertyXml(PropertyInfo &aProp)
 		type = "undefined";
 	}
 	// If we fell through, value and type have been set appropriately above.
-	mResponseBuf.WriteF("<property name=\"%e\" fullname=\"%e\" type=\"%s\" facet=\"%s\" children=\"0\" encoding=\"base64\" size=\""
+	mResponseBuf.WriteF("<property name=\"%e\" fullname=\"%e\" type=\"%s\" facet=\"%s\" children=\"0\""
 		, aProp.name, aProp.fullname.GetString(), type, aProp.facet);
 	int err;
 	if (err = WritePropertyData(aProp.value, aProp.max_data))
@@ -1374,8 +1399,8 @@ void Debugger::AppendStringKey(CStringA &aNameBuf, size_t aParentNameLength, con
 }
 
 int Debugger::WritePropertyData(LPCTSTR aData, size_t aDataSize, int aMaxEncodedSize)
-// Accepts a "native" string, converts it to UTF-8, base64-encodes it and writes
-// the end of the property's size attribute followed by the base64-encoded data.
+// Accepts a "native" string, converts it to UTF-8, encodes it and writes the property's
+// encoding and size attributes followed by the encoded data.
 {
 	int err;
 	
@@ -1442,16 +1467,37 @@ int Debugger::WritePropertyData(LPCTSTR aData, size_t aDataSize, int aMaxEncoded
 	}
 	if (utf8_size == -1) // Data was not limited by aMaxEncodedSize.
 		utf8_size = (int)total_utf8_size;
+
+	if (mDataEncodingNone)
+	{
+		// XML text can't contain most control characters, even as character references.
+		int i;
+		for (i = 0; i < utf16_size; ++i)
+			if (utf16_value[i] < 0x20 && utf16_value[i] != '\t' && utf16_value[i] != '\n' && utf16_value[i] != '\r')
+				break;
+		if (i == utf16_size) // Data can be written as text.
+		{
+			char *utf8_value = (char *)malloc(utf8_size + 1);
+			if (!utf8_value)
+				return DEBUGGER_E_INTERNAL_ERROR;
+			utf8_size = WideCharToMultiByte(CP_UTF8, 0, utf16_value, utf16_size, utf8_value, utf8_size, NULL, NULL);
+			utf8_value[utf8_size] = '\0';
+			err = (!utf8_size && utf16_size) ? DEBUGGER_E_INTERNAL_ERROR // Conversion failed.
+				: mResponseBuf.WriteF(" encoding=\"none\" size=\"%u\">%e", total_utf8_size, utf8_value);
+			free(utf8_value);
+			return err;
+		}
+	}
 	
 	// Calculate maximum length of base64-encoded data.
 	int space_needed = DEBUGGER_BASE64_ENCODED_SIZE(utf8_size);
 	
-	// Reserve enough space for the data's length, "> and encoded data.
-	if (err = mResponseBuf.ExpandIfNecessary(mResponseBuf.mDataUsed + space_needed + MAX_INTEGER_LENGTH + 2))
+	// Reserve enough space for the attributes and encoded data.
+	if (err = mResponseBuf.ExpandIfNecessary(mResponseBuf.mDataUsed + space_needed + MAX_INTEGER_LENGTH + 28))
 		return err;
 	
-	// Complete the size attribute by writing the total size, in terms of UTF-8 bytes.
-	if (err = mResponseBuf.WriteF("%u\">", total_utf8_size))
+	// Write the size attribute, in terms of UTF-8 bytes.
+	if (err = mResponseBuf.WriteF(" encoding=\"base64\" size=\"%u\">", total_utf8_size))
 		return err;
 
 	// Convert to UTF-8, using mResponseBuf temporarily.
@@ -1882,7 +1928,7 @@ int Debugger::property_get_or_value(char **aArgV, int aArgCount, char *aTransact
 		else
 		{
 			mResponseBuf.WriteF(
-				"<response command=\"property_value\" transaction_id=\"%e\" encoding=\"base64\" size=\""
+				"<response command=\"property_value\" transaction_id=\"%e\""
 				, aTransactionId);
 			err = WritePropertyData(prop.value, prop.max_data);
 		}
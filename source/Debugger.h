@@ -274,7 +274,7 @@ public:
 
 	Debugger() : mSocket(INVALID_SOCKET), mInternalState(DIS_Starting)
 		, mMaxPropertyData(1024), mContinuationTransactionId(""), mStdErrMode(SR_Disabled), mStdOutMode(SR_Disabled)
-		, mMaxChildren(20), mMaxDepth(2), mDisabledHooks(0)
+		, mMaxChildren(20), mMaxDepth(2), mDataEncodingNone(false), mLastPollTick(0), mDisabledHooks(0)
 		, mThrownToken(NULL), mBreakOnExceptionID(0), mBreakOnExceptionWasSet(false), mBreakOnExceptionIsTemporary(false), mBreakOnException(false)
 	{
 	}
@@ -338,6 +338,8 @@ private:
 	CStringA mContinuationTransactionId; // transaction_id of last continuation command.
 
 	int mMaxPropertyData, mMaxChildren, mMaxDepth;
+	bool mDataEncodingNone; // feature_set -n data_encoding -v none: Send property data as XML text where possible.
+	DWORD mLastPollTick; // Tick count when PreExecLine() last checked the socket for an asynchronous command.
 
 	HookType mDisabledHooks;
 
@@ -0,0 +1,332 @@
+﻿#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Walks a directory tree on several threads while delivering the results to one consumer in
+// the same order as a sequential walk: the records of a directory, then the contents of each
+// of its subdirectories in turn.  Worker threads read ahead into a bounded buffer.  If no worker
+// has started on the directory the consumer needs next, the consumer reads it directly, so the
+// buffer limit can't cause a deadlock.  This has no dependencies on the OS; the owner supplies
+// a Lister which reads a single directory.
+
+enum DirScanEvent
+{
+	DIRSCAN_END,	// There are no more records.
+	DIRSCAN_RECORD,	// A record was returned.
+	DIRSCAN_ENTER,	// Following records are from a subdirectory, whose own record was returned.
+	DIRSCAN_LEAVE	// Following records are from the parent of the directory last entered.
+};
+
+enum DirScanItem
+{
+	DIRSCAN_ITEM_END,		// There are no more items in this directory.
+	DIRSCAN_ITEM_RECORD,	// A record to be returned to the consumer.
+	DIRSCAN_ITEM_SUBDIR		// A subdirectory to be scanned.  Its record is not returned until it is entered.
+};
+
+template<typename Record>
+class DirScan
+{
+	struct Block;
+
+public:
+	enum { BLOCK_SIZE = 32, MAX_THREADS = 16 };
+
+	struct Dir
+	{
+		Dir *mParent;
+		Record mEntry; // The item which the parent's lister returned for this directory.  Not set for the root.
+		int mDepth; // 0 for the root.
+
+		// The remaining members are for use by DirScan.
+		enum State { QUEUED, LISTING, LISTED } mState = QUEUED;
+		Block *mFirstBlock = nullptr, *mLastBlock = nullptr; // Records not yet taken by the consumer.
+		Dir *mFirstChild = nullptr, *mLastChild = nullptr, *mNextSibling = nullptr;
+		Dir *mNextVisit = nullptr; // The next child for the consumer to enter.
+		Dir *mPrevWork = nullptr, *mNextWork = nullptr; // Links in the work stack while QUEUED.
+		bool mChildrenQueued = false;
+
+		Dir(Dir *aParent) : mParent(aParent), mDepth(aParent ? aParent->mDepth + 1 : 0) {}
+		~Dir()
+		{
+			while (Block *block = mFirstBlock)
+			{
+				mFirstBlock = block->mNext;
+				delete block;
+			}
+			while (Dir *child = mFirstChild) // Only those which haven't been entered remain.
+			{
+				mFirstChild = child->mNextSibling;
+				delete child;
+			}
+		}
+	};
+
+	class Lister
+	{
+	public:
+		// Opens aDir for reading and returns a handle, or nullptr if it can't be read.  Subdirectories
+		// should be returned only if aWantSubdirs is true, and preferably before any records so that
+		// other threads can start on them sooner.  These may be called on any thread, including the
+		// consumer's, and for several directories at once.
+		virtual void *Open(Dir &aDir, bool aWantSubdirs) = 0;
+		virtual DirScanItem Read(void *aHandle, Record &aRecord) = 0;
+		virtual void Close(void *aHandle) = 0;
+	};
+
+	// aMaxDepth is the number of levels of subdirectories to scan, or 0 for no limit.
+	// aMaxRecords is the approximate number of records which the workers may read ahead.
+	DirScan(Lister &aLister, UINT aThreads, UINT aMaxRecords, int aMaxDepth)
+		: mLister(aLister), mRoot(nullptr), mCurrent(&mRoot)
+		, mMaxBlocks(aMaxRecords < BLOCK_SIZE ? 1 : aMaxRecords / BLOCK_SIZE), mMaxDepth(aMaxDepth)
+	{
+		mWorkTop = &mRoot;
+		mThreadCount = aThreads > (UINT)MAX_THREADS ? (UINT)MAX_THREADS : aThreads;
+		for (UINT i = 0; i < mThreadCount; ++i)
+			mThread[i] = std::thread(&DirScan::WorkerMain, this);
+	}
+
+	~DirScan()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			mStop = true;
+		}
+		mWorkReady.notify_all();
+		mSpace.notify_all();
+		for (UINT i = 0; i < mThreadCount; ++i)
+			mThread[i].join();
+		if (mDirect)
+			mLister.Close(mDirectHandle);
+		delete mBlock;
+		// Delete the directories which haven't been left yet.  Entered directories have already
+		// been removed from their parent's list of children.
+		while (Dir *dir = mCurrent)
+		{
+			mCurrent = dir->mParent;
+			if (dir != &mRoot)
+				delete dir;
+		}
+	}
+
+	// Called by the consumer to retrieve the next record or change of directory.
+	DirScanEvent Next(Record &aRecord)
+	{
+		for (;;)
+		{
+			if (mBlock)
+			{
+				if (mBlockIndex < mBlock->mCount)
+				{
+					aRecord = mBlock->mRecord[mBlockIndex++];
+					return DIRSCAN_RECORD;
+				}
+				delete mBlock;
+				mBlock = nullptr;
+			}
+			if (mDirect)
+			{
+				if (ReadRecord(*mCurrent, mDirectHandle, aRecord))
+					return DIRSCAN_RECORD;
+				if (mDirectHandle)
+					mLister.Close(mDirectHandle);
+				mDirect = false;
+				std::lock_guard<std::mutex> lock(mLock);
+				mCurrent->mState = Dir::LISTED;
+				continue;
+			}
+			if (!mCurrent)
+				return DIRSCAN_END;
+			std::unique_lock<std::mutex> lock(mLock);
+			Dir &dir = *mCurrent;
+			if (dir.mState == Dir::QUEUED)
+			{
+				// No worker has started on it yet, so read it directly rather than waiting.
+				RemoveWork(dir);
+				dir.mState = Dir::LISTING;
+				lock.unlock();
+				mDirectHandle = mLister.Open(dir, WantSubdirs(dir));
+				mDirect = true;
+				continue;
+			}
+			if (Block *block = dir.mFirstBlock)
+			{
+				if (  !(dir.mFirstBlock = block->mNext)  )
+					dir.mLastBlock = nullptr;
+				--mBufferedBlocks;
+				lock.unlock();
+				mSpace.notify_all();
+				mBlock = block;
+				mBlockIndex = 0;
+				continue;
+			}
+			if (dir.mState == Dir::LISTING)
+			{
+				mDirReady.wait(lock);
+				continue;
+			}
+			// All records of this directory have been returned.
+			if (Dir *child = dir.mNextVisit)
+			{
+				// Detach it so that it won't be deleted along with the parent's unvisited children.
+				dir.mNextVisit = dir.mFirstChild = child->mNextSibling;
+				mCurrent = child;
+				lock.unlock();
+				mSpace.notify_all(); // A worker might be waiting to read ahead in this directory.
+				aRecord = child->mEntry;
+				return DIRSCAN_ENTER;
+			}
+			mCurrent = dir.mParent;
+			if (&dir == &mRoot)
+				return DIRSCAN_END;
+			lock.unlock();
+			delete &dir;
+			return DIRSCAN_LEAVE;
+		}
+	}
+
+private:
+	struct Block
+	{
+		Block *mNext = nullptr;
+		int mCount = 0;
+		Record mRecord[BLOCK_SIZE];
+	};
+
+	Lister &mLister;
+	Dir mRoot;
+	Dir *mCurrent; // The directory being returned to the consumer.
+	Dir *mWorkTop = nullptr; // The next directory for a worker to read.
+	Block *mBlock = nullptr; // The block being returned to the consumer.
+	int mBlockIndex = 0;
+	void *mDirectHandle = nullptr;
+	bool mDirect = false; // True if the consumer is reading mCurrent directly.
+	UINT mBufferedBlocks = 0, mMaxBlocks;
+	int mMaxDepth;
+	std::atomic<bool> mStop {false};
+	std::mutex mLock;
+	std::condition_variable mWorkReady, mDirReady, mSpace;
+	std::thread mThread[MAX_THREADS];
+	UINT mThreadCount;
+
+	bool WantSubdirs(Dir &aDir)
+	{
+		return !mMaxDepth || aDir.mDepth < mMaxDepth;
+	}
+
+	void RemoveWork(Dir &aDir)
+	// Caller must hold mLock.
+	{
+		if (aDir.mPrevWork)
+			aDir.mPrevWork->mNextWork = aDir.mNextWork;
+		else
+			mWorkTop = aDir.mNextWork;
+		if (aDir.mNextWork)
+			aDir.mNextWork->mPrevWork = aDir.mPrevWork;
+		aDir.mPrevWork = aDir.mNextWork = nullptr;
+	}
+
+	void QueueChildren(Dir &aDir)
+	// Puts the children on top of the work stack in their original order, so that the workers
+	// tend to read directories in the same order as the consumer will need them.
+	{
+		aDir.mChildrenQueued = true;
+		if (!aDir.mFirstChild)
+			return;
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			for (Dir *child = aDir.mFirstChild, *prev = nullptr; child; prev = child, child = child->mNextSibling)
+			{
+				child->mPrevWork = prev;
+				child->mNextWork = child->mNextSibling;
+			}
+			if (  (aDir.mLastChild->mNextWork = mWorkTop)  )
+				mWorkTop->mPrevWork = aDir.mLastChild;
+			mWorkTop = aDir.mFirstChild;
+		}
+		mWorkReady.notify_all();
+	}
+
+	bool ReadRecord(Dir &aDir, void *aHandle, Record &aRecord)
+	// Reads items from aHandle until a record is found (returning true) or there are none left.
+	// Subdirectories are queued for the workers before the first record is returned.
+	{
+		for (;;)
+		{
+			DirScanItem item = aHandle && !mStop ? mLister.Read(aHandle, aRecord) : DIRSCAN_ITEM_END;
+			if (item == DIRSCAN_ITEM_SUBDIR)
+			{
+				if (aDir.mChildrenQueued || !WantSubdirs(aDir)) // Lister didn't follow the rules.
+					continue;
+				Dir *child = new Dir(&aDir);
+				child->mEntry = aRecord;
+				if (aDir.mLastChild)
+					aDir.mLastChild->mNextSibling = child;
+				else
+					aDir.mFirstChild = aDir.mNextVisit = child;
+				aDir.mLastChild = child;
+				continue;
+			}
+			if (!aDir.mChildrenQueued)
+				QueueChildren(aDir);
+			return item == DIRSCAN_ITEM_RECORD;
+		}
+	}
+
+	void WorkerMain()
+	{
+		std::unique_lock<std::mutex> lock(mLock);
+		for (;;)
+		{
+			while (!mWorkTop && !mStop)
+				mWorkReady.wait(lock);
+			if (mStop)
+				return;
+			Dir &dir = *mWorkTop;
+			RemoveWork(dir);
+			dir.mState = Dir::LISTING;
+			lock.unlock();
+			void *handle = mLister.Open(dir, WantSubdirs(dir));
+			Block *block = nullptr;
+			for (bool more = true; more; )
+			{
+				if (!block)
+					block = new Block;
+				while (block->mCount < BLOCK_SIZE
+					&& (more = ReadRecord(dir, handle, block->mRecord[block->mCount])))
+					++block->mCount;
+				lock.lock();
+				if (block->mCount)
+				{
+					if (dir.mLastBlock)
+						dir.mLastBlock->mNext = block;
+					else
+						dir.mFirstBlock = block;
+					dir.mLastBlock = block;
+					++mBufferedBlocks;
+					block = nullptr;
+				}
+				if (!more || mStop)
+				{
+					dir.mState = Dir::LISTED;
+					break;
+				}
+				if (&dir == mCurrent)
+					mDirReady.notify_all();
+				// Wait for the consumer to catch up, unless it is waiting for this directory.
+				while (mBufferedBlocks >= mMaxBlocks && &dir != mCurrent && !mStop)
+					mSpace.wait(lock);
+				lock.unlock();
+			}
+			// mLock is held at this point.
+			mDirReady.notify_all();
+			lock.unlock();
+			delete block;
+			if (handle)
+				mLister.Close(handle);
+			lock.lock();
+		}
+	}
+};
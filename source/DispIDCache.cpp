@@ -0,0 +1,96 @@
+﻿#include "stdafx.h" // pre-compiled headers
+#include "DispIDCache.h"
+
+
+UINT DispIDCache::sHits = 0;
+UINT DispIDCache::sMisses = 0;
+
+UINT DispIDCache::HashName(LPCTSTR aName)
+{
+	UINT hash = 2166136261u; // FNV-1a.
+	for (; *aName; ++aName)
+		hash = (hash ^ (TBYTE)*aName) * 16777619u;
+	return hash | 1;
+}
+
+bool DispIDCache::Find(LPCTSTR aName, DISPID &aDispID)
+{
+	// Names are compared case-sensitively since IDispatchEx objects such as JScript's may have
+	// members which differ only by case.  At worst, this causes one extra lookup per spelling.
+	for (int i = 0; i < MaxEntries && mEntry[i].name; ++i)
+	{
+		if (!_tcscmp(mEntry[i].name, aName))
+		{
+			aDispID = mEntry[i].dispid;
+			++sHits;
+			return true;
+		}
+	}
+	return false;
+}
+
+void DispIDCache::Add(LPCTSTR aName, DISPID aDispID)
+{
+	++sMisses; // Each addition follows a call to GetIDsOfNames().
+	LPTSTR name = _tcsdup(aName);
+	if (!name)
+		return; // Just don't cache it.
+	int i;
+	for (i = 0; i < MaxEntries && mEntry[i].name; ++i);
+	if (i == MaxEntries)
+	{
+		// Cache is full, so replace the entries in round-robin order.
+		i = mNext;
+		mNext = (mNext + 1) % MaxEntries;
+		free(mEntry[i].name);
+	}
+	mEntry[i].name = name;
+	mEntry[i].dispid = aDispID;
+}
+
+void DispIDCache::Remove(LPCTSTR aName)
+{
+	for (int i = 0; i < MaxEntries && mEntry[i].name; ++i)
+	{
+		if (!_tcscmp(mEntry[i].name, aName))
+		{
+			free(mEntry[i].name);
+			// Keep the used entries contiguous so that Find() can stop at the first empty one.
+			int last;
+			for (last = i; last + 1 < MaxEntries && mEntry[last + 1].name; ++last);
+			mEntry[i] = mEntry[last];
+			mEntry[last].name = nullptr;
+			mNext = 0;
+			return;
+		}
+	}
+}
+
+DispIDCache::~DispIDCache()
+{
+	for (int i = 0; i < MaxEntries && mEntry[i].name; ++i)
+		free(mEntry[i].name);
+}
+
+
+
+void DispIDCachePtr::Add(LPCTSTR aName, DISPID aDispID)
+{
+	if (!mCache)
+	{
+		UINT hash = DispIDCache::HashName(aName);
+		int i;
+		for (i = 0; i < RecentNames && mRecent[i] != hash; ++i);
+		if (i == RecentNames)
+		{
+			mRecent[mNextRecent] = hash;
+			mNextRecent = (mNextRecent + 1) % RecentNames;
+			++DispIDCache::sMisses;
+			return;
+		}
+		// This name has been looked up before, so the object is probably being used repeatedly.
+		if (  !(mCache = new DispIDCache)  )
+			return;
+	}
+	mCache->Add(aName, aDispID);
+}
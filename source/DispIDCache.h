@@ -0,0 +1,53 @@
+﻿#pragma once
+
+// Caches name-to-DISPID mappings for a single IDispatch object.  DISPIDs returned by GetIDsOfNames
+// must remain valid for the lifetime of the object, and each lookup may be a cross-apartment or
+// out-of-process call, so repeated access to the same member only needs one round trip.
+// The cache isn't shared between objects of the same type, since identifying the type (via
+// GetTypeInfo or IProvideClassInfo) would itself be a round trip for a remote object.  Instead,
+// see DispIDCachePtr.  This has no dependencies on COM other than the DISPID type.
+class DispIDCache
+{
+	enum { MaxEntries = 8 };
+	struct Entry
+	{
+		LPTSTR name;
+		DISPID dispid;
+	} mEntry[MaxEntries] {};
+	UINT mNext = 0; // Next entry to overwrite once the cache is full.
+
+public:
+	static UINT sHits, sMisses; // Lookups answered by the cache vs. by GetIDsOfNames.
+
+	// Returns a non-zero hash of aName, for detecting a repeated lookup before the cache exists.
+	static UINT HashName(LPCTSTR aName);
+
+	bool Find(LPCTSTR aName, DISPID &aDispID);
+	void Add(LPCTSTR aName, DISPID aDispID);
+	void Remove(LPCTSTR aName);
+	~DispIDCache();
+};
+
+
+// Owns the DispIDCache of an object, which is created only once a name is looked up for the
+// second time, so transient objects (such as the Range returned by each call to Excel's Cells)
+// don't pay for a cache they would never use.  Recently looked up names are remembered by hash
+// in a few slots, so that alternating between members (obj.A, obj.B, obj.A) creates the cache.
+class DispIDCachePtr
+{
+	enum { RecentNames = 4 };
+	DispIDCache *mCache = nullptr;
+	UINT mRecent[RecentNames] {}; // Hashes of names looked up before mCache was created.
+	UINT mNextRecent = 0; // Next element of mRecent to overwrite.
+
+public:
+	DispIDCachePtr() {}
+	DispIDCachePtr(const DispIDCachePtr &) = delete;
+	~DispIDCachePtr() { delete mCache; }
+
+	bool Find(LPCTSTR aName, DISPID &aDispID) { return mCache && mCache->Find(aName, aDispID); }
+	// Called after GetIDsOfNames() returns aDispID for aName.
+	void Add(LPCTSTR aName, DISPID aDispID);
+	void Remove(LPCTSTR aName) { if (mCache) mCache->Remove(aName); }
+	bool IsCreated() { return mCache != nullptr; }
+};
@@ -0,0 +1,154 @@
+﻿#include "stdafx.h" // pre-compiled headers
+#include "DllType.h"
+
+
+// Local equivalents of the Util.h helpers, so that this file can be built without windows.h.
+static inline bool IsSpaceOrTab(TCHAR c) { return c == ' ' || c == '\t'; }
+static inline TCHAR ToLowerAscii(TCHAR c) { return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c; }
+
+static inline LPCTSTR SkipSpaceOrTab(LPCTSTR aBuf)
+{
+	while (IsSpaceOrTab(*aBuf))
+		++aBuf;
+	return aBuf;
+}
+
+
+
+void ConvertDllArgType(LPCTSTR aBuf, DYNAPARM &aDynaParam)
+// Helper function for DllCall().  Updates aDynaParam's type and other attributes.
+{
+	LPCTSTR type_string = aBuf;
+	TCHAR buf[32];
+	
+	aDynaParam.is_ptr = ToLowerAscii(*type_string) == 'p'; // Any type other than "Ptr" with this prefix is invalid.
+
+	if (ToLowerAscii(*type_string) == 'u') // Unsigned
+	{
+		aDynaParam.is_unsigned = true;
+		++type_string; // Omit the 'U' prefix from further consideration.
+	}
+	else
+		aDynaParam.is_unsigned = false;
+	
+	// Check for empty string before checking for pointer suffix, so that we can skip the first character.  This is needed to simplify "Ptr" type-name support.
+	if (!*type_string)
+	{
+		aDynaParam.type = DLL_ARG_INVALID; 
+		return; 
+	}
+
+	// Make a modifiable copy for easier parsing below.  Anything truncated can't be a valid type.
+	size_t length = _tcslen(type_string);
+	if (length >= _countof(buf))
+		length = _countof(buf) - 1;
+	memcpy(buf, type_string, length * sizeof(TCHAR));
+	buf[length] = '\0';
+
+	// v1.0.30.02: The addition of 'P'.
+	// However, the current detection below relies upon the fact that none of the types currently
+	// contain the letter P anywhere in them, so it would have to be altered if that ever changes.
+	LPTSTR cp = _tcspbrk(buf + 1, _T("*pP")); // Asterisk or the letter P.  Relies on the check above to ensure type_string is not empty (and buf + 1 is valid).
+	if (cp && !*SkipSpaceOrTab(cp + 1)) // Additional validation: ensure nothing following the suffix.
+	{
+		aDynaParam.passed_by_address = true;
+		// Remove trailing options so that stricmp() can be used below.
+		// Allow optional space in front of asterisk (seems okay even for 'P').
+		while (cp > buf + 1 && IsSpaceOrTab(cp[-1]))
+			--cp;
+		*cp = '\0'; // Terminate at the leftmost whitespace or the suffix to remove both.
+	}
+	else
+		aDynaParam.passed_by_address = false;
+	// Using a switch benchmarks better than the old approach, which was an if-else-if ladder
+	// of string comparisons.  The old approach appeared to penalize Int64 vs. Int, perhaps due
+	// to position in the ladder.
+	switch (ToLowerAscii(*buf))
+	{
+	case 'i':
+		// This method currently benchmarks better than _tcsnicmp, especially for Int64.
+		if (ToLowerAscii(buf[1]) == 'n' && ToLowerAscii(buf[2]) == 't')
+		{
+			if (!buf[3])
+				aDynaParam.type = DLL_ARG_INT;
+			else if (buf[3] == '6' && buf[4] == '4' && !buf[5])
+				aDynaParam.type = DLL_ARG_INT64;
+			else
+				break;
+			return;
+		}
+		break;
+	case 'p': if (!_tcsicmp(buf, _T("Ptr")))	{ aDynaParam.type = sizeof(void *) == 8 ? DLL_ARG_INT64 : DLL_ARG_INT; return; } break;
+	case 's': if (!_tcsicmp(buf, _T("Str")))	{ aDynaParam.type = DLL_ARG_STR; return; }
+			  if (!_tcsicmp(buf, _T("Short")))	{ aDynaParam.type = DLL_ARG_SHORT; return; } break;
+	case 'd': if (!_tcsicmp(buf, _T("Double")))	{ aDynaParam.type = DLL_ARG_DOUBLE; return; } break;
+	case 'f': if (!_tcsicmp(buf, _T("Float")))	{ aDynaParam.type = DLL_ARG_FLOAT; return; } break;
+	case 'a': if (!_tcsicmp(buf, _T("AStr")))	{ aDynaParam.type = DLL_ARG_ASTR; return; } break;
+	case 'w': if (!_tcsicmp(buf, _T("WStr")))	{ aDynaParam.type = DLL_ARG_WSTR; return; } break;
+	case 'c': if (!_tcsicmp(buf, _T("Char")))	{ aDynaParam.type = DLL_ARG_CHAR; return; } break;
+	}
+	aDynaParam.type = DLL_ARG_INVALID;
+}
+
+
+
+int ConvertDllReturnType(LPCTSTR aBuf, DYNAPARM &aAttrib)
+// Helper function for DllCall() and DllProto.  Sets the return type attributes of aAttrib,
+// which the caller has initialized to zero, and returns the DC_ flags for DynaCall().
+// aAttrib.type is DLL_ARG_INVALID if aBuf isn't a valid return type.
+{
+	int call_mode = 0;
+
+	// 64-bit note: The calling convention detection code is preserved here for script compatibility.
+
+	if (!_tcsnicmp(aBuf, _T("CDecl"), 5)) // Alternate calling convention.
+	{
+		call_mode = DC_CALL_CDECL;
+		aBuf = SkipSpaceOrTab(aBuf + 5);
+		if (!*aBuf)
+		{	// Take a shortcut since we know this empty string will be used as "Int":
+			aAttrib.type = DLL_ARG_INT;
+			return call_mode;
+		}
+	}
+	if (!_tcsicmp(aBuf, _T("HRESULT")))
+	{
+		aAttrib.type = DLL_ARG_INT;
+		aAttrib.is_hresult = true;
+		//aAttrib.is_unsigned = true; // Not relevant since an exception is thrown for any negative value.
+	}
+	else
+		ConvertDllArgType(aBuf, aAttrib);
+
+	if (!aAttrib.passed_by_address) // i.e. the special return flags below are not needed when an address is being returned.
+	{
+		if (aAttrib.type == DLL_ARG_DOUBLE)
+			call_mode |= DC_RETVAL_MATH8;
+		else if (aAttrib.type == DLL_ARG_FLOAT)
+			call_mode |= DC_RETVAL_MATH4;
+	}
+	return call_mode;
+}
+
+
+
+__int64 DllIntValue(const DYNAPARM &aAttrib, int aValue)
+// Returns a return value or output parameter of type Int, Short or Char as the script should see it.
+// Bits beyond the width of the type are ignored, since the callee isn't required to clear them.
+{
+	switch (aAttrib.type)
+	{
+	case DLL_ARG_SHORT:
+		if (aAttrib.is_unsigned)
+			return aValue & 0x0000FFFF; // This also forces the value into the unsigned domain of a signed int.
+		return (short)(unsigned short)aValue; // These casts properly preserve negatives.
+	case DLL_ARG_CHAR:
+		if (aAttrib.is_unsigned)
+			return aValue & 0x000000FF;
+		return (signed char)(unsigned char)aValue;
+	default: // DLL_ARG_INT
+		if (aAttrib.is_unsigned)
+			return (unsigned int)aValue; // Preserve unsigned nature upon promotion to signed 64-bit.
+		return aValue;
+	}
+}
@@ -0,0 +1,80 @@
+﻿#pragma once
+
+// Type names and parameter attributes used by DllCall, DllProto and ComCall.
+// Parsing a signature has no dependencies on the OS; only the call itself, in DllCall.cpp, does.
+
+enum DllArgTypes {
+	  DLL_ARG_INVALID
+	, DLL_ARG_ASTR
+	, DLL_ARG_INT
+	, DLL_ARG_SHORT
+	, DLL_ARG_CHAR
+	, DLL_ARG_INT64
+	, DLL_ARG_FLOAT
+	, DLL_ARG_DOUBLE
+	, DLL_ARG_WSTR
+	, DLL_ARG_STRUCT
+#ifdef UNICODE
+	, DLL_ARG_STR  = DLL_ARG_WSTR
+	, DLL_ARG_xSTR = DLL_ARG_ASTR // To simplify some sections.
+#else
+	, DLL_ARG_STR  = DLL_ARG_ASTR
+	, DLL_ARG_xSTR = DLL_ARG_WSTR
+#endif
+};  // Some sections might rely on DLL_ARG_INVALID being 0.
+
+// Interface for DynaCall():
+#define  DC_MICROSOFT           0x0000      // Default
+#define  DC_BORLAND             0x0001      // Borland compat
+#define  DC_CALL_CDECL          0x0010      // __cdecl
+#define  DC_CALL_STD            0x0020      // __stdcall
+#define  DC_RETVAL_MATH4        0x0100      // Return value in ST
+#define  DC_RETVAL_MATH8        0x0200      // Return value in ST
+
+#define  DC_CALL_STD_BO         (DC_CALL_STD | DC_BORLAND)
+#define  DC_CALL_STD_MS         (DC_CALL_STD | DC_MICROSOFT)
+#define  DC_CALL_STD_M8         (DC_CALL_STD | DC_RETVAL_MATH8)
+
+union DYNARESULT                // Various result types
+{      
+    int     Int;                // Generic four-byte type
+    long    Long;               // Four-byte long
+    void   *Pointer;            // 32-bit pointer
+    float   Float;              // Four byte real
+    double  Double;             // 8-byte real
+    __int64 Int64;              // big int (64-bit)
+	UINT_PTR UIntPtr;
+};
+
+struct DYNAPARM
+{
+    union
+	{
+		int value_int; // Args whose width is less than 32-bit are also put in here because they are right justified within a 32-bit block on the stack.
+		float value_float;
+		__int64 value_int64;
+		UINT_PTR value_uintptr;
+		double value_double;
+		char *astr;
+		wchar_t *wstr;
+		void *ptr;
+    };
+	// Might help reduce struct size to keep other members last and adjacent to each other (due to
+	// 8-byte alignment caused by the presence of double and __int64 members in the union above).
+	DllArgTypes type;
+	union
+	{
+		int struct_size;
+		struct
+		{
+			bool passed_by_address;
+			bool is_unsigned; // Allows return value and output parameters to be interpreted as unsigned vs. signed.
+			bool is_hresult; // Only used for the return value.
+			bool is_ptr; // "Ptr" or "Ptr*", which permit an object with a Ptr property to be passed.
+		};
+	};
+};
+
+void ConvertDllArgType(LPCTSTR aBuf, DYNAPARM &aDynaParam);
+int ConvertDllReturnType(LPCTSTR aBuf, DYNAPARM &aAttrib);
+__int64 DllIntValue(const DYNAPARM &aAttrib, int aValue);
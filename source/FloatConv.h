@@ -0,0 +1,16 @@
+﻿#pragma once
+
+// Fast paths for converting between double and decimal strings.  Each function
+// returns a "not handled" result in the rare cases where the exact answer can't be
+// determined cheaply, in which case the caller should fall back to the CRT.
+
+// Formats aValue exactly as sprintf's "%.17g" would.  aBuf must have room for at
+// least FLOAT17G_BUF_SIZE characters.  Returns the length of the string, or -1 if
+// aValue must be formatted by the CRT (such as for inf and nan).
+#define FLOAT17G_BUF_SIZE 26
+int FormatFloat17g(double aValue, LPTSTR aBuf);
+
+// Parses a decimal number the same way as atof(), setting aValue and returning true
+// on success.  Returns false if aBuf needs the CRT, such as when it contains leading
+// whitespace, hexadecimal, inf/nan or more than 19 significant digits.
+bool ParseFloatFast(LPCTSTR aBuf, double &aValue);
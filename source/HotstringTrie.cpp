@@ -0,0 +1,112 @@
+﻿#include "stdafx.h" // pre-compiled headers
+#include "HotstringTrie.h"
+
+
+
+HotstringTrie *HotstringTrie::Create(HotstringIDType aCount, AbbrevFunc aAbbrev, FoldFunc aFold)
+{
+	HotstringTrie *trie = new HotstringTrie;
+	trie->mFold = aFold;
+	if (  !(trie->mNextHs = (HotstringIDType *)malloc(aCount * sizeof(HotstringIDType)))
+		|| !trie->AddNode(0)  ) // The root.
+	{
+		delete trie;
+		return NULL;
+	}
+	// Add hotstrings in reverse order so that each node's list of hotstrings ends up in ascending
+	// order, which is the order of precedence.
+	for (HotstringIDType u = aCount; u-- > 0; )
+	{
+		int length;
+		LPCTSTR abbrev = aAbbrev(u, length);
+		UINT node = 0;
+		for (LPCTSTR cp = abbrev + length; cp-- > abbrev; )
+		{
+			TCHAR ch = aFold(*cp);
+			UINT child;
+			for (child = trie->mNode[node].first_child; child && trie->mNode[child].ch != ch; child = trie->mNode[child].next_sibling);
+			if (!child)
+			{
+				if (!trie->AddNode(ch))
+				{
+					delete trie;
+					return NULL;
+				}
+				child = trie->mNodeCount - 1;
+				trie->mNode[child].next_sibling = trie->mNode[node].first_child;
+				trie->mNode[node].first_child = child;
+			}
+			node = child;
+		}
+		trie->mNextHs[u] = trie->mNode[node].first_hs;
+		trie->mNode[node].first_hs = u;
+	}
+	trie->mCount = aCount;
+	return trie;
+}
+
+
+
+bool HotstringTrie::AddNode(TCHAR aChar)
+{
+	if (mNodeCount == mNodeCapacity)
+	{
+		UINT new_capacity = mNodeCapacity ? mNodeCapacity * 2 : 256;
+		Node *new_node = (Node *)realloc(mNode, new_capacity * sizeof(Node));
+		if (!new_node)
+			return false;
+		mNode = new_node;
+		mNodeCapacity = new_capacity;
+	}
+	Node &node = mNode[mNodeCount++];
+	node.first_child = node.next_sibling = 0;
+	node.first_hs = HS_TRIE_NONE;
+	node.ch = aChar;
+	return true;
+}
+
+
+
+int HotstringTrie::FindCandidates(LPCTSTR aBuf, int aLength, bool aEndCharTyped, HotstringIDType aCandidate[], int aMaxCandidates)
+// Sets aCandidate to the IDs of hotstrings which might match the end of aBuf, in ascending order.
+// If aEndCharTyped is true, hotstrings which match just before the last character are also included.
+// Returns the number of candidates, or -1 if there are more than aMaxCandidates.
+{
+	int count = 0;
+	Walk(aBuf, aLength, aCandidate, count, aMaxCandidates);
+	if (aEndCharTyped && count >= 0)
+		Walk(aBuf, aLength - 1, aCandidate, count, aMaxCandidates);
+	return count;
+}
+
+
+
+void HotstringTrie::Walk(LPCTSTR aBuf, int aLength, HotstringIDType aCandidate[], int &aCount, int aMaxCandidates)
+{
+	UINT node = 0;
+	for (int i = aLength - 1; i >= 0; --i)
+	{
+		TCHAR ch = mFold(aBuf[i]);
+		UINT child;
+		for (child = mNode[node].first_child; child && mNode[child].ch != ch; child = mNode[child].next_sibling);
+		if (!child)
+			return;
+		node = child;
+		for (HotstringIDType u = mNode[node].first_hs; u != HS_TRIE_NONE; u = mNextHs[u])
+		{
+			// Insert u in order, since the caller must check candidates in order of precedence.
+			int j;
+			for (j = aCount; j > 0 && aCandidate[j - 1] > u; --j);
+			if (j > 0 && aCandidate[j - 1] == u)
+				continue; // Already found by the other walk.
+			if (aCount == aMaxCandidates)
+			{
+				aCount = -1;
+				return;
+			}
+			memmove(aCandidate + j + 1, aCandidate + j, (aCount - j) * sizeof(HotstringIDType));
+			aCandidate[j] = u;
+			++aCount;
+		}
+	}
+}
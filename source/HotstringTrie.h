@@ -0,0 +1,45 @@
+﻿#pragma once
+
+typedef UINT HotstringIDType;
+
+// Used by the hook to narrow down which hotstrings might match the end of its buffer, so that
+// the work done per keystroke doesn't grow with the number of hotstrings.  Abbreviations are
+// stored in reverse order and case-folded (with ltolower() for the hook), so each candidate must
+// still be checked against the hotstring's own options (such as case sensitivity and end-char).
+// The abbreviations and the case-folding function are supplied by the caller, so this has no
+// dependencies on the OS.
+class HotstringTrie
+{
+public:
+	typedef LPCTSTR (*AbbrevFunc)(HotstringIDType aID, int &aLength);
+	typedef TCHAR (*FoldFunc)(TCHAR aChar);
+
+private:
+	struct Node
+	{
+		UINT first_child, next_sibling; // 0 means none, since the root is never a child.
+		HotstringIDType first_hs; // The first hotstring whose abbreviation ends here, or HS_TRIE_NONE.
+		TCHAR ch; // The character which leads to this node from its parent.
+	};
+
+	Node *mNode = nullptr;
+	UINT mNodeCount = 0, mNodeCapacity = 0;
+	HotstringIDType *mNextHs = nullptr; // Links hotstrings which end at the same node, in ascending order.
+	HotstringIDType mCount = 0; // Hotstrings 0..mCount-1 are covered.
+	FoldFunc mFold = nullptr;
+
+	bool AddNode(TCHAR aChar);
+	void Walk(LPCTSTR aBuf, int aLength, HotstringIDType aCandidate[], int &aCount, int aMaxCandidates);
+
+public:
+	#define HS_TRIE_NONE ((HotstringIDType)-1)
+	#define HS_TRIE_MAX_TAIL 32 // Hotstrings added at runtime are checked linearly until this many accumulate.
+	#define HS_TRIE_MAX_CANDIDATES 64
+
+	// Builds a trie of hotstrings 0..aCount-1, whose abbreviations are given by aAbbrev.
+	// Returns NULL if out of memory.
+	static HotstringTrie *Create(HotstringIDType aCount, AbbrevFunc aAbbrev, FoldFunc aFold);
+	~HotstringTrie() { free(mNode); free(mNextHs); }
+	HotstringIDType Count() { return mCount; }
+	int FindCandidates(LPCTSTR aBuf, int aLength, bool aEndCharTyped, HotstringIDType aCandidate[], int aMaxCandidates);
+};
@@ -0,0 +1,42 @@
+﻿#pragma once
+
+// Key and modifier types shared by the keyboard code and SendPlan.h.  These have no dependencies on the OS.
+
+// UPDATE for v1.0.39: Changed sc_type to USHORT vs. UINT to save memory in structs such as sc_hotkey.
+// This saves 60K of memory in one place, and possibly there are other large savings too.
+// The following older comment dates back to 2003/inception and I don't remember its exact intent,
+// but there is no current storage of mouse message constants in scan code variables:
+// OLD: Although only need 9 bits for compressed and 16 for uncompressed scan code, use a full 32 bits 
+// so that mouse messages (WPARAM) can be stored as scan codes.  Formerly USHORT (which is always 16-bit).
+typedef USHORT sc_type; // Scan code.
+typedef UCHAR vk_type;  // Virtual key.
+typedef UINT mod_type;  // Standard Windows modifier type for storing MOD_CONTROL, MOD_WIN, MOD_ALT, MOD_SHIFT.
+
+// The maximum number of virtual keys and scan codes that can ever exist.
+// As of WinXP, these are absolute limits, except for scan codes for which there might conceivably
+// be more if any non-standard keyboard or keyboard drivers generate scan codes that don't start
+// with either 0x00 or 0xE0.  UPDATE: Decided to allow all possible scancodes, rather than just 512,
+// since a lookup array for the 16-bit scan code value will only consume 64K of RAM if the element
+// size is one char.  UPDATE: decided to go back to 512 scan codes, because WinAPI's KeyboardProc()
+// itself can only handle that many (a 9-bit value).  254 is the largest valid vk, according to the
+// WinAPI docs (I think 255 is value that is sometimes returned to indicate an invalid vk).  But
+// just in case something ever tries to access such arrays using the largest 8-bit value (255), add
+// 1 to make it 0xFF, thus ensuring array indexes will always be in-bounds if they are 8-bit values.
+#define VK_MAX 0xFF
+#define SC_MAX 0x1FF
+
+typedef UCHAR modLR_type; // Only the left-right win/alt/ctrl/shift rather than their generic counterparts.
+#define MODLR_MAX 0xFF
+#define MODLR_COUNT 8
+#define MOD_LCONTROL 0x01
+#define MOD_RCONTROL 0x02
+#define MOD_LALT 0x04
+#define MOD_RALT 0x08
+#define MOD_LSHIFT 0x10
+#define MOD_RSHIFT 0x20
+#define MOD_LWIN 0x40
+#define MOD_RWIN 0x80
+#define MODLR_LMASK (MOD_LCONTROL | MOD_LALT | MOD_LSHIFT | MOD_LWIN)
+#define MODLR_RMASK (MOD_RCONTROL | MOD_RALT | MOD_RSHIFT | MOD_RWIN)
+#define MODLR_MASK (MODLR_LMASK | MODLR_RMASK)
+#define MODLR_STRING _T("<^>^<!>!<+>+<#>#")
@@ -0,0 +1,79 @@
+﻿#include "stdafx.h" // pre-compiled headers
+#include "LatencyHistogram.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+static inline int HighestBit(UINT64 aValue)
+// Caller must ensure aValue is non-zero.
+{
+#ifdef _MSC_VER
+	unsigned long index;
+#ifdef _WIN64
+	_BitScanReverse64(&index, aValue);
+#else
+	if (_BitScanReverse(&index, (ULONG)(aValue >> 32)))
+		return 32 + (int)index;
+	_BitScanReverse(&index, (ULONG)aValue);
+#endif
+	return (int)index;
+#else
+	return 63 - __builtin_clzll(aValue);
+#endif
+}
+
+
+
+int LatencyHistogram::BucketOf(UINT64 aValue)
+{
+	if (aValue < 2 * SUB_BUCKET_COUNT)
+		return (int)aValue;
+	// Keep the highest SUB_BUCKET_BITS + 1 bits, the first of which is always 1.
+	int shift = HighestBit(aValue) - SUB_BUCKET_BITS;
+	return ((shift + 1) << SUB_BUCKET_BITS) + (int)(aValue >> shift) - SUB_BUCKET_COUNT;
+}
+
+
+
+UINT64 LatencyHistogram::BucketUpperBound(int aBucket)
+{
+	if (aBucket < 2 * SUB_BUCKET_COUNT)
+		return aBucket;
+	int shift = (aBucket >> SUB_BUCKET_BITS) - 1;
+	UINT64 sub_bucket = (aBucket & (SUB_BUCKET_COUNT - 1)) + SUB_BUCKET_COUNT;
+	return ((sub_bucket + 1) << shift) - 1; // Wraps around to the correct value for the very last bucket.
+}
+
+
+
+void LatencyHistogram::Reset()
+{
+	for (int i = 0; i < BUCKET_COUNT; ++i)
+		mBucket[i] = 0;
+	mCount = mSum = mMax = 0;
+}
+
+
+
+UINT64 LatencyHistogram::ValueAtPercentile(double aPercentile)
+{
+	UINT64 count = mCount; // Copy it in case it changes while we're counting.
+	if (!count)
+		return 0;
+	// Find the first bucket at which the running total reaches the required rank.
+	UINT64 rank = (UINT64)(aPercentile / 100 * count + 0.5);
+	if (rank < 1)
+		rank = 1;
+	UINT64 total = 0;
+	for (int i = 0; i < BUCKET_COUNT; ++i)
+	{
+		total += mBucket[i];
+		if (total >= rank)
+		{
+			UINT64 bound = BucketUpperBound(i);
+			return bound < mMax ? bound : mMax;
+		}
+	}
+	return mMax;
+}
@@ -0,0 +1,48 @@
+﻿#pragma once
+
+// Counts durations (or any other unsigned values) in buckets whose width is 1/8 of their
+// magnitude, in the style of an HDR histogram.  Any value can be recorded, and any
+// percentile reported to within 12.5%, using a fixed-size table; recording only costs a
+// bit scan and a few increments, so it can be left enabled in time-critical code such as
+// the hooks.  This has no dependencies on the OS.
+//
+// Record() isn't synchronized.  Readers on other threads may see a slightly inconsistent
+// snapshot, which is acceptable for statistics.
+class LatencyHistogram
+{
+public:
+	enum
+	{
+		SUB_BUCKET_BITS = 3,
+		SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS,
+		// Values below 2*SUB_BUCKET_COUNT have a bucket each.  Above that, each power of two
+		// is split into SUB_BUCKET_COUNT buckets, up to the highest bit of a 64-bit value.
+		BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT
+	};
+
+	void Record(UINT64 aValue)
+	{
+		++mBucket[BucketOf(aValue)];
+		++mCount;
+		mSum += aValue;
+		if (mMax < aValue)
+			mMax = aValue;
+	}
+
+	void Reset();
+
+	UINT64 Count() { return mCount; }
+	UINT64 Max() { return mMax; }
+	UINT64 Mean() { return mCount ? mSum / mCount : 0; }
+	
+	// Returns the highest value which might be in the same bucket as the value at aPercentile
+	// (0 to 100), but not more than the maximum recorded value.  Returns 0 if there are none.
+	UINT64 ValueAtPercentile(double aPercentile);
+
+	static int BucketOf(UINT64 aValue);
+	static UINT64 BucketUpperBound(int aBucket);
+
+private:
+	UINT mBucket[BUCKET_COUNT] = {};
+	UINT64 mCount = 0, mSum = 0, mMax = 0;
+};
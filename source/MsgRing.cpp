@@ -0,0 +1,298 @@
+#include "stdafx.h" // pre-compiled headers
+#include "MsgRing.h"
+#include <string.h>
+#include <new>
+
+
+#define MSGRING_MAGIC 0x474D4841 // "AHMG"
+// Fragments are limited to a fraction of the ring so that the reader can consume one while
+// the writer is producing the next.
+#define MSGRING_MAX_FRAGMENT(capacity) ((capacity) / 4)
+
+static inline uint32_t RecordSize(uint32_t aFragment) { return 4 + ((aFragment + 3) & ~3u); }
+
+static inline bool IsLittleEndian()
+{
+	const uint16_t one = 1;
+	return *(const uint8_t *)&one == 1;
+}
+
+
+
+bool MsgBuffer::Reserve(size_t aExtra)
+{
+	if (mLength + aExtra <= mCapacity)
+		return true;
+	size_t new_capacity = mCapacity ? mCapacity * 2 : 256;
+	if (new_capacity < mLength + aExtra)
+		new_capacity = mLength + aExtra;
+	auto new_data = (uint8_t *)realloc(mData, new_capacity);
+	if (!new_data)
+		return false;
+	mData = new_data;
+	mCapacity = new_capacity;
+	return true;
+}
+
+
+bool MsgBuffer::Append(const void *aData, size_t aSize)
+{
+	if (!Reserve(aSize))
+		return false;
+	memcpy(mData + mLength, aData, aSize);
+	mLength += aSize;
+	return true;
+}
+
+
+uint8_t *MsgBuffer::Extend(size_t aSize)
+{
+	if (!Reserve(aSize))
+		return nullptr;
+	mLength += aSize;
+	return mData + mLength - aSize;
+}
+
+
+bool MsgBuffer::WriteByte(uint8_t aValue)
+{
+	if (mLength == mCapacity && !Reserve(1))
+		return false;
+	mData[mLength++] = aValue;
+	return true;
+}
+
+
+bool MsgBuffer::WriteVarUInt(uint64_t aValue)
+// Writes 7 bits per byte, least significant first, with the high bit set on all but the last.
+{
+	if (!Reserve(10))
+		return false;
+	while (aValue >= 0x80)
+	{
+		mData[mLength++] = uint8_t(aValue | 0x80);
+		aValue >>= 7;
+	}
+	mData[mLength++] = uint8_t(aValue);
+	return true;
+}
+
+
+bool MsgBuffer::WriteInt(int64_t aValue)
+{
+	return WriteVarUInt(((uint64_t)aValue << 1) ^ (uint64_t)(aValue >> 63));
+}
+
+
+bool MsgBuffer::WriteDouble(double aValue)
+{
+	uint64_t bits;
+	memcpy(&bits, &aValue, sizeof(bits));
+	if (!Reserve(8))
+		return false;
+	for (int i = 0; i < 8; ++i, bits >>= 8)
+		mData[mLength++] = uint8_t(bits);
+	return true;
+}
+
+
+bool MsgBuffer::WriteString(const void *aText, size_t aLength)
+{
+	if (!WriteVarUInt(aLength) || !Reserve(aLength * 2))
+		return false;
+	if (IsLittleEndian())
+		memcpy(mData + mLength, aText, aLength * 2);
+	else
+		for (size_t i = 0; i < aLength; ++i)
+		{
+			uint16_t c = ((const uint16_t *)aText)[i];
+			mData[mLength + i * 2] = uint8_t(c);
+			mData[mLength + i * 2 + 1] = uint8_t(c >> 8);
+		}
+	mLength += aLength * 2;
+	return true;
+}
+
+
+
+bool MsgReader::ReadByte(uint8_t &aValue)
+{
+	if (mPos == mEnd)
+		return false;
+	aValue = *mPos++;
+	return true;
+}
+
+
+bool MsgReader::ReadVarUInt(uint64_t &aValue)
+{
+	aValue = 0;
+	for (int shift = 0; mPos < mEnd && shift < 64; shift += 7)
+	{
+		uint8_t b = *mPos++;
+		aValue |= uint64_t(b & 0x7F) << shift;
+		if (!(b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+
+bool MsgReader::ReadInt(int64_t &aValue)
+{
+	uint64_t n;
+	if (!ReadVarUInt(n))
+		return false;
+	aValue = int64_t(n >> 1) ^ -int64_t(n & 1);
+	return true;
+}
+
+
+bool MsgReader::ReadDouble(double &aValue)
+{
+	if (mEnd - mPos < 8)
+		return false;
+	uint64_t bits = 0;
+	for (int i = 7; i >= 0; --i)
+		bits = (bits << 8) | mPos[i];
+	mPos += 8;
+	memcpy(&aValue, &bits, sizeof(bits));
+	return true;
+}
+
+
+bool MsgReader::ReadString(const void *&aText, size_t &aLength)
+{
+	uint64_t length;
+	if (!ReadVarUInt(length) || length > uint64_t(mEnd - mPos) / 2)
+		return false;
+	aText = mPos;
+	aLength = (size_t)length;
+	mPos += aLength * 2;
+	return true;
+}
+
+
+
+bool MsgRing::Create(void *aMemory, uint32_t aCapacity)
+{
+	if (aCapacity < MIN_CAPACITY || (aCapacity & (aCapacity - 1)))
+		return false;
+	mHeader = new (aMemory) Header();
+	mHeader->mCapacity = aCapacity;
+	mHeader->mMagic = MSGRING_MAGIC;
+	mData = (uint8_t *)(mHeader + 1);
+	mMask = aCapacity - 1;
+	return true;
+}
+
+
+bool MsgRing::Open(void *aMemory, size_t aSize)
+{
+	auto header = (Header *)aMemory;
+	if (aSize < sizeof(Header) || header->mMagic != MSGRING_MAGIC)
+		return false;
+	uint32_t capacity = header->mCapacity;
+	if (capacity < MIN_CAPACITY || (capacity & (capacity - 1)) || aSize < SizeFor(capacity))
+		return false;
+	mHeader = header;
+	mData = (uint8_t *)(header + 1);
+	mMask = capacity - 1;
+	return true;
+}
+
+
+void MsgRing::CopyIn(uint32_t aOffset, const void *aData, uint32_t aSize)
+{
+	aOffset &= mMask;
+	uint32_t first = mMask + 1 - aOffset;
+	if (first >= aSize)
+		memcpy(mData + aOffset, aData, aSize);
+	else
+	{
+		memcpy(mData + aOffset, aData, first);
+		memcpy(mData, (const uint8_t *)aData + first, aSize - first);
+	}
+}
+
+
+void MsgRing::CopyOut(uint32_t aOffset, void *aData, uint32_t aSize)
+{
+	aOffset &= mMask;
+	uint32_t first = mMask + 1 - aOffset;
+	if (first >= aSize)
+		memcpy(aData, mData + aOffset, aSize);
+	else
+	{
+		memcpy(aData, mData + aOffset, first);
+		memcpy((uint8_t *)aData + first, mData, aSize - first);
+	}
+}
+
+
+bool MsgRing::Write(const void *aData, size_t aSize, size_t &aWritten)
+{
+	uint32_t capacity = mMask + 1;
+	uint32_t tail = mHeader->mTail.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		uint32_t space = capacity - (tail - mHeader->mHead.load(std::memory_order_acquire));
+		size_t remaining = aSize - aWritten;
+		uint32_t fragment = MSGRING_MAX_FRAGMENT(capacity);
+		if (remaining < fragment)
+			fragment = (uint32_t)remaining;
+		if (RecordSize(fragment) > space)
+		{
+			// Write whatever fits, unless it's so little that the header would be a large part of it.
+			if (space < 64 + 4)
+				return false;
+			fragment = (space - 4) & ~3u;
+		}
+		bool more = remaining > fragment;
+		uint32_t header = more ? fragment | FRAGMENT_MORE : fragment;
+		// The header is never split since records are aligned and the capacity is a multiple of 4.
+		memcpy(mData + (tail & mMask), &header, 4);
+		CopyIn(tail + 4, (const uint8_t *)aData + aWritten, fragment);
+		tail += RecordSize(fragment);
+		aWritten += fragment;
+		// Sequentially consistent so that TakeWakeRequest() can't see a stale mWaiting.
+		mHeader->mTail.store(tail);
+		if (!more)
+			return true;
+	}
+}
+
+
+bool MsgRing::Read(MsgBuffer &aMessage)
+{
+	uint32_t head = mHeader->mHead.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		uint32_t available = mHeader->mTail.load(std::memory_order_acquire) - head;
+		if (!available)
+			return false;
+		uint32_t header;
+		memcpy(&header, mData + (head & mMask), 4);
+		uint32_t fragment = header & ~FRAGMENT_MORE;
+		// Validate the header, since the other side might not be trustworthy.  A bad record is
+		// left in place, so the channel effectively stops.
+		if (available > mMask + 1 || RecordSize(fragment) > available)
+			return false;
+		auto dest = aMessage.Extend(fragment);
+		if (!dest)
+			return false;
+		CopyOut(head + 4, dest, fragment);
+		head += RecordSize(fragment);
+		mHeader->mHead.store(head, std::memory_order_release);
+		if (!(header & FRAGMENT_MORE))
+			return true;
+	}
+}
+
+
+bool MsgRing::PrepareToWait()
+{
+	// Sequentially consistent to pair with the store of mTail in Write().
+	mHeader->mWaiting.store(1);
+	return mHeader->mHead.load(std::memory_order_relaxed) == mHeader->mTail.load();
+}
@@ -0,0 +1,150 @@
+﻿#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Passes variable-length messages from one thread or process to another through a ring buffer
+// in a block of memory supplied by the caller, such as a file mapping shared by two processes.
+// There must be exactly one writer and one reader.  Messages which don't fit in the ring are
+// written in fragments, so the reader must be consuming them for a large message to complete.
+// This has no dependencies on the OS; the caller is responsible for waking the reader when
+// TakeWakeRequest() returns true, and the writer when TakeSpaceRequest() returns true.
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "MsgRing requires lock-free atomics to work between processes.");
+
+// Tags for values serialized with MsgBuffer.  A value is a tag byte followed by:
+//  STRING: WriteString().  INTEGER: WriteInt().  FLOAT: WriteDouble().
+//  ARRAY: the item count, then each item.  UNSET can only appear as an item.
+//  MAP, OBJECT: the pair count, then each key followed by its value.  Keys are STRING or INTEGER
+//  values (only STRING for OBJECT).
+enum MsgValueTag { MSG_UNSET, MSG_STRING, MSG_INTEGER, MSG_FLOAT, MSG_ARRAY, MSG_MAP, MSG_OBJECT };
+
+class MsgBuffer
+// A growable block of bytes, used both to build a message and to reassemble one.
+{
+	uint8_t *mData = nullptr;
+	size_t mLength = 0, mCapacity = 0;
+
+public:
+	MsgBuffer() {}
+	MsgBuffer(const MsgBuffer &) = delete;
+	~MsgBuffer() { free(mData); }
+
+	uint8_t *Data() { return mData; }
+	size_t Length() { return mLength; }
+	void Clear() { mLength = 0; }
+	// Removes aSize bytes from the beginning.
+	void Erase(size_t aSize) { memmove(mData, mData + aSize, mLength -= aSize); }
+
+	bool Reserve(size_t aExtra);
+	bool Append(const void *aData, size_t aSize);
+	// Increases the length by aSize and returns a pointer to the new bytes, or nullptr on failure.
+	uint8_t *Extend(size_t aSize);
+
+	// Serialization primitives.  Everything is written in little-endian order regardless of the
+	// host, with variable-length encoding for integers, counts and lengths.  Strings are UTF-16,
+	// so are copied as-is on a little-endian host.
+	bool WriteByte(uint8_t aValue);
+	bool WriteVarUInt(uint64_t aValue);
+	bool WriteInt(int64_t aValue); // Zigzag-encoded so that small negative numbers are small.
+	bool WriteDouble(double aValue);
+	bool WriteString(const void *aText, size_t aLength); // aLength is in code units.
+};
+
+class MsgReader
+// Reads the primitives written by MsgBuffer.  Each method returns false if the message is truncated.
+{
+	const uint8_t *mPos, *mEnd;
+
+public:
+	MsgReader(const void *aData, size_t aLength) : mPos((const uint8_t *)aData), mEnd(mPos + aLength) {}
+
+	bool AtEnd() { return mPos == mEnd; }
+
+	bool ReadByte(uint8_t &aValue);
+	bool ReadVarUInt(uint64_t &aValue);
+	bool ReadInt(int64_t &aValue);
+	bool ReadDouble(double &aValue);
+	// Sets aText to the string within the message, which is in little-endian order and not
+	// necessarily aligned.  aLength is in code units.  The caller must copy the string before the message is discarded.
+	bool ReadString(const void *&aText, size_t &aLength);
+};
+
+class MsgRing
+{
+	struct Header
+	{
+		uint32_t mMagic;
+		uint32_t mCapacity; // Size of the data area; a power of two.
+		// Offsets are free-running and are masked by the capacity when used.  Each is written only
+		// by one side, and they are kept on separate cache lines to avoid false sharing.
+		alignas(64) std::atomic<uint32_t> mHead; // Written by the reader.
+		std::atomic<uint32_t> mWaiting; // Set by the reader before it waits; cleared by the writer.
+		alignas(64) std::atomic<uint32_t> mTail; // Written by the writer.
+		std::atomic<uint32_t> mSpaceWaiting; // Set by the writer when the ring is full; cleared by the reader.
+	};
+
+	Header *mHeader = nullptr;
+	uint8_t *mData = nullptr;
+	uint32_t mMask = 0;
+
+	void CopyIn(uint32_t aOffset, const void *aData, uint32_t aSize);
+	void CopyOut(uint32_t aOffset, void *aData, uint32_t aSize);
+
+public:
+	enum { MIN_CAPACITY = 256, FRAGMENT_MORE = 0x80000000 };
+
+	// Returns the number of bytes of memory required for a ring with aCapacity bytes of data.
+	// aCapacity must be a power of two and at least MIN_CAPACITY.
+	static size_t SizeFor(uint32_t aCapacity) { return sizeof(Header) + aCapacity; }
+
+	// Initializes a new ring in aMemory, which must be suitably aligned and zero-filled.
+	bool Create(void *aMemory, uint32_t aCapacity);
+	// Attaches to a ring which was created by another thread or process.  aSize is the size of
+	// the memory block, for validation.
+	bool Open(void *aMemory, size_t aSize);
+
+	//
+	// Writer
+	//
+
+	// Writes aData[aWritten..aSize) as one message, in as many fragments as necessary, and updates
+	// aWritten.  Returns true if the whole message was written, or false if the ring became full,
+	// in which case the caller should wait for the reader and then call it again with the same
+	// parameters.  If the ring is empty on entry, the message is guaranteed to make progress.
+	bool Write(const void *aData, size_t aSize, size_t &aWritten);
+	// Returns true if the reader is waiting for data, and clears the request.  The caller must
+	// then wake the reader.  Should be called after each call to Write().
+	bool TakeWakeRequest() { return mHeader->mWaiting.load() && mHeader->mWaiting.exchange(0); }
+	// Returns true if the reader has consumed everything written so far.
+	bool IsEmpty() { return mHeader->mHead.load() == mHeader->mTail.load(std::memory_order_relaxed); }
+	// Called after Write() returns false, to ask the reader to wake the writer once it has consumed
+	// some data.  The caller must then call Write() again before waiting, since the reader might have
+	// made room before it could see the request.
+	void RequestSpace()
+	{
+		mHeader->mSpaceWaiting.store(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst); // Pairs with the fence in TakeSpaceRequest().
+	}
+
+	//
+	// Reader
+	//
+
+	// Appends the fragments of the next message to aMessage.  Returns true if the message is
+	// complete, or false if the ring is empty (in which case aMessage may hold a partial message,
+	// which should be passed back in on the next call).
+	bool Read(MsgBuffer &aMessage);
+	// Called before waiting for data.  Returns true if the ring is still empty, in which case the
+	// writer will request a wake-up after it writes.  Returns false if data arrived in the meantime.
+	bool PrepareToWait();
+	// Returns true if the writer is waiting for space, and clears the request.  The caller must then
+	// wake the writer.  Should be called after each call to Read(), whether or not it returned true.
+	bool TakeSpaceRequest()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst); // Order the store of mHead before the load below.
+		return mHeader->mSpaceWaiting.load(std::memory_order_relaxed) && mHeader->mSpaceWaiting.exchange(0);
+	}
+};
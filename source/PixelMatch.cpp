@@ -0,0 +1,229 @@
+﻿#include "stdafx.h" // pre-compiled headers
+#include "PixelMatch.h"
+#include <limits.h>
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXELMATCH_SSE2
+#endif
+
+// Each pixel is compared by taking the absolute difference of each byte, which must not exceed the
+// corresponding byte of a tolerance value.  The high byte of the tolerance is always 0xFF so that
+// the high byte of the pixel is ignored, and a tolerance of 0xFFFFFFFF makes the pixel transparent.
+// SSE2 is used to compare four pixels at once; it is always available on the targets which have
+// the intrinsics, so no check of the CPU is needed.
+
+#define TOLERANCE_OF(variation) ((DWORD)(variation) * 0x010101 | 0xFF000000)
+#define TRANSPARENT_TOLERANCE 0xFFFFFFFF
+
+
+static inline bool PixelMatches(DWORD aPixel, DWORD aColor, DWORD aTolerance)
+{
+	for (int shift = 0; shift < 24; shift += 8)
+	{
+		int diff = (int)((aPixel >> shift) & 0xFF) - (int)((aColor >> shift) & 0xFF);
+		if (diff < 0)
+			diff = -diff;
+		if (diff > (int)((aTolerance >> shift) & 0xFF))
+			return false;
+	}
+	return true;
+}
+
+
+#ifdef PIXELMATCH_SSE2
+static inline int MatchMask4(__m128i aPixel, __m128i aColor, __m128i aTolerance)
+// Returns a 4-bit mask indicating which of the four pixels match.
+{
+	__m128i diff = _mm_or_si128(_mm_subs_epu8(aPixel, aColor), _mm_subs_epu8(aColor, aPixel));
+	__m128i byte_ok = _mm_cmpeq_epi8(_mm_max_epu8(diff, aTolerance), aTolerance); // i.e. diff <= tolerance.
+	__m128i pixel_ok = _mm_cmpeq_epi32(byte_ok, _mm_set1_epi32(-1));
+	return _mm_movemask_ps(_mm_castsi128_ps(pixel_ok));
+}
+
+static inline int LowestBit(int aMask)
+// Caller must ensure aMask is non-zero and has only the low 4 bits set.
+{
+	return (aMask & 1) ? 0 : (aMask & 2) ? 1 : (aMask & 4) ? 2 : 3;
+}
+
+static inline int HighestBit(int aMask)
+{
+	return (aMask & 8) ? 3 : (aMask & 4) ? 2 : (aMask & 2) ? 1 : 0;
+}
+#endif
+
+
+
+int FindPixel(const DWORD *aPixel, int aCount, DWORD aColor, int aVariation)
+{
+	DWORD tolerance = TOLERANCE_OF(aVariation);
+	int i = 0;
+#ifdef PIXELMATCH_SSE2
+	__m128i color4 = _mm_set1_epi32((int)aColor), tolerance4 = _mm_set1_epi32((int)tolerance);
+	for (; i + 4 <= aCount; i += 4)
+		if (int mask = MatchMask4(_mm_loadu_si128((const __m128i *)(aPixel + i)), color4, tolerance4))
+			return i + LowestBit(mask);
+#endif
+	for (; i < aCount; ++i)
+		if (PixelMatches(aPixel[i], aColor, tolerance))
+			return i;
+	return -1;
+}
+
+
+
+int FindPixelReverse(const DWORD *aPixel, int aCount, DWORD aColor, int aVariation)
+{
+	DWORD tolerance = TOLERANCE_OF(aVariation);
+	int i = aCount;
+#ifdef PIXELMATCH_SSE2
+	__m128i color4 = _mm_set1_epi32((int)aColor), tolerance4 = _mm_set1_epi32((int)tolerance);
+	for (; i >= 4; i -= 4)
+		if (int mask = MatchMask4(_mm_loadu_si128((const __m128i *)(aPixel + i - 4)), color4, tolerance4))
+			return i - 4 + HighestBit(mask);
+#endif
+	while (i-- > 0)
+		if (PixelMatches(aPixel[i], aColor, tolerance))
+			return i;
+	return -1;
+}
+
+
+
+static bool RowMatches(const DWORD *aScreen, const DWORD *aPixel, const DWORD *aTolerance, int aCount)
+{
+	int i = 0;
+#ifdef PIXELMATCH_SSE2
+	for (; i + 4 <= aCount; i += 4)
+		if (MatchMask4(_mm_loadu_si128((const __m128i *)(aScreen + i))
+				, _mm_loadu_si128((const __m128i *)(aPixel + i))
+				, _mm_loadu_si128((const __m128i *)(aTolerance + i))) != 0xF)
+			return false;
+#endif
+	for (; i < aCount; ++i)
+		if (!PixelMatches(aScreen[i], aPixel[i], aTolerance[i]))
+			return false;
+	return true;
+}
+
+
+
+PixelPattern::~PixelPattern()
+{
+	free(mPixel);
+}
+
+
+
+bool PixelPattern::Init(const DWORD *aPixel, const DWORD *aMask, int aWidth, int aHeight, DWORD aTransColor, int aVariation)
+{
+	int count = aWidth * aHeight;
+	// Allocate both arrays in one block.  Avoid malloc(0) for empty images.
+	if (   !(mPixel = (DWORD *)malloc((count ? count : 1) * 2 * sizeof(DWORD)))   )
+		return false;
+	mTolerance = mPixel + count;
+	mWidth = aWidth;
+	mHeight = aHeight;
+	mVariation = aVariation;
+	DWORD tolerance = TOLERANCE_OF(aVariation);
+	for (int i = 0; i < count; ++i)
+	{
+		mPixel[i] = aPixel[i] & 0x00FFFFFF;
+		mTolerance[i] = ((aMask && aMask[i]) || mPixel[i] == aTransColor) ? TRANSPARENT_TOLERANCE : tolerance;
+	}
+	ChooseAnchor();
+	return true;
+}
+
+
+
+void PixelPattern::ChooseAnchor()
+// Chooses which pixel to search for first when looking for the image.  A color which is rare within
+// the image is also likely to be rare on the screen, so it produces fewer candidate positions which
+// need the full comparison.  To keep this cheap for large images, only a sample of pixels is counted.
+{
+	#define ANCHOR_SAMPLE_SIZE 256
+	int sample[ANCHOR_SAMPLE_SIZE];
+	int count = mWidth * mHeight, sample_count = 0;
+	int step = count / ANCHOR_SAMPLE_SIZE + 1;
+	for (int i = 0; i < count && sample_count < ANCHOR_SAMPLE_SIZE; i += step)
+		if (mTolerance[i] != TRANSPARENT_TOLERANCE)
+			sample[sample_count++] = i;
+	if (!sample_count) // Every pixel is transparent, or the sample happened to include only those.
+	{
+		for (mAnchor = 0; mAnchor < count && mTolerance[mAnchor] == TRANSPARENT_TOLERANCE; ++mAnchor);
+		if (mAnchor == count)
+			mAnchor = -1;
+		return;
+	}
+	// Count each sampled color.  A simple quadratic count is used rather than sorting because it
+	// keeps the earliest pixel of each color as the candidate, and the sample size is bounded.
+	int best = sample[0], best_count = INT_MAX;
+	for (int i = 0; i < sample_count; ++i)
+	{
+		DWORD color = mPixel[sample[i]];
+		int color_count = 0, j;
+		for (j = 0; j < sample_count; ++j)
+			if (mPixel[sample[j]] == color)
+			{
+				if (j < i) // Already counted when it was first seen.
+					break;
+				++color_count;
+			}
+		if (j < i)
+			continue;
+		if (color_count < best_count)
+		{
+			best = sample[i];
+			best_count = color_count;
+			if (best_count == 1)
+				break;
+		}
+	}
+	mAnchor = best;
+}
+
+
+
+bool PixelPattern::MatchAt(const DWORD *aScreen, int aStride)
+{
+	for (int y = 0; y < mHeight; ++y)
+		if (!RowMatches(aScreen + y * aStride, mPixel + y * mWidth, mTolerance + y * mWidth, mWidth))
+			return false;
+	return true;
+}
+
+
+
+int PixelPattern::FindIn(const DWORD *aScreen, int aScreenWidth, int aScreenHeight, int aStride, int aStart)
+{
+	if (mWidth > aScreenWidth || mHeight > aScreenHeight || aStart < 0)
+		return -1;
+	int last_x = aScreenWidth - mWidth, last_y = aScreenHeight - mHeight;
+	int y = aStart / aStride, x = aStart % aStride;
+	if (x > last_x) // aStart is too far right for the image to fit, so start on the next row.
+		++y, x = 0;
+	if (y > last_y)
+		return -1;
+	if (mAnchor == -1) // The image is entirely transparent, so it matches anywhere.
+		return y * aStride + x;
+	int anchor_x = mAnchor % mWidth, anchor_y = mAnchor / mWidth;
+	DWORD anchor_color = mPixel[mAnchor];
+	for (; y <= last_y; ++y, x = 0)
+	{
+		// Find each position in this row where the anchor pixel matches, then compare the rest.
+		const DWORD *anchor_row = aScreen + (y + anchor_y) * aStride + anchor_x;
+		for (;;)
+		{
+			int offset = FindPixel(anchor_row + x, last_x - x + 1, anchor_color, mVariation);
+			if (offset == -1)
+				break;
+			x += offset;
+			if (MatchAt(aScreen + y * aStride + x, aStride))
+				return y * aStride + x;
+			if (++x > last_x)
+				break;
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,41 @@
+﻿#pragma once
+
+// Searches buffers of 32-bit pixels such as those produced by getbits() in lib/pixel.cpp.  Only the
+// low three bytes of each pixel (the color) are compared, so the byte order of the color doesn't matter
+// as long as it is consistent.  Colors match if none of their components differ by more than the
+// variation (0 to 255).  This has no dependencies on the OS.
+
+// Returns the index of the first pixel in aPixel[0..aCount-1] which matches aColor, or -1 if none do.
+int FindPixel(const DWORD *aPixel, int aCount, DWORD aColor, int aVariation);
+// Returns the index of the last pixel which matches aColor, or -1 if none do.
+int FindPixelReverse(const DWORD *aPixel, int aCount, DWORD aColor, int aVariation);
+
+
+// An image prepared for searching within a larger image (such as a capture of the screen).
+class PixelPattern
+{
+public:
+	PixelPattern() : mPixel(nullptr), mTolerance(nullptr), mWidth(0), mHeight(0), mAnchor(-1), mVariation(0) {}
+	~PixelPattern();
+
+	// Copies the image.  A pixel is transparent (matches any color) if aMask is non-null and has a
+	// non-zero value at the same index, or if the pixel's color is aTransColor (which can have a non-zero
+	// high byte to disable this).  Returns false if there was insufficient memory.
+	bool Init(const DWORD *aPixel, const DWORD *aMask, int aWidth, int aHeight, DWORD aTransColor, int aVariation);
+
+	// Searches an area of aScreenWidth x aScreenHeight pixels, where each row begins aStride pixels after
+	// the previous one.  Returns the index (y * aStride + x) of the upper-left pixel of the first match
+	// at or after index aStart, in left-to-right, top-to-bottom order, or -1 if there are no more matches.
+	// All matches can be found by calling it again with aStart one greater than the previous match.
+	int FindIn(const DWORD *aScreen, int aScreenWidth, int aScreenHeight, int aStride, int aStart = 0);
+
+private:
+	DWORD *mPixel; // The color of each pixel, with the high byte set to zero.
+	DWORD *mTolerance; // The variation allowed for each byte of the corresponding pixel.
+	int mWidth, mHeight;
+	int mAnchor; // Index of the pixel checked first for each candidate position, or -1 if all are transparent.
+	int mVariation;
+
+	bool MatchAt(const DWORD *aScreen, int aStride);
+	void ChooseAnchor();
+};
@@ -0,0 +1,42 @@
+﻿#pragma once
+
+// The arrangement of a SAFEARRAY's items in memory.  The data is column-major; i.e. the leftmost
+// index varies fastest.  Lower bounds aren't included, so each index is 0-based.  This has no
+// dependencies on the OS.
+struct SafeArrayLayout
+{
+	enum { MAX_DIMS = 8 }; // Same limit as ComObject::SafeArrayInvoke().
+
+	UINT dims = 0;
+	ULONG count[MAX_DIMS]; // Number of items in each dimension, from left to right.
+	size_t stride[MAX_DIMS]; // Distance between consecutive indices of each dimension, in items.
+
+	// Sets the item count of each dimension and computes the strides.  Returns the total number of
+	// items, or 0 if aDims is 0 or exceeds MAX_DIMS.
+	size_t Init(UINT aDims, const ULONG *aCount)
+	{
+		if (!aDims || aDims > MAX_DIMS)
+		{
+			dims = 0;
+			return 0;
+		}
+		dims = aDims;
+		size_t total = 1;
+		for (UINT d = 0; d < aDims; ++d)
+		{
+			count[d] = aCount[d];
+			stride[d] = total;
+			total *= aCount[d];
+		}
+		return total;
+	}
+
+	// Returns the position of the item at the given 0-based indices, in items from the start of the data.
+	size_t Offset(const ULONG *aIndex) const
+	{
+		size_t offset = 0;
+		for (UINT d = 0; d < dims; ++d)
+			offset += aIndex[d] * stride[d];
+		return offset;
+	}
+};
@@ -0,0 +1,43 @@
+﻿#include "stdafx.h" // pre-compiled headers
+#include "SampleStats.h"
+
+
+static int CompareSamples(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : x > y;
+}
+
+
+
+void SampleStats::Compute(double *aSample, size_t aCount)
+{
+	ASSERT(aCount);
+	qsort(aSample, aCount, sizeof(double), CompareSamples);
+	double sum = 0;
+	for (size_t i = 0; i < aCount; ++i)
+		sum += aSample[i];
+	minimum = aSample[0];
+	maximum = aSample[aCount - 1];
+	mean = sum / aCount;
+	// For an even number of samples, use the midpoint of the middle two.
+	median = (aSample[(aCount - 1) / 2] + aSample[aCount / 2]) / 2;
+	p99 = Percentile(aSample, aCount, 99);
+}
+
+
+
+double SampleStats::Percentile(const double *aSorted, size_t aCount, double aPercentile)
+{
+	if (!aCount)
+		return 0;
+	// Nearest rank: the smallest value which is greater than or equal to aPercentile% of the samples.
+	// Multiply first so that whole ranks are exact; 7 / 100.0 * 100 is slightly more than 7.
+	double exact_rank = aPercentile * aCount / 100;
+	size_t rank = (size_t)exact_rank;
+	if (rank < exact_rank) // Round up.
+		++rank;
+	if (rank > aCount)
+		rank = aCount;
+	return aSorted[rank ? rank - 1 : 0];
+}
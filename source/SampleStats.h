@@ -0,0 +1,14 @@
+﻿#pragma once
+
+// Summarizes a set of timing samples, such as those collected by Benchmark().  This has no
+// dependencies on the OS; the caller measures the samples with whatever clock it likes.
+struct SampleStats
+{
+	double minimum, median, p99, mean, maximum;
+
+	// Sorts aSample in place.  aCount must be non-zero.
+	void Compute(double *aSample, size_t aCount);
+
+	// Returns the nearest-rank value at aPercentile (0 to 100) of a sorted array.
+	static double Percentile(const double *aSorted, size_t aCount, double aPercentile);
+};
@@ -0,0 +1,40 @@
+﻿#pragma once
+#include "KeyTypes.h"
+
+// The key which Send presses for one character of text.
+struct SendTextKey
+{
+	vk_type vk; // 0 if the layout has no key for the character, which must then be sent by other means.
+	modLR_type mods; // The modifiers which the key needs, including any from a ^+!# prefix.
+	modLR_type keep_down; // Win/Alt modifiers which the next character also needs.
+};
+
+// Plans the key for the character at aKeys.  aCharToVK(aChar, &aMods, aEnableAZFallback) translates
+// a character for the target layout as CharToVKAndModifiers() does.  Since that is the only part which
+// depends on the OS, plans can be tested against a fake layout.  aMods are the modifiers from any ^+!#
+// prefix and aPersistentMods are those which are held down for the whole Send.
+//
+// SendKey() releases Win/Alt after each key, so sending a run of AltGr characters such as "{[]}" on a
+// German layout would otherwise press and release AltGr (and LCtrl) around every character.  If the
+// next character needs the same Win/Alt modifiers, keep_down says to treat them as persistent for this
+// key so that they stay down; SetModifierLRState() then has no transitions to generate for them when
+// the next character is sent.  Ctrl and Shift aren't included because SendKey() already defers their
+// release.
+template<typename CharToVK>
+SendTextKey PlanTextKey(LPCTSTR aKeys, bool aRaw, modLR_type aMods, modLR_type aPersistentMods, CharToVK &&aCharToVK)
+{
+	const modLR_type win_alt = MOD_LALT | MOD_RALT | MOD_LWIN | MOD_RWIN;
+	SendTextKey key;
+	key.mods = aMods;
+	// v1.1.27.00: Disable the a-z to vk41-vk5A fallback translation when modifiers are present since it would produce the wrong printable characters.
+	key.vk = aCharToVK(*aKeys, &key.mods, (aMods | aPersistentMods) != 0 && !aRaw);
+	key.keep_down = 0;
+	if (key.vk && (key.mods & win_alt) && aKeys[1]
+		&& (aRaw || !_tcschr(_T("^+!#{}"), aKeys[1]))) // Otherwise the next character is Send syntax rather than text.
+	{
+		modLR_type next_mods = 0;
+		if (aCharToVK(aKeys[1], &next_mods, aPersistentMods != 0 && !aRaw))
+			key.keep_down = key.mods & next_mods & win_alt;
+	}
+	return key;
+}
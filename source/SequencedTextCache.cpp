@@ -0,0 +1,42 @@
+﻿#include "stdafx.h" // pre-compiled headers
+#include "SequencedTextCache.h"
+
+
+bool SequencedTextCache::Get(DWORD aCurrentSequence, LPCTSTR &aText, size_t &aLength)
+{
+	if (!mSequence || mSequence != aCurrentSequence)
+		return false;
+	aText = mText;
+	aLength = mLength;
+	return true;
+}
+
+
+
+void SequencedTextCache::Set(DWORD aSequence, LPCTSTR aText, size_t aLength)
+// aSequence should be retrieved before the text, so that if the source changes in between, the
+// cache is seen as out of date rather than the reverse.
+{
+	mSequence = 0;
+	if (!aSequence || aLength > mMaxLength)
+	{
+		// Free the old text rather than keeping it for a sequence number that can't recur.
+		free(mText);
+		mText = nullptr;
+		mCapacity = 0;
+		return;
+	}
+	size_t capacity_needed = aLength + 1;
+	if (mCapacity < capacity_needed || mCapacity / 2 > capacity_needed) // Don't hold on to a much larger block.
+	{
+		free(mText);
+		mCapacity = 0;
+		if (   !(mText = (LPTSTR)malloc(capacity_needed * sizeof(TCHAR)))   )
+			return;
+		mCapacity = capacity_needed;
+	}
+	memcpy(mText, aText, aLength * sizeof(TCHAR));
+	mText[aLength] = '\0';
+	mLength = aLength;
+	mSequence = aSequence;
+}
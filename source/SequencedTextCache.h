@@ -0,0 +1,24 @@
+﻿#pragma once
+
+// A copy of some text which remains valid only while an external sequence number is unchanged,
+// such as the one returned by GetClipboardSequenceNumber().  Zero is never a valid sequence number,
+// since that is what GetClipboardSequenceNumber() returns on failure.  This has no dependencies
+// on the OS; the caller retrieves the current sequence number.
+class SequencedTextCache
+{
+	LPTSTR mText = nullptr;
+	size_t mLength = 0; // In characters, excluding the terminator.
+	size_t mCapacity = 0; // In characters, including the terminator.
+	DWORD mSequence = 0; // The sequence number which mText belongs to, or 0 if none.
+	size_t mMaxLength;
+
+public:
+	SequencedTextCache(size_t aMaxLength) : mMaxLength(aMaxLength) {}
+	~SequencedTextCache() { free(mText); }
+
+	// Returns true and the text if it was stored for aCurrentSequence.  The text remains valid until
+	// the next call to Set().
+	bool Get(DWORD aCurrentSequence, LPCTSTR &aText, size_t &aLength);
+	// Stores a copy of the text for aSequence, unless it is longer than the maximum.
+	void Set(DWORD aSequence, LPCTSTR aText, size_t aLength);
+};
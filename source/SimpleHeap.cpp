@@ -23,6 +23,13 @@ SimpleHeap *SimpleHeap::sFirst = NULL;
 SimpleHeap *SimpleHeap::sLast  = NULL;
 char *SimpleHeap::sMostRecentlyAllocated = NULL;
 UINT SimpleHeap::sBlockCount = 0;
+void *SimpleHeap::sFreeList[FREE_LIST_COUNT] = {0};
+size_t SimpleHeap::sWasted = 0;
+size_t SimpleHeap::sFreeListed = 0;
+SimpleHeap::PendingChunk *SimpleHeap::sPending = NULL;
+size_t SimpleHeap::sPendingCount = 0;
+size_t SimpleHeap::sPendingCapacity = 0;
+size_t SimpleHeap::sLarge = 0;
 
 LPTSTR SimpleHeap::strDup(LPCTSTR aBuf, size_t aLength)
 // v1.0.44.14: Added aLength to improve performance in cases where callers already know the length.
@@ -71,15 +78,34 @@ void* SimpleHeap::Malloc(size_t aSize)
 {
 	if (aSize < 1)
 		return NULL;
+	if (aSize <= MAX_FREE_LIST_SIZE)
+	{
+		// Reuse a chunk previously returned via Free(), if there is one of this size class.
+		size_t size_class = (aSize - 1) / sizeof(void *);
+		if (void *chunk = sFreeList[size_class])
+		{
+			sFreeList[size_class] = *(void **)chunk;
+			sFreeListed -= (size_class + 1) * sizeof(void *);
+			sMostRecentlyAllocated = NULL; // Delete() applies only to the end of the current block.
+			return chunk;
+		}
+	}
 	if (!sFirst) // We need at least one block to do anything, so create it.
 		if (   !(sFirst = CreateBlock())   )
 			return NULL;
 	if (aSize > sLast->mSpaceAvailable)
 	{
 		if (aSize > MAX_ALLOC_IN_NEW_BLOCK) // Also covers aSize > BLOCK_SIZE.
-			return malloc(aSize); // Avoid wasting the remainder of the block.
+		{
+			void *p = malloc(aSize); // Avoid wasting the remainder of the block.
+			if (p)
+				sLarge += aSize;
+			return p;
+		}
+		size_t remaining = sLast->mSpaceAvailable;
 		if (!(sLast->mNextBlock = CreateBlock()))
 			return NULL;
+		sWasted += remaining;
 	}
 	sMostRecentlyAllocated = sLast->mFreeMarker; // THIS IS NOW THE NEWLY ALLOCATED BLOCK FOR THE CALLER, which is 32-bit aligned because the previous call to this function (i.e. the logic below) set it up that way.
 	// v1.0.40.04: Set up the NEXT chunk to be aligned on a 32-bit boundary (the first chunk in each block
@@ -126,6 +152,73 @@ void SimpleHeap::Delete(void *aPtr)
 
 
 
+void SimpleHeap::Free(void *aPtr, size_t aSize)
+// Unlike Delete(), this can reclaim any chunk, but only for reuse by a later allocation of the same
+// size class.  Memory is never returned to the system, so this is mainly for callers which discard
+// and replace small allocations repeatedly, such as a variable outgrowing its SimpleHeap buffer.
+// The chunk is only queued here.  Expression evaluation may still hold a pointer to the old contents
+// of a variable, so linking the chunk into a free list (which overwrites its first bytes) or handing
+// it to another caller must wait until Reclaim().
+{
+	if (!aPtr || aSize < 1 || aSize > MAX_FREE_LIST_SIZE) // Too large to be worth tracking (and it might have come from malloc()).
+		return;
+	if (sPendingCount == sPendingCapacity)
+	{
+		size_t new_capacity = sPendingCapacity ? sPendingCapacity * 2 : 64;
+		auto new_pending = (PendingChunk *)realloc(sPending, new_capacity * sizeof(PendingChunk));
+		if (!new_pending)
+			return; // Just abandon it, as before.
+		sPending = new_pending;
+		sPendingCapacity = new_capacity;
+	}
+	sPending[sPendingCount].ptr = aPtr;
+	sPending[sPendingCount].size = aSize;
+	++sPendingCount;
+	sFreeListed += ((aSize - 1) / sizeof(void *) + 1) * sizeof(void *);
+}
+
+
+
+void SimpleHeap::FreeString(LPTSTR aStr)
+{
+	if (aStr && *aStr) // Empty strings aren't allocated; see strDup().
+		Free(aStr, (_tcslen(aStr) + 1) * sizeof(TCHAR));
+}
+
+
+
+void SimpleHeap::Reclaim()
+{
+	while (sPendingCount)
+	{
+		PendingChunk &chunk = sPending[--sPendingCount];
+		size_t size_class = (chunk.size - 1) / sizeof(void *);
+		sFreeListed -= (size_class + 1) * sizeof(void *);
+		if (chunk.ptr == sMostRecentlyAllocated)
+		{
+			Delete(chunk.ptr); // Reclaim it directly, for use by allocations of any size.
+			continue;
+		}
+		*(void **)chunk.ptr = sFreeList[size_class]; // Chunks are always large enough and aligned for this.
+		sFreeList[size_class] = chunk.ptr;
+		sFreeListed += (size_class + 1) * sizeof(void *);
+	}
+}
+
+
+
+void SimpleHeap::GetStats(SimpleHeapStats &aStats)
+{
+	aStats.blocks = sBlockCount;
+	aStats.large = sLarge;
+	aStats.reserved = sBlockCount * BLOCK_SIZE + sLarge;
+	aStats.wasted = sWasted;
+	aStats.free_listed = sFreeListed;
+	aStats.used = sBlockCount * BLOCK_SIZE - (sLast ? sLast->mSpaceAvailable : 0) - sWasted - sFreeListed + sLarge;
+}
+
+
+
 // Commented out because not currently used:
 //void SimpleHeap::DeleteAll()
 //// See Hotkey::AllDestructAndExit for comments about why this isn't actually called.
@@ -36,6 +36,20 @@ GNU General Public License for more details.
 // The maximum size for a new allocation when a new block must be created to fulfill it.
 // Allocations under this size might cause wasted space at the end of the previous block.
 #define MAX_ALLOC_IN_NEW_BLOCK (1024 * sizeof(TCHAR))
+// The largest chunk which Free() will keep for reuse.  Chunks are kept in one list per multiple of
+// sizeof(void*), so this should be small enough that the lists stay dense.
+#define MAX_FREE_LIST_SIZE (128 * sizeof(TCHAR))
+#define FREE_LIST_COUNT (MAX_FREE_LIST_SIZE / sizeof(void *))
+
+struct SimpleHeapStats
+{
+	size_t reserved; // Total bytes obtained from the system, including large allocations.
+	size_t used; // Bytes currently handed out to callers, including large allocations.
+	size_t wasted; // Bytes abandoned at the end of blocks when a new block was needed.
+	size_t free_listed; // Bytes returned via Free() and not yet reused.
+	size_t large; // Bytes allocated directly with malloc() because they were too large for a block.
+	UINT blocks;
+};
 
 class SimpleHeap
 {
@@ -46,6 +60,11 @@ private:
 	static UINT sBlockCount;
 	static SimpleHeap *sFirst, *sLast;  // The first and last objects in the linked list.
 	static char *sMostRecentlyAllocated; // For use with Delete().
+	static void *sFreeList[FREE_LIST_COUNT]; // Chunks returned via Free(), by size class.
+	struct PendingChunk { void *ptr; size_t size; };
+	static PendingChunk *sPending; // Chunks returned via Free() which can't be reused until Reclaim().
+	static size_t sPendingCount, sPendingCapacity;
+	static size_t sWasted, sFreeListed, sLarge;
 	SimpleHeap *mNextBlock;  // The object after this one in the linked list; NULL if none.
 
 	static SimpleHeap *CreateBlock();
@@ -68,6 +87,20 @@ public:
 	static void* Alloc(size_t aSize);
 
 	static void Delete(void *aPtr);
+
+	// Return a chunk of aSize bytes to SimpleHeap so that a later allocation of the same size class can
+	// reuse it.  aSize must be the size originally requested from Malloc()/Alloc().  Chunks which are too
+	// large to be kept are simply abandoned, as before.  The chunk is left intact until Reclaim() is
+	// called, since abandoned memory has always stayed valid and callers may still be reading from it.
+	static void Free(void *aPtr, size_t aSize);
+	// Free() a string returned by Malloc() or Alloc() without an explicit length, which may be the
+	// constant empty string.
+	static void FreeString(LPTSTR aStr);
+	// Make chunks passed to Free() available for reuse.  Must be called only when nothing could still
+	// be referring to them, such as when no script threads are running.
+	static void Reclaim();
+
+	static void GetStats(SimpleHeapStats &aStats);
 	//static void DeleteAll();
 
 	static void CriticalFail();
@@ -0,0 +1,50 @@
+﻿#pragma once
+#include <atomic>
+
+// A bounded, lock-free queue for passing items from exactly one producer thread to exactly
+// one consumer thread.  Push() and Pop() never block or allocate, so the producer can be
+// time-critical code such as the hooks.  This has no dependencies on the OS.
+//
+// The indices increase without bound and are masked only when used, so all CAPACITY slots
+// can be filled.  CAPACITY must be a power of two so that the masking stays correct when
+// the indices wrap around.
+template<typename T, unsigned CAPACITY>
+class SpscQueue
+{
+	static_assert(CAPACITY && !(CAPACITY & (CAPACITY - 1)), "CAPACITY must be a power of two");
+
+	T mItem[CAPACITY];
+	// Each index is written by only one thread.  Keep them on separate cache lines so that
+	// the producer and consumer don't contend for the same line.
+	alignas(64) std::atomic<unsigned> mHead {0}; // Index of the next item to pop.
+	alignas(64) std::atomic<unsigned> mTail {0}; // Index of the next slot to fill.
+
+public:
+	// Called only by the producer.  Returns false if the queue is full.
+	bool Push(const T &aItem)
+	{
+		unsigned tail = mTail.load(std::memory_order_relaxed);
+		if (tail - mHead.load(std::memory_order_acquire) == CAPACITY)
+			return false;
+		mItem[tail & (CAPACITY - 1)] = aItem;
+		mTail.store(tail + 1, std::memory_order_release); // Publish the item.
+		return true;
+	}
+
+	// Called only by the consumer.  Returns false if the queue is empty.
+	bool Pop(T &aItem)
+	{
+		unsigned head = mHead.load(std::memory_order_relaxed);
+		if (head == mTail.load(std::memory_order_acquire))
+			return false;
+		aItem = mItem[head & (CAPACITY - 1)];
+		mHead.store(head + 1, std::memory_order_release); // Give the slot back to the producer.
+		return true;
+	}
+
+	// May be called by either thread, but the result may be out of date by the time it is used.
+	bool IsEmpty()
+	{
+		return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire);
+	}
+};
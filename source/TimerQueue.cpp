@@ -0,0 +1,88 @@
+﻿#include "stdafx.h" // pre-compiled headers
+#include "TimerQueue.h"
+
+
+bool TimerQueue::Schedule(TimerQueueItem *aItem, UINT64 aDue)
+{
+	if (aItem->IsQueued())
+	{
+		UINT64 prev_due = aItem->mDue;
+		aItem->mDue = aDue;
+		if (aDue < prev_due)
+			SiftUp(aItem->mQueueIndex);
+		else
+			SiftDown(aItem->mQueueIndex);
+		return true;
+	}
+	if (mCount == mCapacity)
+	{
+		UINT new_capacity = mCapacity ? mCapacity * 2 : 16;
+		auto new_item = (TimerQueueItem **)realloc(mItem, new_capacity * sizeof(TimerQueueItem *));
+		if (!new_item)
+			return false;
+		mItem = new_item;
+		mCapacity = new_capacity;
+	}
+	aItem->mDue = aDue;
+	Place(aItem, mCount++);
+	SiftUp(aItem->mQueueIndex);
+	return true;
+}
+
+void TimerQueue::Cancel(TimerQueueItem *aItem)
+{
+	if (!aItem->IsQueued())
+		return;
+	UINT index = aItem->mQueueIndex;
+	aItem->mQueueIndex = TimerQueueItem::NotQueued;
+	if (index == --mCount)
+		return;
+	// Fill the gap with the last item, which may belong either above or below this position.
+	TimerQueueItem *last = mItem[mCount];
+	Place(last, index);
+	if (last->mDue < aItem->mDue)
+		SiftUp(index);
+	else
+		SiftDown(index);
+}
+
+TimerQueueItem *TimerQueue::PopDue(UINT64 aNow)
+{
+	if (!IsDue(aNow))
+		return nullptr;
+	TimerQueueItem *item = mItem[0];
+	Cancel(item);
+	return item;
+}
+
+void TimerQueue::SiftUp(UINT aIndex)
+{
+	TimerQueueItem *item = mItem[aIndex];
+	while (aIndex)
+	{
+		UINT parent = (aIndex - 1) / 2;
+		if (mItem[parent]->mDue <= item->mDue)
+			break;
+		Place(mItem[parent], aIndex);
+		aIndex = parent;
+	}
+	Place(item, aIndex);
+}
+
+void TimerQueue::SiftDown(UINT aIndex)
+{
+	TimerQueueItem *item = mItem[aIndex];
+	for (;;)
+	{
+		UINT child = aIndex * 2 + 1;
+		if (child >= mCount)
+			break;
+		if (child + 1 < mCount && mItem[child + 1]->mDue < mItem[child]->mDue)
+			++child;
+		if (item->mDue <= mItem[child]->mDue)
+			break;
+		Place(mItem[child], aIndex);
+		aIndex = child;
+	}
+	Place(item, aIndex);
+}
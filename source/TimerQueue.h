@@ -0,0 +1,69 @@
+﻿#pragma once
+
+// Base for objects which can be scheduled in a TimerQueue.
+struct TimerQueueItem
+{
+	enum : UINT { NotQueued = ~0U };
+	UINT64 mDue = 0; // Time at which the item is due, in whatever units the caller's clock uses.
+	UINT mQueueIndex = NotQueued; // Position in the heap.
+	bool IsQueued() { return mQueueIndex != NotQueued; }
+};
+
+// A binary min-heap of items ordered by due time, so that finding the items which are due costs
+// O(log n) each regardless of how many items aren't due.  This has no dependencies on the OS;
+// the caller supplies the current time, and should use a clock which doesn't wrap around.
+class TimerQueue
+{
+	TimerQueueItem **mItem = nullptr;
+	UINT mCount = 0, mCapacity = 0;
+
+	void SiftUp(UINT aIndex);
+	void SiftDown(UINT aIndex);
+	void Place(TimerQueueItem *aItem, UINT aIndex)
+	{
+		mItem[aIndex] = aItem;
+		aItem->mQueueIndex = aIndex;
+	}
+
+public:
+	TimerQueue() {}
+	TimerQueue(const TimerQueue &) = delete;
+	~TimerQueue() { free(mItem); }
+
+	// Inserts aItem or moves it to its new position.  Returns false if out of memory, which can only
+	// happen if aItem wasn't already queued and no item has been removed since the queue was largest.
+	bool Schedule(TimerQueueItem *aItem, UINT64 aDue);
+	void Cancel(TimerQueueItem *aItem);
+	// Removes and returns the item with the earliest due time if it is due at aNow, otherwise nullptr.
+	TimerQueueItem *PopDue(UINT64 aNow);
+	TimerQueueItem *Peek() { return mCount ? mItem[0] : nullptr; }
+	bool IsDue(UINT64 aNow) { return mCount && mItem[0]->mDue <= aNow; }
+	UINT Count() { return mCount; }
+
+	// Returns the earliest-due item which is due at aNow and satisfies aPred, or nullptr if none.
+	// Only items which are due are visited; since no item is due before its parent in the heap,
+	// those form a subtree at the root.  aPred must not modify the queue.
+	template<typename Pred> TimerQueueItem *FindDue(UINT64 aNow, Pred aPred)
+	{
+		TimerQueueItem *found = nullptr;
+		UINT pending[64], pending_count = 0; // Depth-first, so this never exceeds the height of the heap + 1.
+		if (IsDue(aNow))
+			pending[pending_count++] = 0;
+		while (pending_count)
+		{
+			UINT i = pending[--pending_count];
+			TimerQueueItem *item = mItem[i];
+			if (found && found->mDue <= item->mDue)
+				continue; // Neither this item nor its descendants can be due sooner.
+			if (aPred(item))
+			{
+				found = item;
+				continue;
+			}
+			for (UINT child = i * 2 + 1; child <= i * 2 + 2 && child < mCount; ++child)
+				if (mItem[child]->mDue <= aNow)
+					pending[pending_count++] = child;
+		}
+		return found;
+	}
+};
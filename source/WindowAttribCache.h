@@ -0,0 +1,129 @@
+﻿#pragma once
+#include <mutex>
+#include <shared_mutex>
+
+// What WindowAttribCache needs to know about windows.  window.cpp implements this with the Win32 API,
+// which leaves the cache itself with no dependencies on the OS, so it can be tested with a fake list
+// of windows.
+struct WindowInfoSource
+{
+	// Returns the ID of the thread which owns aWnd and sets aPID, or returns 0 if aWnd doesn't exist.
+	virtual DWORD ThreadProcessID(HWND aWnd, DWORD &aPID) = 0;
+	// Sets aBuf to the class name of aWnd, or "" on failure.
+	virtual void ClassName(HWND aWnd, LPTSTR aBuf, int aBufSize) = 0;
+	// Sets aBuf to the full path or name of aPID's executable, or "" on failure.
+	virtual void ProcessName(DWORD aPID, LPTSTR aBuf, DWORD aBufSize, bool aNameOnly) = 0;
+};
+
+// The PID, class and process path of a window can't change during its lifetime, so they are cached
+// across searches.  This mainly benefits ahk_exe, which would otherwise need to open the process (and
+// for a full path, query every drive letter) for each window on each search.  Titles aren't cached
+// because they can change at any moment, and WinEvent notifications are delivered asynchronously, so
+// couldn't be relied upon to invalidate a cached title before the next search.
+// Each entry is validated by checking that the window's thread and process IDs haven't changed, which
+// also detects destroyed windows.  HWND values include a uniqueness counter, so for a new window to
+// be given the same HWND *and* be owned by the same thread is far too unlikely to be a concern.
+template<int ClassSize, int PathSize>
+class WindowAttribCache
+{
+	enum { Size = 64 }; // Must be a power of 2.
+	struct Entry
+	{
+		HWND hwnd;
+		DWORD tid, pid;
+		bool has_class, has_path, path_is_name_only;
+		TCHAR class_name[ClassSize];
+		TCHAR path[PathSize];
+	} mEntry[Size] {};
+	std::shared_mutex mLock; // Searches can be done by the hook thread too.
+
+	static LPCTSTR NameFromPath(LPCTSTR aPath)
+	{
+		LPCTSTR name = aPath;
+		for (LPCTSTR cp = aPath; *cp; ++cp)
+			if (*cp == '\\')
+				name = cp + 1;
+		return name;
+	}
+
+	static void Copy(LPTSTR aBuf, LPCTSTR aText, int aBufSize)
+	{
+		size_t length = _tcslen(aText);
+		if (length >= (size_t)aBufSize) // Can't happen for values retrieved with the same size.
+			length = aBufSize - 1;
+		memcpy(aBuf, aText, length * sizeof(TCHAR));
+		aBuf[length] = '\0';
+	}
+
+public:
+	// Returns the PID of aWnd, or 0 if it doesn't exist.  If aClass is non-null, it receives the class
+	// name and must have room for ClassSize chars.  If aPath is non-null, it receives the path of the
+	// window's executable, or just its name if aPathIsNameOnly is true, and must have room for PathSize
+	// chars.  Both receive "" if the window doesn't exist.
+	DWORD Get(WindowInfoSource &aSource, HWND aWnd, LPTSTR aClass, LPTSTR aPath, bool aPathIsNameOnly)
+	{
+		DWORD pid = 0, tid = aSource.ThreadProcessID(aWnd, pid);
+		if (!aClass && !aPath)
+			return pid;
+		if (!tid) // The window doesn't exist (anymore).
+		{
+			if (aClass)
+				*aClass = '\0';
+			if (aPath)
+				*aPath = '\0';
+			return pid;
+		}
+
+		Entry &entry = mEntry[(((UINT_PTR)aWnd >> 1) ^ ((UINT_PTR)aWnd >> 16)) & (Size - 1)];
+		bool need_class = aClass != nullptr, need_path = aPath != nullptr;
+		{
+			std::shared_lock<std::shared_mutex> lock(mLock);
+			if (entry.hwnd == aWnd && entry.tid == tid && entry.pid == pid)
+			{
+				if (need_class && entry.has_class)
+				{
+					Copy(aClass, entry.class_name, ClassSize);
+					need_class = false;
+				}
+				if (need_path && entry.has_path
+					&& (aPathIsNameOnly || !entry.path_is_name_only)) // A full path can be used to produce the name.
+				{
+					Copy(aPath, aPathIsNameOnly && !entry.path_is_name_only ? NameFromPath(entry.path) : entry.path, PathSize);
+					need_path = false;
+				}
+			}
+		}
+		if (!need_class && !need_path)
+			return pid;
+
+		// Retrieve whatever wasn't cached, outside the lock since ProcessName() can be slow.
+		if (need_class)
+			aSource.ClassName(aWnd, aClass, ClassSize);
+		if (need_path)
+		{
+			aSource.ProcessName(pid, aPath, PathSize, aPathIsNameOnly);
+			need_path = *aPath != '\0'; // Don't cache failure, since it might be due to a transient condition.
+		}
+
+		std::unique_lock<std::shared_mutex> lock(mLock);
+		if (entry.hwnd != aWnd || entry.tid != tid || entry.pid != pid)
+		{
+			entry.hwnd = aWnd;
+			entry.tid = tid;
+			entry.pid = pid;
+			entry.has_class = entry.has_path = false;
+		}
+		if (need_class)
+		{
+			Copy(entry.class_name, aClass, ClassSize);
+			entry.has_class = true;
+		}
+		if (need_path)
+		{
+			Copy(entry.path, aPath, PathSize);
+			entry.path_is_name_only = aPathIsNameOnly;
+			entry.has_path = true;
+		}
+		return pid;
+	}
+};
@@ -0,0 +1,152 @@
+﻿#include "stdafx.h" // pre-compiled headers
+#include "WorkerPool.h"
+
+
+WorkerPool::WorkerPool(UINT aMaxThreads, NotifyProc aNotify, void *aNotifyParam)
+	: mMaxThreads(aMaxThreads < 1 ? 1 : aMaxThreads > (UINT)MAX_THREADS ? (UINT)MAX_THREADS : aMaxThreads)
+	, mNotify(aNotify), mNotifyParam(aNotifyParam)
+{
+}
+
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mStopping = true;
+	}
+	mJobReady.notify_all();
+	for (UINT i = 0; i < mThreadCount; ++i)
+		mThread[i].join();
+}
+
+
+void WorkerPool::Submit(WorkerJob *aJob)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	aJob->mNextJob = nullptr;
+	aJob->mEvents = 0;
+	if (mJobTail)
+		mJobTail->mNextJob = aJob;
+	else
+		mJobHead = aJob;
+	mJobTail = aJob;
+	if (!mIdleCount && mThreadCount < mMaxThreads)
+		mThread[mThreadCount++] = std::thread(&WorkerPool::WorkerMain, this);
+	else
+		mJobReady.notify_one();
+}
+
+
+void WorkerPool::WorkerMain()
+{
+	std::unique_lock<std::mutex> lock(mLock);
+	for (;;)
+	{
+		while (!mJobHead && !mStopping)
+		{
+			++mIdleCount;
+			mJobReady.wait(lock);
+			--mIdleCount;
+		}
+		if (mStopping)
+			return;
+		WorkerJob *job = mJobHead;
+		if (  !(mJobHead = job->mNextJob)  )
+			mJobTail = nullptr;
+		job->mNextJob = nullptr;
+		lock.unlock();
+		job->Run(*this);
+		PostEvent(job, WORKER_EVENT_DONE);
+		lock.lock();
+	}
+}
+
+
+void WorkerPool::PostEvent(WorkerEventSource *aSource, UINT aEvent)
+{
+	bool notify;
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		if (!aSource->mEvents) // Not already in the event queue.
+		{
+			aSource->mNextEvent = nullptr;
+			if (mEventTail)
+				mEventTail->mNextEvent = aSource;
+			else
+				mEventHead = aSource;
+			mEventTail = aSource;
+		}
+		aSource->mEvents |= aEvent;
+		notify = !mWake;
+		mWake = true;
+	}
+	if (notify)
+		mNotify(mNotifyParam);
+}
+
+
+bool WorkerPool::GetEvent(WorkerEventSource *&aSource, UINT &aEvents)
+{
+	bool notify;
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		WorkerEventSource *source = mEventHead;
+		if (!source)
+		{
+			mWake = false;
+			return false;
+		}
+		if (  !(mEventHead = source->mNextEvent)  )
+			mEventTail = nullptr;
+		source->mNextEvent = nullptr;
+		aSource = source;
+		aEvents = source->mEvents;
+		source->mEvents = 0;
+		// Only one source is returned per notification, so that the owner can treat each the same
+		// way as any other event.  Notify again for the next one, if any.
+		notify = mEventHead != nullptr;
+		mWake = notify;
+	}
+	if (notify)
+		mNotify(mNotifyParam);
+	return true;
+}
+
+
+void WorkerPool::Requeue(WorkerEventSource *aSource, UINT aEvents)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	if (!aSource->mEvents)
+	{
+		// Put it back at the front, ahead of any newer events.
+		if (  !(aSource->mNextEvent = mEventHead)  )
+			mEventTail = aSource;
+		mEventHead = aSource;
+	}
+	aSource->mEvents |= aEvents;
+	mWake = true; // The owner is responsible for retrying, so there's no need to notify it.
+}
+
+
+void WorkerPool::Forget(WorkerEventSource *aSource)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	if (!aSource->mEvents)
+		return;
+	WorkerEventSource *prev = nullptr;
+	for (auto source = mEventHead; source; prev = source, source = source->mNextEvent)
+	{
+		if (source != aSource)
+			continue;
+		if (prev)
+			prev->mNextEvent = source->mNextEvent;
+		else
+			mEventHead = source->mNextEvent;
+		if (mEventTail == source)
+			mEventTail = prev;
+		break;
+	}
+	aSource->mNextEvent = nullptr;
+	aSource->mEvents = 0;
+}
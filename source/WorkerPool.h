@@ -0,0 +1,98 @@
+﻿#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Runs jobs on a small set of background threads and queues their progress and completion
+// events for the thread which owns the pool.  This has no dependencies on the OS; the owner
+// supplies a notification function which wakes it up (such as by posting a message) when
+// events become available, then retrieves them one at a time with GetEvent().
+
+class WorkerPool;
+
+enum WorkerEventType
+{
+	WORKER_EVENT_PROGRESS = 0x1,
+	WORKER_EVENT_DONE = 0x2,
+	WORKER_EVENT_DATA = 0x4
+};
+
+// Anything which can queue events for the owner of a pool.  Jobs are the usual source, but
+// other objects can use the same queue to have their events handled on the owner's thread.
+class WorkerEventSource
+{
+	friend class WorkerPool;
+	WorkerEventSource *mNextEvent = nullptr; // Link in the event queue.
+	UINT mEvents = 0; // WORKER_EVENT flags not yet retrieved by the owner.  Protected by the pool's lock.
+
+public:
+	virtual ~WorkerEventSource() {}
+
+	// Never called by the pool; for the owner to handle events retrieved by GetEvent().
+	virtual void OnEvents(UINT /*aEvents*/) {}
+};
+
+class WorkerJob : public WorkerEventSource
+{
+	friend class WorkerPool;
+	WorkerJob *mNextJob = nullptr; // Link in the work queue.
+	std::atomic<bool> mCanceled {false};
+
+public:
+	// Called on a worker thread.  Long jobs should check IsCanceled() periodically.
+	virtual void Run(WorkerPool &aPool) = 0;
+
+	void Cancel() { mCanceled = true; }
+	bool IsCanceled() { return mCanceled.load(std::memory_order_relaxed); }
+};
+
+class WorkerPool
+{
+public:
+	typedef void (*NotifyProc)(void *aParam);
+	enum { MAX_THREADS = 8 };
+
+	// Threads are started as needed, up to aMaxThreads (which is capped at MAX_THREADS).
+	// aNotify is called on a worker thread, and only when no earlier notification is pending.
+	WorkerPool(UINT aMaxThreads, NotifyProc aNotify, void *aNotifyParam);
+	// Waits for running jobs to return.  Jobs which haven't started are abandoned.
+	~WorkerPool();
+
+	void Submit(WorkerJob *aJob);
+
+	// Called by a running job to report progress.  Reports are coalesced until the owner
+	// retrieves them, so the job should keep its own record of the latest values.
+	void PostProgress(WorkerJob *aJob) { PostEvent(aJob, WORKER_EVENT_PROGRESS); }
+
+	// Called by any thread to report that aSource has data for the owner.  Reports are coalesced
+	// in the same way as progress, but the owner must not discard them.  The source must remain
+	// valid until the event is retrieved or Forget() is called.
+	void PostData(WorkerEventSource *aSource) { PostEvent(aSource, WORKER_EVENT_DATA); }
+
+	// Called by the owner.  Retrieves the oldest source with pending events and returns true, or
+	// returns false if there are none.  Once WORKER_EVENT_DONE is returned, the pool no longer
+	// references the job.
+	bool GetEvent(WorkerEventSource *&aSource, UINT &aEvents);
+	// Called by the owner to put back events it couldn't handle yet.  No notification is made;
+	// the owner must arrange to call GetEvent() again.
+	void Requeue(WorkerEventSource *aSource, UINT aEvents);
+	// Called by the owner to discard any pending events of a source which is being deleted.
+	// The caller must ensure that no other thread will post events for it.
+	void Forget(WorkerEventSource *aSource);
+
+private:
+	void WorkerMain();
+	void PostEvent(WorkerEventSource *aSource, UINT aEvent);
+
+	std::mutex mLock;
+	std::condition_variable mJobReady;
+	WorkerJob *mJobHead = nullptr, *mJobTail = nullptr;
+	WorkerEventSource *mEventHead = nullptr, *mEventTail = nullptr;
+	std::thread mThread[MAX_THREADS];
+	UINT mThreadCount = 0, mIdleCount = 0, mMaxThreads;
+	bool mStopping = false;
+	bool mWake = false; // True if a notification is pending.
+	NotifyProc mNotify;
+	void *mNotifyParam;
+};
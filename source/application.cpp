@@ -22,6 +22,9 @@ GNU General Public License for more details.
 #include "resources/resource.h"  // For ID_TRAY_OPEN.
 
 
+static bool sWorkerEventsDeferred = false; // See DeferWorkerEvents().
+
+
 bool MsgSleep(int aSleepDuration, MessageMode aMode)
 // Returns true if it launched at least one thread, and false otherwise.
 // aSleepDuration can be be zero to do a true Sleep(0), or less than 0 to avoid sleeping or
@@ -218,6 +221,8 @@ bool MsgSleep(int aSleepDuration, MessageMode aMode)
 	POINT gui_point;
 	HDROP hdrop_to_free;
 	input_type *input_hook;
+	WorkerEventSource *worker_source;
+	UINT worker_events;
 	LRESULT msg_reply;
 	BOOL peek_result;
 	MSG msg;
@@ -433,6 +438,14 @@ bool MsgSleep(int aSleepDuration, MessageMode aMode)
 		// for further processing.
 		++messages_received;
 
+		// Events from the hook thread are queued rather than posted individually (see PostHookEvent()).
+		// Retrieve the next one so that it gets exactly the same handling as a posted message, including
+		// by MsgMonitor().  Like the events themselves, AHK_HOOK_EVENT is only retrieved while the
+		// script is interruptible, so the queue buffers events the same way the message queue would.
+		if (msg.message == AHK_HOOK_EVENT && (!msg.hwnd || msg.hwnd == g_hWnd)
+			&& !GetHookEvent(msg))
+			continue; // The queue was already drained by an earlier AHK_HOOK_EVENT.
+
 		// For max. flexibility, it seems best to allow the message filter to have the first
 		// crack at looking at the message, before even TRANSLATE_AHK_MSG:
 		if (g_MsgMonitor.Count() && MsgMonitor(msg.hwnd, msg.message, msg.wParam, msg.lParam, &msg, msg_reply))  // Count is checked here to avoid function-call overhead.
@@ -609,6 +622,7 @@ bool MsgSleep(int aSleepDuration, MessageMode aMode)
 		case AHK_HOOK_HOTKEY:  // Sent from this app's keyboard or mouse hook.
 		case AHK_HOTSTRING:    // Sent from keybd hook to activate a non-auto-replace hotstring.
 		case AHK_CLIPBOARD_CHANGE:
+		case AHK_WORKER_EVENT: // A background job has made progress or finished.
 			// This extra handling is present because common controls and perhaps other OS features tend
 			// to use WM_USER+NN messages, a practice that will probably be even more common in the future.
 			// To cut down on message conflicts, dispatch such messages whenever their HWND isn't a what
@@ -790,6 +804,15 @@ bool MsgSleep(int aSleepDuration, MessageMode aMode)
 				priority = 0;
 				break;
 
+			case AHK_WORKER_EVENT:
+				if (sWorkerEventsDeferred && !msg.wParam)
+					continue; // Wait for WorkerEventRetry().  The pool won't notify again until GetEvent() is called.
+				sWorkerEventsDeferred = false;
+				if (!g_WorkerPool || !g_WorkerPool->GetEvent(worker_source, worker_events))
+					continue; // The queue was already drained by an earlier AHK_WORKER_EVENT.
+				priority = 0;
+				break;
+
 			case AHK_INPUT_KEYDOWN:
 			case AHK_INPUT_CHAR:
 			case AHK_INPUT_KEYUP:
@@ -912,6 +935,8 @@ bool MsgSleep(int aSleepDuration, MessageMode aMode)
 				}
 				if (msg.message == AHK_INPUT_END)
 					input_hook->ScriptObject->Release();
+				else if (msg.message == AHK_WORKER_EVENT)
+					DeferWorkerEvents(worker_source, worker_events);
 				continue;
 				// If the above "continued", it seems best not to re-queue/buffer the key since
 				// it might be a while before the number of threads drops back below the limit.
@@ -927,6 +952,8 @@ bool MsgSleep(int aSleepDuration, MessageMode aMode)
 				}
 				if (msg.message == AHK_INPUT_END)
 					input_hook->ScriptObject->Release();
+				else if (msg.message == AHK_WORKER_EVENT)
+					DeferWorkerEvents(worker_source, worker_events);
 				continue;
 			}
 
@@ -963,6 +990,7 @@ bool MsgSleep(int aSleepDuration, MessageMode aMode)
 			case AHK_INPUT_CHAR:
 			case AHK_INPUT_KEYUP:
 			case AHK_USER_MENU: // user-defined menu item
+			case AHK_WORKER_EVENT:
 				break; // Do nothing at this stage.
 			default: // hotkey or hotstring
 				// Just prior to launching the hotkey, update these values to support built-in
@@ -1292,6 +1320,10 @@ bool MsgSleep(int aSleepDuration, MessageMode aMode)
 				break;
 			}
 
+			case AHK_WORKER_EVENT:
+				worker_source->OnEvents(worker_events);
+				break;
+
 			default: // hotkey
 				if (IS_WHEEL_VK(hk->mVK)) // If this is true then also: msg.message==AHK_HOOK_HOTKEY
 					g.EventInfo = LOWORD(msg.lParam); // v1.0.43.03: Override the thread default of 0 with the number of notches by which the wheel was turned.
@@ -1496,7 +1528,7 @@ bool CheckScriptTimers()
 // message pump, and such pending messages might be discarded or mishandled.
 // Caller should already have checked the value of g_script.mTimerEnabledCount to ensure it's
 // greater than zero, since we don't check that here (for performance).
-// This function will go through the list of timed subroutines only once and then return to its caller.
+// This function will launch each due timer at most once and then return to its caller.
 // It does it only once so that it won't keep a thread beneath it permanently suspended if the sum
 // total of all timer durations is too large to be run at their specified frequencies.
 // This function is allowed to be called recursively, which handles certain situations better:
@@ -1531,37 +1563,32 @@ bool CheckScriptTimers()
 	if (g_nPausedThreads > 0 || (!g->AllowTimers && g_nThreads) || g_nThreads >= g_MaxThreadsTotal || !IsInterruptible()) // See above.
 		return false;
 
-	ScriptTimer *ptimer, *next_timer;
-	BOOL at_least_one_timer_launched;
-	DWORD tick_start;
+	// Only the timers which are due are visited, so the cost of each call depends on the number of
+	// due timers rather than the total.  Timers are launched in order of due time.
+	UINT64 tick_start = GetTickCount64();
+	if (!g_script.mTimerQueue.IsDue(tick_start))
+		return false;
+
+	// Each call is numbered so that it launches each timer at most once, even if the timer becomes due
+	// again while its thread or others are running (such as because its period is 0).  Recursive calls
+	// can still launch it again, as described above.
+	static UINT sCheckCount = 0;
+	UINT this_check = ++sCheckCount;
+	auto can_launch = [this_check](TimerQueueItem *aItem) {
+		auto &timer = *static_cast<ScriptTimer *>(aItem);
+		return !timer.mExistingThreads && timer.mPriority >= g->Priority // thread priorities
+			&& timer.mLastCheck != this_check;
+	};
 
 	// Note: It seems inconsequential if a subroutine that the below loop executes causes a
-	// new timer to be added to the linked list while the loop is still enumerating the timers.
-
-	for (at_least_one_timer_launched = FALSE, ptimer = g_script.mFirstTimer
-		; ptimer != NULL
-		; ptimer = next_timer)
+	// new timer to be created or an existing one to be deleted, since each iteration searches
+	// the queue again.
+	BOOL at_least_one_timer_launched = FALSE;
+	for (ScriptTimer *ptimer
+		; (ptimer = static_cast<ScriptTimer *>(g_script.mTimerQueue.FindDue(tick_start, can_launch)))
+		; tick_start = GetTickCount64()) // In case a previous iteration of the loop took a long time to execute.
 	{
 		ScriptTimer &timer = *ptimer; // For performance and convenience.
-		if (!timer.mEnabled || timer.mExistingThreads > 0 || timer.mPriority < g->Priority) // thread priorities
-		{
-			next_timer = timer.mNextTimer;
-			continue;
-		}
-
-		tick_start = GetTickCount(); // Call GetTickCount() every time in case a previous iteration of the loop took a long time to execute.
-		// As of v1.0.36.03, the following subtracts two DWORDs to support intervals of 49.7 vs. 24.8 days.
-		// This should work as long as the distance between the values being compared isn't greater than
-		// 49.7 days. This is because 1 minus 2 in unsigned math yields 0xFFFFFFFF milliseconds (49.7 days).
-		// If the distance between time values is greater than 49.7 days (perhaps because the computer was
-		// suspended/hibernated for 50+ days), the next launch of the affected timer(s) will be delayed
-		// by up to 100% of their periods.  See IsInterruptible() for more discussion.
-		if (tick_start - timer.mTimeLastRun < (DWORD)timer.mPeriod) // Timer is not yet due to run.
-		{
-			next_timer = timer.mNextTimer;
-			continue;
-		}
-		// Otherwise, this timer is due to run.
 		if (!at_least_one_timer_launched) // This will be the first timer launched here.
 		{
 			at_least_one_timer_launched = TRUE;
@@ -1596,14 +1623,22 @@ bool CheckScriptTimers()
 		// one began.  This should make timers behave more consistently (i.e. how long a timed
 		// subroutine takes to run SHOULD NOT affect its *apparent* frequency, which is number
 		// of times per second or per minute that we actually attempt to run it):
+		DWORD late = (DWORD)(tick_start - timer.mDue);
+		if (timer.mLateMax < late)
+			timer.mLateMax = late;
+		timer.mLateTotal += late;
+		++timer.mRunCount;
 		timer.mTimeLastRun = tick_start;
+		timer.mLastCheck = this_check;
 		if (timer.mRunOnlyOnce)
 			timer.Disable();  // This is done prior to launching the thread for reasons similar to above.
+		else
+			g_script.mTimerQueue.Schedule(&timer, tick_start + timer.mPeriod); // Can't fail since the timer is already queued.
 
 		// v1.0.38.04: The following line is done prior to the timer launch to reduce situations
 		// in which a timer thread is interrupted before it can execute even a single line.
 		// Search for mLastPeekTime in MsgSleep() for detailed explanation.
-		g_script.mLastPeekTime = tick_start; // It's valid to reset this because by definition, "msg" just came in to our caller via Get() or Peek(), both of which qualify as a Peek() for this purpose.
+		g_script.mLastPeekTime = (DWORD)tick_start; // It's valid to reset this because by definition, "msg" just came in to our caller via Get() or Peek(), both of which qualify as a Peek() for this purpose.
 
 		// This next line is necessary in case a prior iteration of our loop invoked a different
 		// timed subroutine that changed any of the global struct's values.  In other words, make
@@ -1621,31 +1656,13 @@ bool CheckScriptTimers()
 		timer.mCallback->ExecuteInNewThread(_T("Timer"));
 		--timer.mExistingThreads;
 
-		for (auto *this_timer = &timer; this_timer; this_timer = next_timer)
-		{
-			// Resolve the next timer only now, in case other timers were created or deleted while
-			// this timer was executing.  Must be done before the timer is potentially deleted below.
-			// Currently timers are disabled only when they can't be deleted (because they're
-			// running).  So now that this one has finished, check if it needs to be deleted.
-			if (this_timer->mEnabled || this_timer->mExistingThreads || this_timer->mDeleteLocked)
-			{
-				if (this_timer == &timer) // If this_timer itself has just executed.
-					next_timer = this_timer->mNextTimer;
-				//else leave next_timer == this_timer, in case it is ready to execute.
-				break;
-			}
-			next_timer = this_timer->mNextTimer;
-			if (next_timer)
-				next_timer->mDeleteLocked++; // Prevent next_timer from being deleted.
-			// The following call can trigger __delete, which can cause further changes to timers,
-			// either directly via SetTimer or via thread interruption.
-			g_script.DeleteTimer(this_timer->mCallback->ToObject());
-			if (next_timer)
-				next_timer->mDeleteLocked--; // Might still be non-zero due to thread interruption.
-			// Now also check next_timer, in case it was disabled while __delete was executing.
-		} // for() series of timers being deleted.
-		
-	} // for() each timer.
+		// Currently timers are disabled only when they can't be deleted (because they're
+		// running).  So now that this one has finished, check if it needs to be deleted.
+		// This can trigger __delete, which can cause further changes to timers, either
+		// directly via SetTimer or via thread interruption.
+		if (!timer.mEnabled && !timer.mExistingThreads)
+			g_script.DeleteTimer(timer.mCallback->ToObject());
+	} // for() each timer which is due.
 
 	if (at_least_one_timer_launched) // Since at least one subroutine was run above, restore various values for our caller.
 	{
@@ -1927,6 +1944,8 @@ void ResumeUnderlyingThread()
 
 	if (!g_nThreads)
 	{
+		// Nothing can still be referring to memory which variables have outgrown, so it can be reused.
+		SimpleHeap::Reclaim();
 		// If this was the last running thread and the script has nothing keeping it open (hotkeys, Gui,
 		// message monitors, etc.) then it should terminate now:
 		if (!g_OnExitIsRunning)
@@ -2075,6 +2094,60 @@ VOID CALLBACK RefreshInterruptibility(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DW
 
 
 
+static void NotifyWorkerEvent(void *aParam)
+// Called on a worker thread when g_WorkerPool has events and hasn't already notified us.
+{
+	PostMessage(g_hWnd, AHK_WORKER_EVENT, 0, 0);
+}
+
+
+WorkerPool &GetWorkerPool()
+// The pool is created on first use and never deleted, since its threads might still be
+// running a job (which can't be interrupted safely) when the program exits.
+{
+	if (!g_WorkerPool)
+	{
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		g_WorkerPool = new WorkerPool(si.dwNumberOfProcessors, NotifyWorkerEvent, nullptr);
+	}
+	return *g_WorkerPool;
+}
+
+
+void DeferWorkerEvents(WorkerEventSource *aSource, UINT aEvents)
+// Called by MsgSleep() when a source's events can't be handled yet because the current thread has
+// a higher priority or there are too many threads.  Unlike hotkeys, a job's completion or a
+// message must not be discarded, so it is put back in the queue and retried a little later.
+{
+	aEvents &= ~WORKER_EVENT_PROGRESS; // Progress is only informational, and will be superseded.
+	if (!aEvents)
+		return;
+	g_WorkerPool->Requeue(aSource, aEvents);
+	RetryWorkerEventsLater();
+}
+
+
+void RetryWorkerEventsLater()
+// Called when queued worker events must be retrieved later, either because they were deferred or
+// because the notification was received by some other message pump, which might discard it.
+// The pool won't notify again until GetEvent() is called, so the retry timer is what ensures that
+// MsgSleep() eventually calls it.
+{
+	// Ignore notifications until the timer fires, since any further events would be deferred too.
+	sWorkerEventsDeferred = true;
+	SetTimer(g_hWnd, TIMER_ID_WORKER_RETRY, SLEEP_INTERVAL * 10, WorkerEventRetry);
+}
+
+
+VOID CALLBACK WorkerEventRetry(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime)
+{
+	KillTimer(hWnd, idEvent);
+	PostMessage(g_hWnd, AHK_WORKER_EVENT, TRUE, 0); // wParam indicates that this is the retry.
+}
+
+
+
 void InitMenuPopup(HMENU aMenu)
 {
 	if (MenuIsModeless(aMenu))
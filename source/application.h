@@ -90,6 +90,13 @@ VOID CALLBACK MsgBoxTimeout(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime
 VOID CALLBACK InputTimeout(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
 VOID CALLBACK RefreshInterruptibility(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
 
+class WorkerPool;
+class WorkerEventSource;
+WorkerPool &GetWorkerPool();
+void DeferWorkerEvents(WorkerEventSource *aSource, UINT aEvents);
+void RetryWorkerEventsLater();
+VOID CALLBACK WorkerEventRetry(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
+
 void InitMenuPopup(HMENU aMenu);
 void UninitMenuPopup(HMENU aMenu);
 bool MenuIsModeless(HMENU aMenu);
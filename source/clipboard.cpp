@@ -222,6 +222,9 @@ ResultType Clipboard::Commit(UINT aFormat)
 // was already physically open, this function will close it as part of the commit (since
 // whoever had it open before can't use the prior contents, since they're invalid).
 {
+	// Any lazy ClipboardAll snapshots of the current contents must be copied before they are replaced.
+	if (!mIsOpen && !ClipboardAll::MaterializeAll())
+		return AbortWrite();
 	if (!mIsOpen && !Open())
 		// Since this should be very rare, a shorter message is now used.  Formerly, it was
 		// "Could not open clipboard for writing after many timed attempts.  Another program is probably holding it open."
@@ -18,10 +18,12 @@ GNU General Public License for more details.
 #define clipboard_h
 
 #include "defines.h"
+#include "SequencedTextCache.h"
 
 
 #define CANT_OPEN_CLIPBOARD_READ _T("Can't open clipboard for reading.")
 #define CANT_OPEN_CLIPBOARD_WRITE _T("Can't open clipboard for writing.")
+#define ERR_CLIPBOARD_CHANGED _T("The clipboard has changed since this ClipboardAll was created.")
 
 #ifdef UNICODE
 // In unicode version, always try CF_UNICODETEXT first, then CF_TEXT.
@@ -66,11 +68,20 @@ public:
 	ResultType AbortWrite(LPTSTR aErrorMessage = _T(""));
 	ResultType Close(LPTSTR aErrorMessage = NULL);
 
+	// The text most recently retrieved via A_Clipboard is kept for reuse until the clipboard's
+	// sequence number changes, which avoids opening the clipboard and copying or converting its
+	// contents when it is read repeatedly (such as by a script polling it).
+	#define CLIPBOARD_CACHE_MAX_LENGTH (8 * 1024 * 1024) // In characters.
+	SequencedTextCache mCache; // Tagged with GetClipboardSequenceNumber() from before the text was retrieved.
+	bool GetCache(LPCTSTR &aText, size_t &aLength) { return mCache.Get(GetClipboardSequenceNumber(), aText, aLength); }
+	void SetCache(DWORD aSequence, LPCTSTR aText, size_t aLength) { mCache.Set(aSequence, aText, aLength); }
+
 	Clipboard() // Constructor
 		: mIsOpen(false)  // Assumes our app doesn't already have it open.
 		, mClipMemNow(NULL), mClipMemNew(NULL)
 		, mClipMemNowLocked(NULL), mClipMemNewLocked(NULL)
 		, mLength(0), mCapacity(0)
+		, mCache(CLIPBOARD_CACHE_MAX_LENGTH)
 	{}
 };
 
@@ -873,6 +873,11 @@ struct HotkeyCriterion
 	LPTSTR OriginalExpr; // For finding expr in #HotIf expr
 	IObject *Callback;
 	HotkeyCriterion *NextCriterion, *NextExpr;
+	bool Pure; // #HotIfPure: The result depends only on the foreground window (not on ThisHotkey, for instance).
+	// The following are used only by the hook thread; see HotCriterionAllowsFiring().
+	UINT MemoStamp;       // g_HotCriterionStamp at the time MemoResult was determined, or 0 if never.
+	HWND MemoResult;      // Result of the most recent evaluation.
+	HWND MemoForeground;  // Foreground window at that time, for Pure criteria only.
 
 	ResultType Eval(LPTSTR aHotkeyName); // For HOT_IF_CALLBACK.
 };
@@ -72,6 +72,10 @@ int g_ClipboardTimeout = 1000; // v1.0.31
 HHOOK g_KeybdHook = NULL;
 HHOOK g_MouseHook = NULL;
 HHOOK g_PlaybackHook = NULL;
+HookStats g_KeybdHookStats = {};
+HookStats g_MouseHookStats = {};
+LatencyHistogram g_HookEventDelay; // Written only by the main thread, in GetHookEvent().
+WorkerPool *g_WorkerPool = nullptr; // Created on first use by GetWorkerPool().
 bool g_ForceLaunch = false;
 bool g_WinActivateForce = false;
 WarnMode g_Warn_LocalSameAsGlobal = WARNMODE_OFF;
@@ -79,6 +83,7 @@ WarnMode g_Warn_Unreachable = WARNMODE_MSGBOX;
 WarnMode g_Warn_VarUnset = WARNMODE_MSGBOX;
 SingleInstanceType g_AllowOnlyOneInstance = SINGLE_INSTANCE_PROMPT;
 bool g_persistent = false;  // Whether the script should stay running even after the auto-exec section finishes.
+int g_ConnectedWorkers = 0; // Number of Worker objects with an open channel, which keep the script running.
 bool g_NoTrayIcon = false;
 #ifdef AUTOHOTKEYSC
 	bool g_AllowMainWindow = false;
@@ -116,6 +121,11 @@ HotkeyCriterion *g_FirstHotCriterion = NULL, *g_LastHotCriterion = NULL;
 
 // Global variables for #HotIf (expression).
 UINT g_HotExprTimeout = 1000; // Timeout for #HotIf (expression) evaluation, in milliseconds.
+bool g_HotExprPure = false; // #HotIfPure: Whether subsequent #HotIf expressions depend only on the foreground window.
+// The following are used only by the hook thread:
+UINT g_HotCriterionStamp = 1; // Identifies the input event being processed; never 0.
+UINT g_HotCriterionEvaluated = 0; // Number of times the hook evaluated a #HotIf criterion.
+UINT g_HotCriterionReused = 0; // Number of times the hook reused a prior result instead.
 HWND g_HotExprLFW = NULL; // Last Found Window of last #HotIf expression.
 HotkeyCriterion *g_FirstHotExpr = NULL, *g_LastHotExpr = NULL;
 
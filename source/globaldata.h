@@ -23,6 +23,7 @@ GNU General Public License for more details.
 #include "os_version.h" // For the global OS_Version object
 
 #include "Debugger.h"
+#include "WorkerPool.h"
 
 extern HINSTANCE g_hInstance;
 extern DWORD g_MainThreadID;
@@ -72,6 +73,10 @@ extern int g_ClipboardTimeout;
 extern HHOOK g_KeybdHook;
 extern HHOOK g_MouseHook;
 extern HHOOK g_PlaybackHook;
+extern HookStats g_KeybdHookStats;
+extern HookStats g_MouseHookStats;
+extern LatencyHistogram g_HookEventDelay;
+extern WorkerPool *g_WorkerPool;
 extern bool g_ForceLaunch;
 extern bool g_WinActivateForce;
 extern WarnMode g_Warn_LocalSameAsGlobal;
@@ -79,6 +84,7 @@ extern WarnMode g_Warn_Unreachable;
 extern WarnMode g_Warn_VarUnset;
 extern SingleInstanceType g_AllowOnlyOneInstance;
 extern bool g_persistent;
+extern int g_ConnectedWorkers;
 extern bool g_NoTrayIcon;
 extern bool g_AllowMainWindow;
 extern bool g_DeferMessagesForUnderlyingPump;
@@ -107,6 +113,10 @@ extern HotkeyCriterion *g_FirstHotCriterion, *g_LastHotCriterion;
 
 // Global variables for #HotIf (expression). See globaldata.cpp for comments.
 extern UINT g_HotExprTimeout;
+extern bool g_HotExprPure;
+extern UINT g_HotCriterionStamp;
+extern UINT g_HotCriterionEvaluated;
+extern UINT g_HotCriterionReused;
 extern HWND g_HotExprLFW;
 extern HotkeyCriterion *g_FirstHotExpr, *g_LastHotExpr;
 
@@ -222,7 +232,8 @@ extern DWORD g_TimeLastInputMouse;
 
 enum OurTimers {TIMER_ID_MAIN = MAX_MSGBOXES + 2 // The first timers in the series are used by the MessageBoxes.  Start at +2 to give an extra margin of safety.
 	, TIMER_ID_UNINTERRUPTIBLE // Obsolete but kept as a a placeholder for backward compatibility, so that this and the other the timer-ID's stay the same, and so that obsolete IDs aren't reused for new things (in case anyone is interfacing these OnMessage() or with external applications).
-	, TIMER_ID_AUTOEXEC, TIMER_ID_INPUT, TIMER_ID_DEREF, TIMER_ID_REFRESH_INTERRUPTIBILITY};
+	, TIMER_ID_AUTOEXEC, TIMER_ID_INPUT, TIMER_ID_DEREF, TIMER_ID_REFRESH_INTERRUPTIBILITY
+	, TIMER_ID_WORKER_RETRY};
 
 // MUST MAKE main timer and uninterruptible timers associated with our main window so that
 // MainWindowProc() will be able to process them when it is called by the DispatchMessage()
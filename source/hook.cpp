@@ -20,6 +20,7 @@ GNU General Public License for more details.
 #include "util.h" // for snprintfcat()
 #include "window.h" // for MsgBox()
 #include "application.h" // For MsgSleep().
+#include "SpscQueue.h"
 
 // Declare static variables (global to only this file/module, i.e. no external linkage):
 static HANDLE sKeybdMutex = NULL;
@@ -128,6 +129,17 @@ static key_type *ksc = NULL;
 
 static bool sHookSyncd; // Only valid while in WaitHookIdle().
 
+// Events for the main thread, in the order they were generated.  See PostHookEvent().
+static SpscQueue<HookEvent, 512> sHookEvents;
+static std::atomic<bool> sHookEventWake; // True if an AHK_HOOK_EVENT message may be pending.
+static UINT sHookEventOverflow; // Events which didn't fit in the queue.
+// Events which didn't fit in sHookEvents.  While any are pending, new events are also put here
+// so that they stay in order; the queue is emptied before these are retrieved.
+struct HookEventNode { HookEvent event; HookEventNode *next; };
+static HookEventNode *sOverflowFirst, *sOverflowLast;
+static std::atomic<bool> sOverflowing; // Set only while holding sOverflowLock; cleared only by the main thread.
+static SRWLOCK sOverflowLock = SRWLOCK_INIT;
+
 /////////////////////////////////////////////////////////////////////////////////////////////
 
 /*
@@ -154,7 +166,53 @@ inline bool IsIgnored(ULONG_PTR aExtraInfo)
 
 
 
+static inline void NextHotCriterionStamp()
+// Invalidates #HotIf criterion results remembered by HotCriterionAllowsFiring() for the previous event.
+{
+	if (!++g_HotCriterionStamp) // Skip 0, which means "never evaluated".
+		g_HotCriterionStamp = 1;
+}
+
+
+
+static inline void RecordHookEvent(HookStats &aStats, LONGLONG aStartTicks, LRESULT aResult)
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	aStats.latency.Record((UINT64)(now.QuadPart - aStartTicks));
+	if (aResult)
+		++aStats.blocked;
+}
+
+
+
 LRESULT CALLBACK LowLevelKeybdProc(int aCode, WPARAM wParam, LPARAM lParam)
+// Wraps the real hook procedure to measure how long each event takes to process.
+// QueryPerformanceCounter() typically costs well under a microsecond on modern systems.
+{
+	LARGE_INTEGER start;
+	QueryPerformanceCounter(&start);
+	NextHotCriterionStamp();
+	LRESULT result = LowLevelKeybdEvent(aCode, wParam, lParam);
+	RecordHookEvent(g_KeybdHookStats, start.QuadPart, result);
+	return result;
+}
+
+
+
+LRESULT CALLBACK LowLevelMouseProc(int aCode, WPARAM wParam, LPARAM lParam)
+{
+	LARGE_INTEGER start;
+	QueryPerformanceCounter(&start);
+	NextHotCriterionStamp();
+	LRESULT result = LowLevelMouseEvent(aCode, wParam, lParam);
+	RecordHookEvent(g_MouseHookStats, start.QuadPart, result);
+	return result;
+}
+
+
+
+LRESULT LowLevelKeybdEvent(int aCode, WPARAM wParam, LPARAM lParam)
 {
 	if (aCode != HC_ACTION)  // MSDN docs specify that both LL keybd & mouse hook should return in this case.
 		return CallNextHookEx(g_KeybdHook, aCode, wParam, lParam);
@@ -225,7 +283,7 @@ LRESULT CALLBACK LowLevelKeybdProc(int aCode, WPARAM wParam, LPARAM lParam)
 
 
 
-LRESULT CALLBACK LowLevelMouseProc(int aCode, WPARAM wParam, LPARAM lParam)
+LRESULT LowLevelMouseEvent(int aCode, WPARAM wParam, LPARAM lParam)
 {
 	// code != HC_ACTION should be evaluated PRIOR to considering the values
 	// of wParam and lParam, because those values may be invalid or untrustworthy
@@ -1923,16 +1981,16 @@ LRESULT SuppressThisKeyFunc(const HHOOK aHook, LPARAM lParam, const vk_type aVK,
 	if (aHotkeyIDToPost != HOTKEY_ID_INVALID)
 	{
 		int input_level = InputLevelFromInfo(aExtraInfo);
-		PostMessage(g_hWnd, AHK_HOOK_HOTKEY, aHotkeyIDToPost, MAKELONG(pKeyHistoryCurr->sc, input_level)); // v1.0.43.03: sc is posted currently only to support the number of wheel turns (to store in A_EventInfo).
+		PostHookEvent(AHK_HOOK_HOTKEY, aHotkeyIDToPost, MAKELONG(pKeyHistoryCurr->sc, input_level)); // v1.0.43.03: sc is posted currently only to support the number of wheel turns (to store in A_EventInfo).
 		if (aKeyUp && hotkey_up[aHotkeyIDToPost & HOTKEY_ID_MASK] != HOTKEY_ID_INVALID)
 		{
 			// This is a key-down hotkey being triggered by releasing a prefix key.
 			// There's also a corresponding key-up hotkey, so fire it too:
-			PostMessage(g_hWnd, AHK_HOOK_HOTKEY, hotkey_up[aHotkeyIDToPost & HOTKEY_ID_MASK], MAKELONG(pKeyHistoryCurr->sc, input_level));
+			PostHookEvent(AHK_HOOK_HOTKEY, hotkey_up[aHotkeyIDToPost & HOTKEY_ID_MASK], MAKELONG(pKeyHistoryCurr->sc, input_level));
 		}
 	}
 	if (aHSwParamToPost != HOTSTRING_INDEX_INVALID)
-		PostMessage(g_hWnd, AHK_HOTSTRING, aHSwParamToPost, aHSlParamToPost);
+		PostHookEvent(AHK_HOTSTRING, aHSwParamToPost, aHSlParamToPost);
 	return 1;
 }
 
@@ -2176,16 +2234,16 @@ LRESULT AllowIt(const HHOOK aHook, int aCode, WPARAM wParam, LPARAM lParam, cons
 	if (aHotkeyIDToPost != HOTKEY_ID_INVALID)
 	{
 		int input_level = InputLevelFromInfo(aExtraInfo);
-		PostMessage(g_hWnd, AHK_HOOK_HOTKEY, aHotkeyIDToPost, MAKELONG(pKeyHistoryCurr->sc, input_level)); // v1.0.43.03: sc is posted currently only to support the number of wheel turns (to store in A_EventInfo).
+		PostHookEvent(AHK_HOOK_HOTKEY, aHotkeyIDToPost, MAKELONG(pKeyHistoryCurr->sc, input_level)); // v1.0.43.03: sc is posted currently only to support the number of wheel turns (to store in A_EventInfo).
 		if (aKeyUp && hotkey_up[aHotkeyIDToPost & HOTKEY_ID_MASK] != HOTKEY_ID_INVALID)
 		{
 			// This is a key-down hotkey being triggered by releasing a prefix key.
 			// There's also a corresponding key-up hotkey, so fire it too:
-    		PostMessage(g_hWnd, AHK_HOOK_HOTKEY, hotkey_up[aHotkeyIDToPost & HOTKEY_ID_MASK], MAKELONG(pKeyHistoryCurr->sc, input_level));
+    		PostHookEvent(AHK_HOOK_HOTKEY, hotkey_up[aHotkeyIDToPost & HOTKEY_ID_MASK], MAKELONG(pKeyHistoryCurr->sc, input_level));
 		}
 	}
 	if (hs_wparam_to_post != HOTSTRING_INDEX_INVALID)
-		PostMessage(g_hWnd, AHK_HOTSTRING, hs_wparam_to_post, hs_lparam_to_post);
+		PostHookEvent(AHK_HOTSTRING, hs_wparam_to_post, hs_lparam_to_post);
 	return result_to_return;
 }
 
@@ -2210,7 +2268,7 @@ bool CollectInput(KBDLLHOOKSTRUCT &aEvent, const vk_type aVK, const sc_type aSC,
 				&& ( ((input->KeySC[aSC] | input->KeyVK[aVK]) & INPUT_KEY_NOTIFY)
 					|| input->NotifyNonText && !((input->KeyVK[aVK]) & INPUT_KEY_IS_TEXT) )   )
 			{
-				PostMessage(g_hWnd, AHK_INPUT_KEYUP, (WPARAM)input, (aSC << 16) | aVK);
+				PostHookEvent(AHK_INPUT_KEYUP, (WPARAM)input, (aSC << 16) | aVK);
 			}
 			if (aKeyUp && (input->KeySC[aSC] & INPUT_KEY_DOWN_SUPPRESSED))
 			{
@@ -2365,6 +2423,8 @@ bool CollectInput(KBDLLHOOKSTRUCT &aEvent, const vk_type aVK, const sc_type aSC,
 			--char_count; // Remove '\b' to simplify the backspacing and collection stages.
 	}
 	
+	if (g_input)
+		++g_KeybdHookStats.input;
 	if (!CollectInputHook(aEvent, aVK, aSC, ch, char_count, aIsIgnored))
 		return false; // Suppress.
 	
@@ -2483,11 +2543,14 @@ bool CollectInput(KBDLLHOOKSTRUCT &aEvent, const vk_type aVK, const sc_type aSC,
 			// Fall through to the check below in case this {BS} completed a dead key sequence.
 			break;
 		}
-		if (char_count > 0
-			&& !CollectHotstring(aEvent, ch, char_count, active_window, pKeyHistoryCurr, aHotstringWparamToPost, aHotstringLparamToPost))
+		if (char_count > 0)
 		{
-			sPendingDeadKeyVK = 0; // Avoid reinserting it later (see "dead_key_sequence_complete" below).
-			return false; // Suppress.
+			++g_KeybdHookStats.hotstring;
+			if (!CollectHotstring(aEvent, ch, char_count, active_window, pKeyHistoryCurr, aHotstringWparamToPost, aHotstringLparamToPost))
+			{
+				sPendingDeadKeyVK = 0; // Avoid reinserting it later (see "dead_key_sequence_complete" below).
+				return false; // Suppress.
+			}
 		}
 	}
 
@@ -2570,11 +2633,26 @@ bool CollectHotstring(KBDLLHOOKSTRUCT &aEvent, TCHAR ch[], int char_count, HWND
 		bool first_char_with_case_is_upper, first_char_with_case_has_gone_by;
 		CaseConformModes case_conform_mode;
 
+		// Use the trie to find which hotstrings could match the end of the buffer, so that the
+		// rest needn't be checked.  Any hotstrings added since the trie was built are checked
+		// after the candidates, which is consistent with their order since they come last.
+		// If there are too many candidates, just check all hotstrings.
+		HotstringTrie *trie = Hotstring::sTrie;
+		HotstringIDType candidate[HS_TRIE_MAX_CANDIDATES];
+		int candidate_count = trie ? trie->FindCandidates(g_HSBuf, g_HSBufLength
+			, _tcschr(g_EndChars, g_HSBuf[g_HSBufLength - 1]) != NULL, candidate, _countof(candidate)) : -1;
+		HotstringIDType unlisted_start = candidate_count < 0 ? 0 : trie->Count();
+		if (candidate_count < 0)
+			candidate_count = 0;
+
 		// Searching through the hot strings in the original, physical order is the documented
 		// way in which precedence is determined, i.e. the first match is the only one that will
 		// be triggered.
-		for (HotstringIDType u = 0; u < Hotstring::sHotstringCount; ++u)
+		for (int c = 0; ; ++c)
 		{
+			HotstringIDType u = c < candidate_count ? candidate[c] : unlisted_start + (c - candidate_count);
+			if (u >= Hotstring::sHotstringCount)
+				break;
 			Hotstring &hs = *Hotstring::shs[u];  // For performance and convenience.
 			if (hs.mSuspended)
 				continue;
@@ -2883,13 +2961,13 @@ bool CollectInputHook(KBDLLHOOKSTRUCT &aEvent, const vk_type aVK, const sc_type
 			// complicated by the possibility of an Input being terminated while OnKeyDown
 			// is being executed (and thereby breaking the list).
 			// This leaves room only for the bare essential parameters: aVK and aSC.
-			PostMessage(g_hWnd, AHK_INPUT_KEYDOWN, (WPARAM)input, (aSC << 16) | aVK);
+			PostHookEvent(AHK_INPUT_KEYDOWN, (WPARAM)input, (aSC << 16) | aVK);
 		}
 		// Seems best to not collect dead key chars by default; if needed, OnDeadChar
 		// could be added, or the script could mark each dead key for OnKeyDown.
 		if (collect_chars && input->ScriptObject && input->ScriptObject->onChar)
 		{
-			PostMessage(g_hWnd, AHK_INPUT_CHAR, (WPARAM)input, ((TBYTE)aChar[1] << 16) | (TBYTE)aChar[0]);
+			PostHookEvent(AHK_INPUT_CHAR, (WPARAM)input, ((TBYTE)aChar[1] << 16) | (TBYTE)aChar[0]);
 		}
 
 		if (!visible)
@@ -4419,6 +4497,145 @@ void ResetKeyTypeState(key_type &key)
 
 
 
+void PostHookEvent(UINT aMsg, WPARAM wParam, LPARAM lParam)
+// Queues an event for MsgSleep(), which handles it as though it had been posted directly.
+// AHK_HOOK_EVENT is posted only if one isn't already pending, so a burst of events (such as from
+// auto-repeat or a macro) costs a single PostMessage, and the events can't be reordered relative
+// to each other by the message queue.  This is normally called by the hook thread, but any thread
+// can use it to queue an event behind those already queued (such as AHK_INPUT_END, which must not
+// overtake the InputHook's own events).
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	HookEvent event = { aMsg, wParam, lParam, now.QuadPart };
+	// sHookEvents has a single producer, so other threads always use the overflow list.
+	bool on_hook_thread = GetCurrentThreadId() == g_HookThreadID;
+	if (!on_hook_thread || sOverflowing || !sHookEvents.Push(event))
+	{
+		// The main thread is far behind, probably because the current thread is uninterruptible.
+		// Rather than discarding the event, put it in the overflow list, which is slower but keeps
+		// the events in order.
+		bool queued = false;
+		AcquireSRWLockExclusive(&sOverflowLock);
+		if (on_hook_thread && !sOverflowing && sHookEvents.Push(event)) // The main thread emptied both in the meantime.
+			queued = true;
+		else if (auto node = (HookEventNode *)malloc(sizeof(HookEventNode)))
+		{
+			node->event = event;
+			node->next = NULL;
+			if (sOverflowLast)
+				sOverflowLast->next = node;
+			else
+				sOverflowFirst = node;
+			sOverflowLast = node;
+			sOverflowing = true;
+			if (on_hook_thread)
+				++sHookEventOverflow;
+			queued = true;
+		}
+		ReleaseSRWLockExclusive(&sOverflowLock);
+		if (!queued) // Out of memory, so post it directly as a last resort.
+		{
+			PostMessage(g_hWnd, aMsg, wParam, lParam);
+			return;
+		}
+	}
+	if (!sHookEventWake.exchange(true))
+		PostMessage(g_hWnd, AHK_HOOK_EVENT, 0, 0);
+}
+
+
+
+static bool PopHookEvent(HookEvent &aEvent)
+// Called only by the main thread.  Retrieves the oldest event, from the queue if it has any;
+// otherwise from the overflow list.
+{
+	if (sHookEvents.Pop(aEvent))
+		return true;
+	if (!sOverflowing)
+		return false;
+	AcquireSRWLockExclusive(&sOverflowLock);
+	auto node = sOverflowFirst;
+	if (node)
+	{
+		if (  !(sOverflowFirst = node->next)  )
+			sOverflowLast = NULL;
+		aEvent = node->event;
+	}
+	else
+		// The queue was empty and the hook thread can't add to it while sOverflowing is true, so
+		// it can go back to using the queue now.
+		sOverflowing = false;
+	ReleaseSRWLockExclusive(&sOverflowLock);
+	free(node);
+	return node != NULL;
+}
+
+
+
+bool GetHookEvent(MSG &aMsg)
+// Called only by MsgSleep() upon receiving AHK_HOOK_EVENT.  Replaces aMsg with the oldest queued
+// event and returns true, or returns false if there were none.
+{
+	// Clear the flag before checking the queue, so that any event pushed after this point will
+	// post another AHK_HOOK_EVENT if the check below doesn't find it.
+	sHookEventWake = false;
+	HookEvent event;
+	if (!PopHookEvent(event))
+		return false;
+	// Only one event is returned per message so that MsgSleep() can apply its usual checks to each.
+	// Post a message for the next one, unless the hook thread has already done so.
+	if ((!sHookEvents.IsEmpty() || sOverflowing) && !sHookEventWake.exchange(true))
+		PostMessage(g_hWnd, AHK_HOOK_EVENT, 0, 0);
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	g_HookEventDelay.Record((UINT64)(now.QuadPart - event.time));
+	aMsg.hwnd = g_hWnd;
+	aMsg.message = event.msg;
+	aMsg.wParam = event.wParam;
+	aMsg.lParam = event.lParam;
+	return true;
+}
+
+
+
+void RelayHookEvents()
+// Called by MainWindowProc when AHK_HOOK_EVENT is dispatched by some message pump other than
+// MsgSleep(), such as that of a MsgBox or menu.  Each queued event is turned back into the message
+// which the hook used to post, and handled the same way MainWindowProc handles those: hotkeys and
+// hotstrings are reposted with a NULL hwnd (which the other pump might discard), as is AHK_INPUT_END,
+// while other InputHook events are discarded since they were never handled outside of MsgSleep().
+{
+	sHookEventWake = false; // Any event queued after this point will post a new AHK_HOOK_EVENT.
+	HookEvent event;
+	while (PopHookEvent(event))
+		if (event.msg == AHK_HOOK_HOTKEY || event.msg == AHK_HOTSTRING || event.msg == AHK_INPUT_END)
+			PostMessage(NULL, event.msg, event.wParam, event.lParam);
+}
+
+
+
+double HookLatencyToMicroseconds(UINT64 aTicks)
+{
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	return aTicks * 1000000.0 / freq.QuadPart;
+}
+
+
+
+static LPTSTR LatencyToText(LatencyHistogram &aLatency, LPTSTR aBuf, int aBufSize)
+{
+	sntprintf(aBuf, aBufSize, _T("50%%: %.1f, 99%%: %.1f, 99.9%%: %.1f, max: %.1f")
+		, HookLatencyToMicroseconds(aLatency.ValueAtPercentile(50))
+		, HookLatencyToMicroseconds(aLatency.ValueAtPercentile(99))
+		, HookLatencyToMicroseconds(aLatency.ValueAtPercentile(99.9))
+		, HookLatencyToMicroseconds(aLatency.Max()));
+	return aBuf;
+}
+
+
+
 void GetHookStatus(LPTSTR aBuf, int aBufSize)
 // aBufSize is an int so that any negative values passed in from caller are not lost.
 {
@@ -4431,6 +4648,23 @@ void GetHookStatus(LPTSTR aBuf, int aBufSize)
 		, ModifiersLRToText(g_modifiersLR_physical, LRpText)
 		, pPrefixKey ? _T("yes") : _T("no"));
 
+	// Show the hooks' latency statistics, which are collected even when key history is disabled.
+	// The queue's delay is the time from an event being queued by the hook to MsgSleep() retrieving it.
+	TCHAR keybd_stats[128], mouse_stats[128], queue_stats[128];
+	sntprintfcat(aBuf, aBufSize,
+		_T("Keybd hook stats: %I64u events, %u blocked, latency (us) %s, %u passed to hotstrings, %u to InputHook\r\n")
+		_T("Mouse hook stats: %I64u events, %u blocked, latency (us) %s\r\n")
+		_T("Hook event queue: %I64u events, %u overflowed, delay (us) %s\r\n")
+		_T("#HotIf criteria checked by hook: %u evaluated, %u reused\r\n")
+		, g_KeybdHookStats.latency.Count(), g_KeybdHookStats.blocked
+		, LatencyToText(g_KeybdHookStats.latency, keybd_stats, _countof(keybd_stats))
+		, g_KeybdHookStats.hotstring, g_KeybdHookStats.input
+		, g_MouseHookStats.latency.Count(), g_MouseHookStats.blocked
+		, LatencyToText(g_MouseHookStats.latency, mouse_stats, _countof(mouse_stats))
+		, g_HookEventDelay.Count(), sHookEventOverflow
+		, LatencyToText(g_HookEventDelay, queue_stats, _countof(queue_stats))
+		, g_HotCriterionEvaluated, g_HotCriterionReused);
+
 	if (!g_KeybdHook)
 		sntprintfcat(aBuf, aBufSize, _T("\r\n")
 			_T("NOTE: Only the script's own keyboard events are shown\r\n")
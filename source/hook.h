@@ -18,6 +18,7 @@ GNU General Public License for more details.
 #define hook_h
 
 #include "hotkey.h" // Use here and also by hook.cpp for ChangeHookState(), which reads from static Hotkey class vars.
+#include "LatencyHistogram.h"
 
 // WM_USER is the lowest number that can be a user-defined message.  Anything above that is also valid.
 // NOTE: Any msg about WM_USER will be kept buffered (unreplied-to) whenever the script is uninterruptible.
@@ -41,6 +42,8 @@ enum UserMessages {AHK_HOOK_HOTKEY = WM_USER, AHK_HOTSTRING, AHK_USER_MENU, AHK_
 	, AHK_HOOK_SYNC // For WaitHookIdle().
 	, AHK_INPUT_END, AHK_INPUT_KEYDOWN, AHK_INPUT_CHAR, AHK_INPUT_KEYUP
 	, AHK_HOOK_SET_KEYHISTORY
+	, AHK_HOOK_EVENT // Wakes MsgSleep() to retrieve events queued by PostHookEvent().
+	, AHK_WORKER_EVENT // Wakes MsgSleep() to retrieve events queued by g_WorkerPool.
 };
 // NOTE: TRY NEVER TO CHANGE the specific numbers of the above messages, since some users might be
 // using the Post/SendMessage commands to automate AutoHotkey itself.  Here is the original order
@@ -291,11 +294,35 @@ struct KeyHistoryItem
 };
 
 
+// Statistics which are always collected by each hook, to help identify slow processing (which
+// causes input lag and can cause the OS to silently remove the hook).  Only the hook thread
+// writes to these.
+struct HookStats
+{
+	LatencyHistogram latency; // Time taken to process each event, in performance counter ticks.
+	UINT blocked; // Events which were suppressed, either by this hook or by one later in the chain.
+	UINT hotstring; // Keyboard events passed to the hotstring recognizer.
+	UINT input; // Keyboard events passed to InputHook.
+};
+
+
+// A message queued for the main thread via PostHookEvent().
+struct HookEvent
+{
+	UINT msg;
+	WPARAM wParam;
+	LPARAM lParam;
+	LONGLONG time; // Performance counter value when the event was queued.
+};
+
+
 //-------------------------------------------
 
 
 LRESULT CALLBACK LowLevelKeybdProc(int aCode, WPARAM wParam, LPARAM lParam);
 LRESULT CALLBACK LowLevelMouseProc(int aCode, WPARAM wParam, LPARAM lParam);
+LRESULT LowLevelKeybdEvent(int aCode, WPARAM wParam, LPARAM lParam);
+LRESULT LowLevelMouseEvent(int aCode, WPARAM wParam, LPARAM lParam);
 LRESULT LowLevelCommon(const HHOOK aHook, int aCode, WPARAM wParam, LPARAM lParam, const vk_type aVK
 	, sc_type aSC, bool aKeyUp, ULONG_PTR aExtraInfo, DWORD aEventFlags);
 
@@ -333,6 +360,11 @@ HookType GetActiveHooks();
 void FreeHookMem();
 void ResetKeyTypeState(key_type &key);
 void GetHookStatus(LPTSTR aBuf, int aBufSize);
+double HookLatencyToMicroseconds(UINT64 aTicks);
+
+void PostHookEvent(UINT aMsg, WPARAM wParam, LPARAM lParam);
+bool GetHookEvent(MSG &aMsg);
+void RelayHookEvents();
 
 void WaitHookIdle();
 
@@ -45,6 +45,29 @@ HWND HotCriterionAllowsFiring(HotkeyCriterion *aCriterion, LPTSTR aHotkeyName)
 	HWND found_hwnd;
 	if (!aCriterion)
 		return (HWND)1; // Always allow hotkey to fire.
+
+	// Within a single input event, the hook may check the same criterion for many variants and hotkeys,
+	// so the result is remembered until the next event, or until the foreground window changes for a
+	// criterion declared with #HotIfPure.  This is done only on the hook thread, since the fields are
+	// not synchronized and the main thread relies on g_HotExprLFW being set by each evaluation.
+	// Other expressions and callbacks aren't memoized since they may depend on ThisHotkey, which
+	// differs between the hotkeys checked for a single event.
+	bool use_memo = GetCurrentThreadId() == g_HookThreadID
+		&& (aCriterion->Type != HOT_IF_CALLBACK || aCriterion->Pure);
+	HWND fore_win = NULL;
+	if (use_memo)
+	{
+		if (aCriterion->Pure)
+			fore_win = GetForegroundWindow();
+		if (aCriterion->MemoStamp == g_HotCriterionStamp
+			|| aCriterion->MemoStamp && aCriterion->Pure && aCriterion->MemoForeground == fore_win)
+		{
+			++g_HotCriterionReused;
+			return aCriterion->MemoResult;
+		}
+		++g_HotCriterionEvaluated;
+	}
+
 	switch(aCriterion->Type)
 	{
 	case HOT_IF_ACTIVE:
@@ -59,9 +82,20 @@ HWND HotCriterionAllowsFiring(HotkeyCriterion *aCriterion, LPTSTR aHotkeyName)
 	case HOT_IF_CALLBACK:
 		// Expression evaluation must be done in the main thread. If the message times out, the hotkey/hotstring is not allowed to fire.
 		DWORD_PTR res;
-		return (SendMessageTimeout(g_hWnd, AHK_HOT_IF_EVAL, (WPARAM)aCriterion, (LPARAM)aHotkeyName, SMTO_BLOCK | SMTO_ABORTIFHUNG, g_HotExprTimeout, &res) && res == CONDITION_TRUE) ? (HWND)1 : NULL;
+		if (!SendMessageTimeout(g_hWnd, AHK_HOT_IF_EVAL, (WPARAM)aCriterion, (LPARAM)aHotkeyName, SMTO_BLOCK | SMTO_ABORTIFHUNG, g_HotExprTimeout, &res))
+			return NULL; // Timed out.  Don't remember this result, since the next attempt might not time out.
+		found_hwnd = (res == CONDITION_TRUE) ? (HWND)1 : NULL;
+		break;
 	}
-	return (aCriterion->Type == HOT_IF_ACTIVE || aCriterion->Type == HOT_IF_EXIST) ? found_hwnd : (HWND)!found_hwnd;
+	if (aCriterion->Type == HOT_IF_NOT_ACTIVE || aCriterion->Type == HOT_IF_NOT_EXIST)
+		found_hwnd = (HWND)!found_hwnd;
+	if (use_memo)
+	{
+		aCriterion->MemoResult = found_hwnd;
+		aCriterion->MemoForeground = fore_win;
+		aCriterion->MemoStamp = g_HotCriterionStamp;
+	}
+	return found_hwnd;
 }
 
 
@@ -100,17 +134,26 @@ HotkeyCriterion *AddHotkeyCriterion(HotCriterionType aType, LPCTSTR aWinTitle, L
 	cp = SimpleHeap::Alloc<HotkeyCriterion>();
 	cp->Type = aType;
 	cp->OriginalExpr = nullptr;
+	cp->Pure = false;
+	cp->MemoStamp = 0;
 	if (*aWinTitle)
 	{
 		if (   !(cp->WinTitle = SimpleHeap::Malloc(aWinTitle))   )
+		{
+			SimpleHeap::Free(cp, sizeof(HotkeyCriterion));
 			return NULL;
+		}
 	}
 	else
 		cp->WinTitle = _T("");
 	if (*aWinText)
 	{
 		if (   !(cp->WinText = SimpleHeap::Malloc(aWinText))   )
+		{
+			SimpleHeap::FreeString(cp->WinTitle);
+			SimpleHeap::Free(cp, sizeof(HotkeyCriterion));
 			return NULL;
+		}
 	}
 	else
 		cp->WinText = _T("");
@@ -138,6 +181,8 @@ HotkeyCriterion *AddHotkeyIfExpr()
 	HotkeyCriterion *cp = SimpleHeap::Alloc<HotkeyCriterion>();
 	cp->NextExpr = NULL;
 	cp->OriginalExpr = nullptr;
+	cp->Pure = false;
+	cp->MemoStamp = 0;
 	if (g_LastHotExpr)
 		g_LastHotExpr->NextExpr = cp;
 	else
@@ -459,6 +504,8 @@ void Hotkey::ManifestAllHotkeysHotstringsHooks()
 	// But do this part outside of the above block because these values may have changed since
 	// this function was first called.  By design, the Num/Scroll/CapsLock AlwaysOn/Off setting
 	// stays in effect even when Suspend in ON.
+	if (Hotstring::sEnabledCount)
+		Hotstring::UpdateTrie(false); // Cover any hotstrings added since the last call.
 	if (   Hotstring::sEnabledCount
 		|| g_input // v1.0.91: Hook is needed for collecting input.
 		|| !(g_ForceNumLock == NEUTRAL && g_ForceCapsLock == NEUTRAL && g_ForceScrollLock == NEUTRAL)   )
@@ -1249,7 +1296,7 @@ Hotkey *Hotkey::AddHotkey(IObject *aCallback, HookActionType aHookAction, LPCTST
 	}
 	if (!shk[sNextID]->mConstructedOK)
 	{
-		delete shk[sNextID];  // SimpleHeap allows deletion of most recently added item.
+		delete shk[sNextID];  // Returns its memory to SimpleHeap.
 		return NULL;  // The constructor already displayed the error.
 	}
 	++sNextID;
@@ -2199,6 +2246,7 @@ Hotstring **Hotstring::shs = NULL;
 HotstringIDType Hotstring::sHotstringCount = 0;
 HotstringIDType Hotstring::sHotstringCountMax = 0;
 UINT Hotstring::sEnabledCount = 0;
+HotstringTrie *volatile Hotstring::sTrie = NULL;
 
 
 void Hotstring::SuspendAll(bool aSuspend)
@@ -2245,6 +2293,43 @@ void Hotstring::SuspendAll(bool aSuspend)
 
 
 
+static LPCTSTR HotstringAbbrev(HotstringIDType aID, int &aLength)
+{
+	Hotstring &hs = *Hotstring::shs[aID];
+	aLength = hs.mStringLength;
+	return hs.mString;
+}
+
+static TCHAR HotstringFold(TCHAR aChar)
+{
+	return ltolower(aChar);
+}
+
+void Hotstring::UpdateTrie(bool aAllowTail)
+// Rebuilds sTrie if it doesn't cover all hotstrings.  If aAllowTail is true, rebuilding may be
+// deferred until HS_TRIE_MAX_TAIL hotstrings are uncovered, since the hook checks those linearly.
+// This avoids rebuilding for every hotstring when a script creates many of them one at a time,
+// while keeping the hook's work per keystroke bounded regardless of how many there are.
+{
+	HotstringIDType covered = sTrie ? sTrie->Count() : 0;
+	if (covered == sHotstringCount)
+		return;
+	if (aAllowTail && sHotstringCount - covered < HS_TRIE_MAX_TAIL)
+		return;
+	HotstringTrie *trie = HotstringTrie::Create(sHotstringCount, HotstringAbbrev, HotstringFold);
+	if (!trie)
+		return; // Out of memory, so just leave the remaining hotstrings to be checked linearly.
+	HotstringTrie *old_trie = sTrie;
+	sTrie = trie;
+	if (old_trie)
+	{
+		WaitHookIdle(); // Ensure the hook is no longer using old_trie.
+		delete old_trie;
+	}
+}
+
+
+
 ResultType Hotstring::PerformInNewThreadMadeByCaller()
 // Returns OK or FAIL.  Caller has already ensured that the backspacing (if specified by mDoBackspace)
 // has been done.  Caller must have already created a new thread for us, and must close the thread when
@@ -2404,7 +2489,7 @@ ResultType Hotstring::AddHotstring(LPCTSTR aName, IObjectPtr aCallback, LPCTSTR
 		return MemoryError(); // Short msg. since so rare.
 	if (!shs[sHotstringCount]->mConstructedOK)
 	{
-		delete shs[sHotstringCount];  // SimpleHeap allows deletion of most recently added item.
+		delete shs[sHotstringCount];  // Returns its memory to SimpleHeap.
 		return FAIL;  // The constructor already displayed the error.
 	}
 
@@ -2442,7 +2527,7 @@ Hotstring::Hotstring(LPCTSTR aName, IObjectPtr aCallback, LPCTSTR aOptions, LPCT
 		return; // ScriptError() was already called by Malloc().
 	if (   !(mName = SimpleHeap::Malloc(aName))   )
 	{
-		SimpleHeap::Delete(mString); // SimpleHeap allows deletion of most recently added item.
+		SimpleHeap::FreeString(mString);
 		return;
 	}
 	mStringLength = (UCHAR)_tcslen(mString);
@@ -2451,6 +2536,8 @@ Hotstring::Hotstring(LPCTSTR aName, IObjectPtr aCallback, LPCTSTR aOptions, LPCT
 		// SimpleHeap is not used for the replacement as it can be changed at runtime by Hotstring().
 		if (   !(mReplacement = _tcsdup(aReplacement))   )
 		{
+			SimpleHeap::FreeString(mString);
+			SimpleHeap::FreeString(mName);
 			MemoryError(); // Short msg since very rare.
 			return;
 		}
@@ -2733,6 +2820,7 @@ bif_impl FResult BIF_Hotstring(StrArg name, ExprTokenType *aReplacement, optl<St
 
 		existing = Hotstring::shs[Hotstring::sHotstringCount-1];
 		was_already_enabled = false; // Because it didn't exist.
+		Hotstring::UpdateTrie(true);
 	}
 
 	if (action_obj)
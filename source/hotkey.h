@@ -18,6 +18,7 @@ GNU General Public License for more details.
 #define hotkey_h
 
 #include "keyboard_mouse.h"
+#include "HotstringTrie.h"
 #include "script.h"  // For which label (and in turn which line) in the script to jump to.
 EXTERN_SCRIPT;  // For g_script.
 
@@ -156,7 +157,10 @@ private:
 
 	void *operator new(size_t aBytes) {return SimpleHeap::Malloc(aBytes);}
 	void *operator new[](size_t aBytes) {return SimpleHeap::Malloc(aBytes);}
-	void operator delete(void *aPtr) {SimpleHeap::Delete(aPtr);}  // Deletes aPtr if it was the most recently allocated.
+	// Hotkeys and hotstrings are deleted only when construction fails, since the hook and hotkey IDs
+	// may refer to them for the life of the script.  Free() allows the memory to be reused even if
+	// something else was allocated during construction.
+	void operator delete(void *aPtr, size_t aBytes) {SimpleHeap::Free(aPtr, aBytes);}
 	void operator delete[](void *aPtr) {SimpleHeap::Delete(aPtr);}
 
 	// For now, constructor & destructor are private so that only static methods can create new
@@ -337,7 +341,6 @@ private:
 #define MAX_HOTSTRING_LENGTH 40  // Hard to imagine a need for more than this, and most are only a few chars long.
 #define MAX_HOTSTRING_LENGTH_STR _T("40")  // Keep in sync with the above.
 #define HOTSTRING_BLOCK_SIZE 1024
-typedef UINT HotstringIDType;
 
 enum CaseConformModes {CASE_CONFORM_NONE, CASE_CONFORM_ALL_CAPS, CASE_CONFORM_FIRST_CAP};
 
@@ -349,6 +352,7 @@ public:
 	static HotstringIDType sHotstringCount;
 	static HotstringIDType sHotstringCountMax;
 	static UINT sEnabledCount; // v1.1.28.00: For performance, such as avoiding calling ToAsciiEx() in the hook.
+	static HotstringTrie *volatile sTrie; // Read by the hook thread, so only replaced via UpdateTrie().
 
 	IObjectRef mCallback;
 	LPTSTR mName;
@@ -370,6 +374,7 @@ public:
 		, mDetectWhenInsideWord, mDoReset, mSuspendExempt, mConstructedOK;
 
 	static void SuspendAll(bool aSuspend);
+	static void UpdateTrie(bool aAllowTail);
 	ResultType PerformInNewThreadMadeByCaller();
 	void DoReplace(LPARAM alParam);
 	static Hotstring *FindHotstring(LPCTSTR aHotstring, bool aCaseSensitive, bool aDetectWhenInsideWord, HotkeyCriterion *aHotCriterion);
@@ -387,7 +392,10 @@ public:
 
 	void *operator new(size_t aBytes) {return SimpleHeap::Malloc(aBytes);}
 	void *operator new[](size_t aBytes) {return SimpleHeap::Malloc(aBytes);}
-	void operator delete(void *aPtr) {SimpleHeap::Delete(aPtr);}  // Deletes aPtr if it was the most recently allocated.
+	// Hotkeys and hotstrings are deleted only when construction fails, since the hook and hotkey IDs
+	// may refer to them for the life of the script.  Free() allows the memory to be reused even if
+	// something else was allocated during construction.
+	void operator delete(void *aPtr, size_t aBytes) {SimpleHeap::Free(aPtr, aBytes);}
 	void operator delete[](void *aPtr) {SimpleHeap::Delete(aPtr);}
 };
 
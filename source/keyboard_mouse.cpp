@@ -21,6 +21,7 @@ GNU General Public License for more details.
 #include "util.h"  // for strlicmp()
 #include "window.h" // for IsWindowHung()
 #include "abi.h"
+#include "SendPlan.h"
 
 
 // Added for v1.0.25.  Search on sPrevEventType for more comments:
@@ -424,9 +425,20 @@ void SendKeys(LPCTSTR aKeys, SendRawModes aSendRaw, SendModes aSendModeOrig, HWN
 			mem_size = MAX_INITIAL_EVENTS_PB * sizeof(PlaybackEvent);
 			sMaxEvents = MAX_INITIAL_EVENTS_PB;
 		}
+		// Each character of raw text typically needs two events, plus some for modifiers.  For long text,
+		// size the array up-front rather than letting ExpandEventArray() grow and copy it repeatedly.
+		// CleanupEventArray() frees it since sMaxEvents exceeds the initial size.
+		size_t estimated_events = aSendRaw ? _tcslen(aKeys) * 3 : 0;
+		void *event_mem = NULL;
+		if (estimated_events > sMaxEvents)
+		{
+			size_t event_size = mem_size / sMaxEvents;
+			if (event_mem = malloc(estimated_events * event_size))
+				sMaxEvents = (UINT)estimated_events;
+		}
 		// _alloca() is used to avoid the overhead of malloc/free (99% of Sends will thus fit in stack memory).
 		// _alloca() never returns a failure code, it just raises an exception (e.g. stack overflow).
-		InitEventArray(_alloca(mem_size), sMaxEvents, mods_current);
+		InitEventArray(event_mem ? event_mem : _alloca(mem_size), sMaxEvents, mods_current);
 	}
 
 	bool blockinput_prev = g_BlockInput;
@@ -761,6 +773,7 @@ brace_case_end: // This label is used to simplify the code without sacrificing p
 
 		else // Encountered a character other than ^+!#{} ... or we're in raw mode.
 		{
+			modLR_type mods_to_keep_down = 0;
 			if (aSendRaw == SCM_RAW_TEXT)
 			{
 				// \b needs to produce VK_BACK for auto-replace hotstrings to work (this is more useful anyway).
@@ -782,17 +795,21 @@ brace_case_end: // This label is used to simplify the code without sacrificing p
 			}
 			else
 			{
-				// Best to call this separately, rather than as first arg in SendKey, since it changes the
-				// value of modifiers and the updated value is *not* guaranteed to be passed.
-				// In other words, SendKey(TextToVK(...), modifiers, ...) would often send the old
-				// value for modifiers.
-				vk = CharToVKAndModifiers(*aKeys, &mods_for_next_key, sTargetKeybdLayout
-					, (mods_for_next_key | persistent_modifiers_for_this_SendKeys) != 0 && !aSendRaw); // v1.1.27.00: Disable the a-z to vk41-vk5A fallback translation when modifiers are present since it would produce the wrong printable characters.
 				// CharToVKAndModifiers() takes no measurable time compared to the amount of time SendKey takes.
+				SendTextKey key = PlanTextKey(aKeys, aSendRaw != SCM_NOT_RAW, mods_for_next_key, persistent_modifiers_for_this_SendKeys
+					, [](TCHAR aChar, modLR_type *aMods, bool aEnableAZFallback) {
+						return CharToVKAndModifiers(aChar, aMods, sTargetKeybdLayout, aEnableAZFallback);
+					});
+				vk = key.vk;
+				mods_for_next_key = key.mods;
+				mods_to_keep_down = key.keep_down;
 			}
 			if (vk)
-				SendKey(vk, 0, mods_for_next_key, persistent_modifiers_for_this_SendKeys, 1, KEYDOWNANDUP
+			{
+				SendKey(vk, 0, mods_for_next_key & ~mods_to_keep_down
+					, persistent_modifiers_for_this_SendKeys | mods_to_keep_down, 1, KEYDOWNANDUP
 					, 0, aTargetWindow);
+			}
 			else // Try to send it by alternate means.
 			{
 				// In this mode, mods_for_next_key is ignored due to being unsupported.
@@ -3876,9 +3893,17 @@ ResultType LayoutHasAltGr(HKL aLayout)
 	//   - N'Ko has AltGr but does not appear to use it for anything.
 	//   - Ukrainian has AltGr but only uses it for one character, which is also assigned to a naked
 	//     VK (so VkKeyScanEx returns that one).  Likely the key in question is absent from some keyboards.
-	cl.has_altgr = LayoutHasAltGrDirect(aLayout);
-	cl.hkl = aLayout; // This is done here (immediately after has_altgr is set) rather than earlier to minimize the consequences of not being fully thread-safe.
-	return cl.has_altgr;
+	ResultType has_altgr = LayoutHasAltGrDirect(aLayout);
+	// In case this entry previously belonged to another layout, unpublish it before clearing the cached
+	// VkKeyScanEx() results, so that CachedVkKeyScan() on another thread can't store an old-layout result
+	// which then appears to belong to the new layout (see the checks there).
+	cl.hkl = NULL;
+	MemoryBarrier();
+	ZeroMemory(cl.vk_scan, sizeof(cl.vk_scan));
+	cl.has_altgr = has_altgr;
+	MemoryBarrier();
+	cl.hkl = aLayout; // This is done here (after has_altgr is set) rather than earlier to minimize the consequences of not being fully thread-safe.
+	return has_altgr;
 }
 
 
@@ -4045,6 +4070,41 @@ vk_type TextToVK(LPCTSTR aText, modLR_type *pModifiersLR, bool aExcludeThoseHand
 
 
 
+SHORT CachedVkKeyScan(TCHAR aChar, HKL aKeybdLayout)
+// Returns the same as VkKeyScanEx(), but caches results for the low 256 chars of any layout which
+// LayoutHasAltGr() has already cached.  Send calls LayoutHasAltGr() for the target layout before
+// translating any characters, so long strings of text need only one VkKeyScanEx() call per distinct
+// character.  Thread-safety: The hook thread and main thread may both call this, and LayoutHasAltGr()
+// may reassign an entry to another layout at any time.  The entry's hkl is checked again after each
+// access so that a result is never used or kept for the wrong layout; a collision merely causes a
+// redundant lookup.
+{
+	if ((UINT)aChar < _countof(sCachedLayout[0].vk_scan) && aKeybdLayout)
+		for (int i = 0; i < MAX_CACHED_LAYOUTS && sCachedLayout[i].hkl; ++i)
+			if (sCachedLayout[i].hkl == aKeybdLayout)
+			{
+				CachedLayoutType &cl = sCachedLayout[i];
+				SHORT &cached = cl.vk_scan[(UINT)aChar];
+				SHORT result = cached;
+				if (result) // Already looked up (0 means not, or that the result was 0, which is rare enough not to matter).
+				{
+					MemoryBarrier(); // Read hkl again only after reading the result.
+					if (cl.hkl == aKeybdLayout) // Not reassigned in the meantime, so the result belongs to this layout.
+						return result;
+					break;
+				}
+				result = VkKeyScanEx(aChar, aKeybdLayout);
+				cached = result;
+				MemoryBarrier(); // Read hkl again only after the store is visible to LayoutHasAltGr().
+				if (cl.hkl != aKeybdLayout)
+					cached = 0; // The entry was reassigned, so the result above might not be cleared.
+				return result;
+			}
+	return VkKeyScanEx(aChar, aKeybdLayout);
+}
+
+
+
 vk_type CharToVKAndModifiers(TCHAR aChar, modLR_type *pModifiersLR, HKL aKeybdLayout, bool aEnableAZFallback)
 // If non-NULL, pModifiersLR contains the initial set of modifiers provided by the caller, to which
 // we add any extra modifiers required to realize aChar.
@@ -4055,7 +4115,7 @@ vk_type CharToVKAndModifiers(TCHAR aChar, modLR_type *pModifiersLR, HKL aKeybdLa
 		return VK_RETURN;
 
 	// Otherwise:
-	SHORT mod_plus_vk = VkKeyScanEx(aChar, aKeybdLayout); // v1.0.44.03: Benchmark shows that VkKeyScanEx() is the same speed as VkKeyScan() when the layout has been pre-fetched.
+	SHORT mod_plus_vk = CachedVkKeyScan(aChar, aKeybdLayout); // v1.0.44.03: Benchmark shows that VkKeyScanEx() is the same speed as VkKeyScan() when the layout has been pre-fetched.
 	vk_type vk = LOBYTE(mod_plus_vk);
 	char keyscan_modifiers = HIBYTE(mod_plus_vk);
 	if (keyscan_modifiers == -1 && vk == (UCHAR)-1) // No translation could be made.
@@ -18,64 +18,12 @@ GNU General Public License for more details.
 #include "script.h"
 #include "globaldata.h"
 #include "script_func_impl.h"
+#include "DllType.h"
 
 
 
 #ifdef ENABLE_DLLCALL
 
-#ifdef WIN32_PLATFORM
-// Interface for DynaCall():
-#define  DC_MICROSOFT           0x0000      // Default
-#define  DC_BORLAND             0x0001      // Borland compat
-#define  DC_CALL_CDECL          0x0010      // __cdecl
-#define  DC_CALL_STD            0x0020      // __stdcall
-#define  DC_RETVAL_MATH4        0x0100      // Return value in ST
-#define  DC_RETVAL_MATH8        0x0200      // Return value in ST
-
-#define  DC_CALL_STD_BO         (DC_CALL_STD | DC_BORLAND)
-#define  DC_CALL_STD_MS         (DC_CALL_STD | DC_MICROSOFT)
-#define  DC_CALL_STD_M8         (DC_CALL_STD | DC_RETVAL_MATH8)
-#endif
-
-union DYNARESULT                // Various result types
-{      
-    int     Int;                // Generic four-byte type
-    long    Long;               // Four-byte long
-    void   *Pointer;            // 32-bit pointer
-    float   Float;              // Four byte real
-    double  Double;             // 8-byte real
-    __int64 Int64;              // big int (64-bit)
-	UINT_PTR UIntPtr;
-};
-
-struct DYNAPARM
-{
-    union
-	{
-		int value_int; // Args whose width is less than 32-bit are also put in here because they are right justified within a 32-bit block on the stack.
-		float value_float;
-		__int64 value_int64;
-		UINT_PTR value_uintptr;
-		double value_double;
-		char *astr;
-		wchar_t *wstr;
-		void *ptr;
-    };
-	// Might help reduce struct size to keep other members last and adjacent to each other (due to
-	// 8-byte alignment caused by the presence of double and __int64 members in the union above).
-	DllArgTypes type;
-	union
-	{
-		int struct_size;
-		struct
-		{
-			bool passed_by_address;
-			bool is_unsigned; // Allows return value and output parameters to be interpreted as unsigned vs. signed.
-			bool is_hresult; // Only used for the return value.
-		};
-	};
-};
-
 #ifdef _WIN64
 // This function was borrowed from http://dyncall.org/
 extern "C" UINT_PTR PerformDynaCall(size_t stackArgsSize, DWORD_PTR* stackArgs, DWORD_PTR* regArgs, void* aFunction);
@@ -291,79 +239,6 @@ void DynaCall(void *aFunction, DYNAPARM aParam[], int aParamCount, DWORD &aExcep
 
 
 
-void ConvertDllArgType(LPTSTR aBuf, DYNAPARM &aDynaParam)
-// Helper function for DllCall().  Updates aDynaParam's type and other attributes.
-{
-	LPTSTR type_string = aBuf;
-	TCHAR buf[32];
-	
-	if (ctoupper(*type_string) == 'U') // Unsigned
-	{
-		aDynaParam.is_unsigned = true;
-		++type_string; // Omit the 'U' prefix from further consideration.
-	}
-	else
-		aDynaParam.is_unsigned = false;
-	
-	// Check for empty string before checking for pointer suffix, so that we can skip the first character.  This is needed to simplify "Ptr" type-name support.
-	if (!*type_string)
-	{
-		aDynaParam.type = DLL_ARG_INVALID; 
-		return; 
-	}
-
-	tcslcpy(buf, type_string, _countof(buf)); // Make a modifiable copy for easier parsing below.
-
-	// v1.0.30.02: The addition of 'P'.
-	// However, the current detection below relies upon the fact that none of the types currently
-	// contain the letter P anywhere in them, so it would have to be altered if that ever changes.
-	LPTSTR cp = StrChrAny(buf + 1, _T("*pP")); // Asterisk or the letter P.  Relies on the check above to ensure type_string is not empty (and buf + 1 is valid).
-	if (cp && !*omit_leading_whitespace(cp + 1)) // Additional validation: ensure nothing following the suffix.
-	{
-		aDynaParam.passed_by_address = true;
-		// Remove trailing options so that stricmp() can be used below.
-		// Allow optional space in front of asterisk (seems okay even for 'P').
-		if (IS_SPACE_OR_TAB(cp[-1]))
-		{
-			cp = omit_trailing_whitespace(buf, cp - 1);
-			cp[1] = '\0'; // Terminate at the leftmost whitespace to remove all whitespace and the suffix.
-		}
-		else
-			*cp = '\0'; // Terminate at the suffix to remove it.
-	}
-	else
-		aDynaParam.passed_by_address = false;
-	// Using a switch benchmarks better than the old approach, which was an if-else-if ladder
-	// of string comparisons.  The old approach appeared to penalize Int64 vs. Int, perhaps due
-	// to position in the ladder.
-	switch (ctolower(*buf))
-	{
-	case 'i':
-		// This method currently benchmarks better than _tcsnicmp, especially for Int64.
-		if (ctolower(buf[1]) == 'n' && ctolower(buf[2]) == 't')
-		{
-			if (!buf[3])
-				aDynaParam.type = DLL_ARG_INT;
-			else if (buf[3] == '6' && buf[4] == '4' && !buf[5])
-				aDynaParam.type = DLL_ARG_INT64;
-			else
-				break;
-			return;
-		}
-		break;
-	case 'p': if (!_tcsicmp(buf, _T("Ptr")))	{ aDynaParam.type = Exp32or64(DLL_ARG_INT, DLL_ARG_INT64); return; } break;
-	case 's': if (!_tcsicmp(buf, _T("Str")))	{ aDynaParam.type = DLL_ARG_STR; return; }
-			  if (!_tcsicmp(buf, _T("Short")))	{ aDynaParam.type = DLL_ARG_SHORT; return; } break;
-	case 'd': if (!_tcsicmp(buf, _T("Double")))	{ aDynaParam.type = DLL_ARG_DOUBLE; return; } break;
-	case 'f': if (!_tcsicmp(buf, _T("Float")))	{ aDynaParam.type = DLL_ARG_FLOAT; return; } break;
-	case 'a': if (!_tcsicmp(buf, _T("AStr")))	{ aDynaParam.type = DLL_ARG_ASTR; return; } break;
-	case 'w': if (!_tcsicmp(buf, _T("WStr")))	{ aDynaParam.type = DLL_ARG_WSTR; return; } break;
-	case 'c': if (!_tcsicmp(buf, _T("Char")))	{ aDynaParam.type = DLL_ARG_CHAR; return; } break;
-	}
-	aDynaParam.type = DLL_ARG_INVALID;
-}
-
-
 void *GetDllProcAddress(LPCTSTR aDllFileFunc, HMODULE *hmodule_to_free) // L31: Contains code extracted from BIF_DllCall for reuse in ExpressionToPostfix.
 {
 	int i;
@@ -473,75 +348,129 @@ void GetDllArgObjectPtr(ResultToken &aResultToken, IObject *obj, size_t &aPtr)
 }
 
 
-BIF_DECL(BIF_DllCall)
-// Stores a number or a SYM_STRING result in aResultToken.
-// Caller has set up aParam to be viewable as a left-to-right array of params rather than a stack.
-// It has also ensured that the array has exactly aParamCount items in it.
-// Author: Marcus Sonntag (Ultra)
+// A parameter type of DllCall or DllProto, parsed once and then used to marshal each value.
+struct DllArgType
 {
-	LPTSTR function_name = NULL;
-	void *function = NULL; // Will hold the address of the function to be called.
-	int vf_index = -1; // Set default: not ComCall.
+	DYNAPARM attrib; // The type and its attributes.  The value itself is set separately for each call.
+	Object *struct_class, *struct_proto; // Only used when attrib.type == DLL_ARG_STRUCT.
+};
 
-	if (_f_callee_id == FID_ComCall)
+// The parsed form of DllCall's type parameters or DllProto's return and parameter types.
+struct DllSignature
+{
+	DYNAPARM return_attrib; // The type and other attributes of the function's return value.
+	Object *return_class, *return_proto; // Only used when return_struct_size != 0.
+	int return_struct_size;
+	int dll_call_mode; // Only used on 32-bit builds.  Can be DC_CALL_CDECL and flags can be OR'd into it.
+	int arg_count;
+	DllArgType *arg;
+};
+
+
+
+void ParseDllReturnType(ResultToken &aResultToken, ExprTokenType &aToken, DllSignature &aSig)
+// Helper function for DllCall() and DllProto.  Sets the return type attributes of aSig,
+// which the caller has initialized to zero.
+{
+	if (IObject *obj = TokenToObject(aToken))
 	{
-		function = NULL;
-		if (!ParamIndexIsNumeric(0))
-			_f_throw_param(0, _T("Integer"));
-		vf_index = (int)ParamIndexToInt64(0);
-		if (vf_index < 0) // But positive values aren't checked since there's no known upper bound.
-			_f_throw_param(0);
-		// Cheat a bit to make the second arg both the source of the virtual function
-		// and the first parameter value (always an interface pointer):
-		static ExprTokenType t_this_arg_type = _T("Ptr");
-		aParam[0] = &t_this_arg_type;
+		if (obj->IsOfType(Object::sPrototype))
+		{
+			aSig.return_class = (Object*)obj;
+			obj = aSig.return_class->GetOwnPropObj(_T("Prototype"));
+			if (obj && obj->IsOfType(Object::sPrototype))
+			{
+				aSig.return_proto = (Object*)obj;
+				if (aSig.return_struct_size = (int)aSig.return_proto->LockStructSize())
+					aSig.return_attrib.type = DLL_ARG_STRUCT;
+			}
+		}
 	}
-	else
+	else // If non-numeric TokenToString() returns "", which is detected as invalid below.
+		aSig.dll_call_mode = ConvertDllReturnType(TokenToString(aToken), aSig.return_attrib);
+	if (aSig.return_attrib.type == DLL_ARG_INVALID)
+		_f_throw_value(ERR_INVALID_RETURN_TYPE);
+}
+
+
+
+void ParseDllArgType(ResultToken &aResultToken, ExprTokenType &aToken, DllArgType &aArg)
+// Helper function for DllCall() and DllProto.  aToken is a type name or struct class.
+{
+	aArg.struct_class = aArg.struct_proto = nullptr;
+	if (IObject *obj = TokenToObject(aToken))
 	{
-		// Check that the mandatory first parameter (DLL+Function) is valid.
-		// (load-time validation has ensured at least one parameter is present).
-		switch (TypeOfToken(*aParam[0]))
+		aArg.attrib.type = DLL_ARG_INVALID;
+		if (obj->IsOfType(Object::sPrototype))
 		{
-		case SYM_INTEGER: // Might be the most common case, due to FinalizeExpression resolving function names at load time.
-			// v1.0.46.08: Allow script to specify the address of a function, which might be useful for
-			// calling functions that the script discovers through unusual means such as C++ member functions.
-			function = (void *)ParamIndexToInt64(0);
-			// A check like the following is not present due to rarity of need and because if the address
-			// is zero or negative, the same result will occur as for any other invalid address:
-			// an exception code of 0xc0000005.
-			//if ((UINT64)temp64 < 0x10000 || (UINT64)temp64 > UINTPTR_MAX)
-			//	_f_throw_param(0); // Stage 1 error: Invalid first param.
-			//// Otherwise, assume it's a valid address:
-			//	function = (void *)temp64;
-			break;
-		case SYM_STRING: // For performance, don't even consider the possibility that a string like "33" is a function-address.
-			//function = NULL; // Already set: indicates that no function has been specified yet.
-			break;
-		case SYM_OBJECT:
-			// Permit an object with Ptr property.  This enables DllCall or DllCall.Bind() to be used directly
-			// as a method of an object, such as one used for wrapping a dll function.  It could also have other
-			// uses, such as resolving and memoizing function addresses on first use.
-			__int64 n;
-			if (!GetObjectIntProperty(ParamIndexToObject(0), _T("Ptr"), n, aResultToken))
-				return;
-			function = (void *)n;
-			break;
-		default: // SYM_FLOAT, SYM_MISSING or (should be impossible) something else.
-			_f_throw(ERR_PARAM1_INVALID, ErrorPrototype::Type);
+			aArg.struct_class = (Object*)obj;
+			obj = aArg.struct_class->GetOwnPropObj(_T("Prototype"));
+			if (obj && obj->IsOfType(Object::sPrototype))
+			{
+				aArg.struct_proto = (Object*)obj;
+				if (aArg.attrib.struct_size = (int)aArg.struct_proto->LockStructSize())
+					aArg.attrib.type = DLL_ARG_STRUCT;
+			}
 		}
-		if (!function)
-			function_name = TokenToString(*aParam[0]);
-		++aParam; // Normalize aParam to simplify ComCall vs. DllCall.
-		--aParamCount;
 	}
+	else
+		ConvertDllArgType(TokenToString(aToken), aArg.attrib); // aBuf not needed since floating-point and "" are equally invalid.
+	if (aArg.attrib.type == DLL_ARG_INVALID)
+		_f_throw_value(ERR_INVALID_ARG_TYPE);
+}
 
-	// Determine the type of return value.
-	DYNAPARM return_attrib = {0}; // Init all to default in case ConvertDllArgType() isn't called below. This struct holds the type and other attributes of the function's return value.
+
+
+ResultType GetDllFunction(ResultToken &aResultToken, ExprTokenType &aToken, void *&aFunction)
+// Helper function for DllCall() and DllProto.  Sets aFunction to the address specified by aToken,
+// or NULL if aToken is a function name, which the caller must resolve.
+{
+	aFunction = NULL;
+	switch (TypeOfToken(aToken))
+	{
+	case SYM_INTEGER: // Might be the most common case, due to FinalizeExpression resolving function names at load time.
+		// v1.0.46.08: Allow script to specify the address of a function, which might be useful for
+		// calling functions that the script discovers through unusual means such as C++ member functions.
+		aFunction = (void *)TokenToInt64(aToken);
+		// A check like the following is not present due to rarity of need and because if the address
+		// is zero or negative, the same result will occur as for any other invalid address:
+		// an exception code of 0xc0000005.
+		//if ((UINT64)temp64 < 0x10000 || (UINT64)temp64 > UINTPTR_MAX)
+		//	_f_throw_param(0); // Stage 1 error: Invalid first param.
+		//// Otherwise, assume it's a valid address:
+		//	function = (void *)temp64;
+		return OK;
+	case SYM_STRING: // For performance, don't even consider the possibility that a string like "33" is a function-address.
+		return OK;
+	case SYM_OBJECT:
+		// Permit an object with Ptr property.  This enables DllCall or DllCall.Bind() to be used directly
+		// as a method of an object, such as one used for wrapping a dll function.  It could also have other
+		// uses, such as resolving and memoizing function addresses on first use.
+		__int64 n;
+		if (!GetObjectIntProperty(TokenToObject(aToken), _T("Ptr"), n, aResultToken))
+			return FAIL;
+		aFunction = (void *)n;
+		return OK;
+	default: // SYM_FLOAT, SYM_MISSING or (should be impossible) something else.
+		return aResultToken.Error(ERR_PARAM1_INVALID, ErrorPrototype::Type);
+	}
+}
+
+
+
+void DllCallWithSignature(ResultToken &aResultToken, void *aFunction, LPTSTR aFunctionName, int aVfIndex
+	, DllSignature &aSig, ExprTokenType *aValue[])
+// Converts the values in aValue according to aSig, calls the function and then stores the return value
+// and any output parameters.  aValue must be modifiable and contain exactly aSig.arg_count items.
+// If aFunction is NULL, it is resolved from aFunctionName, or from aVfIndex for ComCall.
+// Author: Marcus Sonntag (Ultra)
+{
+	void *function = aFunction;
+	DYNAPARM return_attrib = aSig.return_attrib; // Copied since it is modified below.
 	void* return_struct_ptr = nullptr;
-	Object *return_class = nullptr, *return_proto = nullptr;
-	int return_struct_size = 0;
+	int return_struct_size = aSig.return_struct_size;
 #ifdef WIN32_PLATFORM
-	int dll_call_mode = 0; // Set default.  Can be overridden to DC_CALL_CDECL and flags can be OR'd into it.
+	int dll_call_mode = aSig.dll_call_mode;
 	int struct_extra_size = 0;
 #endif
 	
@@ -567,7 +496,7 @@ BIF_DECL(BIF_DllCall)
 		}
 	} free_after_exit{0};	// Avoid memory leaks when _f_throw_xxx
 #undef UorA_
-	int arg_count = aParamCount/2;
+	int arg_count = aSig.arg_count;
 	auto pStr = UorA(CStringA**, CStringW**)_alloca(arg_count * sizeof(void*)); // _alloca vs malloc can make a significant difference to performance in some cases.
 	auto pObj = (IObject**)_alloca((arg_count + 1) * sizeof(IObject*)); // The complexity of combining this with pStr to reduce stack usage doesn't seem worth it.
 	free_after_exit.pStr = pStr;
@@ -575,79 +504,13 @@ BIF_DECL(BIF_DllCall)
 	auto &nStr = free_after_exit.nStr;
 	auto &nObj = free_after_exit.nObj;
 
-	if ( !(aParamCount % 2) ) // An even number of parameters indicates the return type has been omitted. aParamCount excludes DllCall's first parameter at this point.
-	{
-		return_attrib.type = DLL_ARG_INT;
-		if (vf_index >= 0) // Default to HRESULT for ComCall.
-			return_attrib.is_hresult = true;
-		// Otherwise, assume normal INT (also covers BOOL).
-	}
-	else
-	{
-		// Check validity of this arg's return type:
-		ExprTokenType &token = *aParam[aParamCount - 1];
-		LPTSTR return_type_string = TokenToString(token); // If non-numeric it will return "", which is detected as invalid below.
-
-		// 64-bit note: The calling convention detection code is preserved here for script compatibility.
-
-		if (!_tcsnicmp(return_type_string, _T("CDecl"), 5)) // Alternate calling convention.
-		{
-#ifdef WIN32_PLATFORM
-			dll_call_mode = DC_CALL_CDECL;
-#endif
-			return_type_string = omit_leading_whitespace(return_type_string + 5);
-			if (!*return_type_string)
-			{	// Take a shortcut since we know this empty string will be used as "Int":
-				return_attrib.type = DLL_ARG_INT;
-				goto has_valid_return_type;
-			}
-		}
-		if (!_tcsicmp(return_type_string, _T("HRESULT")))
-		{
-			return_attrib.type = DLL_ARG_INT;
-			return_attrib.is_hresult = true;
-			//return_attrib.is_unsigned = true; // Not relevant since an exception is thrown for any negative value.
-		}
-		else if (IObject *obj = TokenToObject(token))
-		{
-			if (obj->IsOfType(Object::sPrototype))
-			{
-				return_class = (Object*)obj;
-				obj = return_class->GetOwnPropObj(_T("Prototype"));
-				if (obj && obj->IsOfType(Object::sPrototype))
-				{
-					return_proto = (Object*)obj;
-					if (return_struct_size = (int)return_proto->LockStructSize())
-						return_attrib.type = DLL_ARG_STRUCT;
-				}
-			}
-		}
-		else
-		{
-			ConvertDllArgType(return_type_string, return_attrib);
-		}
-		if (return_attrib.type == DLL_ARG_INVALID)
-			_f_throw_value(ERR_INVALID_RETURN_TYPE);
-
-has_valid_return_type:
-		--aParamCount;  // Remove the last parameter from further consideration.
-#ifdef WIN32_PLATFORM
-		if (!return_attrib.passed_by_address) // i.e. the special return flags below are not needed when an address is being returned.
-		{
-			if (return_attrib.type == DLL_ARG_DOUBLE)
-				dll_call_mode |= DC_RETVAL_MATH8;
-			else if (return_attrib.type == DLL_ARG_FLOAT)
-				dll_call_mode |= DC_RETVAL_MATH4;
-		}
-#endif
-	}
-
 	if (return_struct_size)
 	{
 		aResultToken.symbol = SYM_STRING; // Set default for Invoke.
 		aResultToken.marker = _T("");
 		auto obj = Object::Create();
-		if (obj->New(aResultToken, aParam + aParamCount, 1) != OK)
+		ExprTokenType class_token(aSig.return_class), *class_param = &class_token;
+		if (obj->New(aResultToken, &class_param, 1) != OK)
 			return; // New releases obj on failure.
 		return_struct_ptr = (void*)obj->DataPtr();
 		pObj[nObj++] = obj;
@@ -662,51 +525,25 @@ has_valid_return_type:
 	// nor is an exception block used since stack overflow in this case should be exceptionally rare (if it
 	// does happen, it would probably mean the script or the program has a design flaw somewhere, such as
 	// infinite recursion).
-	LPTSTR arg_type_string;
 	int i;
-	// Above has already ensured that after the first parameter, there are either zero additional parameters
-	// or an even number of them.  In other words, each arg type will have an arg value to go with it.
-	// It has also verified that the dyna_param array is large enough to hold all of the args.
-	for (arg_count = 0, i = 0; i < aParamCount; ++arg_count, i += 2)  // Same loop as used later below, so maintain them together.
+	for (i = 0; i < arg_count; ++i)  // Same loop as used later below, so maintain them together.
 	{
 		// Store each arg into a dyna_param struct, using its arg type to determine how.
-		DYNAPARM &this_dyna_param = dyna_param[arg_count];
-		Object *param_class = nullptr, *param_proto = nullptr;
+		DllArgType &this_arg_type = aSig.arg[i];
+		DYNAPARM &this_dyna_param = dyna_param[i];
+		this_dyna_param = this_arg_type.attrib; // The type and attributes; the value is set below.
 
-		if (IObject *obj = TokenToObject(*aParam[i]))
-		{
-			this_dyna_param.type = DLL_ARG_INVALID;
-			if (obj->IsOfType(Object::sPrototype))
-			{
-				param_class = (Object*)obj;
-				obj = param_class->GetOwnPropObj(_T("Prototype"));
-				if (obj && obj->IsOfType(Object::sPrototype))
-				{
-					param_proto = (Object*)obj;
-					if (this_dyna_param.struct_size = (int)param_proto->LockStructSize())
-						this_dyna_param.type = DLL_ARG_STRUCT;
-				}
-			}
-		}
-		else
-		{
-			arg_type_string = TokenToString(*aParam[i]); // aBuf not needed since floating-point and "" are equally invalid.
-			ConvertDllArgType(arg_type_string, this_dyna_param);
-		}
-		if (this_dyna_param.type == DLL_ARG_INVALID)
-			_f_throw_value(ERR_INVALID_ARG_TYPE);
-
-		IObject *this_param_obj = TokenToObject(*aParam[i + 1]);
+		IObject *this_param_obj = TokenToObject(*aValue[i]);
 		if (this_param_obj && this_dyna_param.type != DLL_ARG_STRUCT)
 		{
 			if ((this_dyna_param.passed_by_address || this_dyna_param.type == DLL_ARG_STR)
 				&& dynamic_cast<VarRef*>(this_param_obj))
 			{
-				aParam[i + 1] = (ExprTokenType *)_alloca(sizeof(ExprTokenType));
-				aParam[i + 1]->SetVarRef(static_cast<VarRef*>(this_param_obj));
+				aValue[i] = (ExprTokenType *)_alloca(sizeof(ExprTokenType));
+				aValue[i]->SetVarRef(static_cast<VarRef*>(this_param_obj));
 				this_param_obj = nullptr;
 			}
-			else if (ctoupper(*arg_type_string) == 'P')
+			else if (this_dyna_param.is_ptr)
 			{
 				// Support Buffer.Ptr, but only for "Ptr" type.  All other types are reserved for possible
 				// future use, which might be general like obj.ToValue(), or might be specific to DllCall
@@ -717,7 +554,7 @@ has_valid_return_type:
 				continue;
 			}
 		}
-		ExprTokenType &this_param = *aParam[i + 1];
+		ExprTokenType &this_param = *aValue[i];
 		if (this_param.symbol == SYM_MISSING && this_dyna_param.type != DLL_ARG_STRUCT) // Permit struct classes with __value to handle unset.
 			_f_throw(ERR_PARAM_REQUIRED);
 
@@ -784,25 +621,26 @@ has_valid_return_type:
 			break;
 			
 		case DLL_ARG_STRUCT: {
-			if (!this_param_obj || !this_param_obj->IsOfType(param_proto))
+			if (!this_param_obj || !this_param_obj->IsOfType(this_arg_type.struct_proto))
 			{
 				aResultToken.symbol = SYM_STRING; // Set default for Invoke.
 				aResultToken.marker = _T("");
 				auto obj = Object::Create();
-				if (!obj->New(aResultToken, aParam + i, 1))
+				ExprTokenType class_token(this_arg_type.struct_class), *class_param = &class_token;
+				if (!obj->New(aResultToken, &class_param, 1))
 					return; // New releases obj on failure.
 				pObj[nObj++] = this_param_obj = obj;
 				aResultToken.symbol = SYM_STRING; // Set default for Invoke (New set aResultToken to obj without calling AddRef).
 				aResultToken.marker = _T("");
 				auto result = obj->Invoke(aResultToken, IT_SET | IF_BYPASS_METAFUNC | IF_NO_NEW_PROPS
-					, _T("__value"), ExprTokenType(obj), aParam + i + 1, 1);
+					, _T("__value"), ExprTokenType(obj), aValue + i, 1);
 				if (result == INVOKE_NOT_HANDLED)
 				{
 					if (this_param.symbol == SYM_MISSING)
 						_f_throw(ERR_PARAM_REQUIRED);
 					ExprTokenType tn;
-					_f_throw_type(param_proto->GetOwnProp(tn, _T("__Class")) && tn.symbol == SYM_STRING
-						? tn.marker : _T("Object"), *aParam[i + 1]);
+					_f_throw_type(this_arg_type.struct_proto->GetOwnProp(tn, _T("__Class")) && tn.symbol == SYM_STRING
+						? tn.marker : _T("Object"), *aValue[i]);
 				}
 				if (aResultToken.Exited())
 					return;
@@ -855,16 +693,16 @@ has_valid_return_type:
 		} // switch (this_dyna_param.type)
 	} // for() each arg.
     
-	if (vf_index >= 0) // ComCall
+	if (aVfIndex >= 0) // ComCall
 	{
 		if ((UINT_PTR)dyna_param[0].ptr < 65536) // Basic sanity check to catch null pointers and small numbers.  On Win32, the first 64KB of address space is always invalid.
-			_f_throw_param(1);
+			return (void)aResultToken.ParamError(1, aValue[0]);
 		LPVOID *vftbl = *(LPVOID **)dyna_param[0].ptr;
-		function = vftbl[vf_index];
+		function = vftbl[aVfIndex];
 	}
 	else if (!function) // The function's address hasn't yet been determined.
 	{
-		function = GetDllProcAddress(function_name, &free_after_exit.hmodule_to_free);
+		function = GetDllProcAddress(aFunctionName, &free_after_exit.hmodule_to_free);
 		if (!function)
 		{
 			// GetDllProcAddress has thrown the appropriate exception.
@@ -962,11 +800,10 @@ has_valid_return_type:
 		switch(return_attrib.type)
 		{
 		case DLL_ARG_INT: // Listed first for performance. If the function has a void return value (formerly DLL_ARG_NONE), the value assigned here is undefined and inconsequential since the script should be designed to ignore it.
+		case DLL_ARG_SHORT:
+		case DLL_ARG_CHAR:
 			ASSERT(aResultToken.symbol == SYM_INTEGER);
-			if (return_attrib.is_unsigned)
-				aResultToken.value_int64 = (UINT)return_value.Int; // Preserve unsigned nature upon promotion to signed 64-bit.
-			else // Signed.
-				aResultToken.value_int64 = return_value.Int;
+			aResultToken.value_int64 = DllIntValue(return_attrib, return_value.Int);
 			break;
 		case DLL_ARG_STR:
 			// The contents of the string returned from the function must not reside in our stack memory since
@@ -1008,20 +845,6 @@ has_valid_return_type:
 				aResultToken.symbol = SYM_STRING;
 			}
 			break;
-		case DLL_ARG_SHORT:
-			ASSERT(aResultToken.symbol == SYM_INTEGER);
-			if (return_attrib.is_unsigned)
-				aResultToken.value_int64 = return_value.Int & 0x0000FFFF; // This also forces the value into the unsigned domain of a signed int.
-			else // Signed.
-				aResultToken.value_int64 = (SHORT)(WORD)return_value.Int; // These casts properly preserve negatives.
-			break;
-		case DLL_ARG_CHAR:
-			ASSERT(aResultToken.symbol == SYM_INTEGER);
-			if (return_attrib.is_unsigned)
-				aResultToken.value_int64 = return_value.Int & 0x000000FF; // This also forces the value into the unsigned domain of a signed int.
-			else // Signed.
-				aResultToken.value_int64 = (char)(BYTE)return_value.Int; // These casts properly preserve negatives.
-			break;
 		case DLL_ARG_INT64:
 			// Even for unsigned 64-bit values, it seems best both for simplicity and consistency to write
 			// them back out to the script as signed values because script internals are not currently
@@ -1048,10 +871,10 @@ has_valid_return_type:
 
 	// Store any output parameters back into the input variables.  This allows a function to change the
 	// contents of a variable for the following arg types: String and Pointer to <various number types>.
-	for (arg_count = 0, i = 0; i < aParamCount; ++arg_count, i += 2) // Same loop as used above, so maintain them together.
+	for (i = 0; i < arg_count; ++i) // Same loop as used above, so maintain them together.
 	{
-		ExprTokenType &this_param = *aParam[i + 1];  // Resolved for performance and convenience.
-		DYNAPARM &this_dyna_param = dyna_param[arg_count];
+		ExprTokenType &this_param = *aValue[i];  // Resolved for performance and convenience.
+		DYNAPARM &this_dyna_param = dyna_param[i];
 
 		if (IObject * obj = TokenToObject(this_param)) // Implies the type is "Ptr" or "Ptr*".
 		{
@@ -1088,22 +911,9 @@ has_valid_return_type:
 		switch (this_dyna_param.type)
 		{
 		case DLL_ARG_INT:
-			if (this_dyna_param.is_unsigned)
-				output_var.Assign((DWORD)this_dyna_param.value_int);
-			else // Signed.
-				output_var.Assign(this_dyna_param.value_int);
-			break;
-		case DLL_ARG_SHORT:
-			if (this_dyna_param.is_unsigned) // Force omission of the high-order word in case it is non-zero from a parameter that was originally and erroneously larger than a short.
-				output_var.Assign(this_dyna_param.value_int & 0x0000FFFF); // This also forces the value into the unsigned domain of a signed int.
-			else // Signed.
-				output_var.Assign((int)(SHORT)(WORD)this_dyna_param.value_int); // These casts properly preserve negatives.
-			break;
+		case DLL_ARG_SHORT: // High-order bits are omitted in case they are non-zero from a parameter that was originally and erroneously larger than a short or char.
 		case DLL_ARG_CHAR:
-			if (this_dyna_param.is_unsigned) // Force omission of the high-order bits in case it is non-zero from a parameter that was originally and erroneously larger than a char.
-				output_var.Assign(this_dyna_param.value_int & 0x000000FF); // This also forces the value into the unsigned domain of a signed int.
-			else // Signed.
-				output_var.Assign((int)(char)(BYTE)this_dyna_param.value_int); // These casts properly preserve negatives.
+			output_var.Assign(DllIntValue(this_dyna_param, this_dyna_param.value_int));
 			break;
 		case DLL_ARG_INT64: // Unsigned and signed are both written as signed for the reasons described elsewhere above.
 			output_var.Assign(this_dyna_param.value_int64);
@@ -1144,4 +954,173 @@ has_valid_return_type:
 	}
 }
 
+
+
+BIF_DECL(BIF_DllCall)
+// Stores a number or a SYM_STRING result in aResultToken.
+// Caller has set up aParam to be viewable as a left-to-right array of params rather than a stack.
+// It has also ensured that the array has exactly aParamCount items in it.
+{
+	LPTSTR function_name = NULL;
+	void *function = NULL; // Will hold the address of the function to be called.
+	int vf_index = -1; // Set default: not ComCall.
+
+	if (_f_callee_id == FID_ComCall)
+	{
+		function = NULL;
+		if (!ParamIndexIsNumeric(0))
+			_f_throw_param(0, _T("Integer"));
+		vf_index = (int)ParamIndexToInt64(0);
+		if (vf_index < 0) // But positive values aren't checked since there's no known upper bound.
+			_f_throw_param(0);
+		// Cheat a bit to make the second arg both the source of the virtual function
+		// and the first parameter value (always an interface pointer):
+		static ExprTokenType t_this_arg_type = _T("Ptr");
+		aParam[0] = &t_this_arg_type;
+	}
+	else
+	{
+		// Check that the mandatory first parameter (DLL+Function) is valid.
+		// (load-time validation has ensured at least one parameter is present).
+		if (!GetDllFunction(aResultToken, *aParam[0], function))
+			return;
+		if (!function)
+			function_name = TokenToString(*aParam[0]);
+		++aParam; // Normalize aParam to simplify ComCall vs. DllCall.
+		--aParamCount;
+	}
+
+	// Determine the type of return value.
+	DllSignature sig = {0}; // Init all to default in case ParseDllReturnType() isn't called below.
+	if ( !(aParamCount % 2) ) // An even number of parameters indicates the return type has been omitted. aParamCount excludes DllCall's first parameter at this point.
+	{
+		sig.return_attrib.type = DLL_ARG_INT;
+		if (vf_index >= 0) // Default to HRESULT for ComCall.
+			sig.return_attrib.is_hresult = true;
+		// Otherwise, assume normal INT (also covers BOOL).
+	}
+	else
+	{
+		// Check validity of this arg's return type:
+		ParseDllReturnType(aResultToken, *aParam[aParamCount - 1], sig);
+		if (aResultToken.Exited())
+			return;
+		--aParamCount;  // Remove the last parameter from further consideration.
+	}
+
+	// Above has already ensured that after the first parameter, there are either zero additional parameters
+	// or an even number of them.  In other words, each arg type will have an arg value to go with it.
+	sig.arg_count = aParamCount / 2;
+	ExprTokenType **value = NULL;
+	if (sig.arg_count)
+	{
+		sig.arg = (DllArgType *)_alloca(sig.arg_count * sizeof(DllArgType));
+		value = (ExprTokenType **)_alloca(sig.arg_count * sizeof(ExprTokenType *));
+	}
+	for (int i = 0; i < sig.arg_count; ++i)
+	{
+		ParseDllArgType(aResultToken, *aParam[i * 2], sig.arg[i]);
+		if (aResultToken.Exited())
+			return;
+		value[i] = aParam[i * 2 + 1];
+	}
+
+	DllCallWithSignature(aResultToken, function, function_name, vf_index, sig, value);
+}
+
+
+
+//
+// DllProto: A function whose address and parameter types are resolved once, for repeated calls.
+//
+
+Object *DllProto::sPrototype;
+
+BIF_DECL(DllProto_Call)
+// DllProto(Function, ReturnType, ParamTypes*): aParam[0] is the class itself.
+{
+	++aParam; // Exclude `this`
+	--aParamCount;
+
+	void *function;
+	HMODULE hmodule = NULL;
+	LPCTSTR function_name = _T("DllProto"); // Used for the call stack and error messages.
+	if (!GetDllFunction(aResultToken, *aParam[0], function))
+		return;
+	if (!function)
+	{
+		function_name = TokenToString(*aParam[0]);
+		function = GetDllProcAddress(function_name, &hmodule);
+		if (!function)
+			_f_return_FAIL; // GetDllProcAddress has thrown the appropriate exception.
+	}
+
+	int arg_count = aParamCount > 2 ? aParamCount - 2 : 0;
+	auto sig = (DllSignature *)calloc(1, sizeof(DllSignature) + arg_count * sizeof(DllArgType));
+	if (!sig)
+	{
+		if (hmodule)
+			FreeLibrary(hmodule);
+		_f_throw_oom;
+	}
+	sig->arg_count = arg_count;
+	sig->arg = (DllArgType *)(sig + 1);
+
+	if (aParamCount > 1 && aParam[1]->symbol != SYM_MISSING)
+		ParseDllReturnType(aResultToken, *aParam[1], *sig);
+	else
+		sig->return_attrib.type = DLL_ARG_INT;
+	for (int i = 0; i < arg_count && !aResultToken.Exited(); ++i)
+		ParseDllArgType(aResultToken, *aParam[i + 2], sig->arg[i]);
+	if (aResultToken.Exited())
+	{
+		free(sig);
+		if (hmodule)
+			FreeLibrary(hmodule);
+		return;
+	}
+	LPTSTR name = _tcsdup(function_name);
+	auto proto = name ? new DllProto(name, function, hmodule, sig, arg_count) : nullptr;
+	if (!proto)
+	{
+		free(name);
+		free(sig);
+		if (hmodule)
+			FreeLibrary(hmodule);
+		_f_throw_oom;
+	}
+	// Keep the struct classes alive for as long as they might be needed.  ~DllProto() releases them.
+	if (sig->return_class)
+		sig->return_class->AddRef();
+	for (int i = 0; i < arg_count; ++i)
+		if (sig->arg[i].struct_class)
+			sig->arg[i].struct_class->AddRef();
+	_f_return(proto);
+}
+
+
+DllProto::~DllProto()
+{
+	if (mSig->return_class)
+		mSig->return_class->Release();
+	for (int i = 0; i < mSig->arg_count; ++i)
+		if (mSig->arg[i].struct_class)
+			mSig->arg[i].struct_class->Release();
+	free(mSig);
+	if (mModule)
+		FreeLibrary(mModule);
+	free((LPTSTR)mName);
+}
+
+
+BIF_DECL(BIF_DllProto)
+// Called via BuiltInFunc::Call(), which has validated the parameter count and set aResultToken.func.
+{
+	auto &proto = *static_cast<DllProto *>(aResultToken.func);
+	// Copy the parameter list since DllCallWithSignature() may modify it.
+	ExprTokenType **value = proto.mSig->arg_count ? (ExprTokenType **)_alloca(proto.mSig->arg_count * sizeof(ExprTokenType *)) : NULL;
+	memcpy(value, aParam, proto.mSig->arg_count * sizeof(ExprTokenType *));
+	DllCallWithSignature(aResultToken, proto.mFunction, NULL, -1, *proto.mSig, value);
+}
+
 #endif
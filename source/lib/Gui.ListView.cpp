@@ -156,43 +156,15 @@ FResult GuiControlType::LV_GetText(int aRow, optl<int> aColumn, StrRet &aRetVal)
 
 
 
-FResult GuiControlType::LV_AddInsertModify(optl<int> aRow, optl<StrArg> aOptions, VariantParams &aCol
-	, int *aRetVal, bool aModify)
-// Returns: 1 on success and 0 on failure.
-// Parameters:
-// 1: For Add(), this is the options.  For Insert/Modify, it's the row index (one-based when it comes in).
-// 2: For Add(), this is the first field's text.  For Insert/Modify, it's the options.
-// 3 and beyond: Additional field text.
-// In Add/Insert mode, if there are no text fields present, a blank for is appended/inserted.
+static FResult LV_ParseRowOptions(LPCTSTR aOptions, bool aModify, LVITEM &lvi, bool &ensure_visible, bool &is_checked, int &col_start_index)
+// Applies the options of LV.Add/Insert/Modify/AddRows to lvi and the other output parameters,
+// which the caller has initialized.
 {
-	CTRL_THROW_IF_DESTROYED;
-	TCHAR buf[MAX_NUMBER_SIZE];
-	GuiControlType &control = *this;
-
-	int index;
-	if (!aRow.has_value()) // Add
-	{
-		index = INT_MAX; // Use INT_MAX as a signal to append the item rather than inserting it.
-	}
-	else // Insert or Modify
-	{
-		index = aRow.value() - 1; // -1 to convert to zero-based.
-		if (index < (aModify ? -1 : 0)) // Allow -1 to mean "all rows" when in modify mode.
-			return FR_E_ARG(0);
-	}
-
-	bool ensure_visible = false, is_checked = false;  // Checkmark.
-	int col_start_index = 0;
-	LVITEM lvi;
-	lvi.mask = LVIF_STATE; // LVIF_STATE: state member is valid, but only to the extent that corresponding bits are set in stateMask (the rest will be ignored).
-	lvi.stateMask = 0;
-	lvi.state = 0;
-
 	// Parse list of space-delimited options:
 	LPCTSTR next_option, option_end;
 	bool adding; // Whether this option is being added (+) or removed (-).
 
-	for (next_option = aOptions.value_or_empty(); *next_option; next_option = omit_leading_whitespace(option_end))
+	for (next_option = aOptions; *next_option; next_option = omit_leading_whitespace(option_end))
 	{
 		if (*next_option == '-')
 		{
@@ -302,6 +274,47 @@ FResult GuiControlType::LV_AddInsertModify(optl<int> aRow, optl<StrArg> aOptions
 		}
 	}
 
+	return OK;
+}
+
+
+
+FResult GuiControlType::LV_AddInsertModify(optl<int> aRow, optl<StrArg> aOptions, VariantParams &aCol
+	, int *aRetVal, bool aModify)
+// Returns: 1 on success and 0 on failure.
+// Parameters:
+// 1: For Add(), this is the options.  For Insert/Modify, it's the row index (one-based when it comes in).
+// 2: For Add(), this is the first field's text.  For Insert/Modify, it's the options.
+// 3 and beyond: Additional field text.
+// In Add/Insert mode, if there are no text fields present, a blank for is appended/inserted.
+{
+	CTRL_THROW_IF_DESTROYED;
+	TCHAR buf[MAX_NUMBER_SIZE];
+	GuiControlType &control = *this;
+
+	int index;
+	if (!aRow.has_value()) // Add
+	{
+		index = INT_MAX; // Use INT_MAX as a signal to append the item rather than inserting it.
+	}
+	else // Insert or Modify
+	{
+		index = aRow.value() - 1; // -1 to convert to zero-based.
+		if (index < (aModify ? -1 : 0)) // Allow -1 to mean "all rows" when in modify mode.
+			return FR_E_ARG(0);
+	}
+
+	bool ensure_visible = false, is_checked = false;  // Checkmark.
+	int col_start_index = 0;
+	LVITEM lvi;
+	lvi.mask = LVIF_STATE; // LVIF_STATE: state member is valid, but only to the extent that corresponding bits are set in stateMask (the rest will be ignored).
+	lvi.stateMask = 0;
+	lvi.state = 0;
+
+	auto fr = LV_ParseRowOptions(aOptions.value_or_empty(), aModify, lvi, ensure_visible, is_checked, col_start_index);
+	if (fr != OK)
+		return fr;
+
 	// Suppress any events raised by the changes made below:
 	control.attrib |= GUI_CONTROL_ATTRIB_SUPPRESS_EVENTS;
 
@@ -406,6 +419,178 @@ FResult GuiControlType::LV_AddInsertModify(optl<int> aRow, optl<StrArg> aOptions
 
 
 
+FResult GuiControlType::LV_AddRows(ExprTokenType &aRows, optl<StrArg> aOptions, int &aRetVal)
+// Returns: The number of rows added.
+// Parameters:
+// 1: An Array of rows, each of which is an Array of field values or a single value for the first field.
+// 2: Options to apply to every row, as for LV.Add().
+// This is equivalent to calling LV.Add() for each row, but parses the options once, preallocates
+// the control's rows and redraws only once at the end.
+{
+	CTRL_THROW_IF_DESTROYED;
+	if (GetWindowLong(hwnd, GWL_STYLE) & LVS_OWNERDATA) // Rows can't be inserted; see LV.SetData().
+		return FError(_T("Not supported by a virtual ListView."));
+	auto rows = dynamic_cast<Array *>(TokenToObject(aRows));
+	if (!rows)
+		return FTypeError(_T("Array"), aRows);
+
+	bool ensure_visible = false, is_checked = false;
+	int col_start_index = 0;
+	LVITEM lvi;
+	lvi.mask = LVIF_STATE;
+	lvi.stateMask = 0;
+	lvi.state = 0;
+	auto fr = LV_ParseRowOptions(aOptions.value_or_empty(), false, lvi, ensure_visible, is_checked, col_start_index);
+	if (fr != OK)
+		return fr;
+	UINT base_mask = lvi.mask;
+	lvi.iSubItem = 0;
+
+	attrib |= GUI_CONTROL_ATTRIB_SUPPRESS_EVENTS;
+	// WM_SETREDRAW works by clearing WS_VISIBLE, so this detects a prior "-Redraw" as well as a hidden
+	// control.  In either case redrawing is left off, since turning it on would also show the control.
+	bool redraw = GetWindowLong(hwnd, GWL_STYLE) & WS_VISIBLE;
+	if (redraw)
+		SendMessage(hwnd, WM_SETREDRAW, FALSE, 0);
+	// Reserve memory for all of the new rows at once, or for the number set by the Count option if
+	// that's larger.  As in LV_AddInsertModify(), this is deferred until after the first row is added
+	// if the control has no rows, since LVM_SETITEMCOUNT is much less effective otherwise.
+	int row_count = ListView_GetItemCount(hwnd);
+	int reserve_count = row_count + (int)rows->Length();
+	if (reserve_count < union_lv_attrib->row_count_hint)
+		reserve_count = union_lv_attrib->row_count_hint;
+	if (row_count && reserve_count > row_count)
+	{
+		SendMessage(hwnd, LVM_SETITEMCOUNT, reserve_count, 0);
+		union_lv_attrib->row_count_hint = 0;
+	}
+
+	TCHAR buf[MAX_NUMBER_SIZE];
+	LVITEM lvi_sub;
+	lvi_sub.mask = LVIF_TEXT;
+	int added = 0, last_row = -1;
+	for (UINT r = 0; r < rows->Length(); ++r)
+	{
+		ExprTokenType row_token, field;
+		rows->ItemToToken(r, row_token);
+		auto row = dynamic_cast<Array *>(TokenToObject(row_token));
+		UINT field_count = row ? row->Length() : 1;
+		#define LV_GET_FIELD(i) (row ? row->ItemToToken(i, field) : (field = row_token, true))
+
+		lvi.mask = base_mask;
+		lvi.iItem = INT_MAX; // Append.
+		if (col_start_index == 0 && field_count && LV_GET_FIELD(0) && field.symbol != SYM_MISSING)
+		{
+			lvi.pszText = TokenToString(field, buf);
+			lvi.mask |= LVIF_TEXT;
+		}
+		if (   -1 == (lvi_sub.iItem = ListView_InsertItem(hwnd, &lvi))   )
+			break;
+		last_row = lvi_sub.iItem;
+		if (!added++ && !row_count && reserve_count > 1) // See above.
+		{
+			SendMessage(hwnd, LVM_SETITEMCOUNT, reserve_count, 0);
+			union_lv_attrib->row_count_hint = 0;
+		}
+		if (is_checked)
+			ListView_SetCheckState(hwnd, lvi_sub.iItem, TRUE);
+		// See LV_AddInsertModify() for comments about how fields are mapped to columns.
+		UINT i;
+		for (lvi_sub.iSubItem = (col_start_index > 1) ? col_start_index : 1
+			, i = (col_start_index == 0)
+			; i < field_count
+			; ++i, ++lvi_sub.iSubItem)
+		{
+			if (!LV_GET_FIELD(i) || field.symbol == SYM_MISSING)
+				continue;
+			lvi_sub.pszText = TokenToString(field, buf);
+			ListView_SetItem(hwnd, &lvi_sub);
+		}
+		#undef LV_GET_FIELD
+	}
+	// "Vis" applies to every row, but only the last one scrolled into view would remain visible.
+	if (ensure_visible && last_row != -1)
+		SendMessage(hwnd, LVM_ENSUREVISIBLE, last_row, FALSE); // PartialOK==FALSE is somewhat arbitrary.
+
+	if (redraw)
+	{
+		SendMessage(hwnd, WM_SETREDRAW, TRUE, 0);
+		InvalidateRect(hwnd, NULL, TRUE);
+	}
+	attrib &= ~GUI_CONTROL_ATTRIB_SUPPRESS_EVENTS;
+	aRetVal = added;
+	return OK;
+}
+
+
+
+FResult GuiControlType::LV_SetData(ExprTokenType *aData)
+// Binds a virtual ListView to an Array of row Arrays, whose cells are then displayed on demand
+// rather than being copied into the control.  Calling it again after changing the Array updates
+// the row count and display.  If aData is omitted, the ListView is unbound and emptied.
+{
+	CTRL_THROW_IF_DESTROYED;
+	if (!(GetWindowLong(hwnd, GWL_STYLE) & LVS_OWNERDATA))
+		return FError(_T("The ListView must be created with the Virtual option."));
+	Array *data = nullptr;
+	if (aData)
+	{
+		if (   !(data = dynamic_cast<Array *>(TokenToObject(*aData)))   )
+			return FTypeError(_T("Array"), *aData);
+		data->AddRef();
+	}
+	LV_FreeData(); // Also resets the sort order, since the rows may have changed.
+	union_lv_attrib->data = data;
+	union_lv_attrib->sorted_by_col = -1;
+	SendMessage(hwnd, LVM_SETITEMCOUNT, data ? data->Length() : 0, LVSICF_NOSCROLL);
+	InvalidateRect(hwnd, NULL, FALSE); // In case the count didn't change.
+	return OK;
+}
+
+
+
+void GuiControlType::LV_FreeData()
+{
+	auto &lv_attrib = *union_lv_attrib;
+	if (lv_attrib.data)
+	{
+		lv_attrib.data->Release();
+		lv_attrib.data = nullptr;
+	}
+	free(lv_attrib.data_order);
+	lv_attrib.data_order = nullptr;
+	lv_attrib.data_order_count = 0;
+}
+
+
+
+void GuiControlType::LV_GetDispInfo(LVITEM &aItem)
+// Provides the text of a cell of a virtual ListView from its bound Array.
+{
+	if (!(aItem.mask & LVIF_TEXT) || !aItem.pszText || aItem.cchTextMax < 1)
+		return;
+	*aItem.pszText = '\0';
+	auto &lv_attrib = *union_lv_attrib;
+	UINT row_index = (UINT)aItem.iItem;
+	if (lv_attrib.data_order)
+	{
+		if (row_index >= lv_attrib.data_order_count)
+			return;
+		row_index = lv_attrib.data_order[row_index];
+	}
+	ExprTokenType row_token, cell;
+	Array *row;
+	if (   !lv_attrib.data->ItemToToken(row_index, row_token)
+		|| !(row = dynamic_cast<Array *>(TokenToObject(row_token)))
+		|| !row->ItemToToken(aItem.iSubItem, cell)
+		|| cell.symbol == SYM_MISSING || cell.symbol == SYM_OBJECT   )
+		return;
+	TCHAR buf[MAX_NUMBER_SIZE];
+	tcslcpy(aItem.pszText, TokenToString(cell, buf), aItem.cchTextMax);
+}
+
+
+
 FResult GuiControlType::LV_Delete(optl<int> aRow)
 // Returns: 1 on success and 0 on failure.
 // Parameters:
@@ -265,6 +265,90 @@ FResult GuiControlType::TV_AddModify(bool add_mode, UINT_PTR aItemID, UINT_PTR a
 
 
 
+static FResult TV_AddTreeItems(HWND aHwnd, HTREEITEM aParent, IObject *aNode, UINT &aCount, int aDepth)
+// Adds the items described by aNode under aParent.  A Map's keys become items whose children are
+// described by the corresponding values (if they are objects).  An Array's items are either names
+// of childless items, or objects describing further items under the same parent.
+{
+	if (aDepth > 1000) // Probably a circular reference.
+		return FValueError(ERR_JSON_TOO_DEEP);
+	TCHAR buf[MAX_NUMBER_SIZE];
+	TVINSERTSTRUCT tvi;
+	tvi.hParent = aParent;
+	tvi.hInsertAfter = TVI_LAST;
+	tvi.item.mask = TVIF_TEXT;
+	ExprTokenType key, value;
+	if (auto map = dynamic_cast<Map *>(aNode))
+	{
+		for (index_t i = 0; map->ItemAt(i, key, value); ++i)
+		{
+			tvi.item.pszText = TokenToString(key, buf);
+			HTREEITEM item = TreeView_InsertItem(aHwnd, &tvi);
+			if (!item)
+				return FR_E_FAILED;
+			++aCount;
+			if (auto children = TokenToObject(value))
+			{
+				auto fr = TV_AddTreeItems(aHwnd, item, children, aCount, aDepth + 1);
+				if (fr != OK)
+					return fr;
+			}
+		}
+	}
+	else if (auto arr = dynamic_cast<Array *>(aNode))
+	{
+		for (index_t i = 0; arr->ItemToToken(i, value); ++i)
+		{
+			if (auto obj = TokenToObject(value))
+			{
+				auto fr = TV_AddTreeItems(aHwnd, aParent, obj, aCount, aDepth + 1);
+				if (fr != OK)
+					return fr;
+				continue;
+			}
+			if (value.symbol == SYM_MISSING)
+				continue;
+			tvi.item.pszText = TokenToString(value, buf);
+			if (!TreeView_InsertItem(aHwnd, &tvi))
+				return FR_E_FAILED;
+			++aCount;
+		}
+	}
+	return OK;
+}
+
+
+
+FResult GuiControlType::TV_AddTree(ExprTokenType &aTree, optl<UINT_PTR> aParentItemID, UINT &aRetVal)
+// Returns: The number of items added.
+// Parameters:
+// 1: A Map or Array describing the items to add (see TV_AddTreeItems).
+// 2: Parent of the top-level items.
+// This is equivalent to calling TV.Add() for each item, but redraws only once at the end.
+{
+	CTRL_THROW_IF_DESTROYED;
+	auto tree = TokenToObject(aTree);
+	if (!dynamic_cast<Map *>(tree) && !dynamic_cast<Array *>(tree))
+		return FTypeError(_T("Map"), aTree);
+	attrib |= GUI_CONTROL_ATTRIB_SUPPRESS_EVENTS;
+	// WM_SETREDRAW works by clearing WS_VISIBLE, so this detects a prior "-Redraw" as well as a hidden
+	// control.  In either case redrawing is left off, since turning it on would also show the control.
+	bool redraw = GetWindowLong(hwnd, GWL_STYLE) & WS_VISIBLE;
+	if (redraw)
+		SendMessage(hwnd, WM_SETREDRAW, FALSE, 0);
+	aRetVal = 0;
+	auto fr = TV_AddTreeItems(hwnd, (HTREEITEM)aParentItemID.value_or(0), tree, aRetVal, 0);
+	if (redraw)
+	{
+		SendMessage(hwnd, WM_SETREDRAW, TRUE, 0);
+		InvalidateRect(hwnd, NULL, TRUE);
+	}
+	attrib &= ~GUI_CONTROL_ATTRIB_SUPPRESS_EVENTS;
+	return fr;
+}
+
+
+
 FResult GuiControlType::TV_Delete(optl<UINT_PTR> aItemID)
 {
 	CTRL_THROW_IF_DESTROYED;
@@ -35,10 +35,12 @@ struct FilePatternStruct
 	void *aCallbackData;
 	FileLoopModeType aOperateOnFolders;
 	bool aDoRecurse;
+	int depth, max_depth; // Current and maximum depth of recursion (0 for unlimited).
 	int failure_count;
 };
 
 static void FilePatternApply(FilePatternStruct &fps);
+static FResult FilePatternApplyParallel(FilePatternStruct &fps);
 
 static FResult FilePatternApply(LPCTSTR aFilePattern, FileLoopModeType aOperateOnFolders
 	, bool aDoRecurse, FilePatternCallback aCallback, void *aCallbackData);
@@ -47,6 +49,9 @@ static FResult FilePatternApply(LPCTSTR aFilePattern, FileLoopModeType aOperateO
 
 static bool FileCreateDirRecursive(LPTSTR aDirSpec);
 
+static FResult FileReadResult(LPBYTE output_buf, DWORD bytes_actually_read, UINT codepage, bool translate_crlf_to_lf
+	, ResultToken &aResultToken);
+
 // As of 2019-09-29, noinline reduces code size by over 20KB on VC++ 2019.
 // Prior to merging Util_CreateDir with this, it wasn't inlined.
 DECLSPEC_NOINLINE
@@ -107,6 +112,16 @@ static bool FileCreateDirRecursive(LPTSTR aDirSpec)
 
 
 
+#ifdef _WIN64
+#define FILE_READ_MAX_BYTES MAXDWORD
+#else
+// Reserve 2 bytes to avoid integer overflow when allocating.  Although any amount larger than 2GB is
+// almost guaranteed to fail at the malloc stage, that might change if we ever become large address aware.
+#define FILE_READ_MAX_BYTES (MAXDWORD - sizeof(wchar_t))
+#endif
+
+
+
 static FResult ConvertFileOptions(LPCTSTR aOptions, UINT &codepage, bool &translate_crlf_to_lf, unsigned __int64 *pmax_bytes_to_load)
 {
 	if (aOptions)
@@ -209,13 +224,7 @@ bif_impl FResult FileRead(StrArg aFilespec, optl<StrArg> aOptions, ResultToken &
 	// by calling ReadFile() in a loop, but it seems unlikely that a script will genuinely want to
 	// do this AND actually be able to allocate a 4GB+ memory block (having 4GB of total free memory
 	// is usually not sufficient, perhaps due to memory fragmentation).
-#ifdef _WIN64
-	if (bytes_to_read > MAXDWORD)
-#else
-	// Reserve 2 bytes to avoid integer overflow below.  Although any amount larger than 2GB is almost
-	// guaranteed to fail at the malloc stage, that might change if we ever become large address aware.
-	if (bytes_to_read > MAXDWORD - sizeof(wchar_t))
-#endif
+	if (bytes_to_read > FILE_READ_MAX_BYTES)
 	{
 		CloseHandle(hfile);
 		return FR_E_OUTOFMEM; // Using this instead of "File too large." to reduce code size, since this condition is very rare (and malloc succeeding would be even rarer).
@@ -245,92 +254,101 @@ bif_impl FResult FileRead(StrArg aFilespec, optl<StrArg> aOptions, ResultToken &
 	// that nothing bad happened.
 
 	if (result)
+		return FileReadResult(output_buf, bytes_actually_read, codepage, translate_crlf_to_lf, aResultToken);
+
+	// ReadFile() failed.  Since MSDN does not document what is in the buffer at this stage, or
+	// whether bytes_to_read contains a valid value, it seems best to abort the entire operation
+	// rather than try to return partial file contents.  An exception will indicate the failure.
+	g->LastError = GetLastError();
+	free(output_buf);
+	return FR_E_WIN32(g->LastError);
+}
+
+
+
+static FResult FileReadResult(LPBYTE output_buf, DWORD bytes_actually_read, UINT codepage, bool translate_crlf_to_lf
+	, ResultToken &aResultToken)
+// Sets the return value of FileRead or the result of FileReadAsync from the raw file contents.
+// Takes ownership of output_buf, which must have room for two bytes beyond bytes_actually_read.
+{
+	BOOL result = TRUE;
+	if (codepage != -1) // Text mode, not "RAW" mode.
 	{
-		if (codepage != -1) // Text mode, not "RAW" mode.
+		codepage &= CP_AHKCP; // Convert to plain Win32 codepage (remove CP_AHKNOBOM, which has no meaning here).
+		bool has_bom;
+		if ( (has_bom = (bytes_actually_read >= 2 && output_buf[0] == 0xFF && output_buf[1] == 0xFE)) // UTF-16LE BOM
+				|| codepage == CP_UTF16 ) // Covers FileEncoding UTF-16 and FileEncoding UTF-16-RAW.
 		{
-			codepage &= CP_AHKCP; // Convert to plain Win32 codepage (remove CP_AHKNOBOM, which has no meaning here).
-			bool has_bom;
-			if ( (has_bom = (bytes_actually_read >= 2 && output_buf[0] == 0xFF && output_buf[1] == 0xFE)) // UTF-16LE BOM
-					|| codepage == CP_UTF16 ) // Covers FileEncoding UTF-16 and FileEncoding UTF-16-RAW.
+			#ifndef UNICODE
+			#error FileRead UTF-16 to ANSI string not implemented.
+			#endif
+			LPWSTR text = (LPWSTR)output_buf;
+			DWORD length = bytes_actually_read / sizeof(WCHAR);
+			if (has_bom)
 			{
-				#ifndef UNICODE
-				#error FileRead UTF-16 to ANSI string not implemented.
-				#endif
-				LPWSTR text = (LPWSTR)output_buf;
-				DWORD length = bytes_actually_read / sizeof(WCHAR);
-				if (has_bom)
-				{
-					// Move the data to eliminate the byte order mark.
-					// Seems likely to perform better than allocating new memory and copying to it.
-					--length;
-					wmemmove(text, text + 1, length);
-				}
-				text[length] = '\0'; // Ensure text is terminated where indicated.  Two bytes were reserved for this purpose.
-				aResultToken.AcceptMem(text, length);
-				output_buf = NULL; // Don't free it; caller will take over.
+				// Move the data to eliminate the byte order mark.
+				// Seems likely to perform better than allocating new memory and copying to it.
+				--length;
+				wmemmove(text, text + 1, length);
 			}
-			else
+			text[length] = '\0'; // Ensure text is terminated where indicated.  Two bytes were reserved for this purpose.
+			aResultToken.AcceptMem(text, length);
+			output_buf = NULL; // Don't free it; caller will take over.
+		}
+		else
+		{
+			LPCSTR text = (LPCSTR)output_buf;
+			DWORD length = bytes_actually_read;
+			if (length >= 3 && output_buf[0] == 0xEF && output_buf[1] == 0xBB && output_buf[2] == 0xBF) // UTF-8 BOM
 			{
-				LPCSTR text = (LPCSTR)output_buf;
-				DWORD length = bytes_actually_read;
-				if (length >= 3 && output_buf[0] == 0xEF && output_buf[1] == 0xBB && output_buf[2] == 0xBF) // UTF-8 BOM
-				{
-					codepage = CP_UTF8;
-					length -= 3;
-					text += 3;
-				}
+				codepage = CP_UTF8;
+				length -= 3;
+				text += 3;
+			}
 #ifndef UNICODE
-				if (codepage == CP_ACP || codepage == GetACP())
-				{
-					// Avoid any unnecessary conversion or copying by using our malloc'd buffer directly.
-					// This should be worth doing since the string must otherwise be converted to UTF-16 and back.
-					output_buf[bytes_actually_read] = 0; // Ensure text is terminated where indicated.
-					aResultToken.AcceptMem((LPSTR)output_buf, bytes_actually_read);
-					output_buf = NULL; // Don't free it; caller will take over.
-				}
-				else
-				#error FileRead non-ACP-ANSI to ANSI string not fully implemented.
+			if (codepage == CP_ACP || codepage == GetACP())
+			{
+				// Avoid any unnecessary conversion or copying by using our malloc'd buffer directly.
+				// This should be worth doing since the string must otherwise be converted to UTF-16 and back.
+				output_buf[bytes_actually_read] = 0; // Ensure text is terminated where indicated.
+				aResultToken.AcceptMem((LPSTR)output_buf, bytes_actually_read);
+				output_buf = NULL; // Don't free it; caller will take over.
+			}
+			else
+			#error FileRead non-ACP-ANSI to ANSI string not fully implemented.
 #endif
+			{
+				int wlen = MultiByteToWideChar(codepage, 0, text, length, NULL, 0);
+				if (wlen > 0)
 				{
-					int wlen = MultiByteToWideChar(codepage, 0, text, length, NULL, 0);
-					if (wlen > 0)
+					if (!TokenSetResult(aResultToken, NULL, wlen))
 					{
-						if (!TokenSetResult(aResultToken, NULL, wlen))
-						{
-							free(output_buf);
-							return aResultToken.Exited() ? FR_FAIL : FR_ABORTED;
-						}
-						wlen = MultiByteToWideChar(codepage, 0, text, length, aResultToken.marker, wlen);
-						aResultToken.symbol = SYM_STRING;
-						aResultToken.marker[wlen] = 0;
-						aResultToken.marker_length = wlen;
-						if (!wlen)
-							result = FALSE;
+						free(output_buf);
+						return aResultToken.Exited() ? FR_FAIL : FR_ABORTED;
 					}
+					wlen = MultiByteToWideChar(codepage, 0, text, length, aResultToken.marker, wlen);
+					aResultToken.symbol = SYM_STRING;
+					aResultToken.marker[wlen] = 0;
+					aResultToken.marker_length = wlen;
+					if (!wlen)
+						result = FALSE;
 				}
 			}
-			if (output_buf) // i.e. it wasn't "claimed" above.
-				free(output_buf);
-			if (translate_crlf_to_lf && aResultToken.marker_length)
-			{
-				// Since a larger string is being replaced with a smaller, there's a good chance the 2 GB
-				// address limit will not be exceeded by StrReplace even if the file is close to the
-				// 1 GB limit as described above:
-				StrReplace(aResultToken.marker, _T("\r\n"), _T("\n"), SCS_SENSITIVE, UINT_MAX, -1, NULL, &aResultToken.marker_length);
-			}
 		}
-		else // codepage == -1 ("RAW" mode)
+		if (output_buf) // i.e. it wasn't "claimed" above.
+			free(output_buf);
+		if (translate_crlf_to_lf && aResultToken.marker_length)
 		{
-			// Return the buffer to our caller.
-			aResultToken.Return(BufferObject::Create(output_buf, bytes_actually_read));
+			// Since a larger string is being replaced with a smaller, there's a good chance the 2 GB
+			// address limit will not be exceeded by StrReplace even if the file is close to the
+			// 1 GB limit as described above:
+			StrReplace(aResultToken.marker, _T("\r\n"), _T("\n"), SCS_SENSITIVE, UINT_MAX, -1, NULL, &aResultToken.marker_length);
 		}
 	}
-	else
+	else // codepage == -1 ("RAW" mode)
 	{
-		// ReadFile() failed.  Since MSDN does not document what is in the buffer at this stage, or
-		// whether bytes_to_read contains a valid value, it seems best to abort the entire operation
-		// rather than try to return partial file contents.  An exception will indicate the failure.
-		free(output_buf);
+		// Return the buffer to our caller.
+		aResultToken.Return(BufferObject::Create(output_buf, bytes_actually_read));
 	}
 
 	if (!result)
@@ -696,6 +714,10 @@ static FResult FilePatternApply(LPCTSTR aFilePattern, FileLoopModeType aOperateO
 	g->LastError = 0; // Set default. Overridden only when a failure occurs.
 
 	FilePatternStruct fps;
+	fps.depth = 0;
+	fps.max_depth = FILE_LOOP_MAX_DEPTH(aOperateOnFolders);
+	bool parallel = aOperateOnFolders & FILE_LOOP_PARALLEL;
+	aOperateOnFolders &= FILE_LOOP_FILES_AND_FOLDERS;
 
 	auto last_backslash = _tcsrchr(aFilePattern, '\\');
 	if (last_backslash)
@@ -730,7 +752,14 @@ static FResult FilePatternApply(LPCTSTR aFilePattern, FileLoopModeType aOperateO
 
 	fps.failure_count = 0;
 
-	FilePatternApply(fps);
+	if (parallel && aDoRecurse)
+	{
+		auto fr = FilePatternApplyParallel(fps);
+		if (fr != OK)
+			return fr;
+	}
+	else
+		FilePatternApply(fps);
 
 	return fps.failure_count ? FR_THROW_INT(fps.failure_count) : OK;
 }
@@ -791,7 +820,8 @@ static void FilePatternApply(FilePatternStruct &fps)
 		FindClose(file_search);
 	} // if (file_search != INVALID_HANDLE_VALUE)
 
-	if (fps.aDoRecurse && space_remaining > 1) // The space_remaining check ensures there's enough room to append "*", though if false, that would imply lfs.pattern is empty.
+	if (fps.aDoRecurse && space_remaining > 1 // The space_remaining check ensures there's enough room to append "*", though if false, that would imply lfs.pattern is empty.
+		&& (!fps.max_depth || fps.depth < fps.max_depth))
 	{
 		_tcscpy(append_pos, _T("*")); // Above has ensured this won't overflow.
 		file_search = FindFirstFile(fps.path, &current_file);
@@ -820,7 +850,9 @@ static void FilePatternApply(FilePatternStruct &fps)
 				fps.dir_length = dir_length + filename_length + 1; // Include the slash.
 				//
 				// Apply the callback to files in this subdirectory:
+				++fps.depth;
 				FilePatternApply(fps);
+				--fps.depth;
 				//
 			} while (FindNextFile(file_search, &current_file));
 			FindClose(file_search);
@@ -832,6 +864,53 @@ static void FilePatternApply(FilePatternStruct &fps)
 
 
 
+static FResult FilePatternApplyParallel(FilePatternStruct &fps)
+// Parallel version of the recursive FilePatternApply(), for the "P" mode.  Other threads read
+// sub-directories ahead, while the callback is applied to each file on this thread.
+{
+	FileScanLister lister(fps.path, fps.dir_length, fps.pattern, fps.pattern_length, fps.aOperateOnFolders
+		, _countof(fps.path));
+	if (!lister.IsValid())
+		return FR_E_OUTOFMEM;
+	FileScan scan(lister, FileScanLister::ThreadCount(), FILE_SCAN_MAX_RECORDS, fps.max_depth);
+
+	size_t root_length = fps.dir_length, dir_length = root_length;
+	LONG_OPERATION_INIT
+	int failure_count = 0;
+	WIN32_FIND_DATA current_file;
+	for (DirScanEvent event; (event = scan.Next(current_file)) != DIRSCAN_END; )
+	{
+		LONG_OPERATION_UPDATE // See FilePatternApply() for comments.
+		if (event == DIRSCAN_ENTER)
+		{
+			// The lister has ensured that there's room for this and the pattern.
+			size_t name_length = _tcslen(current_file.cFileName);
+			tmemcpy(fps.path + dir_length, current_file.cFileName, name_length);
+			dir_length += name_length;
+			fps.path[dir_length++] = '\\';
+			continue;
+		}
+		if (event == DIRSCAN_LEAVE)
+		{
+			for (--dir_length; dir_length > root_length && fps.path[dir_length - 1] != '\\'; --dir_length);
+			continue;
+		}
+		if (_tcslen(current_file.cFileName) > _countof(fps.path) - dir_length - 1)
+		{
+			g->LastError = ERROR_BUFFER_OVERFLOW;
+			++failure_count;
+			continue;
+		}
+		_tcscpy(fps.path + dir_length, current_file.cFileName);
+		if (!fps.aCallback(fps.path, current_file, fps.aCallbackData))
+			++failure_count;
+	}
+	fps.failure_count += failure_count;
+	return OK;
+}
+
+
+
 bif_impl FResult FileGetTime(optl<StrArg> aPath, optl<StrArg> aWhichTime, StrRet &aRetVal)
 {
 	g->LastError = 0; // Set default for successful return or non-Win32 errors.
@@ -1094,3 +1173,537 @@ bif_impl FResult DirDelete(StrArg aPath, optl<BOOL> aRecurse)
 }
 
 
+
+
+
+//
+// Asynchronous file operations
+//
+
+// The amount FileReadAsync reads between checks for cancellation and progress reports.
+#define FILE_TASK_READ_CHUNK (1024 * 1024)
+
+static inline bool IsDotOrDotDot(LPCTSTR aFileName)
+{
+	return aFileName[0] == '.' && (!aFileName[1] || aFileName[1] == '.' && !aFileName[2]);
+}
+
+class FileTask : public Object, public WorkerJob
+{
+public:
+	enum TaskType { TASK_READ, TASK_COPY_FILES, TASK_COPY_DIR };
+
+	static ObjectMemberMd sMembers[];
+	static Object *sPrototype;
+
+	static FResult Start(TaskType aType, LPCTSTR aSource, LPCTSTR aDest, IObject *aCallback, IObject *aOnProgress
+		, IObject *&aRetVal, int aOverwrite = 0, UINT aCodepage = 0, bool aTranslateCRLF = false
+		, unsigned __int64 aMaxBytes = ULLONG_MAX);
+
+	FResult Cancel()
+	{
+		WorkerJob::Cancel();
+		return OK;
+	}
+
+	FResult get_Status(StrRet &aRetVal)
+	{
+		aRetVal.SetStatic(mStatus);
+		return OK;
+	}
+
+	void Run(WorkerPool &aPool) override;
+	void OnEvents(UINT aEvents) override;
+
+private:
+	TaskType mType;
+	TCHAR mSource[T_MAX_PATH], mDest[T_MAX_PATH];
+	bool mSourceHasWildcards = false;
+	int mOverwrite;
+	UINT mCodepage;
+	bool mTranslateCRLF;
+	unsigned __int64 mMaxBytes;
+	IObject *mCallback, *mOnProgress;
+	LPCTSTR mStatus = _T("Running"); // Used only by the main thread.
+
+	// Written by the worker thread.  The main thread reads the following only after the task has
+	// finished, except for the progress counters.
+	WorkerPool *mPool = nullptr;
+	std::atomic<unsigned __int64> mBytesDone {0}, mBytesTotal {0};
+	unsigned __int64 mItemBase = 0; // mBytesDone at the start of the current file.
+	LPBYTE mData = nullptr;
+	DWORD mDataLength = 0;
+	DWORD mError = 0; // The last error, or 0 if successful.
+	int mFailures = 0; // The number of files which couldn't be copied.
+
+	FileTask(TaskType aType, IObject *aCallback, IObject *aOnProgress)
+		: mType(aType), mCallback(aCallback), mOnProgress(aOnProgress)
+	{
+		mCallback->AddRef();
+		if (mOnProgress)
+			mOnProgress->AddRef();
+		SetBase(sPrototype);
+	}
+
+	~FileTask()
+	{
+		mCallback->Release();
+		if (mOnProgress)
+			mOnProgress->Release();
+		free(mData);
+	}
+
+	void ReportProgress(unsigned __int64 aBytesDone)
+	{
+		mBytesDone = aBytesDone;
+		if (mOnProgress)
+			mPool->PostProgress(this);
+	}
+
+	void Fail(DWORD aError)
+	{
+		mError = aError;
+		++mFailures;
+	}
+
+	void ReadFile();
+	void CopyFiles();
+	void CopyDir();
+	void CopyDirContents(LPTSTR aSource, size_t aSourceLength, LPTSTR aDest, size_t aDestLength);
+	unsigned __int64 GetDirSize(LPTSTR aDir, size_t aDirLength);
+	void CopyItem(LPCTSTR aSource, LPCTSTR aDest, unsigned __int64 aSize);
+	static DWORD CALLBACK CopyProgress(LARGE_INTEGER aTotalFileSize, LARGE_INTEGER aTotalBytesTransferred
+		, LARGE_INTEGER aStreamSize, LARGE_INTEGER aStreamBytesTransferred, DWORD aStreamNumber
+		, DWORD aCallbackReason, HANDLE aSourceFile, HANDLE aDestinationFile, LPVOID aData);
+
+	friend void ::DefineFileTaskClass();
+};
+
+
+ObjectMemberMd FileTask::sMembers[] =
+{
+	md_member		(FileTask, Cancel, CALL, md_arg_none),
+	md_property_get	(FileTask, Status, String),
+};
+
+Object *FileTask::sPrototype;
+
+
+void DefineFileTaskClass()
+{
+	FileTask::sPrototype = Object::CreatePrototype(_T("FileTask"), Object::sPrototype
+		, FileTask::sMembers, _countof(FileTask::sMembers));
+	Object::CreateClass(_T("FileTask"), Object::sClass, FileTask::sPrototype, nullptr);
+}
+
+
+FResult FileTask::Start(TaskType aType, LPCTSTR aSource, LPCTSTR aDest, IObject *aCallback, IObject *aOnProgress
+	, IObject *&aRetVal, int aOverwrite, UINT aCodepage, bool aTranslateCRLF, unsigned __int64 aMaxBytes)
+{
+	auto fr = ValidateFunctor(aCallback, 2);
+	if (fr != OK)
+		return fr;
+	if (aOnProgress && (fr = ValidateFunctor(aOnProgress, 2)) != OK)
+		return fr;
+	auto task = new FileTask(aType, aCallback, aOnProgress);
+	task->mOverwrite = aOverwrite;
+	task->mCodepage = aCodepage;
+	task->mTranslateCRLF = aTranslateCRLF;
+	task->mMaxBytes = aMaxBytes;
+	// Resolve relative paths now, since the working directory could change before the task runs.
+	// Directories are handled the same way as by Util_CopyFile().
+	Line::Util_GetFullPathName(aSource, task->mSource, _countof(task->mSource));
+	if (aDest)
+		Line::Util_GetFullPathName(aDest, task->mDest, _countof(task->mDest));
+	else
+		*task->mDest = '\0';
+	if (aType == TASK_COPY_FILES)
+	{
+		task->mSourceHasWildcards = StrChrAny(aSource, _T("?*")) != nullptr;
+		if (Line::Util_IsDir(task->mSource))
+			_tcscat(task->mSource, _T("\\*.*"));
+		if (Line::Util_IsDir(task->mDest))
+			_tcscat(task->mDest, _T("\\*.*"));
+	}
+	task->AddRef(); // Released by OnEvents() when the task is done.
+	GetWorkerPool().Submit(task);
+	aRetVal = task; // Return the reference we were given by the constructor.
+	return OK;
+}
+
+
+void FileTask::Run(WorkerPool &aPool)
+// Called on a worker thread.
+{
+	mPool = &aPool;
+	if (IsCanceled())
+	{
+		mError = ERROR_CANCELLED;
+		return;
+	}
+	switch (mType)
+	{
+	case TASK_READ: ReadFile(); break;
+	case TASK_COPY_FILES: CopyFiles(); break;
+	case TASK_COPY_DIR: CopyDir(); break;
+	}
+}
+
+
+void FileTask::ReadFile()
+// Reads the file in chunks so that the task can be canceled.  The data is converted to a string
+// by the main thread, since that may require allocating memory through the script's functions.
+{
+	// See FileRead() for comments.
+	HANDLE hfile = CreateFile(mSource, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING
+		, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hfile == INVALID_HANDLE_VALUE)
+	{
+		mError = GetLastError();
+		return;
+	}
+	unsigned __int64 bytes_to_read = GetFileSize64(hfile);
+	if (bytes_to_read == ULLONG_MAX)
+		mError = GetLastError();
+	else
+	{
+		if (bytes_to_read > mMaxBytes)
+			bytes_to_read = mMaxBytes;
+		if (bytes_to_read > FILE_READ_MAX_BYTES
+			|| !(mData = (LPBYTE)malloc(size_t(bytes_to_read + (bytes_to_read & 1) + sizeof(wchar_t)))))
+			mError = ERROR_NOT_ENOUGH_MEMORY;
+		else
+		{
+			mBytesTotal = bytes_to_read;
+			DWORD total_read = 0, bytes_read;
+			while (total_read < bytes_to_read)
+			{
+				if (IsCanceled())
+				{
+					mError = ERROR_CANCELLED;
+					break;
+				}
+				DWORD bytes_to_read_now = (DWORD)min(bytes_to_read - total_read, FILE_TASK_READ_CHUNK);
+				if (!::ReadFile(hfile, mData + total_read, bytes_to_read_now, &bytes_read, NULL))
+				{
+					mError = GetLastError();
+					break;
+				}
+				if (!bytes_read) // End of file, such as if it was truncated after its size was retrieved.
+					break;
+				total_read += bytes_read;
+				ReportProgress(total_read);
+			}
+			mDataLength = total_read;
+		}
+	}
+	CloseHandle(hfile);
+}
+
+
+void FileTask::CopyFiles()
+// Copies the files matching mSource, in the same manner as Util_CopyFile().
+{
+	WIN32_FIND_DATA find_data;
+	HANDLE hsearch = FindFirstFile(mSource, &find_data);
+	if (hsearch == INVALID_HANDLE_VALUE)
+	{
+		if (!mSourceHasWildcards) // Indicate failure only if there were no wildcards, like FileCopy.
+			Fail(GetLastError());
+		return;
+	}
+	// Total the sizes first so that progress can be reported as a fraction.
+	unsigned __int64 total = 0;
+	do
+	{
+		if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			total += ((unsigned __int64)find_data.nFileSizeHigh << 32) | find_data.nFileSizeLow;
+	} while (FindNextFile(hsearch, &find_data));
+	FindClose(hsearch);
+	mBytesTotal = total;
+
+	if (  (hsearch = FindFirstFile(mSource, &find_data)) == INVALID_HANDLE_VALUE  )
+	{
+		Fail(GetLastError());
+		return;
+	}
+	TCHAR source[T_MAX_PATH], dest[T_MAX_PATH], dest_pattern[MAX_PATH];
+	tcslcpy(source, mSource, _countof(source));
+	tcslcpy(dest, mDest, _countof(dest));
+	LPTSTR source_append_pos = _tcsrchr(source, '\\') + 1;
+	LPTSTR dest_append_pos = _tcsrchr(dest, '\\') + 1;
+	size_t space_remaining = _countof(source) - (source_append_pos - source) - 1;
+	tcslcpy(dest_pattern, dest_append_pos, _countof(dest_pattern));
+	do
+	{
+		if (IsCanceled())
+		{
+			mError = ERROR_CANCELLED;
+			break;
+		}
+		if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			continue;
+		if (_tcslen(find_data.cFileName) > space_remaining)
+		{
+			Fail(ERROR_BUFFER_OVERFLOW);
+			continue;
+		}
+		_tcscpy(source_append_pos, find_data.cFileName);
+		Line::Util_ExpandFilenameWildcard(find_data.cFileName, dest_pattern, dest_append_pos);
+		CopyItem(source, dest, ((unsigned __int64)find_data.nFileSizeHigh << 32) | find_data.nFileSizeLow);
+	} while (FindNextFile(hsearch, &find_data));
+	FindClose(hsearch);
+	if (IsCanceled())
+		mError = ERROR_CANCELLED;
+}
+
+
+void FileTask::CopyDir()
+// Copies the contents of mSource into mDest, creating it if needed.  Unlike Util_CopyDir(), this
+// copies each file individually so that the task can be canceled and report progress.
+{
+	DWORD attr = GetFileAttributes(mSource);
+	if (attr == INVALID_FILE_ATTRIBUTES || !(attr & FILE_ATTRIBUTE_DIRECTORY))
+	{
+		Fail(attr == INVALID_FILE_ATTRIBUTES ? GetLastError() : ERROR_DIRECTORY);
+		return;
+	}
+	// Apply the same rules as Util_CopyDir() for an existing destination.
+	attr = GetFileAttributes(mDest);
+	if (attr != INVALID_FILE_ATTRIBUTES && (!(attr & FILE_ATTRIBUTE_DIRECTORY) || !mOverwrite))
+	{
+		Fail(ERROR_ALREADY_EXISTS);
+		return;
+	}
+	if (!FileCreateDir(mDest))
+	{
+		Fail(GetLastError());
+		return;
+	}
+	TCHAR source[T_MAX_PATH], dest[T_MAX_PATH];
+	_tcscpy(source, mSource);
+	_tcscpy(dest, mDest);
+	mBytesTotal = GetDirSize(source, _tcslen(source));
+	CopyDirContents(source, _tcslen(source), dest, _tcslen(dest));
+	if (IsCanceled())
+		mError = ERROR_CANCELLED;
+}
+
+
+unsigned __int64 FileTask::GetDirSize(LPTSTR aDir, size_t aDirLength)
+// aDir is a buffer of T_MAX_PATH characters which is used to build the path of each subdirectory.
+{
+	if (aDirLength + 2 >= T_MAX_PATH)
+		return 0;
+	_tcscpy(aDir + aDirLength, _T("\\*"));
+	WIN32_FIND_DATA find_data;
+	HANDLE hsearch = FindFirstFile(aDir, &find_data);
+	aDir[aDirLength] = '\0';
+	if (hsearch == INVALID_HANDLE_VALUE)
+		return 0;
+	unsigned __int64 size = 0;
+	do
+	{
+		if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			// Reparse points such as junctions aren't followed, to avoid infinite recursion.
+			if (find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT || IsDotOrDotDot(find_data.cFileName))
+				continue;
+			size_t name_length = _tcslen(find_data.cFileName);
+			if (aDirLength + 1 + name_length >= T_MAX_PATH)
+				continue;
+			aDir[aDirLength] = '\\';
+			_tcscpy(aDir + aDirLength + 1, find_data.cFileName);
+			size += GetDirSize(aDir, aDirLength + 1 + name_length);
+			aDir[aDirLength] = '\0';
+		}
+		else
+			size += ((unsigned __int64)find_data.nFileSizeHigh << 32) | find_data.nFileSizeLow;
+	} while (!IsCanceled() && FindNextFile(hsearch, &find_data));
+	FindClose(hsearch);
+	return size;
+}
+
+
+void FileTask::CopyDirContents(LPTSTR aSource, size_t aSourceLength, LPTSTR aDest, size_t aDestLength)
+// aSource and aDest are buffers of T_MAX_PATH characters containing the paths of existing
+// directories.  They are extended in place for each item, and restored before returning.
+{
+	if (aSourceLength + 2 >= T_MAX_PATH)
+	{
+		Fail(ERROR_BUFFER_OVERFLOW);
+		return;
+	}
+	_tcscpy(aSource + aSourceLength, _T("\\*"));
+	WIN32_FIND_DATA find_data;
+	HANDLE hsearch = FindFirstFile(aSource, &find_data);
+	aSource[aSourceLength] = '\0';
+	if (hsearch == INVALID_HANDLE_VALUE)
+	{
+		if (GetLastError() != ERROR_FILE_NOT_FOUND) // i.e. not just an empty directory.
+			Fail(GetLastError());
+		return;
+	}
+	do
+	{
+		if (IsDotOrDotDot(find_data.cFileName))
+			continue;
+		size_t name_length = _tcslen(find_data.cFileName);
+		if (aSourceLength + 1 + name_length >= T_MAX_PATH || aDestLength + 1 + name_length >= T_MAX_PATH)
+		{
+			Fail(ERROR_BUFFER_OVERFLOW);
+			continue;
+		}
+		aSource[aSourceLength] = '\\';
+		_tcscpy(aSource + aSourceLength + 1, find_data.cFileName);
+		aDest[aDestLength] = '\\';
+		_tcscpy(aDest + aDestLength + 1, find_data.cFileName);
+		if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			if (!CreateDirectory(aDest, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+				Fail(GetLastError());
+			else if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) // See GetDirSize().
+				CopyDirContents(aSource, aSourceLength + 1 + name_length, aDest, aDestLength + 1 + name_length);
+		}
+		else
+			CopyItem(aSource, aDest, ((unsigned __int64)find_data.nFileSizeHigh << 32) | find_data.nFileSizeLow);
+		aSource[aSourceLength] = '\0';
+		aDest[aDestLength] = '\0';
+	} while (!IsCanceled() && FindNextFile(hsearch, &find_data));
+	FindClose(hsearch);
+}
+
+
+void FileTask::CopyItem(LPCTSTR aSource, LPCTSTR aDest, unsigned __int64 aSize)
+{
+	mItemBase = mBytesDone;
+	if (!CopyFileEx(aSource, aDest, CopyProgress, this, NULL, mOverwrite ? 0 : COPY_FILE_FAIL_IF_EXISTS))
+	{
+		if (IsCanceled())
+			return; // Not counted as a failure.
+		Fail(GetLastError());
+	}
+	ReportProgress(mItemBase + aSize); // Even if it failed, so that progress still reaches the total.
+}
+
+
+DWORD CALLBACK FileTask::CopyProgress(LARGE_INTEGER aTotalFileSize, LARGE_INTEGER aTotalBytesTransferred
+	, LARGE_INTEGER aStreamSize, LARGE_INTEGER aStreamBytesTransferred, DWORD aStreamNumber
+	, DWORD aCallbackReason, HANDLE aSourceFile, HANDLE aDestinationFile, LPVOID aData)
+{
+	auto task = (FileTask *)aData;
+	if (task->IsCanceled())
+		return PROGRESS_CANCEL; // CopyFileEx() deletes the partially copied file.
+	task->ReportProgress(task->mItemBase + aTotalBytesTransferred.QuadPart);
+	return PROGRESS_CONTINUE;
+}
+
+
+void FileTask::OnEvents(UINT aEvents)
+// Called on the main thread, in a new script thread.
+{
+	if (!(aEvents & WORKER_EVENT_DONE))
+	{
+		if (mOnProgress)
+		{
+			ExprTokenType params[] = { (__int64)mBytesDone.load(), (__int64)mBytesTotal.load() };
+			IObjectPtr(mOnProgress)->ExecuteInNewThread(_T("FileTask"), params, _countof(params));
+		}
+		return;
+	}
+	TCHAR result_buf[MAX_NUMBER_SIZE];
+	ResultToken result;
+	result.InitResult(result_buf);
+	IObject *error = nullptr;
+	bool canceled = mError == ERROR_CANCELLED || (mError && IsCanceled());
+	if (canceled)
+		mStatus = _T("Canceled");
+	else if (mError)
+		mStatus = _T("Failed");
+	else
+	{
+		mStatus = _T("Done");
+		if (mType == TASK_READ)
+		{
+			// FileReadResult() takes ownership of mData.
+			auto fr = FileReadResult(mData, mDataLength, mCodepage, mTranslateCRLF, result);
+			mData = nullptr;
+			if (fr == FR_FAIL || fr == FR_ABORTED)
+			{
+				// An error was thrown (or shown) in this thread.  Pass it to the callback rather
+				// than leaving it unhandled, so that the outcome is reported the usual way.
+				if (g->ThrownToken)
+				{
+					if (g->ThrownToken->symbol == SYM_OBJECT)
+						(error = g->ThrownToken->object)->AddRef();
+					g_script.FreeExceptionToken(g->ThrownToken);
+				}
+				result.InitResult(result_buf);
+				mError = ERROR_NOT_ENOUGH_MEMORY;
+				mStatus = _T("Failed");
+			}
+			else if (fr != OK)
+			{
+				mError = (fr & 0xFFFF0000) == (DWORD)FR_E_WIN32 ? (fr & 0xFFFF) : ERROR_NOT_ENOUGH_MEMORY;
+				mStatus = _T("Failed");
+			}
+		}
+	}
+	ExprTokenType params[2];
+	params[0].CopyValueFrom(result);
+	if (mError && !error)
+	{
+		TCHAR number_string[_MAX_ULTOSTR_BASE10_COUNT], extra[_MAX_ULTOSTR_BASE10_COUNT];
+		if (canceled)
+			error = g_script.CreateRuntimeException(_T("Canceled."), _T(""), ErrorPrototype::Error);
+		else // Extra is the number of files which couldn't be copied, if applicable.
+			error = g_script.CreateRuntimeException(_ultot(mError, number_string, 10)
+				, mFailures ? _itot(mFailures, extra, 10) : _T(""), ErrorPrototype::OS);
+	}
+	if (error)
+		params[1].SetValue(error);
+	else
+		params[1].SetValue(_T(""), 0);
+	IObjectPtr(mCallback)->ExecuteInNewThread(_T("FileTask"), params, _countof(params));
+	if (error)
+		error->Release();
+	result.Free();
+	Release(); // Balance the AddRef() in Start().
+}
+
+
+bif_impl FResult FileReadAsync(StrArg aPath, IObject *aCallback, optl<StrArg> aOptions, optl<IObject*> aOnProgress
+	, IObject *&aRetVal)
+{
+	if (!*aPath)
+		return FR_E_ARG(0);
+	bool translate_crlf_to_lf = false;
+	unsigned __int64 max_bytes_to_load = ULLONG_MAX;
+	UINT codepage = g->Encoding;
+	auto fr = ConvertFileOptions(aOptions.value_or_null(), codepage, translate_crlf_to_lf, &max_bytes_to_load);
+	if (fr != OK)
+		return fr;
+	return FileTask::Start(FileTask::TASK_READ, aPath, nullptr, aCallback, aOnProgress.value_or_null(), aRetVal
+		, 0, codepage, translate_crlf_to_lf, max_bytes_to_load);
+}
+
+
+bif_impl FResult FileCopyAsync(StrArg aSource, StrArg aDest, IObject *aCallback, optl<int> aOverwrite
+	, optl<IObject*> aOnProgress, IObject *&aRetVal)
+{
+	if (!*aSource) return FR_E_ARG(0);
+	if (!*aDest) return FR_E_ARG(1);
+	return FileTask::Start(FileTask::TASK_COPY_FILES, aSource, aDest, aCallback, aOnProgress.value_or_null(), aRetVal
+		, aOverwrite.value_or(0) == 1);
+}
+
+
+bif_impl FResult DirCopyAsync(StrArg aSource, StrArg aDest, IObject *aCallback, optl<int> aOverwrite
+	, optl<IObject*> aOnProgress, IObject *&aRetVal)
+{
+	if (!*aSource) return FR_E_ARG(0);
+	if (!*aDest) return FR_E_ARG(1);
+	int overwrite = aOverwrite.value_or(0);
+	return FileTask::Start(FileTask::TASK_COPY_DIR, aSource, aDest, aCallback, aOnProgress.value_or_null(), aRetVal
+		, overwrite == 1 || overwrite == 2); // Strict validation for safety, as in Util_CopyDir().
+}
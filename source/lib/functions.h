@@ -5,6 +5,8 @@
 #define MD_CONTROL_ARGS_OPT (In_Opt, Variant, Control), MD_WINTITLE_ARGS
 #endif
 
+md_func(Benchmark, (In, Object, Function), (In_Opt, Int32, Iterations), (Ret, Object, RetVal))
+
 md_func_x(BlockInput, ScriptBlockInput, FResult, (In, String, Mode))
 
 #ifdef ENABLE_REGISTERCALLBACK
@@ -57,6 +59,8 @@ md_func_v(DetectHiddenText, (In, Bool32, Mode), (Ret, Bool32, RetVal))
 md_func_v(DetectHiddenWindows, (In, Bool32, Mode), (Ret, Bool32, RetVal))
 
 md_func(DirCopy, (In, String, Source), (In, String, Dest), (In_Opt, Int32, Overwrite))
+md_func(DirCopyAsync, (In, String, Source), (In, String, Dest), (In, Object, Callback), (In_Opt, Int32, Overwrite),
+	(In_Opt, Object, OnProgress), (Ret, Object, RetVal))
 md_func(DirCreate, (In, String, Path))
 md_func(DirDelete, (In, String, Path), (In_Opt, Bool32, Recurse))
 md_func_v(DirExist, (In, String, Pattern), (Ret, String, RetVal))
@@ -97,6 +101,8 @@ md_func_x(ExitApp, ExitApp, ResultType, (In_Opt, Int32, ExitCode))
 
 md_func(FileAppend, (In, Variant, Value), (In_Opt, String, Path), (In_Opt, String, Options))
 md_func(FileCopy, (In, String, Source), (In, String, Dest), (In_Opt, Int32, Overwrite))
+md_func(FileCopyAsync, (In, String, Source), (In, String, Dest), (In, Object, Callback), (In_Opt, Int32, Overwrite),
+	(In_Opt, Object, OnProgress), (Ret, Object, RetVal))
 md_func(FileCreateShortcut, (In, String, Target), (In, String, LinkFile), (In_Opt, String, WorkingDir),
 	(In_Opt, String, Args), (In_Opt, String, Description), (In_Opt, String, IconFile),
 	(In_Opt, String, ShortcutKey), (In_Opt, Int32, IconNumber), (In_Opt, Int32, RunState))
@@ -113,6 +119,8 @@ md_func(FileGetVersion, (In_Opt, String, Path), (Ret, String, RetVal))
 md_func(FileInstall, (In, String, Source), (In, String, Dest), (In_Opt, Int32, Overwrite))
 md_func(FileMove, (In, String, Source), (In, String, Dest), (In_Opt, Int32, Overwrite))
 md_func(FileRead, (In, String, Path), (In_Opt, String, Options), (Ret, Variant, RetVal))
+md_func(FileReadAsync, (In, String, Path), (In, Object, Callback), (In_Opt, String, Options),
+	(In_Opt, Object, OnProgress), (Ret, Object, RetVal))
 md_func(FileRecycle, (In, String, Pattern))
 md_func(FileRecycleEmpty, (In_Opt, String, Drive))
 md_func(FileSelect, (In_Opt, String, Options), (In_Opt, String, RootDirFileName), (In_Opt, String, Title), (In_Opt, String, Filter), (Ret, Variant, RetVal))
@@ -132,6 +140,10 @@ md_func(GroupDeactivate, (In, String, GroupName), (In_Opt, String, Mode))
 md_func_v(GuiCtrlFromHwnd, (In, UInt32, Hwnd), (Ret, Object, Gui))
 md_func_v(GuiFromHwnd, (In, UInt32, Hwnd), (In_Opt, Bool32, Recurse), (Ret, Object, Gui))
 
+md_func(HeapStats, (Ret, Object, RetVal))
+
+md_func(HookLatency, (In, Float64, Percentile), (In_Opt, String, Hook), (Ret, Float64, RetVal))
+
 md_func(HotIf, (In_Opt, Variant, Criterion))
 md_func(HotIfWinActive, (In_Opt, String, WinTitle), (In_Opt, String, WinText))
 md_func(HotIfWinExist, (In_Opt, String, WinTitle), (In_Opt, String, WinText))
@@ -145,6 +157,7 @@ md_func_x(IL_Create, IL_Create, UIntPtr, (In_Opt, Int32, InitialCount), (In_Opt,
 md_func_x(IL_Destroy, IL_Destroy, Bool32, (In, UIntPtr, ImageList))
 
 md_func(ImageSearch, (Out_Opt, Variant, X), (Out_Opt, Variant, Y), (In, Int32, X1), (In, Int32, Y1), (In, Int32, X2), (In, Int32, Y2), (In, String, Image), (Ret, Bool32, Found))
+md_func(ImageSearchAll, (In, Int32, X1), (In, Int32, Y1), (In, Int32, X2), (In, Int32, Y2), (In, String, Image), (In_Opt, Int32, MaxCount), (Ret, Object, RetVal))
 
 md_func(IniDelete, (In, String, Path), (In, String, Section), (In_Opt, String, Key))
 md_func(IniRead, (In, String, Path), (In_Opt, String, Section), (In_Opt, String, Key), (In_Opt, String, Default), (Ret, String, RetVal))
@@ -222,6 +235,7 @@ md_func_v(Persistent, (In_Opt, Bool32, NewValue), (Ret, Bool32, OldValue))
 
 md_func(PixelGetColor, (In, Int32, X), (In, Int32, Y), (In_Opt, String, Mode), (Ret, String, Color))
 md_func(PixelSearch, (Ret, Bool32, Found), (Out_Opt, Variant, X), (Out_Opt, Variant, Y), (In, Int32, X1), (In, Int32, Y1), (In, Int32, X2), (In, Int32, Y2), (In, UInt32, Color), (In_Opt, Int32, Variation))
+md_func(PixelSearchAll, (In, Int32, X1), (In, Int32, Y1), (In, Int32, X2), (In, Int32, Y2), (In, UInt32, Color), (In_Opt, Int32, Variation), (In_Opt, Int32, MaxCount), (Ret, Object, RetVal))
 
 #undef PostMessage
 md_func_x(PostMessage, ScriptPostMessage, FResult, (In, UInt32, Msg), (In_Opt, Variant, wParam), (In_Opt, Variant, lParam), MD_CONTROL_ARGS_OPT)
@@ -270,7 +284,7 @@ md_func(SetWorkingDir, (In, String, Path))
 
 md_func(Shutdown, (In, Int32, Flags))
 
-md_func_x(Sleep, ScriptSleep, Void, (In, Int32, Delay))
+md_func_x(Sleep, ScriptSleep, Void, (In, Float64, Delay), (In_Opt, Bool32, Precise))
 
 md_func_v(SoundBeep, (In_Opt, Int32, Duration), (In_Opt, Int32, Frequency))
 md_func(SoundPlay, (In, String, Path), (In_Opt, String, Wait))
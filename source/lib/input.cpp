@@ -479,7 +479,9 @@ void input_type::EndByReason(InputStatusType aReason)
 	// ...so that we can rely on MsgSleep() to create a new thread for the OnEnd event.
 	// ...because InputRelease() can't be called by the hook thread.
 	// ...because some callers rely on the list not being broken by this call.
-	PostMessage(g_hWnd, AHK_INPUT_END, (WPARAM)this, 0);
+	// It's queued behind any of this InputHook's events which haven't been handled yet, since
+	// they would be discarded if it ended first.
+	PostHookEvent(AHK_INPUT_END, (WPARAM)this, 0);
 }
 
 
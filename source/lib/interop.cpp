@@ -243,6 +243,408 @@ BIF_DECL(BIF_NumPut)
 
 
 
+
+//
+// Buffer.Find and Buffer.View
+//
+
+void BufferObject::Find(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount)
+// Buffer.Find(Needle [, Offset]): Returns the offset of the first occurrence of a sequence of bytes,
+// or -1 if there is none.  Needle can be a buffer-like object or a string (excluding its terminator).
+{
+	size_t needle, needle_size;
+	if (auto obj = ParamIndexToObject(0))
+	{
+		GetBufferObjectPtr(aResultToken, obj, needle, needle_size);
+		if (aResultToken.Exited())
+			return;
+	}
+	else
+	{
+		size_t length;
+		needle = (size_t)ParamIndexToString(0, _f_number_buf, &length);
+		needle_size = length * sizeof(TCHAR);
+	}
+	if (!needle_size)
+		_o_throw_param(0);
+	__int64 offset = 0;
+	if (!ParamIndexIsOmitted(1))
+	{
+		if (!ParamIndexIsNumeric(1))
+			_o_throw_param(1, _T("Number"));
+		offset = ParamIndexToInt64(1);
+		if (offset < 0 || (size_t)offset > mSize)
+			_o_throw_param(1);
+	}
+	auto found = FindBytes((BYTE *)mData + offset, mSize - (size_t)offset, (void *)needle, needle_size);
+	_o_return(found < 0 ? -1 : offset + found);
+}
+
+
+void BufferObject::View(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount)
+// Buffer.View(Type [, Offset, Length]): Returns a BufferView.  If Length is omitted, the view extends
+// to the end of the buffer and is adjusted automatically when the buffer is resized.
+{
+	NumKind kind;
+	if (!BufferView::ParseType(ParamIndexToString(0, _f_number_buf), kind))
+		_o_throw_param(0);
+	__int64 offset = 0, length = 0;
+	if (!ParamIndexIsOmitted(1))
+	{
+		if (!ParamIndexIsNumeric(1))
+			_o_throw_param(1, _T("Number"));
+		offset = ParamIndexToInt64(1);
+		if (offset < 0 || (size_t)offset > mSize)
+			_o_throw_param(1);
+	}
+	bool fixed_length = !ParamIndexIsOmitted(2);
+	if (fixed_length)
+	{
+		if (!ParamIndexIsNumeric(2))
+			_o_throw_param(2, _T("Number"));
+		length = ParamIndexToInt64(2);
+		if (length < 0 || (size_t)length > (mSize - (size_t)offset) / NumKindSize(kind))
+			_o_throw_param(2);
+	}
+	_o_return(BufferView::Create(this, kind, (size_t)offset, (size_t)length, fixed_length));
+}
+
+
+
+//
+// BufferView
+//
+
+ObjectMemberMd BufferView::sMembers[] =
+{
+	md_member(BufferView, __Enum, CALL, (In_Opt, Int32, VarCount), (Ret, Object, RetVal)),
+	md_member(BufferView, __Item, GET, (In, Int64, Index), (Ret, Variant, RetVal)),
+	md_member(BufferView, __Item, SET, (In, Variant, Value), (In, Int64, Index)),
+	md_member(BufferView, Assign, CALL, (In, Object, Values), (In_Opt, Int64, Start)),
+	md_member(BufferView, CopyWithin, CALL, (In, Int64, Target), (In, Int64, Start), (In_Opt, Int64, Count)),
+	md_member(BufferView, Fill, CALL, (In, Variant, Value), (In_Opt, Int64, Start), (In_Opt, Int64, Count)),
+	md_member(BufferView, Max, CALL, (In_Opt, Int64, Start), (In_Opt, Int64, Count), (Ret, Variant, RetVal)),
+	md_member(BufferView, Min, CALL, (In_Opt, Int64, Start), (In_Opt, Int64, Count), (Ret, Variant, RetVal)),
+	md_member(BufferView, Sum, CALL, (In_Opt, Int64, Start), (In_Opt, Int64, Count), (Ret, Variant, RetVal)),
+	md_member(BufferView, ToArray, CALL, (In_Opt, Int64, Start), (In_Opt, Int64, Count), (Ret, Object, RetVal)),
+	md_property_get(BufferView, Buffer, Object),
+	md_property_get(BufferView, Length, UIntPtr),
+	md_property_get(BufferView, Offset, UIntPtr),
+	md_property_get(BufferView, Ptr, UIntPtr),
+	md_property_get(BufferView, Size, UIntPtr),
+	md_property_get(BufferView, Type, String)
+};
+int BufferView::sMemberCount = _countof(sMembers);
+
+Object *BufferView::sPrototype;
+
+
+bool BufferView::ParseType(LPCTSTR aType, NumKind &aKind)
+// Accepts the same type names as NumGet.  As with NumGet, UInt64 is treated as Int64.
+{
+	NumGetParams op;
+	ExprTokenType type_token(const_cast<LPTSTR>(aType));
+	ConvertNumGetType(type_token, op);
+	switch (op.num_size)
+	{
+	case 1: aKind = op.is_signed ? NumKind::Int8 : NumKind::UInt8; break;
+	case 2: aKind = op.is_signed ? NumKind::Int16 : NumKind::UInt16; break;
+	case 4: aKind = !op.is_integer ? NumKind::Float32 : op.is_signed ? NumKind::Int32 : NumKind::UInt32; break;
+	case 8: aKind = !op.is_integer ? NumKind::Float64 : NumKind::Int64; break;
+	default: return false;
+	}
+	return true;
+}
+
+
+FResult BufferView::get_Type(StrRet &aRetVal)
+{
+	static LPCTSTR sName[] = { _T("Char"), _T("UChar"), _T("Short"), _T("UShort"), _T("Int"), _T("UInt"), _T("Int64"), _T("Float"), _T("Double") };
+	aRetVal.SetStatic(sName[(int)mKind]);
+	return OK;
+}
+
+
+size_t BufferView::Length()
+{
+	if (mFixedLength)
+		return mLength;
+	size_t size = mBuffer->Size();
+	return size > mOffset ? (size - mOffset) / ElementSize() : 0;
+}
+
+
+FResult BufferView::CheckBounds()
+// A view with a fixed length is left invalid (rather than being truncated) if the buffer is shrunk,
+// since that's more likely to be an error than intentional.  A view without a fixed length is invalid
+// only if the buffer is shrunk to less than its offset.
+{
+	if ((mFixedLength ? mOffset + mLength * ElementSize() : mOffset) > mBuffer->Size())
+		return FValueError(_T("The view extends beyond the end of the buffer."));
+	return OK;
+}
+
+
+FResult BufferView::get_Ptr(UINT_PTR &aRetVal)
+{
+	// Validate, since the address is likely to be passed to NumPut, DllCall, etc. along with Size.
+	auto fr = CheckBounds();
+	if (fr != OK)
+		return fr;
+	aRetVal = (UINT_PTR)mBuffer->Data() + mOffset;
+	return OK;
+}
+
+
+FResult BufferView::get_Size(UINT_PTR &aRetVal)
+{
+	auto fr = CheckBounds();
+	if (fr != OK)
+		return fr;
+	aRetVal = Length() * ElementSize();
+	return OK;
+}
+
+
+FResult BufferView::GetRange(optl<__int64> aStart, optl<__int64> aCount, int aStartArg, BYTE *&aData, size_t &aItemCount)
+// Resolves a one-based Start (negative to count from the end) and Count (default: to the end).
+{
+	auto fr = CheckBounds();
+	if (fr != OK)
+		return fr;
+	__int64 length = (__int64)Length();
+	__int64 start = aStart.value_or(1);
+	if (!start) // There is no item before the first, so reject 0 rather than letting it mean the end.
+		return FR_E_ARG(aStartArg);
+	if (start < 0)
+		start += length + 1;
+	--start;
+	if (start < 0 || start > length)
+		return FR_E_ARG(aStartArg);
+	__int64 count = aCount.value_or(length - start);
+	if (count < 0 || count > length - start)
+		return FR_E_ARG(aStartArg + 1);
+	aData = (BYTE *)mBuffer->Data() + mOffset + (size_t)start * ElementSize();
+	aItemCount = (size_t)count;
+	return OK;
+}
+
+
+FResult BufferView::GetItem(__int64 aIndex, BYTE *&aItem)
+{
+	auto fr = CheckBounds();
+	if (fr != OK)
+		return fr;
+	__int64 length = (__int64)Length();
+	__int64 index = aIndex <= 0 ? aIndex + length : aIndex - 1; // Let -1 be the last item.
+	if (index < 0 || index >= length)
+	{
+		TCHAR buf[MAX_INTEGER_SIZE];
+		return FError(ERR_INVALID_INDEX, ITOA64(aIndex, buf), ErrorPrototype::Index);
+	}
+	aItem = (BYTE *)mBuffer->Data() + mOffset + (size_t)index * ElementSize();
+	return OK;
+}
+
+
+FResult BufferView::TokenToNum(ExprTokenType &aToken, NumValue &aValue)
+{
+	if (!TokenIsNumeric(aToken))
+		return FTypeError(_T("Number"), aToken);
+	// See NumPut for comments about conversion of large unsigned integers.
+	if (NumKindIsFloat(mKind))
+		aValue.d = TokenToDouble(aToken);
+	else
+		aValue.i = TokenToInt64(aToken);
+	return OK;
+}
+
+
+void BufferView::NumToToken(NumValue aValue, ResultToken &aToken)
+{
+	if (NumKindIsFloat(mKind))
+		aToken.SetValue(aValue.d);
+	else
+		aToken.SetValue(aValue.i);
+}
+
+
+FResult BufferView::get___Item(__int64 aIndex, ResultToken &aRetVal)
+{
+	BYTE *item;
+	auto fr = GetItem(aIndex, item);
+	if (fr != OK)
+		return fr;
+	NumToToken(NumLoad(item, mKind), aRetVal);
+	return OK;
+}
+
+
+FResult BufferView::set___Item(ExprTokenType &aValue, __int64 aIndex)
+{
+	NumValue value;
+	BYTE *item;
+	auto fr = TokenToNum(aValue, value);
+	if (fr == OK)
+		fr = GetItem(aIndex, item);
+	if (fr != OK)
+		return fr;
+	NumStore(item, mKind, value);
+	return OK;
+}
+
+
+FResult BufferView::__Enum(optl<int> aVarCount, IObject *&aRetVal)
+{
+	aRetVal = new IndexEnumerator(this, aVarCount.value_or(0)
+		, static_cast<IndexEnumerator::Callback>(&BufferView::GetEnumItem), true);
+	return OK;
+}
+
+
+ResultType BufferView::GetEnumItem(UINT &aIndex, Var *aVal, Var *aReserved, int aVarCount)
+{
+	if (aIndex >= Length() || CheckBounds() != OK) // Stop if the buffer was shrunk during the loop.
+		return CONDITION_FALSE;
+	if (aVarCount > 1)
+	{
+		// Put the index first, only when there are two parameters.
+		if (aVal)
+			aVal->Assign((__int64)aIndex + 1);
+		aVal = aReserved;
+	}
+	if (aVal)
+	{
+		auto value = NumLoad((BYTE *)mBuffer->Data() + mOffset + (size_t)aIndex * ElementSize(), mKind);
+		if (NumKindIsFloat(mKind))
+			aVal->Assign(value.d);
+		else
+			aVal->Assign(value.i);
+	}
+	return CONDITION_TRUE;
+}
+
+
+FResult BufferView::Assign(IObject *aValues, optl<__int64> aStart)
+// Stores the numbers contained by an Array, starting at the given index.
+{
+	auto values = dynamic_cast<Array *>(aValues);
+	if (!values)
+	{
+		ExprTokenType values_token(aValues);
+		return FTypeError(_T("Array"), values_token);
+	}
+	BYTE *data;
+	size_t count;
+	auto fr = GetRange(aStart, nullptr, 1, data, count);
+	if (fr != OK)
+		return fr;
+	if (values->Length() > count)
+		return FR_E_ARG(0);
+	size_t size = ElementSize();
+	ExprTokenType item;
+	for (Array::index_t i = 0; values->ItemToToken(i, item); ++i, data += size)
+	{
+		NumValue value;
+		fr = TokenToNum(item, value);
+		if (fr != OK)
+			return fr;
+		NumStore(data, mKind, value);
+	}
+	return OK;
+}
+
+
+FResult BufferView::CopyWithin(__int64 aTarget, __int64 aStart, optl<__int64> aCount)
+// Copies Count elements from Start to Target within the view.  The ranges may overlap.
+{
+	BYTE *source, *target;
+	size_t count, target_count;
+	auto fr = GetRange(aStart, aCount, 1, source, count);
+	if (fr == OK)
+		fr = GetRange(aTarget, nullptr, 0, target, target_count);
+	if (fr != OK)
+		return fr;
+	if (count > target_count)
+		return FR_E_ARG(2);
+	memmove(target, source, count * ElementSize());
+	return OK;
+}
+
+
+FResult BufferView::Fill(ExprTokenType &aValue, optl<__int64> aStart, optl<__int64> aCount)
+{
+	NumValue value;
+	BYTE *data;
+	size_t count;
+	auto fr = TokenToNum(aValue, value);
+	if (fr == OK)
+		fr = GetRange(aStart, aCount, 1, data, count);
+	if (fr != OK)
+		return fr;
+	NumFill(data, count, mKind, value);
+	return OK;
+}
+
+
+FResult BufferView::Reduce(NumValue (*aOp)(const void *, size_t, NumKind), optl<__int64> aStart, optl<__int64> aCount, ResultToken &aRetVal)
+{
+	BYTE *data;
+	size_t count;
+	auto fr = GetRange(aStart, aCount, 0, data, count);
+	if (fr != OK)
+		return fr;
+	if (count || aOp == NumSum)
+		NumToToken(aOp(data, count, mKind), aRetVal);
+	else
+		aRetVal.SetValue(_T(""), 0); // There is no Min or Max of an empty range.
+	return OK;
+}
+
+FResult BufferView::Max(optl<__int64> aStart, optl<__int64> aCount, ResultToken &aRetVal)
+{
+	return Reduce(NumMax, aStart, aCount, aRetVal);
+}
+
+FResult BufferView::Min(optl<__int64> aStart, optl<__int64> aCount, ResultToken &aRetVal)
+{
+	return Reduce(NumMin, aStart, aCount, aRetVal);
+}
+
+FResult BufferView::Sum(optl<__int64> aStart, optl<__int64> aCount, ResultToken &aRetVal)
+{
+	return Reduce(NumSum, aStart, aCount, aRetVal);
+}
+
+
+FResult BufferView::ToArray(optl<__int64> aStart, optl<__int64> aCount, IObject *&aRetVal)
+{
+	BYTE *data;
+	size_t count;
+	auto fr = GetRange(aStart, aCount, 0, data, count);
+	if (fr != OK)
+		return fr;
+	if (count > Array::MaxIndex)
+		return FR_E_OUTOFMEM;
+	auto arr = Array::Create();
+	if (!arr)
+		return FR_E_OUTOFMEM;
+	size_t size = ElementSize();
+	for (size_t i = 0; i < count; ++i, data += size)
+	{
+		auto value = NumLoad(data, mKind);
+		if (!(NumKindIsFloat(mKind) ? arr->Append(ExprTokenType(value.d)) : arr->Append(value.i)))
+		{
+			arr->Release();
+			return FR_E_OUTOFMEM;
+		}
+	}
+	aRetVal = arr;
+	return OK;
+}
+
+
+
 BIF_DECL(BIF_StrGetPut) // BIF_DECL(BIF_StrGet), BIF_DECL(BIF_StrPut)
 {
 	// To simplify flexible handling of parameters:
@@ -0,0 +1,701 @@
+﻿/*
+AutoHotkey
+
+Copyright 2003-2009 Chris Mallett (support@autohotkey.com)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "stdafx.h"
+#include "script.h"
+#include "script_func_impl.h"
+#include <float.h> // For _finite().
+
+
+
+// Limits recursion so that deeply nested input can't overflow the stack, and so that
+// Stringify fails cleanly on objects which contain references to themselves.
+#define JSON_MAX_DEPTH 1000
+#define JSON_MAX_INDENT 32
+
+
+class JSON
+{
+	typedef Object::Variant Variant;
+
+	ResultToken &mResult;
+	int mDepth = 0;
+
+	// Output buffer for Stringify.  Parse uses it to hold unescaped strings, which are
+	// stacked so that an object's key remains valid while the value following it is
+	// parsed.  Offsets are kept rather than pointers since the buffer may be moved.
+	LPTSTR mBuf = nullptr;
+	size_t mLength = 0, mCapacity = 0;
+
+	// Parse state.
+	LPCTSTR mPos = nullptr;
+	bool mObjectMode = false; // Produce Object rather than Map for JSON objects.
+
+	// Stringify state.
+	TCHAR mIndent[JSON_MAX_INDENT + 1];
+	size_t mIndentLength = 0;
+
+	JSON(ResultToken &aResultToken) : mResult(aResultToken) {}
+	~JSON() { free(mBuf); }
+
+	bool Reserve(size_t aExtra)
+	// Ensures there is room for aExtra more characters plus a null terminator.
+	{
+		if (mLength + aExtra < mCapacity)
+			return true;
+		size_t new_capacity = mCapacity ? mCapacity * 2 : 256;
+		if (new_capacity <= mLength + aExtra)
+			new_capacity = mLength + aExtra + 1;
+		auto new_buf = (LPTSTR)realloc(mBuf, new_capacity * sizeof(TCHAR));
+		if (!new_buf)
+			return false;
+		mBuf = new_buf;
+		mCapacity = new_capacity;
+		return true;
+	}
+
+	ResultType Write(LPCTSTR aText, size_t aLength)
+	{
+		if (!Reserve(aLength))
+			return mResult.MemoryError();
+		tmemcpy(mBuf + mLength, aText, aLength);
+		mLength += aLength;
+		return OK;
+	}
+
+	ResultType Write(TCHAR aChar)
+	{
+		if (!Reserve(1))
+			return mResult.MemoryError();
+		mBuf[mLength++] = aChar;
+		return OK;
+	}
+
+	//
+	// Parsing
+	//
+
+	void SkipWhitespace()
+	{
+		while (*mPos == ' ' || *mPos == '\t' || *mPos == '\n' || *mPos == '\r')
+			++mPos;
+	}
+
+	ResultType SyntaxError()
+	{
+		// Show the text at the point of failure, since the full document may be very large.
+		TCHAR extra[32];
+		tcslcpy(extra, mPos, _countof(extra));
+		return mResult.ValueError(ERR_JSON_SYNTAX, *mPos ? extra : _T("<end of text>"));
+	}
+
+	static bool ParseHex4(LPCTSTR aText, UINT &aValue)
+	{
+		aValue = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			TCHAR c = aText[i];
+			if (c >= '0' && c <= '9')
+				aValue = (aValue << 4) | (c - '0');
+			else if ((c |= 0x20) >= 'a' && c <= 'f') // |= 0x20 converts A-F to lowercase.
+				aValue = (aValue << 4) | (c - 'a' + 10);
+			else
+				return false;
+		}
+		return true;
+	}
+
+	ResultType ParseString(ExprTokenType &aValue)
+	// Unescapes the string at mPos into mBuf and sets aValue to point at it.
+	// mLength is advanced past the string's null terminator.
+	{
+		size_t start = mLength;
+		for (++mPos;;)
+		{
+			// Copy runs of characters which need no translation in bulk.
+			LPCTSTR run = mPos;
+			while (*mPos != '"' && *mPos != '\\' && (TBYTE)*mPos >= 0x20)
+				++mPos;
+			if (mPos > run && !Write(run, mPos - run))
+				return FAIL;
+			if (*mPos == '"')
+				break;
+			if (*mPos != '\\') // Control character or end of text.
+				return SyntaxError();
+			TCHAR c;
+			switch (*++mPos)
+			{
+			case '"':
+			case '\\':
+			case '/': c = *mPos; break;
+			case 'b': c = '\b'; break;
+			case 'f': c = '\f'; break;
+			case 'n': c = '\n'; break;
+			case 'r': c = '\r'; break;
+			case 't': c = '\t'; break;
+			case 'u':
+			{
+				UINT u;
+				if (!ParseHex4(mPos + 1, u))
+					return SyntaxError();
+				mPos += 4;
+#ifdef UNICODE
+				c = (TCHAR)u; // Surrogate pairs need no special handling since the string is UTF-16.
+#else
+				WCHAR wc[2] = { (WCHAR)u };
+				int wc_count = 1;
+				UINT u2;
+				if (IS_HIGH_SURROGATE(u) && mPos[1] == '\\' && mPos[2] == 'u'
+					&& ParseHex4(mPos + 3, u2) && IS_LOW_SURROGATE(u2))
+				{
+					wc[wc_count++] = (WCHAR)u2;
+					mPos += 6;
+				}
+				char mb[8];
+				int mb_count = WideCharToMultiByte(CP_ACP, 0, wc, wc_count, mb, _countof(mb), NULL, NULL);
+				if (mb_count > 1)
+				{
+					if (!Write(mb, mb_count - 1))
+						return FAIL;
+					c = mb[mb_count - 1];
+				}
+				else
+					c = mb_count ? mb[0] : '?';
+#endif
+				break;
+			}
+			default:
+				return SyntaxError();
+			}
+			if (!Write(c))
+				return FAIL;
+			++mPos;
+		}
+		++mPos; // Skip the closing quote.
+		if (!Write('\0'))
+			return FAIL;
+		aValue.SetValue(mBuf + start, mLength - start - 1);
+		return OK;
+	}
+
+	ResultType ParseNumber(ExprTokenType &aValue)
+	{
+		LPCTSTR start = mPos;
+		bool negative = *mPos == '-';
+		if (negative)
+			++mPos;
+		if (*mPos == '0')
+			++mPos;
+		else if (*mPos >= '1' && *mPos <= '9')
+			while (cisdigit(*++mPos));
+		else
+			return SyntaxError();
+		bool is_float = false;
+		if (*mPos == '.')
+		{
+			if (!cisdigit(*++mPos))
+				return SyntaxError();
+			while (cisdigit(*++mPos));
+			is_float = true;
+		}
+		if (*mPos == 'e' || *mPos == 'E')
+		{
+			if (*++mPos == '-' || *mPos == '+')
+				++mPos;
+			if (!cisdigit(*mPos))
+				return SyntaxError();
+			while (cisdigit(*++mPos));
+			is_float = true;
+		}
+		if (!is_float)
+		{
+			// Integers which don't fit in 64 bits are loaded as floats, as in JavaScript.
+			UINT64 limit = negative ? 0x8000000000000000ULL : 0x7FFFFFFFFFFFFFFFULL, n = 0;
+			LPCTSTR cp;
+			for (cp = start + negative; cp < mPos; ++cp)
+			{
+				UINT d = *cp - '0';
+				if (n > (limit - d) / 10)
+					break;
+				n = n * 10 + d;
+			}
+			if (cp == mPos)
+			{
+				aValue.SetValue((__int64)(negative ? 0 - n : n));
+				return OK;
+			}
+		}
+		// Since the syntax was validated above, the conversion stops at the end of the number.
+		aValue.SetValue(ATOF_NOHEX(start));
+		return OK;
+	}
+
+	ResultType ParseArray(ExprTokenType &aValue)
+	{
+		auto arr = Array::Create();
+		if (!arr)
+			return mResult.MemoryError();
+		++mPos;
+		SkipWhitespace();
+		if (*mPos != ']')
+		{
+			for (;;)
+			{
+				size_t buf_mark = mLength;
+				ExprTokenType item;
+				if (!ParseValue(item))
+					goto fail;
+				// null is stored as an unset item, so the array keeps its length.
+				bool ok = arr->Append(item);
+				if (item.symbol == SYM_OBJECT)
+					item.object->Release();
+				mLength = buf_mark;
+				if (!ok)
+				{
+					mResult.MemoryError();
+					goto fail;
+				}
+				SkipWhitespace();
+				if (*mPos != ',')
+					break;
+				++mPos;
+				SkipWhitespace();
+			}
+			if (*mPos != ']')
+			{
+				SyntaxError();
+				goto fail;
+			}
+		}
+		++mPos;
+		aValue.SetValue(arr);
+		return OK;
+	fail:
+		arr->Release();
+		return FAIL;
+	}
+
+	ResultType ParseObject(ExprTokenType &aValue)
+	{
+		auto obj = mObjectMode ? Object::Create() : Map::Create();
+		if (!obj)
+			return mResult.MemoryError();
+		++mPos;
+		SkipWhitespace();
+		if (*mPos != '}')
+		{
+			for (;;)
+			{
+				size_t key_offset = mLength;
+				ExprTokenType key, value;
+				if (*mPos != '"')
+				{
+					SyntaxError();
+					goto fail;
+				}
+				if (!ParseString(key))
+					goto fail;
+				SkipWhitespace();
+				if (*mPos != ':')
+				{
+					SyntaxError();
+					goto fail;
+				}
+				++mPos;
+				SkipWhitespace();
+				if (!ParseValue(value))
+					goto fail;
+				// null is stored as "" since a Map or Object can't contain an unset value.
+				if (value.symbol == SYM_MISSING)
+					value.SetValue(_T(""), 0);
+				// The key is resolved only now since parsing the value may have moved mBuf.
+				LPTSTR name = mBuf + key_offset;
+				bool ok = mObjectMode ? obj->SetOwnProp(name, value) : static_cast<Map *>(obj)->SetItem(name, value);
+				if (value.symbol == SYM_OBJECT)
+					value.object->Release();
+				mLength = key_offset;
+				if (!ok)
+				{
+					mResult.MemoryError();
+					goto fail;
+				}
+				SkipWhitespace();
+				if (*mPos != ',')
+					break;
+				++mPos;
+				SkipWhitespace();
+			}
+			if (*mPos != '}')
+			{
+				SyntaxError();
+				goto fail;
+			}
+		}
+		++mPos;
+		aValue.SetValue(obj);
+		return OK;
+	fail:
+		obj->Release();
+		return FAIL;
+	}
+
+	ResultType ParseValue(ExprTokenType &aValue)
+	// Parses the value at mPos, which must not be whitespace.  If aValue is an object,
+	// the caller is responsible for releasing it.  If it is a string, it points into mBuf.
+	{
+		switch (*mPos)
+		{
+		case '"':
+			return ParseString(aValue);
+		case '{':
+		case '[':
+		{
+			if (++mDepth > JSON_MAX_DEPTH)
+				return mResult.ValueError(ERR_JSON_TOO_DEEP);
+			auto result = *mPos == '{' ? ParseObject(aValue) : ParseArray(aValue);
+			--mDepth;
+			return result;
+		}
+		case 't':
+			if (!_tcsncmp(mPos, _T("true"), 4))
+			{
+				mPos += 4;
+				aValue.SetValue(1);
+				return OK;
+			}
+			break;
+		case 'f':
+			if (!_tcsncmp(mPos, _T("false"), 5))
+			{
+				mPos += 5;
+				aValue.SetValue(0);
+				return OK;
+			}
+			break;
+		case 'n':
+			if (!_tcsncmp(mPos, _T("null"), 4))
+			{
+				mPos += 4;
+				aValue.symbol = SYM_MISSING;
+				return OK;
+			}
+			break;
+		default:
+			if (*mPos == '-' || cisdigit(*mPos))
+				return ParseNumber(aValue);
+		}
+		return SyntaxError();
+	}
+
+	//
+	// Stringify
+	//
+
+	ResultType NewLine()
+	// Starts a new line at the current depth, if pretty-printing.
+	{
+		if (!mIndentLength)
+			return OK;
+		if (!Reserve(1 + mDepth * mIndentLength))
+			return mResult.MemoryError();
+		mBuf[mLength++] = '\n';
+		for (int i = 0; i < mDepth; ++i, mLength += mIndentLength)
+			tmemcpy(mBuf + mLength, mIndent, mIndentLength);
+		return OK;
+	}
+
+	ResultType WriteString(LPCTSTR aText, size_t aLength)
+	{
+		if (!Write('"'))
+			return FAIL;
+		for (LPCTSTR cp = aText, end = aText + aLength; ; ++cp)
+		{
+			// Copy runs of characters which need no escaping in bulk.
+			LPCTSTR run = cp;
+			while (cp < end && *cp != '"' && *cp != '\\' && (TBYTE)*cp >= 0x20)
+				++cp;
+			if (cp > run && !Write(run, cp - run))
+				return FAIL;
+			if (cp == end)
+				break;
+			TCHAR esc[7] = { '\\' };
+			size_t esc_length = 2;
+			switch (*cp)
+			{
+			case '"':
+			case '\\': esc[1] = *cp; break;
+			case '\b': esc[1] = 'b'; break;
+			case '\f': esc[1] = 'f'; break;
+			case '\n': esc[1] = 'n'; break;
+			case '\r': esc[1] = 'r'; break;
+			case '\t': esc[1] = 't'; break;
+			default: esc_length = _stprintf(esc, _T("\\u%04X"), (UINT)(TBYTE)*cp);
+			}
+			if (!Write(esc, esc_length))
+				return FAIL;
+		}
+		return Write('"');
+	}
+
+	ResultType WriteInteger(__int64 aValue)
+	{
+		TCHAR buf[MAX_INTEGER_SIZE];
+		return Write(buf, _tcslen(ITOA64(aValue, buf)));
+	}
+
+	ResultType WriteFloat(double aValue)
+	{
+		if (!_finite(aValue)) // JSON has no representation for inf or nan.
+		{
+			ExprTokenType value(aValue);
+			return mResult.Error(ERR_INVALID_VALUE, value, ErrorPrototype::Value);
+		}
+		TCHAR buf[MAX_NUMBER_SIZE];
+		return Write(buf, FTOA(aValue, buf, _countof(buf)));
+	}
+
+	ResultType WriteValue(Variant &aValue)
+	{
+		switch (aValue.symbol)
+		{
+		case SYM_STRING: return WriteString(aValue.string, aValue.string.Length());
+		case SYM_INTEGER: return WriteInteger(aValue.n_int64);
+		case SYM_FLOAT: return WriteFloat(aValue.n_double);
+		case SYM_OBJECT: return WriteObject(aValue.object);
+		default: return Write(_T("null"), 4); // SYM_MISSING; an unset array item.
+		}
+	}
+
+	ResultType WriteValue(ExprTokenType &aValue)
+	{
+		switch (aValue.symbol)
+		{
+		case SYM_VAR:
+		{
+			ExprTokenType value;
+			aValue.var->ToTokenSkipAddRef(value);
+			return WriteValue(value);
+		}
+		case SYM_STRING:
+			return WriteString(aValue.marker, aValue.marker_length != -1 ? aValue.marker_length : _tcslen(aValue.marker));
+		case SYM_INTEGER: return WriteInteger(aValue.value_int64);
+		case SYM_FLOAT: return WriteFloat(aValue.value_double);
+		case SYM_OBJECT: return WriteObject(aValue.object);
+		default: return Write(_T("null"), 4);
+		}
+	}
+
+	ResultType WriteMember(bool aFirst, LPCTSTR aName, size_t aNameLength)
+	// Writes the separator and key which precede a value within an object.
+	{
+		if (!aFirst && !Write(','))
+			return FAIL;
+		if (!NewLine() || !WriteString(aName, aNameLength) || !Write(':'))
+			return FAIL;
+		return mIndentLength ? Write(' ') : OK;
+	}
+
+	ResultType WriteArray(Array &aArray)
+	{
+		if (!Write('['))
+			return FAIL;
+		for (Array::index_t i = 0; i < aArray.mLength; ++i)
+		{
+			if (i && !Write(','))
+				return FAIL;
+			if (!NewLine() || !WriteValue(aArray.mItem[i]))
+				return FAIL;
+		}
+		return End(']', aArray.mLength != 0);
+	}
+
+	ResultType WriteMap(Map &aMap)
+	// Writes items in the Map's own order: integer keys in numeric order, then string keys.
+	{
+		if (aMap.mKeyOffsetObject < aMap.mKeyOffsetString)
+		{
+			// JSON keys must be strings, and there's no sensible string form of an object.
+			ExprTokenType key(aMap.mItem[aMap.mKeyOffsetObject].key.p);
+			return mResult.TypeError(_T("String"), key);
+		}
+		if (!Write('{'))
+			return FAIL;
+		for (Map::index_t i = 0; i < aMap.mCount; ++i)
+		{
+			auto &item = aMap.mItem[i];
+			TCHAR buf[MAX_INTEGER_SIZE];
+			LPCTSTR name = i < aMap.mKeyOffsetObject ? ITOA64(item.key.i, buf) : item.key.s;
+			if (!WriteMember(i == 0, name, _tcslen(name)) || !WriteValue(item))
+				return FAIL;
+		}
+		return End('}', aMap.mCount != 0);
+	}
+
+	ResultType WriteFields(Object &aObject)
+	// Writes the object's own value properties in name order.  Dynamic properties are skipped.
+	{
+		if (!Write('{'))
+			return FAIL;
+		bool first = true;
+		for (Object::index_t i = 0; i < aObject.mFields.Length(); ++i)
+		{
+			auto &field = aObject.mFields.Value()[i];
+			if (field.symbol == SYM_DYNAMIC || field.symbol == SYM_TYPED_FIELD)
+				continue;
+			if (!WriteMember(first, field.name, _tcslen(field.name)) || !WriteValue(field))
+				return FAIL;
+			first = false;
+		}
+		return End('}', !first);
+	}
+
+	ResultType End(TCHAR aBracket, bool aHasItems)
+	{
+		if (aHasItems)
+		{
+			--mDepth;
+			bool ok = NewLine();
+			++mDepth;
+			if (!ok)
+				return FAIL;
+		}
+		return Write(aBracket);
+	}
+
+	ResultType WriteObject(IObject *aObject)
+	{
+		auto obj = dynamic_cast<Object *>(aObject);
+		if (!obj) // Such as a ComObject.
+		{
+			ExprTokenType value(aObject);
+			return mResult.TypeError(_T("Object"), value);
+		}
+		if (++mDepth > JSON_MAX_DEPTH) // Most likely a circular reference.
+			return mResult.ValueError(ERR_JSON_TOO_DEEP);
+		ResultType result;
+		if (auto arr = dynamic_cast<Array *>(obj))
+			result = WriteArray(*arr);
+		else if (auto map = dynamic_cast<Map *>(obj))
+			result = WriteMap(*map);
+		else
+			result = WriteFields(*obj);
+		--mDepth;
+		return result;
+	}
+
+public:
+	static BIF_DECL(Parse);
+	static BIF_DECL(Stringify);
+};
+
+
+
+BIF_DECL(JSON::Parse)
+{
+	size_t length;
+	_f_param_string(text, 1, &length);
+	_f_param_string_opt(options, 2);
+
+	JSON json(aResultToken);
+	for (auto cp = options; *cp; ++cp)
+	{
+		switch (ctoupper(*cp))
+		{
+		case 'O': json.mObjectMode = true; break;
+		case ' ':
+		case '\t': break;
+		default: _f_throw_value(ERR_INVALID_OPTION, cp);
+		}
+	}
+
+	ExprTokenType value;
+	json.mPos = text;
+	json.SkipWhitespace();
+	if (!json.ParseValue(value))
+		return;
+	json.SkipWhitespace();
+	if (json.mPos != text + length)
+	{
+		if (value.symbol == SYM_OBJECT)
+			value.object->Release();
+		json.SyntaxError();
+		return;
+	}
+	switch (value.symbol)
+	{
+	case SYM_STRING: _f_return(value.marker, value.marker_length);
+	case SYM_INTEGER: _f_return(value.value_int64);
+	case SYM_FLOAT: _f_return(value.value_double);
+	case SYM_OBJECT: _f_return(value.object);
+	default: _f_return_empty; // null
+	}
+}
+
+
+
+BIF_DECL(JSON::Stringify)
+{
+	_f_param_string_opt(options, 2);
+
+	JSON json(aResultToken);
+	for (auto cp = options; *cp; ++cp)
+	{
+		switch (ctoupper(*cp))
+		{
+		case 'I': // Indent by N spaces (default 2) and put each item on its own line.
+		{
+			LPTSTR end;
+			auto n = _tcstol(cp + 1, &end, 10);
+			if (end == cp + 1)
+				n = 2;
+			else if (n < 0 || n > JSON_MAX_INDENT)
+				_f_throw_value(ERR_INVALID_OPTION, cp);
+			tmemset(json.mIndent, ' ', n);
+			json.mIndentLength = n;
+			cp = end - 1;
+			break;
+		}
+		case 'T': // Indent by tabs.
+			json.mIndent[0] = '\t';
+			json.mIndentLength = 1;
+			break;
+		case ' ':
+		case '\t': break;
+		default: _f_throw_value(ERR_INVALID_OPTION, cp);
+		}
+	}
+
+	if (!json.WriteValue(*aParam[1]) || !json.Write('\0'))
+		return;
+	aResultToken.AcceptMem(json.mBuf, json.mLength - 1);
+	json.mBuf = nullptr; // Ownership was transferred.
+}
+
+
+
+void DefineJSONClass()
+{
+	auto proto = Object::CreatePrototype(_T("JSON"), Object::sPrototype);
+	auto class_obj = Object::CreateClass(_T("JSON"), Object::sClass, proto, nullptr);
+	proto->Release(); // The class holds a reference.
+
+	auto func = new BuiltInFunc(_T("JSON.Parse"), &JSON::Parse, 2, 3); // Includes `this`.
+	class_obj->DefineMethod(_T("Parse"), func);
+	func->Release();
+	func = new BuiltInFunc(_T("JSON.Stringify"), &JSON::Stringify, 2, 3);
+	class_obj->DefineMethod(_T("Stringify"), func);
+	func->Release();
+}
@@ -17,11 +17,17 @@ GNU General Public License for more details.
 #include "stdafx.h" // pre-compiled headers
 #include "script.h"
 #include "script_func_impl.h"
+#include "PixelMatch.h"
+
+
+
+static int sPixelCacheTime = 0; // A_PixelCacheTime: How long a capture can be reused by implicit searches, in milliseconds.
+static ScreenCapture sCapture; // The capture used by PixelSearch, ImageSearch and PixelGetColor's Slow mode.
 
 
 
 LPCOLORREF getbits(HBITMAP ahImage, HDC hdc, LONG &aWidth, LONG &aHeight, bool &aIs16Bit, int aMinColorDepth = 8)
-// Helper function used by PixelSearch below.
+// Helper function used by ImageSearch below.
 // Returns an array of pixels to the caller, which it must free when done.  Returns NULL on failure,
 // in which case the contents of the output parameters is indeterminate.
 {
@@ -134,75 +140,39 @@ end:
 
 
 
-FResult PixelSearch(BOOL *aFound, ResultToken *aFoundX, ResultToken *aFoundY
-	, int aLeft, int aTop, int aRight, int aBottom, COLORREF aColorRGB
-	, int aVariation, LPTSTR aGetColor)
-// Author: The fast-mode PixelSearch was created by Aurelian Maga.
-{
-	// For maintainability, get RGB/BGR conversion out of the way early.
-	COLORREF aColorBGR = rgb_to_bgr(aColorRGB);
-
-	// Many of the following sections are similar to those in ImageSearch(), so they should be
-	// maintained together.
-
-	POINT origin = {0};
-	CoordToScreen(origin, COORD_MODE_PIXEL);
-	aLeft   += origin.x;
-	aTop    += origin.y;
-	aRight  += origin.x;
-	aBottom += origin.y;
-
-	bool right_to_left = aLeft > aRight;
-	bool bottom_to_top = aTop > aBottom;
 
-	int left = aLeft;
-	int top = aTop;
-	int right = aRight;
-	int bottom = aBottom;
-	if (right_to_left)
+void ScreenCapture::Free()
+{
+	if (mDC)
 	{
-		left = aRight;
-		right = aLeft;
+		if (mOrigBitmap)
+			SelectObject(mDC, mOrigBitmap);
+		DeleteDC(mDC);
+		mDC = NULL;
+		mOrigBitmap = NULL;
 	}
-	if (bottom_to_top)
+	if (mBitmap)
 	{
-		top = aBottom;
-		bottom = aTop;
+		DeleteObject(mBitmap); // This also frees mPixel.
+		mBitmap = NULL;
 	}
+	mPixel = nullptr;
+	mWidth = mHeight = 0;
+}
 
-	if (aVariation < 0)
-		aVariation = 0;
-	if (aVariation > 255)
-		aVariation = 255;
 
-	// Allow colors to vary within the spectrum of intensity, rather than having them
-	// wrap around (which doesn't seem to make much sense).  For example, if the user specified
-	// a variation of 5, but the red component of aColorBGR is only 0x01, we don't want red_low to go
-	// below zero, which would cause it to wrap around to a very intense red color:
-	COLORREF pixel; // Used much further down.
-	BYTE red, green, blue; // Used much further down.
-	BYTE search_red, search_green, search_blue;
-	BYTE red_low, green_low, blue_low, red_high, green_high, blue_high;
-	if (aVariation > 0)
+
+bool ScreenCapture::Capture(int aLeft, int aTop, int aWidth, int aHeight)
+// Copies the specified part of the screen.  The bitmap is reused if it is already the right size,
+// which is typical when the same region is searched repeatedly.  Returns false on failure, in which
+// case GetLastError() indicates the reason.
+{
+	if (aWidth < 1 || aHeight < 1)
 	{
-		search_red = GetRValue(aColorBGR);
-		search_green = GetGValue(aColorBGR);
-		search_blue = GetBValue(aColorBGR);
+		Free();
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return false;
 	}
-	//else leave uninitialized since they won't be used.
-
-	HDC hdc = GetDC(NULL);
-	if (!hdc)
-		return FR_E_WIN32;
-
-	bool found = false; // Must init here for use by "goto fast_end".
-
-	// From this point on, "goto fast_end" will assume hdc is non-NULL but that the below might still be NULL.
-	// Therefore, all of the following must be initialized so that the "fast_end" label can detect them:
-	HDC sdc = NULL;
-	HBITMAP hbitmap_screen = NULL;
-	LPCOLORREF screen_pixel = NULL;
-	HGDIOBJ sdc_orig_select = NULL;
 
 	// Some explanation for the method below is contained in this quote from the newsgroups:
 	// "you shouldn't really be getting the current bitmap from the GetDC DC. This might
@@ -210,148 +180,290 @@ FResult PixelSearch(BOOL *aFound, ResultToken *aFoundX, ResultToken *aFoundY
 	// a memory DC first of the correct size. Then BitBlt into it and then GetDIBits on
 	// that instead. This way, the provider of the DC (the video driver) can make sure that
 	// the correct pixels are copied across."
-
-	// Create an empty bitmap to hold all the pixels currently visible on the screen (within the search area):
-	int search_width = right - left + 1;
-	int search_height = bottom - top + 1;
-	if (   !(sdc = CreateCompatibleDC(hdc)) || !(hbitmap_screen = CreateCompatibleBitmap(hdc, search_width, search_height))   )
-		goto fast_end;
-
-	if (   !(sdc_orig_select = SelectObject(sdc, hbitmap_screen))   )
-		goto fast_end;
+	// A top-down 32-bit DIB section is used rather than a compatible bitmap so that BitBlt converts
+	// the pixels directly into the format searched, and no GetDIBits() call or copy is needed.
+	HDC hdc = GetDC(NULL);
+	if (!hdc)
+		return false;
+	bool success = false;
+	if (!mPixel || aWidth != mWidth || aHeight != mHeight)
+	{
+		Free();
+		BITMAPINFO bmi = {0};
+		bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+		bmi.bmiHeader.biWidth = aWidth;
+		bmi.bmiHeader.biHeight = -aHeight; // Negative for top-down.
+		bmi.bmiHeader.biPlanes = 1;
+		bmi.bmiHeader.biBitCount = 32;
+		bmi.bmiHeader.biCompression = BI_RGB;
+		if (   !(mDC = CreateCompatibleDC(hdc))
+			|| !(mBitmap = CreateDIBSection(mDC, &bmi, DIB_RGB_COLORS, (void **)&mPixel, NULL, 0))
+			|| !(mOrigBitmap = SelectObject(mDC, mBitmap))   )
+			goto end;
+		mWidth = aWidth;
+		mHeight = aHeight;
+	}
 
 	// Copy the pixels in the search-area of the screen into the DC to be searched:
-	if (   !(BitBlt(sdc, 0, 0, search_width, search_height, hdc, left, top, SRCCOPY))   )
-		goto fast_end;
-
-	LONG screen_width, screen_height;
-	bool screen_is_16bit;
-	if (   !(screen_pixel = getbits(hbitmap_screen, sdc, screen_width, screen_height, screen_is_16bit))   )
-		goto fast_end;
+	if (!BitBlt(mDC, 0, 0, aWidth, aHeight, hdc, aLeft, aTop, SRCCOPY))
+		goto end;
+	GdiFlush(); // Ensure the bits have been written before they are read.
 
-	// Concerning 0xF8F8F8F8: "On 16bit and 15 bit color the first 5 bits in each byte are valid
+	// Concerning 0xF8F8F8: "On 16bit and 15 bit color the first 5 bits in each byte are valid
 	// (in 16bit there is an extra bit but i forgot for which color). And this will explain the
 	// second problem [in the test script], since GetPixel even in 16bit will return some "valid"
 	// data in the last 3bits of each byte."
-	register int i;
-	LONG screen_pixel_count = screen_width * screen_height;
-	if (screen_is_16bit)
-		for (i = 0; i < screen_pixel_count; ++i)
-			screen_pixel[i] &= 0xF8F8F8F8;
+	// The highest order byte is also masked to zero since it is never compared.
+	mIs16Bit = GetDeviceCaps(hdc, BITSPIXEL) == 16;
+	if (mIs16Bit)
+		for (int i = 0, pixel_count = aWidth * aHeight; i < pixel_count; ++i)
+			mPixel[i] &= 0x00F8F8F8;
+
+	mLeft = aLeft;
+	mTop = aTop;
+	mTime = GetTickCount();
+	success = true;
 
-	if (aGetColor)
+end:
+	DWORD error = GetLastError();
+	ReleaseDC(NULL, hdc);
+	if (!success)
+		Free();
+	SetLastError(error);
+	return success;
+}
+
+
+
+bool ScreenCapture::Contains(int aLeft, int aTop, int aRight, int aBottom)
+{
+	return mPixel && aLeft <= aRight && aTop <= aBottom
+		&& aLeft >= mLeft && aTop >= mTop && aRight < mLeft + mWidth && aBottom < mTop + mHeight;
+}
+
+
+
+bool ScreenCapture::GetRegion(int aLeft, int aTop, int aRight, int aBottom, PixelRegion &aRegion)
+// Sets aRegion to the captured part of the given rectangle, which is in screen coordinates and
+// includes its right and bottom edges.  Returns false if no part of the rectangle was captured.
+{
+	if (!mPixel)
+		return false;
+	if (aLeft < mLeft)
+		aLeft = mLeft;
+	if (aTop < mTop)
+		aTop = mTop;
+	if (aRight >= mLeft + mWidth)
+		aRight = mLeft + mWidth - 1;
+	if (aBottom >= mTop + mHeight)
+		aBottom = mTop + mHeight - 1;
+	if (aLeft > aRight || aTop > aBottom)
+		return false;
+	aRegion.pixel = mPixel + (aTop - mTop) * mWidth + (aLeft - mLeft);
+	aRegion.width = aRight - aLeft + 1;
+	aRegion.height = aBottom - aTop + 1;
+	aRegion.stride = mWidth;
+	aRegion.left = aLeft;
+	aRegion.top = aTop;
+	aRegion.is_16bit = mIs16Bit;
+	return true;
+}
+
+
+
+static bool CaptureScreenRegion(int aLeft, int aTop, int aRight, int aBottom, PixelRegion &aRegion)
+// Captures the given rectangle of the screen, or reuses the previous capture if A_PixelCacheTime
+// permits it.  Returns false on failure, in which case GetLastError() indicates the reason.
+{
+	if (!(sPixelCacheTime && sCapture.Age() < (DWORD)sPixelCacheTime && sCapture.Contains(aLeft, aTop, aRight, aBottom)))
+		if (!sCapture.Capture(aLeft, aTop, aRight - aLeft + 1, aBottom - aTop + 1))
+			return false;
+	return sCapture.GetRegion(aLeft, aTop, aRight, aBottom, aRegion);
+}
+
+
+
+static void ReleaseScreenRegion()
+{
+	// Keep the bitmap only if A_PixelCacheTime permits it to be reused, since it can be large.
+	if (!sPixelCacheTime)
+		sCapture.Free();
+}
+
+
+
+bool GetCachedScreenPixel(int aX, int aY, COLORREF &aColorRGB)
+// Used by PixelGetColor to take advantage of A_PixelCacheTime.
+{
+	PixelRegion region;
+	if (!(sPixelCacheTime && sCapture.Age() < (DWORD)sPixelCacheTime && sCapture.GetRegion(aX, aY, aX, aY, region)))
+		return false;
+	aColorRGB = *region.pixel & 0x00FFFFFF;
+	return true;
+}
+
+
+
+// Collects the position of each match for PixelSearchAll and ImageSearchAll.
+struct FoundList
+{
+	Array *array = nullptr;
+	POINT origin = {0};
+	int max_count = 0; // Zero means no limit.
+	bool out_of_memory = false;
+
+	~FoundList()
 	{
-		COLORREF color = screen_pixel[0] & 0x00FFFFFF; // See other 0x00FFFFFF below for explanation.
-		// In this case, aFoundX is a pointer to PixelGetColor's aResultToken.
-		_stprintf(aGetColor, _T("0x%06X"), color);
+		if (array)
+			array->Release();
 	}
-	else if (aVariation < 1) // Caller wants an exact match on one particular color.
-	{
-		if (screen_is_16bit)
-			aColorRGB &= 0xF8F8F8F8;
 
-		for (int j = 0; j < screen_pixel_count; ++j)
-		{
-			if (right_to_left && bottom_to_top)
-				i = screen_pixel_count - j - 1;
-			else if (right_to_left)
-				i = j / screen_width * screen_width + screen_width - j % screen_width - 1;
-			else if (bottom_to_top)
-				i = (screen_pixel_count - j - 1) / screen_width * screen_width + j % screen_width;
-			else
-				i = j;
+	bool Add(PixelRegion &aRegion, int aIndex);
+};
 
-			// Note that screen pixels sometimes have a non-zero high-order byte.  That's why
-			// bit-and with 0x00FFFFFF is done.  Otherwise, reddish/orangish colors are not properly
-			// found:
-			if ((screen_pixel[i] & 0x00FFFFFF) == aColorRGB)
-			{
-				found = true;
-				break;
-			}
-		}
-	}
-	else
-	{
-		// It seems more appropriate to do the 16-bit conversion prior to SET_COLOR_RANGE,
-		// rather than applying 0xF8 to each of the high/low values individually.
-		if (screen_is_16bit)
-		{
-			search_red &= 0xF8;
-			search_green &= 0xF8;
-			search_blue &= 0xF8;
-		}
 
-#define SET_COLOR_RANGE \
-{\
-	red_low = (aVariation > search_red) ? 0 : search_red - aVariation;\
-	green_low = (aVariation > search_green) ? 0 : search_green - aVariation;\
-	blue_low = (aVariation > search_blue) ? 0 : search_blue - aVariation;\
-	red_high = (aVariation > 0xFF - search_red) ? 0xFF : search_red + aVariation;\
-	green_high = (aVariation > 0xFF - search_green) ? 0xFF : search_green + aVariation;\
-	blue_high = (aVariation > 0xFF - search_blue) ? 0xFF : search_blue + aVariation;\
+
+bool FoundList::Add(PixelRegion &aRegion, int aIndex)
+// Appends an object with X and Y properties for the match at aIndex.  Returns false if the search
+// should stop because max_count has been reached or there was insufficient memory.
+{
+	ExprTokenType argt[] = {
+		_T("X"), (__int64)((aRegion.left + aIndex % aRegion.stride) - origin.x),
+		_T("Y"), (__int64)((aRegion.top + aIndex / aRegion.stride) - origin.y) };
+	ExprTokenType *args[_countof(argt)] = { argt, argt+1, argt+2, argt+3 };
+	auto pos = Object::Create(args, _countof(args));
+	if (!pos || !array->Append(ExprTokenType(pos)))
+	{
+		if (pos)
+			pos->Release();
+		out_of_memory = true;
+		return false;
+	}
+	pos->Release(); // The array holds its own reference.
+	return !max_count || (int)array->Length() < max_count;
 }
-			
-		SET_COLOR_RANGE
 
-		for (int j = 0; j < screen_pixel_count; ++j)
+
+
+static int SearchPixel(PixelRegion &aRegion, COLORREF aColorRGB, int aVariation, bool aRightToLeft, bool aBottomToTop
+	, FoundList *aAll = nullptr)
+// Returns the index (y * stride + x) of the first pixel in aRegion which matches, searching in the
+// specified direction, or -1 if there is no match.  If aAll is non-null, each match is also added
+// to it in the order found, until it is full.
+{
+	// Colors are allowed to vary within the spectrum of intensity, rather than having them
+	// wrap around (which doesn't seem to make much sense).  For example, if the user specified
+	// a variation of 5, but the red component of aColorRGB is only 0x01, a red component of
+	// 0xFC on the screen is not considered a match.  FindPixel() takes care of this.
+	if (aVariation < 0)
+		aVariation = 0;
+	if (aVariation > 255)
+		aVariation = 255;
+
+	// It seems more appropriate to do the 16-bit conversion prior to applying the variation,
+	// rather than applying 0xF8 to the high/low range of each component individually.
+	// Note that screen pixels sometimes have a non-zero high-order byte.  That's why it is
+	// ignored by the comparison; otherwise, reddish/orangish colors are not properly found.
+	if (aRegion.is_16bit)
+		aColorRGB &= 0x00F8F8F8;
+
+	if (aRightToLeft == aBottomToTop && aRegion.stride == aRegion.width && !aAll) // Search the entire region as though it was one row.
+		return aRightToLeft ? FindPixelReverse(aRegion.pixel, aRegion.width * aRegion.height, aColorRGB, aVariation)
+			: FindPixel(aRegion.pixel, aRegion.width * aRegion.height, aColorRGB, aVariation);
+	int first = -1;
+	for (int row = 0; row < aRegion.height; ++row) // Search each row in the appropriate order.
+	{
+		int y = aBottomToTop ? aRegion.height - row - 1 : row;
+		LPCOLORREF row_pixel = aRegion.pixel + y * aRegion.stride;
+		// Search the part of the row not yet searched: [start, end).
+		for (int start = 0, end = aRegion.width; start < end; )
 		{
-			if (right_to_left && bottom_to_top)
-				i = screen_pixel_count - j - 1;
-			else if (right_to_left)
-				i = j / screen_width * screen_width + screen_width - j % screen_width - 1;
-			else if (bottom_to_top)
-				i = (screen_pixel_count - j - 1) / screen_width * screen_width + j % screen_width;
-			else
-				i = j;
-
-			// Note that screen pixels sometimes have a non-zero high-order byte.  But it doesn't
-			// matter with the below approach, since that byte is not checked in the comparison.
-			pixel = screen_pixel[i];
-			red = GetBValue(pixel);   // Because pixel is in RGB vs. BGR format, red is retrieved with
-			green = GetGValue(pixel); // GetBValue() and blue is retrieved with GetRValue().
-			blue = GetRValue(pixel);
-			if (red >= red_low && red <= red_high
-				&& green >= green_low && green <= green_high
-				&& blue >= blue_low && blue <= blue_high)
-			{
-				found = true;
+			int x = aRightToLeft ? FindPixelReverse(row_pixel, end, aColorRGB, aVariation)
+				: FindPixel(row_pixel + start, end - start, aColorRGB, aVariation);
+			if (x == -1)
 				break;
-			}
+			if (!aRightToLeft)
+				x += start;
+			int i = y * aRegion.stride + x;
+			if (!aAll)
+				return i;
+			if (first == -1)
+				first = i;
+			if (!aAll->Add(aRegion, i))
+				return first;
+			if (aRightToLeft)
+				end = x;
+			else
+				start = x + 1;
 		}
 	}
+	return first;
+}
 
-fast_end:
-	DWORD error = GetLastError(); // Might help to ensure the correct error number is thrown on failure.
-	ReleaseDC(NULL, hdc);
-	if (sdc)
-	{
-		if (sdc_orig_select) // i.e. the original call to SelectObject() didn't fail.
-			SelectObject(sdc, sdc_orig_select); // Probably necessary to prevent memory leak.
-		DeleteDC(sdc);
-	}
-	if (hbitmap_screen)
-		DeleteObject(hbitmap_screen);
-	if (screen_pixel)
-		free(screen_pixel);
-	else // One of the GDI calls failed and the search wasn't carried out.
-		return FR_E_WIN32(error);
 
-	if (aGetColor)
-		return OK; // Return value was already set.
 
-	// Otherwise, success.  Calculate xpos and ypos of where the match was found and adjust
-	// coords to make them relative to the position of the target window (rect will contain
-	// zeroes if this doesn't need to be done):
-	if (found)
+static void SetFoundPos(PixelRegion &aRegion, int aIndex, POINT &aOrigin, ResultToken *aFoundX, ResultToken *aFoundY)
+// Calculates the position of where the match was found and adjusts coords to make them relative
+// to the origin point (which will contain zeroes if this doesn't need to be done).
+{
+	if (aFoundX)
+		aFoundX->SetValue((aRegion.left + aIndex % aRegion.stride) - aOrigin.x);
+	if (aFoundY)
+		aFoundY->SetValue((aRegion.top + aIndex / aRegion.stride) - aOrigin.y);
+}
+
+
+
+static FResult PixelSearch(BOOL *aFound, ResultToken *aFoundX, ResultToken *aFoundY
+	, int aLeft, int aTop, int aRight, int aBottom, COLORREF aColorRGB
+	, int aVariation, LPTSTR aGetColor, FoundList *aAll)
+// Author: The fast-mode PixelSearch was created by Aurelian Maga.
+{
+	POINT origin = {0};
+	CoordToScreen(origin, COORD_MODE_PIXEL);
+	if (aAll)
+		aAll->origin = origin;
+	aLeft   += origin.x;
+	aTop    += origin.y;
+	aRight  += origin.x;
+	aBottom += origin.y;
+
+	bool right_to_left = aLeft > aRight;
+	bool bottom_to_top = aTop > aBottom;
+	if (right_to_left)
+		std::swap(aLeft, aRight);
+	if (bottom_to_top)
+		std::swap(aTop, aBottom);
+
+	PixelRegion region;
+	if (!CaptureScreenRegion(aLeft, aTop, aRight, aBottom, region))
+		return FR_E_WIN32(GetLastError());
+
+	if (aGetColor)
 	{
-		if (aFoundX)
-			aFoundX->SetValue((left + i%screen_width) - origin.x);
-		if (aFoundY)
-			aFoundY->SetValue((top + i/screen_width) - origin.y);
+		// In this case, aGetColor is PixelGetColor's buffer.
+		_stprintf(aGetColor, _T("0x%06X"), *region.pixel & 0x00FFFFFF); // See SearchPixel() for why the high byte is excluded.
+		ReleaseScreenRegion();
+		return OK;
 	}
-	*aFound = found;
-	return OK;
+
+	int i = SearchPixel(region, aColorRGB, aVariation, right_to_left, bottom_to_top, aAll);
+	if (i != -1)
+		SetFoundPos(region, i, origin, aFoundX, aFoundY);
+	ReleaseScreenRegion();
+	if (aFound)
+		*aFound = i != -1;
+	return aAll && aAll->out_of_memory ? FR_E_OUTOFMEM : OK;
+}
+
+
+
+FResult PixelSearch(BOOL *aFound, ResultToken *aFoundX, ResultToken *aFoundY
+	, int aLeft, int aTop, int aRight, int aBottom, COLORREF aColorRGB
+	, int aVariation, LPTSTR aGetColor)
+{
+	return PixelSearch(aFound, aFoundX, aFoundY, aLeft, aTop, aRight, aBottom, aColorRGB
+		, aVariation, aGetColor, nullptr);
 }
 
 
@@ -365,29 +477,69 @@ bif_impl FResult PixelSearch(BOOL &aFound, ResultToken *aFoundX, ResultToken *aF
 
 
 
-bif_impl FResult ImageSearch(ResultToken *aFoundX, ResultToken *aFoundY
-	, int aLeft, int aTop, int aRight, int aBottom, StrArg aImageFile
-	, BOOL &aRetVal)
-// Author: ImageSearch was created by Aurelian Maga.
+static FResult BeginFoundList(FoundList &aAll, optl<int> aMaxCount, int aMaxCountArg)
 {
-	// Many of the following sections are similar to those in PixelSearch(), so they should be
-	// maintained together.
+	if (aMaxCount.value_or(0) < 0)
+		return FR_E_ARG(aMaxCountArg);
+	aAll.max_count = aMaxCount.value_or(0);
+	return (aAll.array = Array::Create()) ? OK : FR_E_OUTOFMEM;
+}
 
-	// Set default results (output variables), in case of early return:
-	//aFoundX.SetValue(_T(""), 0);  // Init to empty string regardless of whether we succeed here.
-	//aFoundY.SetValue(_T(""), 0);  // Same.
 
-	POINT origin = {0};
-	CoordToScreen(origin, COORD_MODE_PIXEL);
-	aLeft   += origin.x;
-	aTop    += origin.y;
-	aRight  += origin.x;
-	aBottom += origin.y;
 
+static void EndFoundList(FoundList &aAll, IObject *&aRetVal)
+{
+	aRetVal = aAll.array;
+	aAll.array = nullptr; // Ownership was transferred to the caller.
+}
+
+
+
+bif_impl FResult PixelSearchAll(int aLeft, int aTop, int aRight, int aBottom, UINT aColor
+	, optl<int> aVariation, optl<int> aMaxCount, IObject *&aRetVal)
+// Returns an array of {X, Y} objects, one for each matching pixel, in the order PixelSearch
+// would find them.
+{
+	FoundList all;
+	auto fr = BeginFoundList(all, aMaxCount, 6);
+	if (fr == OK)
+		fr = PixelSearch(nullptr, nullptr, nullptr, aLeft, aTop, aRight, aBottom, aColor
+			, aVariation.value_or(0), nullptr, &all);
+	if (fr == OK)
+		EndFoundList(all, aRetVal);
+	return fr;
+}
+
+
+
+// An image to be searched for by ImageSearch.
+struct SearchImage
+{
+	LPCOLORREF image_pixel = nullptr, image_mask = nullptr;
+	LONG image_width = 0, image_height = 0;
+	bool image_is_16bit = false;
+	COLORREF trans_color = CLR_NONE; // The default must be a value that can't occur naturally in an image.
+	int variation = 0;
+
+	~SearchImage()
+	{
+		free(image_pixel);
+		free(image_mask);
+	}
+
+	FResult Load(StrArg aImageFile, int aArgIndex);
+	FResult Find(PixelRegion &aRegion, int &aIndex, FoundList *aAll = nullptr);
+};
+
+
+
+FResult SearchImage::Load(StrArg aImageFile, int aArgIndex)
+// Author: ImageSearch was created by Aurelian Maga.
+// Parses any options in aImageFile (the ImageSearch parameter), then loads the image.
+// aArgIndex is the index of that parameter, for error reporting.
+{
 	// Options are done as asterisk+option to permit future expansion.
 	// Set defaults to be possibly overridden by any specified options:
-	int aVariation = 0;  // This is named aVariation vs. variation for use with the SET_COLOR_RANGE macro.
-	COLORREF trans_color = CLR_NONE; // The default must be a value that can't occur naturally in an image.
 	int icon_number = 0; // Zero means "load icon or bitmap (doesn't matter)".
 	int width = 0, height = 0;
 	// For icons, override the default to be 16x16 because that is what is sought 99% of the time.
@@ -432,7 +584,7 @@ bif_impl FResult ImageSearch(ResultToken *aFoundX, ResultToken *aFoundY
 					// It seems _tcstol() automatically handles the optional leading "0x" if present:
 					trans_color = _tcstol(color_name, &endptr, 16);
 					if (*endptr) // Not (entirely) a valid hex number.
-						return FR_E_ARG(6);
+						return FR_E_ARG(aArgIndex);
 				}
 				else
 					trans_color = bgr_to_rgb(trans_color); // v1.0.44.10: See fix/comment above.
@@ -440,18 +592,18 @@ bif_impl FResult ImageSearch(ResultToken *aFoundX, ResultToken *aFoundY
 			}
 			else // Assume it's a number since that's the only other asterisk-option.
 			{
-				aVariation = ATOI(cp); // Seems okay to support hex via ATOI because the space after the number is documented as being mandatory.
-				if (aVariation < 0)
-					aVariation = 0;
-				if (aVariation > 255)
-					aVariation = 255;
+				variation = ATOI(cp); // Seems okay to support hex via ATOI because the space after the number is documented as being mandatory.
+				if (variation < 0)
+					variation = 0;
+				if (variation > 255)
+					variation = 255;
 				// Note: because it's possible for filenames to start with a space (even though Explorer itself
 				// won't let you create them that way), allow exactly one space between end of option and the
 				// filename itself:
 			}
 		} // switch()
 		if (   !(cp = StrChrAny(cp, _T(" \t")))   ) // Find the first space or tab after the option.
-			return FR_E_ARG(6); // Bad option/format.
+			return FR_E_ARG(aArgIndex); // Bad option/format.
 		// Now it's the space or tab (if there is one) after the option letter.  Advance by exactly one character
 		// because only one space or tab is considered the delimiter.  Any others are considered to be part of the
 		// filename (though some or all OSes might simply ignore them or tolerate them as first-try match criteria).
@@ -483,270 +635,332 @@ bif_impl FResult ImageSearch(ResultToken *aFoundX, ResultToken *aFoundY
 	// by the search.  In other words, nothing works.  Obsolete comment: Pass "true" so that an attempt
 	// will be made to load icons as bitmaps if GDIPlus is available.
 	if (!hbitmap_image)
-		return FR_E_ARG(6);
+		return FR_E_ARG(aArgIndex);
 
 	HDC hdc = GetDC(NULL);
-	if (!hdc)
+	DWORD error = 0;
+	if (hdc)
 	{
-		DWORD error = GetLastError();
-		if (!no_delete_bitmap)
+		if (image_type == IMAGE_ICON)
 		{
-			if (image_type == IMAGE_ICON)
-				DestroyIcon((HICON)hbitmap_image);
-			else
-				DeleteObject(hbitmap_image);
+			// Must be done prior to IconToBitmap() since it deletes (HICON)hbitmap_image:
+			ICONINFO ii;
+			if (GetIconInfo((HICON)hbitmap_image, &ii))
+			{
+				// If the icon is monochrome (black and white), ii.hbmMask will contain twice as many pixels as
+				// are actually in the icon.  But since the top half of the pixels are the AND-mask, it seems
+				// okay to get all the pixels given the rarity of monochrome icons.  This scenario should be
+				// handled properly because: 1) the variables image_height and image_width will be overridden
+				// further below with the correct icon dimensions; 2) Only the first half of the pixels within
+				// the image_mask array will actually be referenced by the transparency checker in the loops,
+				// and that first half is the AND-mask, which is the transparency part that is needed.  The
+				// second half, the XOR part, is not needed and thus ignored.  Also note that if width/height
+				// required the icon to be scaled, LoadPicture() has already done that directly to the icon,
+				// so ii.hbmMask should already be scaled to match the size of the bitmap created later below.
+				image_mask = getbits(ii.hbmMask, hdc, image_width, image_height, image_is_16bit, 1);
+				DeleteObject(ii.hbmColor); // DeleteObject() probably handles NULL okay since few MSDN/other examples ever check for NULL.
+				DeleteObject(ii.hbmMask);
+			}
+			hbitmap_image = IconToBitmap((HICON)hbitmap_image, true);
 		}
-		return FR_E_WIN32(error);
+		if (hbitmap_image)
+			image_pixel = getbits(hbitmap_image, hdc, image_width, image_height, image_is_16bit);
+		error = GetLastError();
+		ReleaseDC(NULL, hdc);
 	}
-
-	// From this point on, "goto end" will assume hdc and hbitmap_image are non-NULL, but that the below
-	// might still be NULL.  Therefore, all of the following must be initialized so that the "end"
-	// label can detect them:
-	HDC sdc = NULL;
-	HBITMAP hbitmap_screen = NULL;
-	LPCOLORREF image_pixel = NULL, screen_pixel = NULL, image_mask = NULL;
-	HGDIOBJ sdc_orig_select = NULL;
-	bool found = false; // Must init here for use by "goto end".
-    
-	bool image_is_16bit;
-	LONG image_width, image_height;
-
-	if (image_type == IMAGE_ICON)
+	else
 	{
-		// Must be done prior to IconToBitmap() since it deletes (HICON)hbitmap_image:
-		ICONINFO ii;
-		if (GetIconInfo((HICON)hbitmap_image, &ii))
+		error = GetLastError();
+		if (image_type == IMAGE_ICON && !no_delete_bitmap)
 		{
-			// If the icon is monochrome (black and white), ii.hbmMask will contain twice as many pixels as
-			// are actually in the icon.  But since the top half of the pixels are the AND-mask, it seems
-			// okay to get all the pixels given the rarity of monochrome icons.  This scenario should be
-			// handled properly because: 1) the variables image_height and image_width will be overridden
-			// further below with the correct icon dimensions; 2) Only the first half of the pixels within
-			// the image_mask array will actually be referenced by the transparency checker in the loops,
-			// and that first half is the AND-mask, which is the transparency part that is needed.  The
-			// second half, the XOR part, is not needed and thus ignored.  Also note that if width/height
-			// required the icon to be scaled, LoadPicture() has already done that directly to the icon,
-			// so ii.hbmMask should already be scaled to match the size of the bitmap created later below.
-			image_mask = getbits(ii.hbmMask, hdc, image_width, image_height, image_is_16bit, 1);
-			DeleteObject(ii.hbmColor); // DeleteObject() probably handles NULL okay since few MSDN/other examples ever check for NULL.
-			DeleteObject(ii.hbmMask);
+			DestroyIcon((HICON)hbitmap_image);
+			hbitmap_image = NULL;
 		}
-		if (   !(hbitmap_image = IconToBitmap((HICON)hbitmap_image, true))   )
-			goto end;
 	}
+	if (!no_delete_bitmap && hbitmap_image)
+		DeleteObject(hbitmap_image);
+	return image_pixel ? OK : FR_E_WIN32(error);
+}
 
-	if (   !(image_pixel = getbits(hbitmap_image, hdc, image_width, image_height, image_is_16bit))   )
-		goto end;
-
-	// Create an empty bitmap to hold all the pixels currently visible on the screen that lie within the search area:
-	int search_width = aRight - aLeft + 1;
-	int search_height = aBottom - aTop + 1;
-	if (   !(sdc = CreateCompatibleDC(hdc)) || !(hbitmap_screen = CreateCompatibleBitmap(hdc, search_width, search_height))   )
-		goto end;
-
-	if (   !(sdc_orig_select = SelectObject(sdc, hbitmap_screen))   )
-		goto end;
-
-	// Copy the pixels in the search-area of the screen into the DC to be searched:
-	if (   !(BitBlt(sdc, 0, 0, search_width, search_height, hdc, aLeft, aTop, SRCCOPY))   )
-		goto end;
-
-	LONG screen_width, screen_height;
-	bool screen_is_16bit;
-	if (   !(screen_pixel = getbits(hbitmap_screen, sdc, screen_width, screen_height, screen_is_16bit))   )
-		goto end;
 
-	LONG image_pixel_count = image_width * image_height;
-	LONG screen_pixel_count = screen_width * screen_height;
-	int i, j, k, x, y; // Declaring as "register" makes no performance difference with current compiler, so let the compiler choose which should be registers.
 
-	// If either is 16-bit, convert *both* to the 16-bit-compatible 32-bit format:
-	if (image_is_16bit || screen_is_16bit)
+FResult SearchImage::Find(PixelRegion &aRegion, int &aIndex, FoundList *aAll)
+// Sets aIndex to the index (y * stride + x) within aRegion of the first match, or -1 if none.
+// If aAll is non-null, each match is also added to it, until it is full.  Matches may overlap.
+{
+	LPCOLORREF screen_pixel = aRegion.pixel, screen_copy = nullptr;
+	int screen_stride = aRegion.stride;
+	int i;
+
+	// If either is 16-bit, convert *both* to the 16-bit-compatible 32-bit format.  Captures from a
+	// 16-bit screen have already been converted.  Otherwise, convert a copy since the capture may be
+	// reused by another search.
+	if (image_is_16bit || aRegion.is_16bit)
 	{
+		if (!aRegion.is_16bit)
+		{
+			if (   !(screen_copy = (LPCOLORREF)malloc(aRegion.width * aRegion.height * sizeof(COLORREF)))   )
+				return FR_E_OUTOFMEM;
+			for (int y = 0; y < aRegion.height; ++y)
+				for (int x = 0; x < aRegion.width; ++x)
+					screen_copy[y * aRegion.width + x] = aRegion.pixel[y * aRegion.stride + x] & 0x00F8F8F8;
+			screen_pixel = screen_copy;
+			screen_stride = aRegion.width;
+		}
 		if (trans_color != CLR_NONE)
 			trans_color &= 0x00F8F8F8; // Convert indicated trans-color to be compatible with the conversion below.
-		for (i = 0; i < screen_pixel_count; ++i)
-			screen_pixel[i] &= 0x00F8F8F8; // Highest order byte must be masked to zero for consistency with use of 0x00FFFFFF below.
-		for (i = 0; i < image_pixel_count; ++i)
-			image_pixel[i] &= 0x00F8F8F8;  // Same.
+		for (i = 0; i < image_width * image_height; ++i)
+			image_pixel[i] &= 0x00F8F8F8; // Highest order byte must be masked to zero for consistency with the screen.
 	}
 
-	// v1.0.44.03: The below is now done even for variation>0 mode so its results are consistent with those of
-	// non-variation mode.  This is relied upon by variation=0 mode but now also by the following line in the
-	// variation>0 section:
-	//     || image_pixel[j] == trans_color
-	// Without this change, there are cases where variation=0 would find a match but a higher variation
-	// (for the same search) wouldn't. 
-	for (i = 0; i < image_pixel_count; ++i)
-		image_pixel[i] &= 0x00FFFFFF;
-
-	// Search the specified region for the first occurrence of the image:
-	if (aVariation < 1) // Caller wants an exact match.
-	{
-		// Concerning the following use of 0x00FFFFFF, the use of 0x00F8F8F8 above is related (both have high order byte 00).
-		// The following needs to be done only when shades-of-variation mode isn't in effect because
-		// shades-of-variation mode ignores the high-order byte due to its use of macros such as GetRValue().
-		// This transformation incurs about a 15% performance decrease (percentage is fairly constant since
-		// it is proportional to the search-region size, which tends to be much larger than the search-image and
-		// is therefore the primary determination of how long the loops take). But it definitely helps find images
-		// more successfully in some cases.  For example, if a PNG file is displayed in a GUI window, this
-		// transformation allows certain bitmap search-images to be found via variation==0 when they otherwise
-		// would require variation==1 (possibly the variation==1 success is just a side-effect of it
-		// ignoring the high-order byte -- maybe a much higher variation would be needed if the high
-		// order byte were also subject to the same shades-of-variation analysis as the other three bytes [RGB]).
-		for (i = 0; i < screen_pixel_count; ++i)
-			screen_pixel[i] &= 0x00FFFFFF;
-
-		for (i = 0; i < screen_pixel_count; ++i)
-		{
-			// Unlike the variation-loop, the following one uses a first-pixel optimization to boost performance
-			// by about 10% because it's only 3 extra comparisons and exact-match mode is probably used more often.
-			// Before even checking whether the other adjacent pixels in the region match the image, ensure
-			// the image does not extend past the right or bottom edges of the current part of the search region.
-			// This is done for performance but more importantly to prevent partial matches at the edges of the
-			// search region from being considered complete matches.
-			// The following check is ordered for short-circuit performance.  In addition, image_mask, if
-			// non-NULL, is used to determine which pixels are transparent within the image and thus should
-			// match any color on the screen.
-			if ((screen_pixel[i] == image_pixel[0] // A screen pixel has been found that matches the image's first pixel.
-				|| image_mask && image_mask[0]     // Or: It's an icon's transparent pixel, which matches any color.
-				|| image_pixel[0] == trans_color)  // This should be okay even if trans_color==CLR_NONE, since CLR_NONE should never occur naturally in the image.
-				&& image_height <= screen_height - i/screen_width // Image is short enough to fit in the remaining rows of the search region.
-				&& image_width <= screen_width - i%screen_width)  // Image is narrow enough not to exceed the right-side boundary of the search region.
-			{
-				// Check if this candidate region -- which is a subset of the search region whose height and width
-				// matches that of the image -- is a pixel-for-pixel match of the image.
-				for (found = true, x = 0, y = 0, j = 0, k = i; j < image_pixel_count; ++j)
-				{
-					if (!(found = (screen_pixel[k] == image_pixel[j] // At least one pixel doesn't match, so this candidate is discarded.
-						|| image_mask && image_mask[j]      // Or: It's an icon's transparent pixel, which matches any color.
-						|| image_pixel[j] == trans_color))) // This should be okay even if trans_color==CLR_NONE, since CLR none should never occur naturally in the image.
-						break;
-					if (++x < image_width) // We're still within the same row of the image, so just move on to the next screen pixel.
-						++k;
-					else // We're starting a new row of the image.
-					{
-						x = 0; // Return to the leftmost column of the image.
-						++y;   // Move one row downward in the image.
-						// Move to the next row within the current-candidate region (not the entire search region).
-						// This is done by moving vertically downward from "i" (which is the upper-left pixel of the
-						// current-candidate region) by "y" rows.
-						k = i + y*screen_width; // Verified correct.
-					}
-				}
-				if (found) // Complete match found.
-					break;
-			}
-		}
-	}
-	else // Allow colors to vary by aVariation shades; i.e. approximate match is okay.
+	// The high-order byte of each pixel is ignored by the comparison.  This definitely helps find images
+	// more successfully in some cases.  For example, if a PNG file is displayed in a GUI window, this
+	// allows certain bitmap search-images to be found via variation==0 when they otherwise would require
+	// variation==1.  The pattern also applies this to trans_color comparisons, for consistency between
+	// variation==0 and higher variations (otherwise there are cases where variation=0 would find a match
+	// but a higher variation for the same search wouldn't).
+	// The mask, if non-NULL, is used to determine which pixels are transparent within the image and
+	// thus should match any color on the screen.  trans_color is okay to pass even if it is CLR_NONE,
+	// since CLR_NONE should never occur naturally in the image.
+	PixelPattern pattern;
+	if (!pattern.Init(image_pixel, image_mask, image_width, image_height, trans_color, variation))
 	{
-		// The following section is part of the first-pixel-check optimization that improves performance by
-		// 15% or more depending on where and whether a match is found.  This section and one the follows
-		// later is commented out to reduce code size.
-		// Set high/low range for the first pixel of the image since it is the pixel most often checked
-		// (i.e. for performance).
-		//BYTE search_red1 = GetBValue(image_pixel[0]);  // Because it's RGB vs. BGR, the B value is fetched, not R (though it doesn't matter as long as everything is internally consistent here).
-		//BYTE search_green1 = GetGValue(image_pixel[0]);
-		//BYTE search_blue1 = GetRValue(image_pixel[0]); // Same comment as above.
-		//BYTE red_low1 = (aVariation > search_red1) ? 0 : search_red1 - aVariation;
-		//BYTE green_low1 = (aVariation > search_green1) ? 0 : search_green1 - aVariation;
-		//BYTE blue_low1 = (aVariation > search_blue1) ? 0 : search_blue1 - aVariation;
-		//BYTE red_high1 = (aVariation > 0xFF - search_red1) ? 0xFF : search_red1 + aVariation;
-		//BYTE green_high1 = (aVariation > 0xFF - search_green1) ? 0xFF : search_green1 + aVariation;
-		//BYTE blue_high1 = (aVariation > 0xFF - search_blue1) ? 0xFF : search_blue1 + aVariation;
-		// Above relies on the fact that the 16-bit conversion higher above was already done because like
-		// in PixelSearch, it seems more appropriate to do the 16-bit conversion prior to setting the range
-		// of high and low colors (vs. than applying 0xF8 to each of the high/low values individually).
-
-		BYTE red, green, blue;
-		BYTE search_red, search_green, search_blue;
-		BYTE red_low, green_low, blue_low, red_high, green_high, blue_high;
-
-		// The following loop is very similar to its counterpart above that finds an exact match, so maintain
-		// them together and see above for more detailed comments about it.
-		for (i = 0; i < screen_pixel_count; ++i)
-		{
-			// The following is commented out to trade code size reduction for performance (see comment above).
-			//red = GetBValue(screen_pixel[i]);   // Because it's RGB vs. BGR, the B value is fetched, not R (though it doesn't matter as long as everything is internally consistent here).
-			//green = GetGValue(screen_pixel[i]);
-			//blue = GetRValue(screen_pixel[i]);
-			//if ((red >= red_low1 && red <= red_high1
-			//	&& green >= green_low1 && green <= green_high1
-			//	&& blue >= blue_low1 && blue <= blue_high1 // All three color components are a match, so this screen pixel matches the image's first pixel.
-			//		|| image_mask && image_mask[0]         // Or: It's an icon's transparent pixel, which matches any color.
-			//		|| image_pixel[0] == trans_color)      // This should be okay even if trans_color==CLR_NONE, since CLR none should never occur naturally in the image.
-			//	&& image_height <= screen_height - i/screen_width // Image is short enough to fit in the remaining rows of the search region.
-			//	&& image_width <= screen_width - i%screen_width)  // Image is narrow enough not to exceed the right-side boundary of the search region.
-			
-			// Instead of the above, only this abbreviated check is done:
-			if (image_height <= screen_height - i/screen_width    // Image is short enough to fit in the remaining rows of the search region.
-				&& image_width <= screen_width - i%screen_width)  // Image is narrow enough not to exceed the right-side boundary of the search region.
-			{
-				// Since the first pixel is a match, check the other pixels.
-				for (found = true, x = 0, y = 0, j = 0, k = i; j < image_pixel_count; ++j)
-				{
-   					search_red = GetBValue(image_pixel[j]);
-	   				search_green = GetGValue(image_pixel[j]);
-		   			search_blue = GetRValue(image_pixel[j]);
-					SET_COLOR_RANGE
-   					red = GetBValue(screen_pixel[k]);
-	   				green = GetGValue(screen_pixel[k]);
-		   			blue = GetRValue(screen_pixel[k]);
-
-					if (!(found = red >= red_low && red <= red_high
-						&& green >= green_low && green <= green_high
-                        && blue >= blue_low && blue <= blue_high
-							|| image_mask && image_mask[j]     // Or: It's an icon's transparent pixel, which matches any color.
-							|| image_pixel[j] == trans_color)) // This should be okay even if trans_color==CLR_NONE, since CLR_NONE should never occur naturally in the image.
-						break; // At least one pixel doesn't match, so this candidate is discarded.
-					if (++x < image_width) // We're still within the same row of the image, so just move on to the next screen pixel.
-						++k;
-					else // We're starting a new row of the image.
-					{
-						x = 0; // Return to the leftmost column of the image.
-						++y;   // Move one row downward in the image.
-						k = i + y*screen_width; // Verified correct.
-					}
-				}
-				if (found) // Complete match found.
-					break;
-			}
-		}
+		free(screen_copy);
+		return FR_E_OUTOFMEM;
 	}
 
-end:
-	DWORD error = GetLastError();
-	ReleaseDC(NULL, hdc);
-	if (!no_delete_bitmap && hbitmap_image)
-		DeleteObject(hbitmap_image);
-	if (sdc)
+	// Search the region for the first occurrence of the image.  Positions where the image would
+	// extend past the right or bottom edges of the region aren't considered, to prevent partial
+	// matches at the edges from being considered complete matches.
+	aIndex = -1;
+	for (int start = 0; (i = pattern.FindIn(screen_pixel, aRegion.width, aRegion.height, screen_stride, start)) != -1; start = i + 1)
 	{
-		if (sdc_orig_select) // i.e. the original call to SelectObject() didn't fail.
-			SelectObject(sdc, sdc_orig_select); // Probably necessary to prevent memory leak.
-		DeleteDC(sdc);
+		int region_index = screen_copy ? i / screen_stride * aRegion.stride + i % screen_stride // Convert to an index within aRegion.
+			: i;
+		if (aIndex == -1)
+			aIndex = region_index;
+		if (!aAll || !aAll->Add(aRegion, region_index))
+			break;
 	}
-	if (hbitmap_screen)
-		DeleteObject(hbitmap_screen);
-	if (image_pixel)
-		free(image_pixel);
-	if (image_mask)
-		free(image_mask);
-	if (screen_pixel)
-		free(screen_pixel);
-	else // One of the GDI calls failed.
-		return FR_E_WIN32(error);
+	free(screen_copy);
+	return aAll && aAll->out_of_memory ? FR_E_OUTOFMEM : OK;
+}
 
-	if (found)
-	{
-		// Calculate xpos and ypos of where the match was found and adjust coords to
-		// make them relative to the origin point (which will contain zeroes if this
-		// doesn't need to be done):
-		if (aFoundX)
-			aFoundX->SetValue((aLeft + i%screen_width) - origin.x);
-		if (aFoundY)
-			aFoundY->SetValue((aTop + i/screen_width) - origin.y);
-	}
-	aRetVal = found;
+
+
+static FResult ImageSearch(ResultToken *aFoundX, ResultToken *aFoundY
+	, int aLeft, int aTop, int aRight, int aBottom, StrArg aImageFile
+	, BOOL *aFound, FoundList *aAll)
+{
+	POINT origin = {0};
+	CoordToScreen(origin, COORD_MODE_PIXEL);
+	if (aAll)
+		aAll->origin = origin;
+	aLeft   += origin.x;
+	aTop    += origin.y;
+	aRight  += origin.x;
+	aBottom += origin.y;
+
+	SearchImage image;
+	auto fr = image.Load(aImageFile, aAll ? 4 : 6); // ImageSearchAll has no OutputVar parameters.
+	if (fr != OK)
+		return fr;
+
+	PixelRegion region;
+	if (!CaptureScreenRegion(aLeft, aTop, aRight, aBottom, region))
+		return FR_E_WIN32(GetLastError());
+	int i;
+	fr = image.Find(region, i, aAll);
+	if (fr == OK && i != -1)
+		SetFoundPos(region, i, origin, aFoundX, aFoundY);
+	ReleaseScreenRegion();
+	if (aFound)
+		*aFound = i != -1;
+	return fr;
+}
+
+
+
+bif_impl FResult ImageSearch(ResultToken *aFoundX, ResultToken *aFoundY
+	, int aLeft, int aTop, int aRight, int aBottom, StrArg aImageFile
+	, BOOL &aRetVal)
+{
+	return ImageSearch(aFoundX, aFoundY, aLeft, aTop, aRight, aBottom, aImageFile, &aRetVal, nullptr);
+}
+
+
+
+bif_impl FResult ImageSearchAll(int aLeft, int aTop, int aRight, int aBottom, StrArg aImageFile
+	, optl<int> aMaxCount, IObject *&aRetVal)
+// Returns an array of {X, Y} objects, one for each position where the image was found, in
+// left-to-right, top-to-bottom order.
+{
+	FoundList all;
+	auto fr = BeginFoundList(all, aMaxCount, 5);
+	if (fr == OK)
+		fr = ImageSearch(nullptr, nullptr, aLeft, aTop, aRight, aBottom, aImageFile, nullptr, &all);
+	if (fr == OK)
+		EndFoundList(all, aRetVal);
+	return fr;
+}
+
+
+
+BIV_DECL_R(BIV_PixelCacheTime)
+{
+	_f_return_i(sPixelCacheTime);
+}
+
+BIV_DECL_W(BIV_PixelCacheTime_Set)
+{
+	Throw_if_RValue_NaN();
+	__int64 value = BivRValueToInt64();
+	if (value < 0 || value > INT_MAX)
+		_f_throw_value(ERR_INVALID_VALUE);
+	sPixelCacheTime = (int)value;
+	if (!sPixelCacheTime)
+		sCapture.Free(); // Caching was disabled, so the last capture won't be reused.
+}
+
+
+
+//
+// ScreenSnapshot: A capture of part of the screen, which can be searched any number of times.
+//
+
+ObjectMemberMd ScreenSnapshot::sMembers[] =
+{
+	md_member(ScreenSnapshot, __New, CALL, (In, Int32, X1), (In, Int32, Y1), (In, Int32, X2), (In, Int32, Y2)),
+	md_member(ScreenSnapshot, ImageSearch, CALL, (Out_Opt, Variant, X), (Out_Opt, Variant, Y)
+		, (In, Int32, X1), (In, Int32, Y1), (In, Int32, X2), (In, Int32, Y2), (In, String, Image), (Ret, Bool32, Found)),
+	md_member(ScreenSnapshot, ImageSearchAll, CALL, (In, Int32, X1), (In, Int32, Y1), (In, Int32, X2), (In, Int32, Y2)
+		, (In, String, Image), (In_Opt, Int32, MaxCount), (Ret, Object, RetVal)),
+	md_member(ScreenSnapshot, PixelGetColor, CALL, (In, Int32, X), (In, Int32, Y), (Ret, String, Color)),
+	md_member(ScreenSnapshot, PixelSearch, CALL, (Out_Opt, Variant, X), (Out_Opt, Variant, Y)
+		, (In, Int32, X1), (In, Int32, Y1), (In, Int32, X2), (In, Int32, Y2), (In, UInt32, Color), (In_Opt, Int32, Variation), (Ret, Bool32, Found)),
+	md_member(ScreenSnapshot, PixelSearchAll, CALL, (In, Int32, X1), (In, Int32, Y1), (In, Int32, X2), (In, Int32, Y2)
+		, (In, UInt32, Color), (In_Opt, Int32, Variation), (In_Opt, Int32, MaxCount), (Ret, Object, RetVal)),
+	md_member(ScreenSnapshot, Update, CALL, md_arg_none)
+};
+int ScreenSnapshot::sMemberCount = _countof(sMembers);
+
+Object *ScreenSnapshot::sPrototype;
+
+
+FResult ScreenSnapshot::__New(int aX1, int aY1, int aX2, int aY2)
+{
+	// Use the same coordinates as PixelSearch and ImageSearch.
+	CoordToScreen(aX1, aY1, COORD_MODE_PIXEL);
+	CoordToScreen(aX2, aY2, COORD_MODE_PIXEL);
+	if (aX1 > aX2)
+		std::swap(aX1, aX2);
+	if (aY1 > aY2)
+		std::swap(aY1, aY2);
+	return mCapture.Capture(aX1, aY1, aX2 - aX1 + 1, aY2 - aY1 + 1) ? OK : FR_E_WIN32(GetLastError());
+}
+
+
+FResult ScreenSnapshot::Update()
+{
+	return mCapture.Recapture() ? OK : FR_E_WIN32(GetLastError());
+}
+
+
+FResult ScreenSnapshot::PixelGetColor(int aX, int aY, StrRet &aRetVal)
+{
+	CoordToScreen(aX, aY, COORD_MODE_PIXEL);
+	PixelRegion region;
+	if (!mCapture.GetRegion(aX, aY, aX, aY, region))
+		return FR_E_ARG(0); // The point is outside the snapshot.
+	LPTSTR buf = aRetVal.CallerBuf();
+	aRetVal.SetTemp(buf, _stprintf(buf, _T("0x%06X"), *region.pixel & 0x00FFFFFF));
+	return OK;
+}
+
+
+FResult ScreenSnapshot::PixelSearch(ResultToken *aFoundX, ResultToken *aFoundY
+	, int aX1, int aY1, int aX2, int aY2, UINT aColor, optl<int> aVariation, BOOL &aRetVal)
+// Searches the part of the snapshot which is within the given rectangle.  The search direction
+// is determined the same way as for PixelSearch.
+{
+	POINT origin = {0};
+	CoordToScreen(origin, COORD_MODE_PIXEL);
+	bool right_to_left = aX1 > aX2, bottom_to_top = aY1 > aY2;
+	if (right_to_left)
+		std::swap(aX1, aX2);
+	if (bottom_to_top)
+		std::swap(aY1, aY2);
+	PixelRegion region;
+	int i = -1;
+	if (mCapture.GetRegion(aX1 + origin.x, aY1 + origin.y, aX2 + origin.x, aY2 + origin.y, region))
+		i = SearchPixel(region, aColor, aVariation.value_or(0), right_to_left, bottom_to_top);
+	if (i != -1)
+		SetFoundPos(region, i, origin, aFoundX, aFoundY);
+	aRetVal = i != -1;
 	return OK;
 }
+
+
+FResult ScreenSnapshot::ImageSearch(ResultToken *aFoundX, ResultToken *aFoundY
+	, int aX1, int aY1, int aX2, int aY2, StrArg aImageFile, BOOL &aRetVal)
+{
+	POINT origin = {0};
+	CoordToScreen(origin, COORD_MODE_PIXEL);
+	SearchImage image;
+	auto fr = image.Load(aImageFile, 6);
+	if (fr != OK)
+		return fr;
+	PixelRegion region;
+	int i = -1;
+	if (mCapture.GetRegion(aX1 + origin.x, aY1 + origin.y, aX2 + origin.x, aY2 + origin.y, region))
+		fr = image.Find(region, i);
+	if (fr == OK && i != -1)
+		SetFoundPos(region, i, origin, aFoundX, aFoundY);
+	aRetVal = i != -1;
+	return fr;
+}
+
+
+FResult ScreenSnapshot::PixelSearchAll(int aX1, int aY1, int aX2, int aY2, UINT aColor
+	, optl<int> aVariation, optl<int> aMaxCount, IObject *&aRetVal)
+{
+	FoundList all;
+	auto fr = BeginFoundList(all, aMaxCount, 6);
+	if (fr != OK)
+		return fr;
+	CoordToScreen(all.origin, COORD_MODE_PIXEL);
+	bool right_to_left = aX1 > aX2, bottom_to_top = aY1 > aY2;
+	if (right_to_left)
+		std::swap(aX1, aX2);
+	if (bottom_to_top)
+		std::swap(aY1, aY2);
+	PixelRegion region;
+	if (mCapture.GetRegion(aX1 + all.origin.x, aY1 + all.origin.y, aX2 + all.origin.x, aY2 + all.origin.y, region))
+		SearchPixel(region, aColor, aVariation.value_or(0), right_to_left, bottom_to_top, &all);
+	if (all.out_of_memory)
+		return FR_E_OUTOFMEM;
+	EndFoundList(all, aRetVal);
+	return OK;
+}
+
+
+FResult ScreenSnapshot::ImageSearchAll(int aX1, int aY1, int aX2, int aY2, StrArg aImageFile
+	, optl<int> aMaxCount, IObject *&aRetVal)
+{
+	FoundList all;
+	auto fr = BeginFoundList(all, aMaxCount, 5);
+	if (fr != OK)
+		return fr;
+	CoordToScreen(all.origin, COORD_MODE_PIXEL);
+	SearchImage image;
+	fr = image.Load(aImageFile, 4);
+	if (fr != OK)
+		return fr;
+	PixelRegion region;
+	int i;
+	if (mCapture.GetRegion(aX1 + all.origin.x, aY1 + all.origin.y, aX2 + all.origin.x, aY2 + all.origin.y, region))
+		fr = image.Find(region, i, &all);
+	if (fr == OK)
+		EndFoundList(all, aRetVal);
+	return fr;
+}
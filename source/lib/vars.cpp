@@ -138,7 +138,16 @@ bif_impl FResult SetControlDelay(int aDelay, int &aRetVal)
 
 BIV_DECL_R(BIV_Clipboard)
 {
-	auto length = g_clip.Get();
+	LPCTSTR cached;
+	size_t length;
+	if (g_clip.GetCache(cached, length))
+	{
+		if (TokenSetResult(aResultToken, cached, length))
+			aResultToken.symbol = SYM_STRING;
+		return;
+	}
+	DWORD sequence = GetClipboardSequenceNumber(); // Must be done before retrieving the contents.
+	length = g_clip.Get();
 	if (length == CLIPBOARD_FAILURE)
 		_f_return_FAIL;
 	if (TokenSetResult(aResultToken, nullptr, length))
@@ -146,6 +155,8 @@ BIV_DECL_R(BIV_Clipboard)
 		aResultToken.marker_length = g_clip.Get(aResultToken.marker);
 		if (aResultToken.marker_length == CLIPBOARD_FAILURE)
 			aResultToken.SetExitResult(FAIL);
+		else
+			g_clip.SetCache(sequence, aResultToken.marker, aResultToken.marker_length);
 		aResultToken.symbol = SYM_STRING;
 	}
 	g_clip.Close();
@@ -157,6 +168,10 @@ BIV_DECL_W(BIV_Clipboard_Set)
 	{
 		if (ClipboardAll *cba = dynamic_cast<ClipboardAll *>(obj))
 		{
+			if (cba->IsCurrent())
+				return; // A lazy snapshot of contents which are still on the clipboard.
+			if (!cba->Materialize())
+				_f_return_FAIL;
 			if (!Var::SetClipboardAll(cba->Data(), cba->Size()))
 				_f_return_FAIL;
 			return;
@@ -848,6 +863,11 @@ BIV_DECL_R(BIV_TickCount)
 	_f_return(GetTickCount64());
 }
 
+BIV_DECL_R(BIV_TickCountPrecise)
+{
+	_f_return(GetTickCountPrecise());
+}
+
 
 
 BIV_DECL_R(BIV_Now)
@@ -0,0 +1,836 @@
+﻿/*
+AutoHotkey
+
+Copyright 2003-2009 Chris Mallett (support@autohotkey.com)
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "stdafx.h"
+#include "script.h"
+#include "globaldata.h"
+#include "application.h"
+#include "script_func_impl.h"
+#include "abi.h"
+#include "MsgRing.h"
+#include <typeinfo>
+
+
+// Each direction of a channel has its own ring in a shared file mapping.  Larger messages
+// are passed in fragments, so this only limits how far the writer can get ahead.
+#define WORKER_RING_CAPACITY (1 << 20)
+#define WORKER_RING_STRIDE ((MsgRing::SizeFor(WORKER_RING_CAPACITY) + 0xFFFF) & ~(size_t)0xFFFF)
+#define WORKER_MAX_DEPTH 1000
+
+
+// Worker: A child process running another script, which exchanges messages with this one.
+// The messages are copies of strings, numbers, Arrays, Maps and Objects, so the two scripts
+// can run in parallel without sharing any state.  Worker.Parent is the other end of the
+// channel, for the child script.
+class Worker : public Object, public WorkerEventSource
+{
+	typedef Object::Variant Variant;
+
+	// Holds a decoded string until it has been copied into its container.
+	struct TextBuf
+	{
+		LPTSTR mText = nullptr;
+		size_t mSize = 0;
+		~TextBuf() { free(mText); }
+		LPTSTR Reserve(size_t aLength);
+	};
+
+	HANDLE mMapping = NULL;
+	LPVOID mView = nullptr;
+	MsgRing mSend, mReceive;
+	HANDLE mSendEvent = NULL, mReceiveEvent = NULL; // Wake the reader of the respective ring.
+	HANDLE mPeer = NULL; // The process at the other end of the channel.
+	HANDLE mDataWait = NULL, mExitWait = NULL;
+	DWORD mPid = 0;
+	IObject *mOnMessage = nullptr;
+	MsgBuffer mMessage; // The message being received, which might be incomplete.
+	MsgBuffer mOutbox; // Messages which didn't fit in the ring, each preceded by its size.
+	size_t mOutboxPos = 0; // Offset of the size of the first message in mOutbox.
+	size_t mOutboxWritten = 0; // Bytes of the first message which have been written to the ring.
+	std::atomic<bool> mPeerExited {false};
+	bool mConnected = false;
+
+	static Worker *sParent;
+	static HANDLE sJob;
+
+	Worker() { SetBase(sPrototype); }
+	~Worker();
+
+	bool CreateChannel();
+	bool OpenChannel(LPCTSTR aChannel);
+	bool MapChannel(bool aCreate);
+	void Connect();
+	void Disconnect();
+	void WakePeer() { if (mSend.TakeWakeRequest()) SetEvent(mSendEvent); }
+	bool Receive();
+	bool Flush();
+	static VOID CALLBACK DataReady(PVOID aParam, BOOLEAN aTimedOut);
+	static VOID CALLBACK PeerExited(PVOID aParam, BOOLEAN aTimedOut);
+
+	static FResult EncodeValue(MsgBuffer &aMsg, ExprTokenType &aValue, int aDepth);
+	static FResult EncodeValue(MsgBuffer &aMsg, Variant &aValue, int aDepth);
+	static FResult EncodeString(MsgBuffer &aMsg, LPCTSTR aText, size_t aLength);
+	static FResult EncodeObject(MsgBuffer &aMsg, IObject *aObject, int aDepth);
+	static bool DecodeValue(MsgReader &aReader, ExprTokenType &aValue, TextBuf &aKeyBuf, TextBuf &aValueBuf, int aDepth);
+	static bool DecodeString(MsgReader &aReader, TextBuf &aBuf, LPTSTR &aText, size_t &aLength);
+
+public:
+	static ObjectMemberMd sMembers[];
+	static Object *sPrototype;
+
+	static Object *Create() { return new Worker(); }
+	static BIF_DECL(GetParent);
+
+	FResult __New(StrArg aScript, optl<IObject*> aOnMessage, optl<BOOL> aIsCode);
+	FResult Post(ExprTokenType &aValue);
+	FResult Terminate(optl<int> aExitCode);
+	FResult get_OnMessage(IObject *&aRetVal);
+	FResult set_OnMessage(ExprTokenType &aValue);
+	FResult get_Pid(UINT &aRetVal) { aRetVal = mPid; return OK; }
+	FResult get_IsRunning(BOOL &aRetVal) { aRetVal = mConnected; return OK; }
+
+	void OnEvents(UINT aEvents) override;
+
+	friend void ::DefineWorkerClass();
+};
+
+
+ObjectMemberMd Worker::sMembers[] =
+{
+	md_member(Worker, __New, CALL, (In, String, Script), (In_Opt, Object, OnMessage), (In_Opt, Bool32, IsCode)),
+	md_member(Worker, Post, CALL, (In, Variant, Value)),
+	md_member(Worker, Terminate, CALL, (In_Opt, Int32, ExitCode)),
+	md_property_get(Worker, IsRunning, Bool32),
+	md_property_get(Worker, OnMessage, Object),
+	md_property_set(Worker, OnMessage, Variant),
+	md_property_get(Worker, Pid, UInt32)
+};
+
+Object *Worker::sPrototype;
+Worker *Worker::sParent;
+HANDLE Worker::sJob;
+
+
+void DefineWorkerClass()
+{
+	Worker::sPrototype = Object::CreatePrototype(_T("Worker"), Object::sPrototype
+		, Worker::sMembers, _countof(Worker::sMembers));
+	auto class_obj = Object::CreateClass(_T("Worker"), Object::sClass, Worker::sPrototype, NewObject<Worker>);
+
+	auto prop = class_obj->DefineProperty(_T("Parent"));
+	prop->MinParams = prop->MaxParams = 0;
+	auto func = new BuiltInFunc(_T("Worker.Parent.Get"), &Worker::GetParent, 1, 1); // Includes `this`.
+	prop->SetGetter(func);
+	func->Release();
+}
+
+
+Worker::~Worker()
+{
+	if (mView)
+		UnmapViewOfFile(mView);
+	if (mMapping)
+		CloseHandle(mMapping);
+	if (mSendEvent)
+		CloseHandle(mSendEvent);
+	if (mReceiveEvent)
+		CloseHandle(mReceiveEvent);
+	if (mPeer)
+		CloseHandle(mPeer);
+	if (mOnMessage)
+		mOnMessage->Release();
+}
+
+
+bool Worker::CreateChannel()
+// Creates the shared memory and events of a new channel.  They have no names, so no other process
+// can open them; the child inherits them instead (see __New).
+{
+	mMapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)(WORKER_RING_STRIDE * 2), NULL);
+	if (!mMapping || !MapChannel(true))
+		return false;
+	// The events are auto-reset, since each one has only one waiter.
+	return (mSendEvent = CreateEvent(NULL, FALSE, FALSE, NULL))
+		&& (mReceiveEvent = CreateEvent(NULL, FALSE, FALSE, NULL));
+}
+
+
+bool Worker::OpenChannel(LPCTSTR aChannel)
+// Attaches to the channel described by the /Worker= parameter, which is the values of the handles
+// this process inherited from the parent: the shared memory, the event for each direction and the
+// parent process.
+{
+	HANDLE handle[4];
+	LPCTSTR cp = aChannel;
+	for (int i = 0; i < 4; ++i)
+	{
+		LPTSTR end;
+		handle[i] = (HANDLE)(UINT_PTR)_tcstoui64(cp, &end, 10);
+		if (end == cp || *end != (i < 3 ? ',' : '\0') || !handle[i])
+		{
+			SetLastError(ERROR_INVALID_PARAMETER);
+			return false;
+		}
+		cp = end + 1;
+		// Don't pass them on to any processes this script starts.
+		SetHandleInformation(handle[i], HANDLE_FLAG_INHERIT, 0);
+	}
+	mMapping = handle[0];
+	mReceiveEvent = handle[1];
+	mSendEvent = handle[2];
+	mPeer = handle[3];
+	return (mPid = GetProcessId(mPeer)) && MapChannel(false);
+}
+
+
+bool Worker::MapChannel(bool aCreate)
+// Maps the shared memory and initializes or validates the rings.  The parent writes to the
+// first ring and the child writes to the second ring.
+{
+	size_t size = WORKER_RING_STRIDE * 2;
+	if (  !(mView = MapViewOfFile(mMapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0))  )
+		return false;
+	if (!aCreate)
+	{
+		MEMORY_BASIC_INFORMATION mbi;
+		if (!VirtualQuery(mView, &mbi, sizeof(mbi)) || mbi.RegionSize < size)
+			return false;
+	}
+	auto rings = (LPBYTE)mView;
+	auto &to_child = aCreate ? mSend : mReceive, &to_parent = aCreate ? mReceive : mSend;
+	if (aCreate ? !to_child.Create(rings, WORKER_RING_CAPACITY) || !to_parent.Create(rings + WORKER_RING_STRIDE, WORKER_RING_CAPACITY)
+		: !to_child.Open(rings, WORKER_RING_STRIDE) || !to_parent.Open(rings + WORKER_RING_STRIDE, WORKER_RING_STRIDE))
+	{
+		SetLastError(ERROR_INVALID_DATA);
+		return false;
+	}
+	return true;
+}
+
+
+void Worker::Connect()
+// Starts watching for messages and for the other process to exit.
+{
+	GetWorkerPool(); // Ensure it exists before the callbacks below can use it.
+	mConnected = true;
+	++g_ConnectedWorkers;
+	AddRef(); // Released by Disconnect().
+	RegisterWaitForSingleObject(&mDataWait, mReceiveEvent, DataReady, this, INFINITE, WT_EXECUTEDEFAULT);
+	RegisterWaitForSingleObject(&mExitWait, mPeer, PeerExited, this, INFINITE, WT_EXECUTEONLYONCE);
+	// Check for messages which were sent before the wait began.
+	g_WorkerPool->PostData(this);
+}
+
+
+void Worker::Disconnect()
+// Stops watching the channel.  Messages which haven't been delivered are discarded.
+{
+	if (!mConnected)
+		return;
+	mConnected = false;
+	--g_ConnectedWorkers;
+	// Wait for any callbacks which are in progress, since they use this object.
+	if (mDataWait)
+		UnregisterWaitEx(mDataWait, INVALID_HANDLE_VALUE);
+	if (mExitWait)
+		UnregisterWaitEx(mExitWait, INVALID_HANDLE_VALUE);
+	mDataWait = mExitWait = NULL;
+	mOutbox.Clear(); // These can no longer be delivered.
+	mOutboxPos = mOutboxWritten = 0;
+	g_WorkerPool->Forget(this);
+	Release(); // Balance the AddRef() in Connect().  This may delete the object.
+}
+
+
+VOID CALLBACK Worker::DataReady(PVOID aParam, BOOLEAN aTimedOut)
+// Called on a thread pool thread when the other process has sent data or made room for more.
+{
+	g_WorkerPool->PostData((Worker *)aParam);
+}
+
+
+VOID CALLBACK Worker::PeerExited(PVOID aParam, BOOLEAN aTimedOut)
+// Called on a thread pool thread when the other process has exited.
+{
+	auto worker = (Worker *)aParam;
+	worker->mPeerExited = true;
+	g_WorkerPool->PostData(worker);
+}
+
+
+FResult Worker::__New(StrArg aScript, optl<IObject*> aOnMessage, optl<BOOL> aIsCode)
+{
+	if (mMapping)
+		return FError(ERR_INVALID_USAGE);
+	if (aOnMessage.has_value())
+	{
+		auto fr = ValidateFunctor(aOnMessage.value(), 2);
+		if (fr != OK)
+			return fr;
+		(mOnMessage = aOnMessage.value())->AddRef();
+	}
+	bool is_code = aIsCode.value_or(FALSE);
+
+	if (!CreateChannel())
+		return FR_E_WIN32(GetLastError());
+	// The child waits on this to detect when this process exits.
+	HANDLE self;
+	if (!DuplicateHandle(GetCurrentProcess(), GetCurrentProcess(), GetCurrentProcess(), &self
+		, SYNCHRONIZE | PROCESS_QUERY_LIMITED_INFORMATION, TRUE, 0))
+		return FR_E_WIN32(GetLastError());
+
+	// /script allows a compiled script to run another script.  Code is passed via stdin ("*").
+	// /Worker= passes the values of the handles which the child inherits (see OpenChannel()).
+	TCHAR cmd[UorA(MAX_WIDE_PATH, MAX_PATH * 2 + 128)];
+	if (sntprintf(cmd, _countof(cmd), _T("\"%s\" /script /Worker=%Iu,%Iu,%Iu,%Iu \"%s\""), g_script.mOurEXE
+		, (UINT_PTR)mMapping, (UINT_PTR)mSendEvent, (UINT_PTR)mReceiveEvent, (UINT_PTR)self
+		, is_code ? _T("*") : aScript) >= _countof(cmd) - 1) // Too long.
+	{
+		CloseHandle(self);
+		return FR_E_ARG(0);
+	}
+
+	STARTUPINFO si = { sizeof(STARTUPINFO) };
+	HANDLE stdin_read = NULL, stdin_write = NULL;
+	if (is_code)
+	{
+		SECURITY_ATTRIBUTES sa = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+		if (!CreatePipe(&stdin_read, &stdin_write, &sa, 0))
+		{
+			CloseHandle(self);
+			return FR_E_WIN32(GetLastError());
+		}
+		SetHandleInformation(stdin_write, HANDLE_FLAG_INHERIT, 0);
+		si.dwFlags = STARTF_USESTDHANDLES;
+		si.hStdInput = stdin_read;
+		si.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+		si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+	}
+	// Make the channel inheritable only for as long as needed, so that processes started by Run
+	// (which doesn't inherit handles) or by other Workers don't get it.
+	HANDLE channel[] = { mMapping, mSendEvent, mReceiveEvent };
+	for (auto h : channel)
+		SetHandleInformation(h, HANDLE_FLAG_INHERIT, HANDLE_FLAG_INHERIT);
+	PROCESS_INFORMATION pi;
+	BOOL started = CreateProcess(NULL, cmd, NULL, NULL, TRUE, CREATE_SUSPENDED, NULL, NULL, &si, &pi);
+	DWORD last_error = GetLastError();
+	for (auto h : channel)
+		SetHandleInformation(h, HANDLE_FLAG_INHERIT, 0);
+	CloseHandle(self);
+	if (stdin_read)
+		CloseHandle(stdin_read);
+	if (!started)
+	{
+		if (stdin_write)
+			CloseHandle(stdin_write);
+		return FR_E_WIN32(last_error);
+	}
+
+	// Put the child in a job which is closed when this process exits, so that workers can't
+	// outlive the script which started them.  Failure isn't fatal.
+	if (!sJob && (sJob = CreateJobObject(NULL, NULL)))
+	{
+		JOBOBJECT_EXTENDED_LIMIT_INFORMATION limit = {};
+		limit.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+		SetInformationJobObject(sJob, JobObjectExtendedLimitInformation, &limit, sizeof(limit));
+	}
+	if (sJob)
+		AssignProcessToJobObject(sJob, pi.hProcess);
+	ResumeThread(pi.hThread);
+	CloseHandle(pi.hThread);
+	mPeer = pi.hProcess;
+	mPid = pi.dwProcessId;
+
+	if (is_code)
+	{
+		// The script is read as UTF-8 due to the BOM.  If the child exits early, WriteFile fails.
+		CStringUTF8FromTChar code(aScript);
+		DWORD written;
+		WriteFile(stdin_write, "\xEF\xBB\xBF", 3, &written, NULL)
+			&& WriteFile(stdin_write, code.GetString(), (DWORD)code.GetLength(), &written, NULL);
+		CloseHandle(stdin_write);
+	}
+
+	Connect();
+	return OK;
+}
+
+
+BIF_DECL(Worker::GetParent)
+// Returns the channel to the script which started this one, or "" if it wasn't started by a Worker.
+{
+	if (!sParent && g_script.mWorkerChannel)
+	{
+		auto parent = new Worker();
+		if (!parent->OpenChannel(g_script.mWorkerChannel))
+		{
+			DWORD error = GetLastError();
+			parent->Release();
+			_f_throw_win32(error);
+		}
+		parent->Connect();
+		sParent = parent; // Keep this reference so that the same object is always returned.
+	}
+	if (!sParent)
+		_f_return_empty;
+	sParent->AddRef();
+	_f_return(sParent);
+}
+
+
+FResult Worker::Post(ExprTokenType &aValue)
+{
+	if (!mConnected)
+		return FError(ERR_WORKER_NOT_RUNNING);
+	MsgBuffer msg;
+	auto fr = EncodeValue(msg, aValue, 0);
+	if (fr != OK)
+		return fr;
+	// Post never waits for the other script, which might be busy or might not have set OnMessage
+	// yet.  Whatever doesn't fit in the ring is kept in mOutbox and written by OnEvents() when the
+	// other script makes room.  Messages already in mOutbox must be written first.
+	size_t written = 0;
+	if (mOutboxPos == mOutbox.Length() && mSend.Write(msg.Data(), msg.Length(), written))
+	{
+		WakePeer();
+		return OK;
+	}
+	size_t size = msg.Length();
+	if (!mOutbox.Reserve(sizeof(size) + size))
+	{
+		// The part already written can't be taken back, so the channel would be corrupted.
+		if (written)
+			Terminate(nullptr);
+		return FR_E_OUTOFMEM;
+	}
+	mOutbox.Append(&size, sizeof(size));
+	mOutbox.Append(msg.Data(), size);
+	if (mOutboxPos + sizeof(size) + size == mOutbox.Length()) // This is the only message.
+		mOutboxWritten = written;
+	Flush();
+	return OK;
+}
+
+
+bool Worker::Flush()
+// Writes as much of mOutbox to the ring as will fit.  Returns true if it is now empty.
+{
+	while (mOutboxPos < mOutbox.Length())
+	{
+		size_t size;
+		memcpy(&size, mOutbox.Data() + mOutboxPos, sizeof(size));
+		auto data = mOutbox.Data() + mOutboxPos + sizeof(size);
+		if (!mSend.Write(data, size, mOutboxWritten))
+		{
+			// Ask to be woken when there is room, then check again in case the other script made
+			// room before it could see the request.
+			mSend.RequestSpace();
+			if (!mSend.Write(data, size, mOutboxWritten))
+			{
+				WakePeer();
+				if (mOutboxPos >= mOutbox.Length() / 2)
+				{
+					// Discard the messages which have been written, so that the outbox doesn't grow
+					// indefinitely while the other script is keeping up with only some of them.
+					mOutbox.Erase(mOutboxPos);
+					mOutboxPos = 0;
+				}
+				return false;
+			}
+		}
+		mOutboxPos += sizeof(size) + size;
+		mOutboxWritten = 0;
+	}
+	mOutbox.Clear();
+	mOutboxPos = 0;
+	WakePeer();
+	return true;
+}
+
+
+bool Worker::Receive()
+// Reads the next message into mMessage.  Returns false if it is not complete.
+{
+	bool complete = mReceive.Read(mMessage);
+	if (mReceive.TakeSpaceRequest())
+		SetEvent(mSendEvent); // The other script is waiting to write more (see Flush()).
+	return complete;
+}
+
+
+FResult Worker::Terminate(optl<int> aExitCode)
+// Ends the worker's process, or for Worker.Parent, closes the channel to the parent.
+{
+	if (mPeer && this != sParent && !mPeerExited)
+		TerminateProcess(mPeer, aExitCode.value_or(0));
+	Disconnect();
+	return OK;
+}
+
+
+FResult Worker::get_OnMessage(IObject *&aRetVal)
+{
+	if (aRetVal = mOnMessage)
+		aRetVal->AddRef();
+	return OK;
+}
+
+
+FResult Worker::set_OnMessage(ExprTokenType &aValue)
+{
+	auto obj = TokenToObject(aValue);
+	if (obj)
+	{
+		auto fr = ValidateFunctor(obj, 2);
+		if (fr != OK)
+			return fr;
+		obj->AddRef();
+	}
+	else if (!TokenIsEmptyString(aValue))
+		return FTypeError(_T("object"), aValue);
+	auto prev = mOnMessage;
+	mOnMessage = obj;
+	if (prev)
+		prev->Release();
+	if (mOnMessage && mConnected)
+		g_WorkerPool->PostData(this); // Deliver any messages which arrived while there was no callback.
+	return OK;
+}
+
+
+void Worker::OnEvents(UINT aEvents)
+// Called on the main thread, in a new script thread.  Delivers at most one message, so that each
+// message gets its own thread, and queues another event if there might be more.
+{
+	if (!mConnected)
+		return;
+	if (mOutboxPos < mOutbox.Length())
+		Flush(); // The other script may have made room.
+	if (!mOnMessage)
+	{
+		// Messages are kept until a callback is set, unless they can never be delivered.
+		if (mPeerExited)
+			Disconnect();
+		return;
+	}
+	AddRef(); // In case the callback calls Terminate().
+	TextBuf key_buf, value_buf;
+	ExprTokenType value;
+	bool received = false, valid = false;
+	if (Receive())
+	{
+		MsgReader reader(mMessage.Data(), mMessage.Length());
+		valid = DecodeValue(reader, value, key_buf, value_buf, 0) && reader.AtEnd();
+		mMessage.Clear();
+		received = true;
+	}
+	if (received)
+	{
+		g_WorkerPool->PostData(this); // Check for another message after this one.
+		// A message which can't be decoded could only come from a faulty peer, so is ignored.
+		if (valid)
+		{
+			ExprTokenType params[] = { static_cast<IObject *>(this), value };
+			IObjectPtr(mOnMessage)->ExecuteInNewThread(_T("Worker"), params, _countof(params));
+			if (value.symbol == SYM_OBJECT)
+				value.object->Release();
+		}
+	}
+	else
+	{
+		// Check this first, so that anything sent before the peer exited is seen below.
+		bool exited = mPeerExited;
+		if (!mReceive.PrepareToWait())
+			g_WorkerPool->PostData(this); // Data arrived in the meantime.
+		else if (exited)
+			Disconnect();
+	}
+	Release();
+}
+
+
+//
+// Serialization
+//
+
+FResult Worker::EncodeString(MsgBuffer &aMsg, LPCTSTR aText, size_t aLength)
+{
+#ifdef UNICODE
+	if (!aMsg.WriteByte(MSG_STRING) || !aMsg.WriteString(aText, aLength))
+#else
+	CStringWCharFromTChar wide(aText, (int)aLength);
+	if (!aMsg.WriteByte(MSG_STRING) || !aMsg.WriteString(wide.GetString(), wide.GetLength()))
+#endif
+		return FR_E_OUTOFMEM;
+	return OK;
+}
+
+
+FResult Worker::EncodeValue(MsgBuffer &aMsg, ExprTokenType &aValue, int aDepth)
+{
+	switch (aValue.symbol)
+	{
+	case SYM_VAR:
+	{
+		ExprTokenType value;
+		aValue.var->ToTokenSkipAddRef(value);
+		return EncodeValue(aMsg, value, aDepth);
+	}
+	case SYM_STRING:
+		return EncodeString(aMsg, aValue.marker, aValue.marker_length != -1 ? aValue.marker_length : _tcslen(aValue.marker));
+	case SYM_INTEGER:
+		return aMsg.WriteByte(MSG_INTEGER) && aMsg.WriteInt(aValue.value_int64) ? OK : FR_E_OUTOFMEM;
+	case SYM_FLOAT:
+		return aMsg.WriteByte(MSG_FLOAT) && aMsg.WriteDouble(aValue.value_double) ? OK : FR_E_OUTOFMEM;
+	case SYM_OBJECT:
+		return EncodeObject(aMsg, aValue.object, aDepth);
+	default:
+		return aMsg.WriteByte(MSG_UNSET) ? OK : FR_E_OUTOFMEM; // An unset array item.
+	}
+}
+
+
+FResult Worker::EncodeValue(MsgBuffer &aMsg, Variant &aValue, int aDepth)
+{
+	switch (aValue.symbol)
+	{
+	case SYM_STRING: return EncodeString(aMsg, aValue.string, aValue.string.Length());
+	case SYM_INTEGER: return aMsg.WriteByte(MSG_INTEGER) && aMsg.WriteInt(aValue.n_int64) ? OK : FR_E_OUTOFMEM;
+	case SYM_FLOAT: return aMsg.WriteByte(MSG_FLOAT) && aMsg.WriteDouble(aValue.n_double) ? OK : FR_E_OUTOFMEM;
+	case SYM_OBJECT: return EncodeObject(aMsg, aValue.object, aDepth);
+	default: return aMsg.WriteByte(MSG_UNSET) ? OK : FR_E_OUTOFMEM;
+	}
+}
+
+
+FResult Worker::EncodeObject(MsgBuffer &aMsg, IObject *aObject, int aDepth)
+// Copies an Array, Map or plain Object.  Objects of other types, such as a Buffer or a function,
+// can't be meaningfully copied to another process.
+{
+	auto obj = dynamic_cast<Object *>(aObject);
+	auto arr = dynamic_cast<Array *>(obj);
+	auto map = arr ? nullptr : dynamic_cast<Map *>(obj);
+	if (!arr && !map && (!obj || typeid(*obj) != typeid(Object)))
+	{
+		ExprTokenType value(aObject);
+		return FTypeError(_T("Array, Map or Object"), value);
+	}
+	if (++aDepth > WORKER_MAX_DEPTH) // Most likely a circular reference.
+		return FValueError(ERR_JSON_TOO_DEEP);
+	FResult fr;
+	if (arr)
+	{
+		if (!aMsg.WriteByte(MSG_ARRAY) || !aMsg.WriteVarUInt(arr->mLength))
+			return FR_E_OUTOFMEM;
+		for (Array::index_t i = 0; i < arr->mLength; ++i)
+			if ((fr = EncodeValue(aMsg, arr->mItem[i], aDepth)) != OK)
+				return fr;
+	}
+	else if (map)
+	{
+		if (map->mKeyOffsetObject < map->mKeyOffsetString)
+		{
+			// An object key would refer to an object in this process, which the other can't use.
+			ExprTokenType key(map->mItem[map->mKeyOffsetObject].key.p);
+			return FTypeError(_T("String or Integer"), key);
+		}
+		if (!aMsg.WriteByte(MSG_MAP) || !aMsg.WriteVarUInt(map->mCount))
+			return FR_E_OUTOFMEM;
+		for (Map::index_t i = 0; i < map->mCount; ++i)
+		{
+			auto &item = map->mItem[i];
+			fr = i < map->mKeyOffsetObject
+				? (aMsg.WriteByte(MSG_INTEGER) && aMsg.WriteInt(item.key.i) ? OK : FR_E_OUTOFMEM)
+				: EncodeString(aMsg, item.key.s, _tcslen(item.key.s));
+			if (fr != OK || (fr = EncodeValue(aMsg, item, aDepth)) != OK)
+				return fr;
+		}
+	}
+	else
+	{
+		// Own value properties only; dynamic properties are skipped, as by JSON.Stringify.
+		Object::index_t count = 0;
+		for (Object::index_t i = 0; i < obj->mFields.Length(); ++i)
+			if (obj->mFields.Value()[i].symbol != SYM_DYNAMIC && obj->mFields.Value()[i].symbol != SYM_TYPED_FIELD)
+				++count;
+		if (!aMsg.WriteByte(MSG_OBJECT) || !aMsg.WriteVarUInt(count))
+			return FR_E_OUTOFMEM;
+		for (Object::index_t i = 0; i < obj->mFields.Length(); ++i)
+		{
+			auto &field = obj->mFields.Value()[i];
+			if (field.symbol == SYM_DYNAMIC || field.symbol == SYM_TYPED_FIELD)
+				continue;
+			if ((fr = EncodeString(aMsg, field.name, _tcslen(field.name))) != OK
+				|| (fr = EncodeValue(aMsg, field, aDepth)) != OK)
+				return fr;
+		}
+	}
+	return OK;
+}
+
+
+LPTSTR Worker::TextBuf::Reserve(size_t aLength)
+{
+	if (aLength >= mSize)
+	{
+		size_t new_size = max(aLength + 1, mSize * 2);
+		auto new_text = (LPTSTR)realloc(mText, new_size * sizeof(TCHAR));
+		if (!new_text)
+			return nullptr;
+		mText = new_text;
+		mSize = new_size;
+	}
+	return mText;
+}
+
+
+bool Worker::DecodeString(MsgReader &aReader, TextBuf &aBuf, LPTSTR &aText, size_t &aLength)
+{
+	const void *text;
+	size_t length;
+	if (!aReader.ReadString(text, length) || length > INT_MAX)
+		return false;
+#ifdef UNICODE
+	if (  !(aText = aBuf.Reserve(length))  )
+		return false;
+	memcpy(aText, text, length * sizeof(WCHAR)); // text might not be aligned.
+#else
+	// Convert from an aligned copy, since text might not be aligned.
+	auto wide = (LPWSTR)malloc(length * sizeof(WCHAR) + 1);
+	if (!wide)
+		return false;
+	memcpy(wide, text, length * sizeof(WCHAR));
+	int size = length ? WideCharToMultiByte(CP_ACP, 0, wide, (int)length, NULL, 0, NULL, NULL) : 0;
+	if (aText = aBuf.Reserve(size))
+		WideCharToMultiByte(CP_ACP, 0, wide, (int)length, aText, size, NULL, NULL);
+	free(wide);
+	if (!aText)
+		return false;
+	length = size;
+#endif
+	aText[length] = '\0';
+	aLength = length;
+	return true;
+}
+
+
+bool Worker::DecodeValue(MsgReader &aReader, ExprTokenType &aValue, TextBuf &aKeyBuf, TextBuf &aValueBuf, int aDepth)
+// If aValue is an object, the caller is responsible for releasing it.  If it is a string, it is
+// in aValueBuf.  Returns false if the message is invalid or memory couldn't be allocated.
+{
+	uint8_t tag;
+	if (!aReader.ReadByte(tag))
+		return false;
+	switch (tag)
+	{
+	case MSG_STRING:
+	{
+		LPTSTR text;
+		size_t length;
+		if (!DecodeString(aReader, aValueBuf, text, length))
+			return false;
+		aValue.SetValue(text, length);
+		return true;
+	}
+	case MSG_INTEGER:
+	{
+		int64_t n;
+		if (!aReader.ReadInt(n))
+			return false;
+		aValue.SetValue((__int64)n);
+		return true;
+	}
+	case MSG_FLOAT:
+	{
+		double d;
+		if (!aReader.ReadDouble(d))
+			return false;
+		aValue.SetValue(d);
+		return true;
+	}
+	case MSG_ARRAY:
+	case MSG_MAP:
+	case MSG_OBJECT:
+		break;
+	default:
+		return false; // MSG_UNSET is handled below, since it is only valid in an array.
+	}
+
+	uint64_t count;
+	if (++aDepth > WORKER_MAX_DEPTH || !aReader.ReadVarUInt(count))
+		return false;
+	Object *obj = tag == MSG_ARRAY ? Array::Create() : tag == MSG_MAP ? Map::Create() : Object::Create();
+	if (!obj)
+		return false;
+	for (; count; --count)
+	{
+		ExprTokenType key, item;
+		bool ok;
+		if (tag == MSG_ARRAY)
+		{
+			uint8_t item_tag;
+			if (aReader.AtEnd())
+				goto fail;
+			// Peek at the tag, since an unset item has no further data.
+			MsgReader peek = aReader;
+			if (peek.ReadByte(item_tag) && item_tag == MSG_UNSET)
+			{
+				aReader = peek;
+				item.symbol = SYM_MISSING;
+			}
+			else if (!DecodeValue(aReader, item, aKeyBuf, aValueBuf, aDepth))
+				goto fail;
+			ok = static_cast<Array *>(obj)->Append(item);
+		}
+		else
+		{
+			// The key is decoded after the value, since decoding a nested Map or Object reuses aKeyBuf.
+			MsgReader key_reader = aReader;
+			uint8_t key_tag;
+			int64_t key_int = 0;
+			const void *key_text;
+			size_t key_length;
+			if (!aReader.ReadByte(key_tag))
+				goto fail;
+			if (key_tag == MSG_STRING ? !aReader.ReadString(key_text, key_length)
+				: key_tag != MSG_INTEGER || tag == MSG_OBJECT || !aReader.ReadInt(key_int))
+				goto fail;
+			if (!DecodeValue(aReader, item, aKeyBuf, aValueBuf, aDepth))
+				goto fail;
+			if (key_tag == MSG_STRING)
+			{
+				LPTSTR name;
+				key_reader.ReadByte(key_tag);
+				ok = DecodeString(key_reader, aKeyBuf, name, key_length)
+					&& (tag == MSG_MAP ? static_cast<Map *>(obj)->SetItem(name, item) : obj->SetOwnProp(name, item));
+			}
+			else
+			{
+				key.SetValue((__int64)key_int);
+				ok = static_cast<Map *>(obj)->SetItem(key, item);
+			}
+		}
+		if (item.symbol == SYM_OBJECT)
+			item.object->Release();
+		if (!ok)
+			goto fail;
+	}
+	aValue.SetValue(obj);
+	return true;
+fail:
+	obj->Release();
+	return false;
+}
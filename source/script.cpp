@@ -21,6 +21,7 @@ GNU General Public License for more details.
 #include "window.h" // for a lot of things
 #include "application.h" // for MsgSleep()
 #include "TextIO.h"
+#include "DispIDCache.h" // for KeyHistory stats
 
 #define NA MAX_FUNCTION_PARAMS
 #define BIFn(name, minp, maxp, bif, ...) {_T(#name), bif, minp, maxp, FID_##name, __VA_ARGS__}
@@ -244,6 +245,7 @@ VarEntry g_BIV_A[] =
 	A_x(Now, BIV_Now),
 	A_x(NowUTC, BIV_Now),
 	A_(OSVersion),
+	A_w(PixelCacheTime),
 	A_(PriorHotkey),
 	A_(PriorKey),
 	A_x(ProgramFiles, BIV_SpecialFolderPath),
@@ -272,6 +274,7 @@ VarEntry g_BIV_A[] =
 	A_(ThisFunc),
 	A_(ThisHotkey),
 	A_(TickCount),
+	A_(TickCountPrecise),
 	A_x(TimeIdle, BIV_TimeIdle),
 	A_x(TimeIdleKeyboard, BIV_TimeIdle),
 	A_x(TimeIdleMouse, BIV_TimeIdle),
@@ -326,6 +329,7 @@ Script::Script()
 	, mValidateThenExit(false)
 	, mCmdLineInclude(NULL)
 #endif
+	, mWorkerChannel(NULL)
 	, mUninterruptedLineCountMax(1000), mUninterruptibleTime(17)
 	, mCustomIcon(NULL), mCustomIconSmall(NULL) // Normally NULL unless there's a custom tray icon loaded dynamically.
 	, mCustomIconFile(NULL), mIconFrozen(false), mTrayIconTip(NULL) // Allocated on first use.
@@ -1016,6 +1020,7 @@ bool Script::IsPersistent()
 		|| g_script.mTimerEnabledCount // At least one script timer is currently enabled.
 		|| mOnClipboardChange.Count() // The script is monitoring clipboard changes.
 		|| g_input // At least one active InputHook.
+		|| g_ConnectedWorkers // A Worker or Worker.Parent channel is open, so messages may arrive.
 		|| IsWindowVisible(g_hWnd))
 		return true;
 	// OnMessage does not make the script persistent because:
@@ -3572,7 +3577,11 @@ inline ResultType Script::IsDirective(LPTSTR aBuf)
 		//  - HotIf would only be able to select the first expression with the given source code.
 		//  - Conserves memory.
 		if (g->HotCriterion = FindHotkeyIfExpr(parameter))
+		{
+			if (g->HotCriterion->Pure != g_HotExprPure)
+				return ScriptError(_T("This #HotIf expression was previously declared with a different #HotIfPure setting."), parameter);
 			return CONDITION_TRUE;
+		}
 
 		auto pending_hotkey = mPendingHotkey;
 		mPendingHotkey = nullptr;
@@ -3587,6 +3596,7 @@ inline ResultType Script::IsDirective(LPTSTR aBuf)
 			return fr == FR_E_OUTOFMEM ? ScriptError(ERR_OUTOFMEM) : FAIL;
 
 		g->HotCriterion->OriginalExpr = SimpleHeap::Alloc(parameter);
+		g->HotCriterion->Pure = g_HotExprPure;
 		
 		if (!ParseAndAddLineInBlock(parameter, ACT_HOTKEY_IF)) // PreparseExpressions will change this to ACT_RETURN
 			return ScriptError(ERR_OUTOFMEM);
@@ -3602,6 +3612,15 @@ inline ResultType Script::IsDirective(LPTSTR aBuf)
 		return CONDITION_TRUE;
 	}
 
+	// Declare that subsequent #HotIf expressions depend only on the foreground window, so that
+	// the hook can reuse their results until the foreground window changes.
+	if (IS_DIRECTIVE_MATCH(_T("#HotIfPure")))
+	{
+		if (!ConvertDirectiveBool(parameter, g_HotExprPure, true))
+			return ScriptError(ERR_PARAM1_INVALID, parameter);
+		return CONDITION_TRUE;
+	}
+
 	// L4: Allow #HotIf timeout to be adjusted.
 	if (IS_DIRECTIVE_MATCH(_T("#HotIfTimeout")))
 	{
@@ -3869,6 +3888,7 @@ ResultType Script::RequirementError(LPCTSTR aRequirement)
 void ScriptTimer::Disable()
 {
 	mEnabled = false;
+	g_script.mTimerQueue.Cancel(this);
 	--g_script.mTimerEnabledCount;
 	if (!g_script.mTimerEnabledCount && !g_nLayersNeedingTimer && !Hotkey::sJoyHotkeyCount)
 		KILL_MAIN_TIMER
@@ -3955,7 +3975,14 @@ ResultType Script::UpdateOrCreateTimer(IObject *aCallback
 		// flexible, e.g. a user might want to create a timer that is triggered 5 seconds from now.
 		// In such a case, we don't want the timer's first triggering to occur immediately.
 		// Instead, we want it to occur only when the full 5 seconds have elapsed:
-		timer->mTimeLastRun = GetTickCount();
+		timer->mTimeLastRun = GetTickCount64();
+
+	// Since the timer is enabled, it must be queued.  If it already was, this can't fail.
+	if (!mTimerQueue.Schedule(timer, timer->mTimeLastRun + timer->mPeriod))
+	{
+		timer->Disable();
+		return FAIL; // Caller reports the error.
+	}
 
     // Below is obsolete, see above for why:
 	// We don't have to kill or set the main timer because the only way this function is called
@@ -3977,8 +4004,7 @@ void Script::DeleteTimer(IObject *aLabel)
 			// Disable it, even if it's not technically being deleted yet.
 			if (timer->mEnabled)
 				timer->Disable(); // Keeps track of mTimerEnabledCount and whether the main timer is needed.
-			if (timer->mExistingThreads // This condition differs from g->CurrentTimer == timer, which only detects the "top-most" timer.
-				|| timer->mDeleteLocked)
+			if (timer->mExistingThreads) // This condition differs from g->CurrentTimer == timer, which only detects the "top-most" timer.
 			{
 				// In this case we can't delete the timer yet, but CheckScriptTimers()
 				// will check mEnabled after the callback returns and will delete it then.
@@ -10146,7 +10172,7 @@ ResultType Line::ExecUntil(ExecUntilMode aMode, ResultToken *aResultToken, Line
 				break;
 			case ACT_LOOP_FILE:
 				result = line->PerformLoopFilePattern(aResultToken, jump_to_line, until
-					, (file_loop_mode & ~FILE_LOOP_RECURSE), (file_loop_mode & FILE_LOOP_RECURSE), ARG1);
+					, (file_loop_mode & ~FILE_LOOP_RECURSE), (file_loop_mode & FILE_LOOP_RECURSE), ARG1); // Callee decodes FILE_LOOP_PARALLEL and depth.
 				break;
 			case ACT_LOOP_REG:
 				// This isn't the most efficient way to do things (e.g. the repeated calls to
@@ -10159,7 +10185,7 @@ ResultType Line::ExecUntil(ExecUntilMode aMode, ResultToken *aResultToken, Line
 				{
 					// root_key_type needs to be passed in order to support GetLoopRegKey():
 					result = line->PerformLoopReg(aResultToken, jump_to_line, until
-						, (file_loop_mode & ~FILE_LOOP_RECURSE), (file_loop_mode & FILE_LOOP_RECURSE), root_key_type, root_key, subkey);
+						, (file_loop_mode & FILE_LOOP_FILES_AND_FOLDERS), (file_loop_mode & FILE_LOOP_RECURSE), root_key_type, root_key, subkey);
 					if (is_remote_registry)
 						RegCloseKey(root_key);
 				}
@@ -11084,7 +11110,17 @@ ResultType Line::PerformLoopFilePattern(ResultToken *aResultToken, Line *&aJumpT
 	//    This approach means a little up-front work that mightn't be needed, but greatly improves
 	//    performance in some common cases, such as if A_LoopFileLongPath is used on each iteration.
 	if (ParseLoopFilePattern(aFilePattern, *plfs, result))
-		result = PerformLoopFilePattern(aResultToken, aJumpToLine, aUntil, aFileLoopMode, aRecurseSubfolders, *plfs);
+	{
+		plfs->max_depth = FILE_LOOP_MAX_DEPTH(aFileLoopMode);
+		bool parallel = aFileLoopMode & FILE_LOOP_PARALLEL;
+		aFileLoopMode &= FILE_LOOP_FILES_AND_FOLDERS;
+		// Parallel mode only helps when there are sub-directories to read.  It isn't used for
+		// "C:" with no pattern, which is handled specially by PerformLoopFilePattern().
+		if (parallel && aRecurseSubfolders && plfs->pattern_length)
+			result = PerformLoopFileScan(aResultToken, aJumpToLine, aUntil, aFileLoopMode, *plfs);
+		else
+			result = PerformLoopFilePattern(aResultToken, aJumpToLine, aUntil, aFileLoopMode, aRecurseSubfolders, *plfs);
+	}
 	//else: leave result == CONDITION_FALSE, since in effect, no files were found.
 	delete plfs;
 	return result;
@@ -11291,7 +11327,8 @@ ResultType Line::PerformLoopFilePattern(ResultToken *aResultToken, Line *&aJumpT
 	// search for more files and folders inside that match aFilePattern.  We can't do this in the
 	// first loop, above, because it may have a restricted file-pattern such as *.txt and we want to
 	// find and recurse into ALL folders:
-	if (!aRecurseSubfolders) // No need to continue into the "recurse" section.
+	if (!aRecurseSubfolders // No need to continue into the "recurse" section.
+		|| lfs.max_depth && lfs.depth >= lfs.max_depth) // Already at the requested depth.
 		return result;
 
 	// Since above didn't return, this is a file-loop and recursion into sub-folders has been requested.
@@ -11343,7 +11380,9 @@ ResultType Line::PerformLoopFilePattern(ResultToken *aResultToken, Line *&aJumpT
 		short_path_end[short_name_length + 1] = '\0';
 		lfs.short_path_length = short_path_length + short_name_length + 1;
 
+		++lfs.depth;
 		auto sub_result = PerformLoopFilePattern(aResultToken, aJumpToLine, aUntil, aFileLoopMode, aRecurseSubfolders, lfs);
+		--lfs.depth;
 		// Above returns LOOP_CONTINUE for cases like "continue 2" or "continue outer_loop", where the
 		// target is not this Loop but a Loop which encloses it. In those cases we want below to return:
 		if (sub_result != CONDITION_FALSE)
@@ -11364,6 +11403,70 @@ ResultType Line::PerformLoopFilePattern(ResultToken *aResultToken, Line *&aJumpT
 
 
 
+ResultType Line::PerformLoopFileScan(ResultToken *aResultToken, Line *&aJumpToLine, Line *aUntil
+	, FileLoopModeType aFileLoopMode, LoopFilesStruct &lfs)
+// Parallel version of the recursive PerformLoopFilePattern().  Other threads read sub-directories
+// ahead of the loop, but files are returned in the same order.  Caller has initialized lfs.
+{
+	FileScanLister lister(lfs.file_path, lfs.file_path_length, lfs.pattern, lfs.pattern_length, aFileLoopMode
+		, _countof(lfs.file_path), lfs.short_path_length, _countof(lfs.short_path));
+	if (!lister.IsValid())
+		return MemoryError();
+	FileScan scan(lister, FileScanLister::ThreadCount(), FILE_SCAN_MAX_RECORDS, lfs.max_depth);
+
+	size_t root_length = lfs.file_path_length, short_root_length = lfs.short_path_length;
+	lfs.dir_length = root_length;
+
+	ResultType result = CONDITION_FALSE; // Default to "no iterations executed".
+	Line *jump_to_line = nullptr;
+	global_struct &g = *::g; // Primarily for performance in this case.
+
+	g.mLoopFile = &lfs; // See PerformLoopFilePattern() for comments.
+
+	for (;; ++g.mLoopIteration)
+	{
+		// Retrieve the next file which isn't filtered out, keeping track of the current
+		// directory in the same way as PerformLoopFilePattern().  Sub-directories which
+		// wouldn't fit in the buffers have already been excluded by the lister.
+		DirScanEvent event;
+		while ((event = scan.Next(lfs)) != DIRSCAN_END)
+		{
+			if (event == DIRSCAN_ENTER)
+			{
+				size_t name_length = _tcslen(lfs.cFileName);
+				tmemcpy(lfs.file_path + lfs.dir_length, lfs.cFileName, name_length);
+				lfs.dir_length += name_length;
+				lfs.file_path[lfs.dir_length++] = '\\';
+				lfs.file_path[lfs.dir_length] = '\0';
+				LPTSTR short_name = *lfs.cAlternateFileName ? lfs.cAlternateFileName : lfs.cFileName;
+				name_length = _tcslen(short_name);
+				tmemcpy(lfs.short_path + lfs.short_path_length, short_name, name_length);
+				lfs.short_path_length += name_length;
+				lfs.short_path[lfs.short_path_length++] = '\\';
+				lfs.short_path[lfs.short_path_length] = '\0';
+			}
+			else if (event == DIRSCAN_LEAVE)
+			{
+				// Remove the last "name\" from each path.
+				for (--lfs.dir_length; lfs.dir_length > root_length && lfs.file_path[lfs.dir_length - 1] != '\\'; --lfs.dir_length);
+				lfs.file_path[lfs.dir_length] = '\0';
+				for (--lfs.short_path_length; lfs.short_path_length > short_root_length && lfs.short_path[lfs.short_path_length - 1] != '\\'; --lfs.short_path_length);
+				lfs.short_path[lfs.short_path_length] = '\0';
+			}
+			else if (!FileIsFilteredOut(lfs, aFileLoopMode))
+				break;
+		}
+		if (event == DIRSCAN_END)
+			break;
+
+		PERFORMLOOP_EXECUTE_BODY
+		PERFORMLOOP_EVALUATE_UNTIL
+	}
+	return result;
+}
+
+
+
 ResultType Line::PerformLoopReg(ResultToken *aResultToken, Line *&aJumpToLine, Line *aUntil
 	, FileLoopModeType aFileLoopMode, bool aRecurseSubfolders, HKEY aRootKeyType, HKEY aRootKey, LPTSTR aRegSubkey)
 // aRootKeyType is the type of root key, independent of whether it's local or remote.
@@ -12402,11 +12505,18 @@ LPTSTR Script::ListKeyHistory(LPTSTR aBuf, int aBufSize) // aBufSize should be a
 	else
 		*win_title = '\0';
 
-	TCHAR timer_list[128];
+	// Each timer is followed by its average and maximum lateness in milliseconds, if it has run.
+	TCHAR timer_list[256];
 	*timer_list = '\0';
 	for (ScriptTimer *timer = mFirstTimer; timer != NULL; timer = timer->mNextTimer)
 		if (timer->mEnabled)
-			sntprintfcat(timer_list, _countof(timer_list) - 3, _T("%s "), timer->mCallback->Name()); // Allow room for "..."
+		{
+			if (timer->mRunCount)
+				sntprintfcat(timer_list, _countof(timer_list) - 3, _T("%s[%u/%u] "), timer->mCallback->Name() // Allow room for "..."
+					, (UINT)(timer->mLateTotal / timer->mRunCount), timer->mLateMax);
+			else
+				sntprintfcat(timer_list, _countof(timer_list) - 3, _T("%s "), timer->mCallback->Name()); // Allow room for "..."
+		}
 	if (*timer_list)
 	{
 		size_t length = _tcslen(timer_list);
@@ -12416,10 +12526,14 @@ LPTSTR Script::ListKeyHistory(LPTSTR aBuf, int aBufSize) // aBufSize should be a
 			timer_list[--length] = '\0';  // Remove the last space if there was room enough for it to have been added.
 	}
 
+	SimpleHeapStats heap;
+	SimpleHeap::GetStats(heap);
+
 	TCHAR LRtext[256];
 	aBuf += sntprintf(aBuf, aBufSize,
 		_T("Window: %s")
-		//"\r\nBlocks: %u"
+		_T("\r\nSimpleHeap: %u KB used of %u KB (%u blocks, %u KB large, %u KB wasted, %u KB free-listed)")
+		_T("\r\nCOM DISPID cache: %u hits, %u misses")
 		_T("\r\nKeybd hook: %s")
 		_T("\r\nMouse hook: %s")
 		_T("\r\nEnabled Timers: %u of %u (%s)")
@@ -12429,7 +12543,9 @@ LPTSTR Script::ListKeyHistory(LPTSTR aBuf, int aBufSize) // aBufSize should be a
 		_T("\r\nModifiers (GetKeyState() now) = %s")
 		_T("\r\n")
 		, win_title
-		//, SimpleHeap::GetBlockCount()
+		, (UINT)(heap.used / 1024), (UINT)(heap.reserved / 1024), heap.blocks
+		, (UINT)(heap.large / 1024), (UINT)(heap.wasted / 1024), (UINT)(heap.free_listed / 1024)
+		, DispIDCache::sHits, DispIDCache::sMisses
 		, g_KeybdHook == NULL ? _T("no") : _T("yes")
 		, g_MouseHook == NULL ? _T("no") : _T("yes")
 		, mTimerEnabledCount, mTimerCount, timer_list
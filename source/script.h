@@ -28,6 +28,8 @@ GNU General Public License for more details.
 #include "resources/resource.h"  // For tray icon.
 #include "Debugger.h"
 #include "abi.h"
+#include "DirScan.h"
+#include "TimerQueue.h"
 
 #include "os_version.h" // For the global OS_Version object
 EXTERN_OSVER; // For the access to the g_os version object without having to include globaldata.h
@@ -61,7 +63,12 @@ typedef int FileLoopModeType;
 #define FILE_LOOP_FILES_ONLY	1
 #define FILE_LOOP_FOLDERS_ONLY	2
 #define FILE_LOOP_RECURSE		4
+#define FILE_LOOP_PARALLEL		8 // Read sub-directories ahead on other threads.
 #define FILE_LOOP_FILES_AND_FOLDERS (FILE_LOOP_FILES_ONLY | FILE_LOOP_FOLDERS_ONLY)
+// The maximum depth of recursion (0 for unlimited) is stored in the upper bits, as in "R2".
+#define FILE_LOOP_DEPTH_SHIFT	16
+#define FILE_LOOP_DEPTH_LIMIT	0x7FFF
+#define FILE_LOOP_MAX_DEPTH(mode) ((mode) >> FILE_LOOP_DEPTH_SHIFT)
 
 enum VariableTypeType {VAR_TYPE_INVALID, VAR_TYPE_NUMBER, VAR_TYPE_INTEGER, VAR_TYPE_FLOAT
 	, VAR_TYPE_TIME	, VAR_TYPE_DIGIT, VAR_TYPE_XDIGIT, VAR_TYPE_ALNUM, VAR_TYPE_ALPHA
@@ -144,6 +151,9 @@ enum CommandIDs {CONTROL_ID_FIRST = IDCANCEL + 1
 #define ERR_EXE_CORRUPTED _T("EXE corrupted")
 #define ERR_INVALID_INDEX _T("Invalid index.")
 #define ERR_INVALID_VALUE _T("Invalid value.")
+#define ERR_JSON_SYNTAX _T("Invalid JSON.")
+#define ERR_JSON_TOO_DEEP _T("Nesting too deep.")
+#define ERR_WORKER_NOT_RUNNING _T("The worker is not running.")
 #define ERR_INVALID_FUNCTOR _T("Invalid callback function.")
 #define ERR_PARAM_INVALID _T("Invalid parameter(s).")
 #define ERR_PARAM_COUNT_INVALID _T("Invalid number of parameters.")
@@ -504,8 +514,9 @@ struct LoopFilesStruct : WIN32_FIND_DATA
 	TCHAR *long_dir; // Full/long path of initial directory (used by A_LoopFileLongPath).
 	size_t file_path_length, pattern_length, short_path_length, orig_dir_length, long_dir_length
 		, dir_length; // Portion of file_path which is the directory, used by BIVs.
+	int depth, max_depth; // Current and maximum depth of recursion (0 for unlimited).
 
-	LoopFilesStruct() : orig_dir_length(0), long_dir(NULL) {}
+	LoopFilesStruct() : orig_dir_length(0), long_dir(NULL), depth(0), max_depth(0) {}
 	~LoopFilesStruct()
 	{
 		if (orig_dir_length)
@@ -515,6 +526,39 @@ struct LoopFilesStruct : WIN32_FIND_DATA
 	}
 };
 
+typedef DirScan<WIN32_FIND_DATA> FileScan;
+
+// The approximate number of files and folders which a FileScan may read ahead of the script.
+#define FILE_SCAN_MAX_RECORDS 4096
+
+// Reads directories for a FileScan in parallel mode (Loop Files with "P" or the equivalent for
+// FileSetAttrib and FileSetTime).  Each directory is read the same way as a sequential file-loop:
+// items matching the pattern are returned as records after the same filtering by mode, and all
+// sub-directories are returned for recursion.  The consumer is responsible for building the path
+// of each record as it enters and leaves directories.
+class FileScanLister : public FileScan::Lister
+{
+	LPTSTR mDir; // The root directory with trailing slash, copied since the caller's buffer will change.
+	size_t mDirLength;
+	LPCTSTR mPattern; // Naked filename or pattern.  Must remain valid for the lifetime of the scan.
+	size_t mPatternLength;
+	size_t mPathSize; // Size of the consumer's path buffer, which limits the depth of recursion.
+	size_t mShortDirLength, mShortPathSize; // Same for the short path, or 0 if not applicable.
+	FileLoopModeType mMode;
+
+public:
+	FileScanLister(LPCTSTR aDir, size_t aDirLength, LPCTSTR aPattern, size_t aPatternLength, FileLoopModeType aMode
+		, size_t aPathSize, size_t aShortDirLength = 0, size_t aShortPathSize = 0);
+	~FileScanLister() { free(mDir); }
+	bool IsValid() { return mDir != nullptr; }
+
+	void *Open(FileScan::Dir &aDir, bool aWantSubdirs) override;
+	DirScanItem Read(void *aHandle, WIN32_FIND_DATA &aRecord) override;
+	void Close(void *aHandle) override;
+
+	static UINT ThreadCount();
+};
+
 // Some of these lengths and such are based on the MSDN example at
 // http://msdn.microsoft.com/library/default.asp?url=/library/en-us/sysinfo/base/enumerating_registry_subkeys.asp:
 // FIX FOR v1.0.48: 
@@ -591,22 +635,6 @@ typedef UCHAR ArgCountType;
 #define MAX_ARGS 20   // Maximum number of args used by any command.
 
 
-enum DllArgTypes {
-	  DLL_ARG_INVALID
-	, DLL_ARG_ASTR
-	, DLL_ARG_INT
-	, DLL_ARG_SHORT
-	, DLL_ARG_CHAR
-	, DLL_ARG_INT64
-	, DLL_ARG_FLOAT
-	, DLL_ARG_DOUBLE
-	, DLL_ARG_WSTR
-	, DLL_ARG_STRUCT
-	, DLL_ARG_STR  = UorA(DLL_ARG_WSTR, DLL_ARG_ASTR)
-	, DLL_ARG_xSTR = UorA(DLL_ARG_ASTR, DLL_ARG_WSTR) // To simplify some sections.
-};  // Some sections might rely on DLL_ARG_INVALID being 0.
-
-
 // Note that currently this value must fit into a sc_type variable because that is how TextToKey()
 // stores it in the hotkey class.  sc_type is currently a UINT, and will always be at least a
 // WORD in size, so it shouldn't be much of an issue:
@@ -703,6 +731,8 @@ private:
 	bool ParseLoopFilePattern(LPTSTR aFilePattern, LoopFilesStruct &lfs, ResultType &aResult);
 	ResultType PerformLoopFilePattern(ResultToken *aResultToken, Line *&aJumpToLine, Line *aUntil
 		, FileLoopModeType aFileLoopMode, bool aRecurseSubfolders, LoopFilesStruct &lfs);
+	ResultType PerformLoopFileScan(ResultToken *aResultToken, Line *&aJumpToLine, Line *aUntil
+		, FileLoopModeType aFileLoopMode, LoopFilesStruct &lfs);
 	ResultType PerformLoopReg(ResultToken *aResultToken, Line *&aJumpToLine, Line *aUntil
 		, FileLoopModeType aFileLoopMode, bool aRecurseSubfolders, HKEY aRootKeyType, HKEY aRootKey, LPTSTR aRegSubkey);
 	ResultType PerformLoopParse(ResultToken *aResultToken, Line *&aJumpToLine, Line *aUntil);
@@ -1155,6 +1185,17 @@ public:
 				break;
 			case 'R':
 				mode |= FILE_LOOP_RECURSE;
+				if (*aBuf >= '0' && *aBuf <= '9') // Rn: Recurse at most n levels deep.
+				{
+					int depth = 0;
+					for (; *aBuf >= '0' && *aBuf <= '9'; ++aBuf)
+						if ((depth = depth * 10 + (*aBuf - '0')) > FILE_LOOP_DEPTH_LIMIT)
+							return FILE_LOOP_INVALID;
+					mode = (mode & ~(FILE_LOOP_DEPTH_LIMIT << FILE_LOOP_DEPTH_SHIFT)) | (depth << FILE_LOOP_DEPTH_SHIFT);
+				}
+				break;
+			case 'P': // Parallel
+				mode |= FILE_LOOP_PARALLEL;
 				break;
 			case ' ':  // Allow whitespace.
 			case '\t': //
@@ -1789,6 +1830,42 @@ public:
 };
 
 
+#ifdef ENABLE_DLLCALL
+struct DllSignature;
+
+BIF_DECL(BIF_DllProto);
+
+// A DllCall function whose address and parameter types have been resolved in advance.  It is
+// called like any other built-in function (via BIF_DllProto), so it appears on the call stack
+// and in error messages under the name of the DLL function.
+class DllProto : public BuiltInFunc
+{
+	void *mFunction;
+	HMODULE mModule; // A module loaded for this function, or NULL.
+	DllSignature *mSig;
+
+	DllProto(LPTSTR aName, void *aFunction, HMODULE aModule, DllSignature *aSig, int aParamCount)
+		: BuiltInFunc(aName, BIF_DllProto, aParamCount, aParamCount)
+		, mFunction(aFunction), mModule(aModule), mSig(aSig)
+	{
+		SetBase(sPrototype);
+	}
+
+	friend BIF_DECL(DllProto_Call);
+	friend BIF_DECL(BIF_DllProto);
+
+public:
+	static Object *sPrototype;
+
+	~DllProto();
+
+	// Unlike other built-in functions, these are created and deleted while the script runs.
+	void *operator new(size_t aBytes) { return malloc(aBytes); }
+	void operator delete(void *aPtr) { free(aPtr); }
+};
+#endif
+
+
 class BuiltInMethod : public NativeFunc
 {
 public:
@@ -1875,8 +1952,10 @@ private:
 	Object *mObject;
 	UINT mIndex = UINT_MAX;
 	Callback mGetItem;
+	bool mSeekable; // Each index corresponds to exactly one item.
 public:
-	IndexEnumerator(Object *aObject, int aVarCount, Callback aGetItem) : mObject(aObject), mGetItem(aGetItem)
+	IndexEnumerator(Object *aObject, int aVarCount, Callback aGetItem, bool aSeekable = false)
+		: mObject(aObject), mGetItem(aGetItem), mSeekable(aSeekable)
 	{
 		mObject->AddRef();
 		mParamCount = aVarCount;
@@ -1887,19 +1966,30 @@ public:
 		mObject->Release();
 	}
 	ResultType Next(Var *, Var *) override;
+	// Causes the next call to return item aIndex, if the enumerator supports it.
+	bool Seek(UINT aIndex)
+	{
+		if (!mSeekable)
+			return false;
+		mIndex = aIndex - 1;
+		return true;
+	}
 };
 
 
 
-class ScriptTimer
+class ScriptTimer : public TimerQueueItem // Queued in g_script.mTimerQueue while enabled, due at mTimeLastRun + mPeriod.
 {
 public:
 	IObjectRef mCallback;
 	DWORD mPeriod; // v1.0.36.33: Changed from int to DWORD to double its capacity.
-	DWORD mTimeLastRun;  // TickCount
+	UINT64 mTimeLastRun; // GetTickCount64(), which unlike GetTickCount() doesn't wrap around after 49.7 days.
+	DWORD mLateMax;      // The most that any run of this timer has been delayed past its due time, in ms.
+	UINT64 mLateTotal;   // Sum of delays, for calculating the average.
+	UINT mRunCount;      // Number of times the timer has been launched.
 	int mPriority;  // Thread priority relative to other threads, default 0.
 	UCHAR mExistingThreads;  // Whether this timer is already running its subroutine.
-	UCHAR mDeleteLocked;     // Lock count to prevent full deletion.  Separate to mExistingThreads so it doesn't prevent timer execution.
+	UINT mLastCheck;         // The call to CheckScriptTimers() which last launched this timer.
 	bool mEnabled;
 	bool mRunOnlyOnce;
 	ScriptTimer *mNextTimer;  // Next items in linked list
@@ -1908,8 +1998,8 @@ public:
 		#define DEFAULT_TIMER_PERIOD 250
 		: mCallback(aLabel), mPeriod(DEFAULT_TIMER_PERIOD), mPriority(0) // Default is always 0.
 		, mExistingThreads(0), mTimeLastRun(0)
+		, mLateMax(0), mLateTotal(0), mRunCount(0), mLastCheck(0)
 		, mEnabled(false), mRunOnlyOnce(false), mNextTimer(NULL)  // Note that mEnabled must default to false for the counts to be right.
-		, mDeleteLocked(0)
 	{}
 };
 
@@ -2158,6 +2248,9 @@ struct lv_attrib_type
 	lv_col_type col[LV_MAX_COLUMNS];
 	int col_count; // Number of columns currently in the above array.
 	int row_count_hint;
+	Array *data; // For a virtual (LVS_OWNERDATA) ListView bound by SetData(): an Array of row Arrays.
+	UINT *data_order; // Row permutation applied by sorting a virtual ListView, or NULL if unsorted.
+	UINT data_order_count;
 };
 
 typedef UCHAR TabControlIndexType;
@@ -2360,6 +2453,10 @@ struct GuiControlType : public Object
 	FResult LV_GetNext(optl<int> aStartIndex, optl<StrArg> aRowType, int &aRetVal);
 	FResult LV_GetText(int aRow, optl<int> aColumn, StrRet &aRetVal);
 	FResult LV_SetImageList(UINT_PTR aImageListID, optl<int> aIconType, UINT_PTR &aRetVal);
+	FResult LV_AddRows(ExprTokenType &aRows, optl<StrArg> aOptions, int &aRetVal);
+	FResult LV_SetData(ExprTokenType *aData);
+	void LV_GetDispInfo(LVITEM &aItem);
+	void LV_FreeData();
 	
 	FResult SB_SetIcon(StrArg aFilename, optl<int> aIconNumber, optl<UINT> aPartNumber, UINT_PTR &aRetVal);
 	FResult SB_SetParts(VariantParams &aParam, UINT& aRetVal);
@@ -2371,6 +2468,7 @@ struct GuiControlType : public Object
 	
 	FResult TV_AddModify(bool aAdd, UINT_PTR aItemID, UINT_PTR aParentItemID, optl<StrArg> aOptions, optl<StrArg> aName, UINT_PTR &aRetVal);
 	FResult TV_Add(StrArg aName, optl<UINT_PTR> aParentItemID, optl<StrArg> aOptions, UINT_PTR &aRetVal) { return TV_AddModify(true, 0, aParentItemID.value_or(0), aOptions, aName, aRetVal); }
+	FResult TV_AddTree(ExprTokenType &aTree, optl<UINT_PTR> aParentItemID, UINT &aRetVal);
 	FResult TV_Modify(UINT_PTR aItemID, optl<StrArg> aOptions, optl<StrArg> aNewName, UINT_PTR &aRetVal) { return TV_AddModify(false, aItemID, 0, aOptions, aNewName, aRetVal); }
 	FResult TV_Delete(optl<UINT_PTR> aItemID);
 	FResult TV_Get(UINT_PTR aItemID, StrArg aAttribute, UINT_PTR &aRetVal);
@@ -2763,6 +2861,7 @@ public:
 	void UpdateTabDialog(HWND aTabControlHwnd);
 	void ControlGetPosOfFocusedItem(GuiControlType &aControl, POINT &aPoint);
 	static void LV_Sort(GuiControlType &aControl, int aColumnIndex, bool aSortOnlyIfEnabled, TCHAR aForceDirection = '\0');
+	static void LV_SortData(GuiControlType &aControl, int aColumnIndex, bool aSortAscending);
 	static IObject *ControlGetActiveX(HWND aWnd);
 	
 	void UpdateAccelerators(UserMenu &aMenu);
@@ -2936,6 +3035,7 @@ public:
 
 	ScriptTimer *mFirstTimer, *mLastTimer;  // The first and last script timers in the linked list.
 	UINT mTimerCount, mTimerEnabledCount;
+	TimerQueue mTimerQueue; // Enabled timers ordered by due time, so CheckScriptTimers() needn't visit the others.
 
 	UserMenu *mFirstMenu, *mLastMenu;
 	UINT mMenuCount;
@@ -2967,6 +3067,7 @@ public:
 	bool mValidateThenExit;
 	LPTSTR mCmdLineInclude;
 #endif
+	LPTSTR mWorkerChannel; // The handles passed by /Worker=, if this script was started by a Worker object.
 
 	int mUninterruptedLineCountMax; // 32-bit for performance (since huge values seem unnecessary here).
 	int mUninterruptibleTime;
@@ -3194,6 +3295,7 @@ BIV_DECL_R (BIV_Space_Tab);
 BIV_DECL_R (BIV_AhkVersion);
 BIV_DECL_R (BIV_AhkPath);
 BIV_DECL_R (BIV_TickCount);
+BIV_DECL_R (BIV_TickCountPrecise);
 BIV_DECL_R (BIV_Now);
 BIV_DECL_R (BIV_OSVersion);
 BIV_DECL_R (BIV_Is64bitOS);
@@ -3233,6 +3335,7 @@ BIV_DECL_R (BIV_LoopField);
 BIV_DECL_RW(BIV_LoopIndex);
 BIV_DECL_R (BIV_ThisFunc);
 BIV_DECL_R (BIV_ThisHotkey);
+BIV_DECL_RW(BIV_PixelCacheTime);
 BIV_DECL_R (BIV_PriorHotkey);
 BIV_DECL_R (BIV_TimeSinceThisHotkey);
 BIV_DECL_R (BIV_TimeSincePriorHotkey);
@@ -3253,6 +3356,7 @@ BIV_DECL_R (BIV_ScreenDPI);
 #ifdef ENABLE_DLLCALL
 void *GetDllProcAddress(LPCTSTR aDllFileFunc, HMODULE *hmodule_to_free = NULL);
 BIF_DECL(BIF_DllCall);
+BIF_DECL(DllProto_Call);
 #endif
 
 BIF_DECL(BIF_StrCompare);
@@ -3421,6 +3525,65 @@ FResult ControlSetTab(HWND aHwnd, DWORD aTabIndex);
 FResult PixelSearch(BOOL *aFound, ResultToken *aFoundX, ResultToken *aFoundY
 	, int aLeft, int aTop, int aRight, int aBottom, COLORREF aColorRGB
 	, int aVariation, LPTSTR aGetColor);
+bool GetCachedScreenPixel(int aX, int aY, COLORREF &aColorRGB);
+
+// A rectangle of captured pixels, in 0x00RRGGBB format.
+struct PixelRegion
+{
+	LPCOLORREF pixel; // The top-left pixel of the region.
+	int width, height, stride; // stride is the number of pixels from one row to the next.
+	int left, top; // Screen coordinates of the top-left pixel.
+	bool is_16bit; // Pixels have already been masked with 0xF8F8F8 for a 16-bit display.
+};
+
+// A copy of part of the screen, kept in a DIB section so that it can be captured repeatedly
+// without allocating new buffers.
+class ScreenCapture
+{
+	HDC mDC = NULL;
+	HBITMAP mBitmap = NULL;
+	HGDIOBJ mOrigBitmap = NULL;
+	LPCOLORREF mPixel = nullptr;
+	int mLeft = 0, mTop = 0, mWidth = 0, mHeight = 0;
+	DWORD mTime = 0;
+	bool mIs16Bit = false;
+
+public:
+	~ScreenCapture() { Free(); }
+
+	bool Capture(int aLeft, int aTop, int aWidth, int aHeight);
+	bool Recapture() { return Capture(mLeft, mTop, mWidth, mHeight); }
+	void Free();
+	bool Contains(int aLeft, int aTop, int aRight, int aBottom);
+	bool GetRegion(int aLeft, int aTop, int aRight, int aBottom, PixelRegion &aRegion);
+	DWORD Age() { return GetTickCount() - mTime; }
+};
+
+class ScreenSnapshot : public Object
+{
+	ScreenCapture mCapture;
+
+	ScreenSnapshot() { SetBase(sPrototype); }
+
+public:
+	static Object *sPrototype;
+	static ObjectMemberMd sMembers[];
+	static int sMemberCount;
+
+	static Object *Create() { return new ScreenSnapshot(); }
+
+	FResult __New(int aX1, int aY1, int aX2, int aY2);
+	FResult Update();
+	FResult PixelGetColor(int aX, int aY, StrRet &aRetVal);
+	FResult PixelSearch(ResultToken *aFoundX, ResultToken *aFoundY
+		, int aX1, int aY1, int aX2, int aY2, UINT aColor, optl<int> aVariation, BOOL &aRetVal);
+	FResult ImageSearch(ResultToken *aFoundX, ResultToken *aFoundY
+		, int aX1, int aY1, int aX2, int aY2, StrArg aImageFile, BOOL &aRetVal);
+	FResult PixelSearchAll(int aX1, int aY1, int aX2, int aY2, UINT aColor
+		, optl<int> aVariation, optl<int> aMaxCount, IObject *&aRetVal);
+	FResult ImageSearchAll(int aX1, int aY1, int aX2, int aY2, StrArg aImageFile
+		, optl<int> aMaxCount, IObject *&aRetVal);
+};
 
 bool ColorToBGR(ExprTokenType &aColorNameOrRGB, COLORREF &aBGR);
 
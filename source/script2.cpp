@@ -21,6 +21,7 @@ GNU General Public License for more details.
 #include "application.h" // for MsgSleep()
 #include "script_func_impl.h"
 #include "abi.h"
+#include "SampleStats.h"
 
 
 
@@ -244,6 +245,25 @@ LRESULT CALLBACK MainWindowProc(HWND hWnd, UINT iMsg, WPARAM wParam, LPARAM lPar
 	case AHK_HOTSTRING: // Added for v1.0.36.02 so that hotstrings work even while an InputBox or other non-standard msg pump is running.
 	case AHK_CLIPBOARD_CHANGE: // Added for v1.0.44 so that clipboard notifications aren't lost while the script is displaying a MsgBox or other dialog.
 	case AHK_INPUT_END:
+	case AHK_HOOK_EVENT:
+	case AHK_WORKER_EVENT:
+		if (iMsg == AHK_HOOK_EVENT)
+		{
+			// Post the queued events individually, as the hook did before they were queued, so that
+			// the other pump treats them exactly as it always has.
+			RelayHookEvents();
+			if (IsInterruptible())
+				MsgSleep(-1, RETURN_AFTER_MESSAGES_SPECIAL_FILTER);
+			return 0;
+		}
+		if (iMsg == AHK_WORKER_EVENT)
+		{
+			// The message posted below might be discarded by the other pump, and the pool won't
+			// notify again until the events are retrieved, so ensure MsgSleep() retries later.
+			// The repost is marked as a retry so that MsgSleep() doesn't ignore it if it gets it.
+			RetryWorkerEventsLater();
+			wParam = TRUE;
+		}
 		// If the following facts are ever confirmed, there would be no need to post the message in cases where
 		// the MsgSleep() won't be done:
 		// 1) The mere fact that any of the above messages has been received here in MainWindowProc means that a
@@ -885,6 +905,24 @@ bif_impl void ListHotkeys()
 
 
 
+bif_impl FResult HookLatency(double aPercentile, optl<StrArg> aHook, double &aRetVal)
+{
+	if (!(aPercentile >= 0 && aPercentile <= 100)) // Written this way to also exclude NaN.
+		return FR_E_ARG(0);
+	LatencyHistogram *latency;
+	switch (ctoupper(*aHook.value_or(_T("K"))))
+	{
+	case 'K': latency = &g_KeybdHookStats.latency; break;
+	case 'M': latency = &g_MouseHookStats.latency; break;
+	case 'Q': latency = &g_HookEventDelay; break; // Delay between the hook queuing an event and MsgSleep() receiving it.
+	default: return FR_E_ARG(1);
+	}
+	aRetVal = HookLatencyToMicroseconds(latency->ValueAtPercentile(aPercentile));
+	return OK;
+}
+
+
+
 bif_impl FResult KeyHistory(optl<int> aMaxEvents)
 {
 	if (!aMaxEvents.has_value())
@@ -1899,6 +1937,139 @@ bool Line::FileIsFilteredOut(LoopFilesStruct &aCurrentFile, FileLoopModeType aFi
 
 
 
+struct FileScanHandle
+{
+	HANDLE search; // NULL if a search hasn't been started for the current phase.
+	enum { SCAN_SUBDIRS, SCAN_RECORDS, SCAN_DONE } phase;
+	size_t dir_length, short_dir_length;
+	TCHAR path[1]; // Allocated to the size of the consumer's path buffer.
+};
+
+
+FileScanLister::FileScanLister(LPCTSTR aDir, size_t aDirLength, LPCTSTR aPattern, size_t aPatternLength
+	, FileLoopModeType aMode, size_t aPathSize, size_t aShortDirLength, size_t aShortPathSize)
+	: mDirLength(aDirLength), mPattern(aPattern), mPatternLength(aPatternLength), mPathSize(aPathSize)
+	, mShortDirLength(aShortDirLength), mShortPathSize(aShortPathSize), mMode(aMode)
+{
+	if (mDir = tmalloc(aDirLength + 1))
+	{
+		tmemcpy(mDir, aDir, aDirLength);
+		mDir[aDirLength] = '\0';
+	}
+}
+
+
+UINT FileScanLister::ThreadCount()
+// Reading directories mostly waits on the file system (or network) rather than the CPU,
+// so use a few threads even if there's only one processor.
+{
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return si.dwNumberOfProcessors < 4 ? 4 : si.dwNumberOfProcessors > 8 ? 8 : si.dwNumberOfProcessors;
+}
+
+
+void *FileScanLister::Open(FileScan::Dir &aDir, bool aWantSubdirs)
+// Called on a worker thread or the consumer's thread.
+{
+	// Measure the path of aDir.  Read() has ensured that each sub-directory fits within the
+	// consumer's buffers.
+	size_t dir_length = mDirLength, short_dir_length = mShortDirLength;
+	for (auto dir = &aDir; dir->mParent; dir = dir->mParent)
+	{
+		dir_length += _tcslen(dir->mEntry.cFileName) + 1;
+		short_dir_length += _tcslen(*dir->mEntry.cAlternateFileName ? dir->mEntry.cAlternateFileName : dir->mEntry.cFileName) + 1;
+	}
+	if (dir_length + mPatternLength >= mPathSize) // Only possible for the root, where the pattern is too long.
+		return nullptr;
+	auto h = (FileScanHandle *)malloc(sizeof(FileScanHandle) + mPathSize * sizeof(TCHAR));
+	if (!h)
+		return nullptr;
+	// Build the path from the end, since the chain of directories runs from child to parent.
+	tmemcpy(h->path, mDir, mDirLength);
+	LPTSTR cp = h->path + dir_length;
+	for (auto dir = &aDir; dir->mParent; dir = dir->mParent)
+	{
+		*--cp = '\\';
+		size_t name_length = _tcslen(dir->mEntry.cFileName);
+		tmemcpy(cp -= name_length, dir->mEntry.cFileName, name_length);
+	}
+	h->search = NULL;
+	h->phase = aWantSubdirs ? FileScanHandle::SCAN_SUBDIRS : FileScanHandle::SCAN_RECORDS;
+	h->dir_length = dir_length;
+	h->short_dir_length = short_dir_length;
+	return h;
+}
+
+
+DirScanItem FileScanLister::Read(void *aHandle, WIN32_FIND_DATA &aRecord)
+// Sub-directories are read first so that other threads can start on them sooner, although
+// the consumer still receives all matching files before the contents of any sub-directory.
+{
+	auto &h = *(FileScanHandle *)aHandle;
+	for (;;)
+	{
+		if (h.phase == FileScanHandle::SCAN_DONE)
+			return DIRSCAN_ITEM_END;
+		BOOL found;
+		if (h.search)
+			found = FindNextFile(h.search, &aRecord);
+		else
+		{
+			tmemcpy(h.path + h.dir_length, h.phase == FileScanHandle::SCAN_SUBDIRS ? _T("*") : mPattern
+				, h.phase == FileScanHandle::SCAN_SUBDIRS ? 2 : mPatternLength + 1);
+			h.search = FindFirstFile(h.path, &aRecord);
+			if (h.search == INVALID_HANDLE_VALUE)
+				h.search = NULL;
+			found = h.search != NULL;
+		}
+		if (!found)
+		{
+			if (h.search)
+				FindClose(h.search);
+			h.search = NULL;
+			h.phase = h.phase == FileScanHandle::SCAN_SUBDIRS ? FileScanHandle::SCAN_RECORDS : FileScanHandle::SCAN_DONE;
+			continue;
+		}
+		bool is_dir = aRecord.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY;
+		if (is_dir && aRecord.cFileName[0] == '.' && (!aRecord.cFileName[1]      // Relies on short-circuit boolean order.
+				|| aRecord.cFileName[1] == '.' && !aRecord.cFileName[2])) //
+			continue;
+		if (h.phase == FileScanHandle::SCAN_SUBDIRS)
+		{
+			if (!is_dir)
+				continue;
+			// Skip any sub-directory whose path (plus the pattern or "*") wouldn't fit in the
+			// consumer's buffers, as a sequential file-loop would.
+			size_t name_length = _tcslen(aRecord.cFileName);
+			if (h.dir_length + name_length + 1 + (mPatternLength ? mPatternLength : 1) >= mPathSize)
+				continue;
+			if (mShortPathSize)
+			{
+				size_t short_name_length = *aRecord.cAlternateFileName ? _tcslen(aRecord.cAlternateFileName) : name_length;
+				if (h.short_dir_length + short_name_length + 1 >= mShortPathSize)
+					continue;
+			}
+			return DIRSCAN_ITEM_SUBDIR;
+		}
+		// Filter by mode here rather than in the consumer, to reduce the work done by the script's thread.
+		if (is_dir ? mMode == FILE_LOOP_FILES_ONLY : mMode == FILE_LOOP_FOLDERS_ONLY)
+			continue;
+		return DIRSCAN_ITEM_RECORD;
+	}
+}
+
+
+void FileScanLister::Close(void *aHandle)
+{
+	auto h = (FileScanHandle *)aHandle;
+	if (h->search)
+		FindClose(h->search);
+	free(h);
+}
+
+
+
 Label *Line::GetJumpTarget(bool aIsDereferenced)
 {
 	LPTSTR target_label = aIsDereferenced ? ARG1 : RAW_ARG1;
@@ -2546,15 +2717,126 @@ bif_impl FResult SetTimer(optl<IObject*> aFunction, optl<__int64> aPeriod, optl<
 		priority = aPriority.value();
 		update_priority = true;
 	}
-	g_script.UpdateOrCreateTimer(callback, update_period, period, update_priority, priority);
+	if (!g_script.UpdateOrCreateTimer(callback, update_period, period, update_priority, priority))
+		return FR_E_OUTOFMEM;
 	return OK;
 }
 
 
 
-bif_impl void ScriptSleep(int aDelay)
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+static void PreciseSleep(double aDelay)
+// Waits for aDelay milliseconds with sub-millisecond accuracy, checking messages the same
+// as MsgSleep() so that hotkeys, timers and GUI events can still interrupt the wait.
+{
+	double end_time = GetTickCountPrecise() + aDelay;
+	// MsgSleep()'s wake-ups are rounded up to the system tick (usually 15.6ms), so let it handle
+	// the bulk of a long wait and leave at least one tick of margin for the precise part below.
+	const double margin = 20;
+	if (aDelay > margin)
+		MsgSleep((int)(aDelay - margin));
+	// A high-resolution waitable timer (Windows 10 1803+) fires on time without raising the
+	// system-wide timer resolution via timeBeginPeriod().  On older systems, an ordinary timer
+	// is used, which still wakes on the next system tick rather than rounding up to a whole tick.
+	static HANDLE sTimer = NULL;
+	if (!sTimer)
+		sTimer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (!sTimer)
+		sTimer = CreateWaitableTimer(NULL, FALSE, NULL);
+	for (;;)
+	{
+		// Recalculate each iteration since a thread launched by MsgSleep() may have taken any amount
+		// of time, and may itself have used this timer.
+		double remaining = end_time - GetTickCountPrecise();
+		if (remaining <= 0)
+			break;
+		LARGE_INTEGER due;
+		due.QuadPart = -(LONGLONG)(remaining * 10000); // Negative means relative, in 100ns units.
+		if (!sTimer || !SetWaitableTimer(sTimer, &due, 0, NULL, NULL, FALSE))
+		{
+			MsgSleep((int)remaining + 1); // Fall back to the usual resolution.
+			break;
+		}
+		if (MsgWaitForMultipleObjects(1, &sTimer, FALSE, INFINITE, QS_ALLINPUT) != WAIT_OBJECT_0)
+			MsgSleep(-1); // Process whatever arrived, then resume waiting for the remainder.
+	}
+}
+
+bif_impl void ScriptSleep(double aDelay, optl<BOOL> aPrecise)
+{
+	if (aPrecise.value_or(FALSE) && aDelay > 0)
+		PreciseSleep(aDelay);
+	else
+		// Truncate fractions, as for Int32 parameters.  Out-of-range values are clamped since
+		// converting them to int would be undefined, and NaN is treated as 0.
+		MsgSleep(aDelay > INT_MAX ? INT_MAX : aDelay < INT_MIN ? INT_MIN : aDelay == aDelay ? (int)aDelay : 0);
+}
+
+
+
+bif_impl FResult Benchmark(IObject *aFunction, optl<int> aIterations, IObject *&aRetVal)
+{
+	int iterations = aIterations.value_or(100);
+	if (iterations < 1 || (size_t)iterations > SIZE_MAX / sizeof(double)) // The latter only applies to 32-bit builds.
+		return FR_E_ARG(1);
+	auto fr = ValidateFunctor(aFunction, 0);
+	if (fr != OK)
+		return fr;
+	double *sample = (double *)calloc(iterations, sizeof(double));
+	if (!sample)
+		return FR_E_OUTOFMEM;
+	// Warm up with a few untimed calls so that one-time costs such as the first evaluation of
+	// each expression or a COM DISPID lookup don't skew the results.
+	int warmup = iterations / 10;
+	if (warmup < 1) warmup = 1;
+	if (warmup > 100) warmup = 100;
+	ResultType result = OK;
+	for (int i = 0; i < warmup && result != FAIL && result != EARLY_EXIT; ++i)
+		result = CallMethod(aFunction, aFunction, nullptr);
+	for (int i = 0; i < iterations && result != FAIL && result != EARLY_EXIT; ++i)
+	{
+		double start = GetTickCountPrecise();
+		result = CallMethod(aFunction, aFunction, nullptr);
+		sample[i] = GetTickCountPrecise() - start;
+	}
+	if (result == FAIL || result == EARLY_EXIT)
+	{
+		free(sample);
+		return FR_FAIL;
+	}
+	SampleStats stats;
+	stats.Compute(sample, iterations);
+	free(sample);
+	ExprTokenType argt[] = {
+		_T("Min"), stats.minimum, _T("Median"), stats.median, _T("P99"), stats.p99,
+		_T("Mean"), stats.mean, _T("Max"), stats.maximum, _T("Iterations"), (__int64)iterations };
+	ExprTokenType *args[_countof(argt)];
+	for (size_t i = 0; i < _countof(argt); ++i)
+		args[i] = argt + i;
+	aRetVal = Object::Create(args, _countof(args));
+	return aRetVal ? OK : FR_E_OUTOFMEM;
+}
+
+
+
+bif_impl FResult HeapStats(IObject *&aRetVal)
+// Reports the memory used by the script's code, variable names and other persistent structures,
+// as shown by KeyHistory.  All sizes are in bytes.
 {
-	MsgSleep(aDelay);
+	SimpleHeapStats heap;
+	SimpleHeap::GetStats(heap);
+	ExprTokenType argt[] = {
+		_T("Reserved"), (__int64)heap.reserved, _T("Used"), (__int64)heap.used,
+		_T("Wasted"), (__int64)heap.wasted, _T("FreeListed"), (__int64)heap.free_listed,
+		_T("Large"), (__int64)heap.large, _T("Blocks"), (__int64)heap.blocks };
+	ExprTokenType *args[_countof(argt)];
+	for (size_t i = 0; i < _countof(argt); ++i)
+		args[i] = argt + i;
+	aRetVal = Object::Create(args, _countof(args));
+	return aRetVal ? OK : FR_E_OUTOFMEM;
 }
 
 
@@ -3243,7 +3525,7 @@ BOOL ResultToBOOL(LPTSTR aResult)
 	switch (IsNumeric(aResult, true, false, true)) // It's purely numeric and not all whitespace (and due to earlier check, it's not blank).
 	{
 	case PURE_INTEGER: return ATOI64(aResult) != 0; // Could call ATOF() for both integers and floats; but ATOI64() probably performs better, and a float comparison to 0.0 might be a slower than an integer comparison to 0.
-	case PURE_FLOAT:   return _tstof(aResult) != 0.0; // _tstof() vs. ATOF() because PURE_FLOAT is never hexadecimal.
+	case PURE_FLOAT:   return ATOF_NOHEX(aResult) != 0.0; // ATOF_NOHEX() vs. ATOF() because PURE_FLOAT is never hexadecimal.
 	default: // PURE_NOT_NUMERIC.
 		// Even a string containing all whitespace would be considered non-numeric since it's a non-blank string
 		// that isn't equal to 0.
@@ -3415,7 +3697,7 @@ double TokenToDouble(ExprTokenType &aToken, BOOL aCheckForHex)
 		case SYM_FLOAT:		return aToken.value_double;
 		case SYM_INTEGER:	return (double)aToken.value_int64;
 		case SYM_VAR:		return aToken.var->ToDouble();
-		case SYM_STRING:	return aCheckForHex ? ATOF(aToken.marker) : _tstof(aToken.marker); // atof() omits the check for hexadecimal.
+		case SYM_STRING:	return aCheckForHex ? ATOF(aToken.marker) : ATOF_NOHEX(aToken.marker);
 	}
 	// Since above didn't return, it can only be SYM_OBJECT or not an operand.
 	return 0;
@@ -3543,7 +3825,7 @@ ResultType TokenToDoubleOrInt64(const ExprTokenType &aInput, ExprTokenType &aOut
 		aOutput.value_int64 = ATOI64(str);
 		break;
 	case PURE_FLOAT:
-		aOutput.value_double = _tstof(str); // _tstof() vs. ATOF() because PURE_FLOAT is never hexadecimal.
+		aOutput.value_double = ATOF_NOHEX(str); // ATOF_NOHEX() vs. ATOF() because PURE_FLOAT is never hexadecimal.
 		break;
 	default: // Not a pure number.
 		return FAIL;
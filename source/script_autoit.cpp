@@ -181,6 +181,12 @@ bif_impl FResult PixelGetColor(int aX, int aY, optl<StrArg> aMode, StrRet &aRetV
 	CoordToScreen(aX, aY, COORD_MODE_PIXEL);
 	
 	bool use_alt_mode = tcscasestr(aOptions, _T("Alt")) != NULL; // New mode for v1.0.43.10: Two users reported that CreateDC works better in certain windows such as SciTE, at least one some systems.
+	COLORREF color;
+	if (!use_alt_mode && GetCachedScreenPixel(aX, aY, color)) // A_PixelCacheTime permits reuse of a recent PixelSearch/ImageSearch capture.
+	{
+		_stprintf(buf, _T("0x%06X"), color);
+		return OK;
+	}
 	HDC hdc = use_alt_mode ? CreateDC(_T("DISPLAY"), NULL, NULL, NULL) : GetDC(NULL);
 	if (!hdc)
 		return FR_E_WIN32;
@@ -190,7 +196,7 @@ bif_impl FResult PixelGetColor(int aX, int aY, optl<StrArg> aMode, StrRet &aRetV
 	// look at a hex BGR value to get some idea of the hue.  In addition, the result
 	// is zero padded to make it easier to convert to RGB and more consistent in
 	// appearance:
-	COLORREF color = GetPixel(hdc, aX, aY);
+	color = GetPixel(hdc, aX, aY);
 	if (use_alt_mode)
 		DeleteDC(hdc);
 	else
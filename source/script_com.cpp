@@ -4,6 +4,7 @@
 #include "script_object.h"
 #include "script_com.h"
 #include "script_func_impl.h"
+#include "SafeArrayLayout.h"
 #include <DispEx.h>
 
 
@@ -492,6 +493,65 @@ BIF_DECL(BIF_ComObjFlags)
 }
 
 
+static HRESULT ArrayToSafeArray(Array &aArray, VARTYPE aVarType, SAFEARRAY *&aArrayOut)
+// Creates a SAFEARRAY from aArray, locking it only once to convert all items.  If every item of
+// aArray is itself an Array (such as rows of cells), the result is 2-dimensional: [row, column].
+{
+	SAFEARRAYBOUND bound[2] = {{aArray.Length(), 0}, {0, 0}};
+	UINT dims = 1;
+	ExprTokenType item;
+	index_t i, j;
+	if (aArray.Length())
+	{
+		for (i = 0; i < aArray.Length(); ++i)
+		{
+			Array *row;
+			if (!aArray.ItemToToken(i, item) || !(row = dynamic_cast<Array *>(TokenToObject(item))))
+				break;
+			if (bound[1].cElements < row->Length())
+				bound[1].cElements = row->Length();
+		}
+		if (i == aArray.Length())
+			dims = 2;
+	}
+	if (   !(aArrayOut = SafeArrayCreate(aVarType, dims, bound))   )
+		return (aVarType > 1 && aVarType < 0x18 && aVarType != 0xF) ? E_OUTOFMEMORY : DISP_E_BADVARTYPE;
+	SafeArrayLayout layout;
+	ULONG count[] = { bound[0].cElements, bound[1].cElements };
+	layout.Init(dims, count);
+	char *data = nullptr;
+	HRESULT hr = SafeArrayAccessData(aArrayOut, (void **)&data);
+	UINT elem_size = SafeArrayGetElemsize(aArrayOut);
+	for (i = 0; SUCCEEDED(hr) && i < aArray.Length(); ++i)
+	{
+		aArray.ItemToToken(i, item);
+		if (dims == 1)
+		{
+			if (item.symbol != SYM_MISSING) // Leave unset items as VT_EMPTY/zero.
+				hr = TokenToVarType(item, aVarType, data + i * elem_size);
+			continue;
+		}
+		auto &row = *(Array *)TokenToObject(item);
+		for (j = 0; SUCCEEDED(hr) && j < row.Length(); ++j)
+		{
+			ExprTokenType cell;
+			row.ItemToToken(j, cell);
+			ULONG index[] = { i, j };
+			if (cell.symbol != SYM_MISSING)
+				hr = TokenToVarType(cell, aVarType, data + layout.Offset(index) * elem_size);
+		}
+	}
+	if (data)
+		SafeArrayUnaccessData(aArrayOut);
+	if (FAILED(hr))
+	{
+		SafeArrayDestroy(aArrayOut);
+		aArrayOut = nullptr;
+	}
+	return hr;
+}
+
+
 BIF_DECL(ComObjArray_Call)
 {
 	++aParam; // Exclude `this`
@@ -499,6 +559,23 @@ BIF_DECL(ComObjArray_Call)
 
 	Throw_if_Param_NaN(0);
 	VARTYPE vt = (VARTYPE)TokenToInt64(*aParam[0]);
+	if (aParamCount == 2)
+	{
+		// ComObjArray(VarType, ArrayObject): Create and fill the SAFEARRAY in one step.
+		if (auto arr = dynamic_cast<Array *>(TokenToObject(*aParam[1])))
+		{
+			SAFEARRAY *psa;
+			HRESULT hr = ArrayToSafeArray(*arr, vt, psa);
+			if (SUCCEEDED(hr))
+				_f_return(new ComObject((__int64)psa, VT_ARRAY | vt, ComObject::F_OWNVALUE));
+			if (hr == E_OUTOFMEMORY)
+				_f_throw_oom;
+			if (hr == DISP_E_BADVARTYPE)
+				_f_throw_param(0);
+			ComError(hr, aResultToken);
+			return;
+		}
+	}
 	SAFEARRAYBOUND bound[8]; // Same limit as ComObject::SafeArrayInvoke().
 	int dims = aParamCount - 1;
 	ASSERT(dims <= _countof(bound)); // Enforced by MaxParams.
@@ -1167,6 +1244,7 @@ ResultType ComObject::Invoke(IObject_Invoke_PARAMS_DECL)
 
 	DISPID dispid;
 	HRESULT	hr;
+	bool dispid_is_cached = false;
 	if ((aFlags & IF_NEWENUM) && (!aParamCount || ParamIndexToInt(0) <= 2))
 	{
 		hr = S_OK;
@@ -1187,8 +1265,16 @@ ResultType ComObject::Invoke(IObject_Invoke_PARAMS_DECL)
 		CStringWCharFromChar cnvbuf(aName);
 		LPOLESTR wname = (LPOLESTR)(LPCWSTR)cnvbuf;
 #endif
-		hr = mDispatch->GetIDsOfNames(IID_NULL, &wname, 1, LOCALE_USER_DEFAULT, &dispid);
-		if (hr == DISP_E_UNKNOWNNAME) // v1.1.18: Retry with IDispatchEx if supported, to allow creating new properties.
+		if (mDispIDCache.Find(aName, dispid))
+		{
+			hr = S_OK;
+			dispid_is_cached = true;
+		}
+		else if (SUCCEEDED(hr = mDispatch->GetIDsOfNames(IID_NULL, &wname, 1, LOCALE_USER_DEFAULT, &dispid)))
+		{
+			mDispIDCache.Add(aName, dispid);
+		}
+		else if (hr == DISP_E_UNKNOWNNAME) // v1.1.18: Retry with IDispatchEx if supported, to allow creating new properties.
 		{
 			if (IS_INVOKE_SET)
 			{
@@ -1262,6 +1348,30 @@ ResultType ComObject::Invoke(IObject_Invoke_PARAMS_DECL)
 		hr = mDispatch->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, flags[0], &dispparams, &varResult, &excepinfo, NULL);
 		if (hr == DISP_E_MEMBERNOTFOUND && flags[1]) // Only this particular HRESULT.
 			hr = mDispatch->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, flags[1], &dispparams, &varResult, &excepinfo, NULL);
+		if (hr == DISP_E_MEMBERNOTFOUND && dispid_is_cached)
+		{
+			// The member may have been deleted (e.g. via IDispatchEx) and possibly re-added with a new ID,
+			// so discard the cached ID and retry once with a fresh one.
+			DISPID old_dispid = dispid;
+			mDispIDCache.Remove(aName);
+#ifdef UNICODE
+			LPOLESTR wname = aName;
+#else
+			CStringWCharFromChar cnvbuf(aName);
+			LPOLESTR wname = (LPOLESTR)(LPCWSTR)cnvbuf;
+#endif
+			HRESULT lookup_hr = mDispatch->GetIDsOfNames(IID_NULL, &wname, 1, LOCALE_USER_DEFAULT, &dispid);
+			if (SUCCEEDED(lookup_hr))
+				mDispIDCache.Add(aName, dispid);
+			else
+				hr = lookup_hr; // The member no longer exists, so don't invoke DISPID_UNKNOWN.
+			if (SUCCEEDED(lookup_hr) && dispid != old_dispid) // Otherwise, the member simply doesn't support this operation.
+			{
+				hr = mDispatch->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, flags[0], &dispparams, &varResult, &excepinfo, NULL);
+				if (hr == DISP_E_MEMBERNOTFOUND && flags[1])
+					hr = mDispatch->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, flags[1], &dispparams, &varResult, &excepinfo, NULL);
+			}
+		}
 	}
 
 	for (int i = 0; i < aParamCount; i++)
@@ -1309,7 +1419,8 @@ ObjectMemberMd ComObject::sArrayMembers[]
 	md_member_x(ComObject, __Enum, SafeArray_Enum, CALL, (In_Opt, Int32, N), (Ret, Object, RetVal)),
 	md_member_x(ComObject, Clone, SafeArray_Clone, CALL, (Ret, Object, RetVal)),
 	md_member_x(ComObject, MaxIndex, SafeArray_MaxIndex, CALL, (In_Opt, UInt32, Dims), (Ret, Int32, RetVal)),
-	md_member_x(ComObject, MinIndex, SafeArray_MinIndex, CALL, (In_Opt, UInt32, Dims), (Ret, Int32, RetVal))
+	md_member_x(ComObject, MinIndex, SafeArray_MinIndex, CALL, (In_Opt, UInt32, Dims), (Ret, Int32, RetVal)),
+	md_member_x(ComObject, ToArray, SafeArray_ToArray, CALL, (Ret, Object, RetVal))
 };
 
 ObjectMember ComObject::sRefMembers[]
@@ -1448,6 +1559,107 @@ FResult ComObject::SafeArray_Item(VariantParams &aParam, ExprTokenType *aNewValu
 }
 
 
+static void SafeArrayItemToToken(VARTYPE aItemType, void *aItem, ResultToken &aToken)
+// Equivalent to VarTypeToToken(), but avoids VariantCopyInd() for the most common types.
+{
+	aToken.mem_to_free = nullptr;
+	switch (aItemType)
+	{
+	case VT_I1: aToken.SetValue((__int64)*(char *)aItem); break;
+	case VT_UI1: aToken.SetValue((__int64)*(BYTE *)aItem); break;
+	case VT_I2: aToken.SetValue((__int64)*(SHORT *)aItem); break;
+	case VT_UI2: aToken.SetValue((__int64)*(USHORT *)aItem); break;
+	case VT_INT:
+	case VT_I4: aToken.SetValue((__int64)*(LONG *)aItem); break;
+	case VT_UINT:
+	case VT_UI4: aToken.SetValue((__int64)*(ULONG *)aItem); break;
+	case VT_I8:
+	case VT_UI8: aToken.SetValue(*(__int64 *)aItem); break;
+	case VT_R4: aToken.SetValue((double)*(float *)aItem); break;
+	case VT_R8: aToken.SetValue(*(double *)aItem); break;
+	case VT_BOOL: aToken.SetValue((__int64)(*(VARIANT_BOOL *)aItem != VARIANT_FALSE)); break;
+	// For VT_VARIANT, the item is retained (not copied) since the caller copies the value.
+	case VT_VARIANT: VariantToToken(*(VARIANT *)aItem, aToken); break;
+	default: VarTypeToToken(aItemType, aItem, aToken); break;
+	}
+}
+
+
+struct SafeArrayShape
+{
+	char *data;
+	UINT elem_size;
+	VARTYPE item_type;
+	SafeArrayLayout layout;
+};
+
+static Array *SafeArrayToArray(SafeArrayShape &aShape, UINT aDim, size_t aOffset)
+// Converts the items of dimension aDim (0-based) starting at aOffset, recursing into the
+// following dimensions to produce nested Arrays.
+{
+	auto arr = Array::Create();
+	if (!arr)
+		return nullptr;
+	for (ULONG i = 0; i < aShape.layout.count[aDim]; ++i)
+	{
+		size_t offset = aOffset + i * aShape.layout.stride[aDim];
+		ResultToken item;
+		if (aDim + 1 < aShape.layout.dims)
+		{
+			auto sub = SafeArrayToArray(aShape, aDim + 1, offset);
+			if (!sub)
+			{
+				arr->Release();
+				return nullptr;
+			}
+			item.mem_to_free = nullptr;
+			item.SetValue(sub);
+		}
+		else
+			SafeArrayItemToToken(aShape.item_type, aShape.data + offset * aShape.elem_size, item);
+		bool ok = arr->Append(item);
+		item.Free();
+		if (!ok)
+		{
+			arr->Release();
+			return nullptr;
+		}
+	}
+	return arr;
+}
+
+
+FResult ComObject::SafeArray_ToArray(IObject *&aRetVal)
+{
+	SAFEARRAY *psa = mArray;
+	SafeArrayShape shape;
+	HRESULT hr;
+	UINT dims = SafeArrayGetDim(psa);
+	if (!dims || dims > SafeArrayLayout::MAX_DIMS)
+		return E_NOTIMPL;
+	ULONG count[SafeArrayLayout::MAX_DIMS];
+	for (UINT d = 0; d < dims; ++d)
+	{
+		LONG lbound, ubound;
+		if (   FAILED(hr = SafeArrayGetLBound(psa, d + 1, &lbound))
+			|| FAILED(hr = SafeArrayGetUBound(psa, d + 1, &ubound))   )
+			return hr;
+		count[d] = ubound >= lbound ? ubound - lbound + 1 : 0;
+	}
+	shape.layout.Init(dims, count);
+	shape.item_type = mVarType & VT_TYPEMASK;
+	shape.elem_size = SafeArrayGetElemsize(psa);
+	if (FAILED(hr = SafeArrayAccessData(psa, (void **)&shape.data)))
+		return hr;
+	auto arr = SafeArrayToArray(shape, 0, 0);
+	SafeArrayUnaccessData(psa);
+	if (!arr)
+		return FR_E_OUTOFMEM;
+	aRetVal = arr;
+	return OK;
+}
+
+
 LPTSTR ComObject::Type()
 {
 	if ((mVarType == VT_DISPATCH || mVarType == VT_UNKNOWN) && mUnknown)
@@ -1,4 +1,5 @@
 ﻿#pragma once
+#include "DispIDCache.h"
 
 
 extern bool g_ComErrorNotify;
@@ -49,6 +50,7 @@ public:
 		__int64 mVal64; // Allow 64-bit values when ComObject is used as a VARIANT in 32-bit builds.
 	};
 	ComEvent *mEventSink;
+	DispIDCachePtr mDispIDCache;
 	VARTYPE mVarType;
 	enum { F_OWNVALUE = 1 };
 	USHORT mFlags;
@@ -70,6 +72,7 @@ public:
 	FResult SafeArray_Enum(optl<int>, IObject *&aRetVal);
 	FResult SafeArray_MaxIndex(optl<UINT> aDims, int &aRetVal);
 	FResult SafeArray_MinIndex(optl<UINT> aDims, int &aRetVal);
+	FResult SafeArray_ToArray(IObject *&aRetVal);
 
 	ResultType Invoke(IObject_Invoke_PARAMS_DECL);
 	void Invoke(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount);
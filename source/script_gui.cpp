@@ -601,18 +601,21 @@ ObjectMemberMd GuiControlType::sMembersLV[] =
 	md_member_x(GuiControlType, GetCount, LV_GetCount, CALL, (In_Opt, String, Mode), (Ret, Int32, RetVal)),
 	md_member_x(GuiControlType, GetText, LV_GetText, CALL, (In, Int32, Row), (In_Opt, Int32, Column), (Ret, String, RetVal)),
 	md_member_x(GuiControlType, Add, LV_Add, CALL, (In_Opt, String, Options), (In, Params, Columns), (Ret, Int32, RetVal)),
+	md_member_x(GuiControlType, AddRows, LV_AddRows, CALL, (In, Variant, Rows), (In_Opt, String, Options), (Ret, Int32, RetVal)),
 	md_member_x(GuiControlType, Insert, LV_Insert, CALL, (In, Int32, Row), (In_Opt, String, Options), (In, Params, Columns), (Ret, Int32, RetVal)),
 	md_member_x(GuiControlType, Modify, LV_Modify, CALL, (In, Int32, Row), (In_Opt, String, Options), (In, Params, Columns)),
 	md_member_x(GuiControlType, Delete, LV_Delete, CALL, (In_Opt, Int32, Row)),
 	md_member_x(GuiControlType, InsertCol, LV_InsertCol, CALL, (In_Opt, Int32, Column), (In_Opt, String, Options), (In_Opt, String, Title), (Ret, Int32, RetVal)),
 	md_member_x(GuiControlType, ModifyCol, LV_ModifyCol, CALL, (In_Opt, Int32, Column), (In_Opt, String, Options), (In_Opt, String, Title)),
 	md_member_x(GuiControlType, DeleteCol, LV_DeleteCol, CALL, (In, Int32, Column)),
-	md_member_x(GuiControlType, SetImageList, LV_SetImageList, CALL, (In, UIntPtr, ImageListID), (In_Opt, Int32, IconType), (Ret, UIntPtr, RetVal))
+	md_member_x(GuiControlType, SetImageList, LV_SetImageList, CALL, (In, UIntPtr, ImageListID), (In_Opt, Int32, IconType), (Ret, UIntPtr, RetVal)),
+	md_member_x(GuiControlType, SetData, LV_SetData, CALL, (In_Opt, Variant, Data))
 };
 
 ObjectMemberMd GuiControlType::sMembersTV[] =
 {
 	md_member_x(GuiControlType, Add, TV_Add, CALL, (In, String, Name), (In_Opt, UIntPtr, ParentItemID), (In_Opt, String, Options), (Ret, UIntPtr, RetVal)),
+	md_member_x(GuiControlType, AddTree, TV_AddTree, CALL, (In, Variant, Tree), (In_Opt, UIntPtr, ParentItemID), (Ret, UInt32, RetVal)),
 	md_member_x(GuiControlType, Delete, TV_Delete, CALL, (In_Opt, UIntPtr, ItemID)),
 	md_member_x(GuiControlType, Get, TV_Get, CALL, (In, UIntPtr, ItemID), (In, String, Attribute), (Ret, UIntPtr, RetVal)),
 	md_member_x(GuiControlType, GetChild, TV_GetChild, CALL, (In, UIntPtr, ItemID), (Ret, UIntPtr, RetVal)),
@@ -2339,7 +2342,10 @@ void GuiControlType::Dispose()
 			DeleteObject(union_hbitmap);
 	}
 	else if (type == GUI_CONTROL_LISTVIEW) // It was ensured at an earlier stage that union_lv_attrib != NULL.
+	{
+		LV_FreeData();
 		free(union_lv_attrib);
+	}
 	else if (type == GUI_CONTROL_ACTIVEX && union_object)
 		union_object->Release();
 	//else do nothing, since this type has nothing more than a color stored in the union.
@@ -5616,6 +5622,8 @@ ResultType GuiType::ControlParseOptions(LPCTSTR aOptions, GuiControlOptionsType
 			else // Header is still clickable (unless above is *also* specified), but has no automatic sorting.
 				aOpt.listview_no_auto_sort = adding;
 		}
+		else if (aControl.type == GUI_CONTROL_LISTVIEW && !_tcsicmp(option, _T("Virtual"))) // Rows are provided by SetData() or LVN_GETDISPINFO.
+			if (adding) aOpt.style_add |= LVS_OWNERDATA; else aOpt.style_remove |= LVS_OWNERDATA; // Can't be changed after the control is created.
 		else if (aControl.type == GUI_CONTROL_LISTVIEW && !_tcsicmp(option, _T("Grid")))
 			if (adding) aOpt.listview_style |= LVS_EX_GRIDLINES; else aOpt.listview_style &= ~LVS_EX_GRIDLINES;
 		else if (!_tcsnicmp(option, _T("Count"), 5)) // Script should only provide the option for ListViews.
@@ -8585,6 +8593,11 @@ LRESULT CALLBACK GuiWindowProc(HWND hWnd, UINT iMsg, WPARAM wParam, LPARAM lPara
 
 			case LVN_DELETEALLITEMS:
 				return TRUE; // For performance, tell it not to notify us as each individual item is deleted.
+
+			case LVN_GETDISPINFO: // Only received by virtual ListViews, since other items never use LPSTR_TEXTCALLBACK.
+				if (control.union_lv_attrib->data) // Otherwise, leave it to the script's OnNotify callback, if any.
+					control.LV_GetDispInfo(((NMLVDISPINFO *)lParam)->item);
+				return 0;
 			} // switch(nmhdr.code).
 			break;
 
@@ -10867,6 +10880,14 @@ void GuiType::LV_Sort(GuiControlType &aControl, int aColumnIndex, bool aSortOnly
 	if ((col.sort_disabled && aSortOnlyIfEnabled) || item_count < 2) // This column cannot be sorted or doesn't need to be.
 		return; // Below relies on having returned here when control is empty or contains 1 item.
 
+	if (lv_attrib.data) // Virtual ListView: sort the bound data's row order instead of the items.
+	{
+		bool sort_ascending = aForceDirection ? aForceDirection == 'A'
+			: (aColumnIndex == lv_attrib.sorted_by_col && !col.unidirectional) ? !lv_attrib.is_now_sorted_ascending : !col.prefer_descending;
+		LV_SortData(aControl, aColumnIndex, sort_ascending);
+		return;
+	}
+
 	// Init any lvs members that are needed by both LV_Int32Sort and the other sorting functions.
 	// The new sort order is determined by the column's primary order unless the user clicked the current
 	// sort-column, in which case the direction is reversed (unless the column is unidirectional):
@@ -10954,6 +10975,97 @@ void GuiType::LV_Sort(GuiControlType &aControl, int aColumnIndex, bool aSortOnly
 
 
 
+struct LV_DataSortKey
+{
+	ExprTokenType cell; // The cell's value, converted to a number if the column is numeric.
+	UINT row; // Index of the row in the bound Array.
+	UINT pos; // Position before sorting, to keep the sort stable.
+};
+
+static lv_col_type sLVDataSortCol; // For LV_DataSort().  Sorting is never interrupted by another sort.
+static bool sLVDataSortAscending;
+
+static int __cdecl LV_DataSort(const void *a1, const void *a2)
+{
+	auto &k1 = *(LV_DataSortKey *)a1, &k2 = *(LV_DataSortKey *)a2;
+	int result;
+	switch (sLVDataSortCol.type)
+	{
+	case LV_COL_INTEGER:
+		result = k1.cell.value_int64 > k2.cell.value_int64 ? 1 : (k1.cell.value_int64 == k2.cell.value_int64 ? 0 : -1);
+		break;
+	case LV_COL_FLOAT:
+		result = k1.cell.value_double > k2.cell.value_double ? 1 : (k1.cell.value_double == k2.cell.value_double ? 0 : -1);
+		break;
+	default:
+	{
+		TCHAR buf1[MAX_NUMBER_SIZE], buf2[MAX_NUMBER_SIZE];
+		LPTSTR s1 = TokenToString(k1.cell, buf1), s2 = TokenToString(k2.cell, buf2);
+#ifdef UNICODE
+		if (sLVDataSortCol.case_sensitive == SCS_INSENSITIVE_LOGICAL)
+			result = StrCmpLogicalW(s1, s2);
+		else
+#endif
+			result = tcscmp2(s1, s2, sLVDataSortCol.case_sensitive);
+	}
+	}
+	if (!sLVDataSortAscending)
+		result = -result;
+	return result ? result : (k1.pos < k2.pos ? -1 : 1);
+}
+
+
+
+void GuiType::LV_SortData(GuiControlType &aControl, int aColumnIndex, bool aSortAscending)
+// Sorts a virtual ListView by computing a new row order for its bound Array, which is much faster
+// than sorting actual items since each cell is retrieved only once and no messages are sent.
+{
+	lv_attrib_type &lv_attrib = *aControl.union_lv_attrib;
+	UINT count = lv_attrib.data->Length();
+	auto keys = (LV_DataSortKey *)malloc(count * sizeof(LV_DataSortKey));
+	auto order = lv_attrib.data_order_count == count ? lv_attrib.data_order : (UINT *)malloc(count * sizeof(UINT));
+	if (!keys || !order)
+	{
+		free(keys);
+		if (order != lv_attrib.data_order)
+			free(order);
+		return;
+	}
+	lv_col_type &col = lv_attrib.col[aColumnIndex];
+	for (UINT i = 0; i < count; ++i)
+	{
+		LV_DataSortKey &key = keys[i];
+		key.pos = i;
+		key.row = lv_attrib.data_order == order ? order[i] : i; // Start from the current order, if any.
+		ExprTokenType row_token;
+		Array *row;
+		if (   !lv_attrib.data->ItemToToken(key.row, row_token)
+			|| !(row = dynamic_cast<Array *>(TokenToObject(row_token)))
+			|| !row->ItemToToken(aColumnIndex, key.cell)
+			|| key.cell.symbol == SYM_MISSING || key.cell.symbol == SYM_OBJECT   )
+			key.cell.SetValue(_T(""), 0);
+		if (col.type == LV_COL_INTEGER)
+			key.cell.SetValue(TokenToInt64(key.cell));
+		else if (col.type == LV_COL_FLOAT)
+			key.cell.SetValue(TokenToDouble(key.cell));
+	}
+	sLVDataSortCol = col;
+	sLVDataSortAscending = aSortAscending;
+	qsort(keys, count, sizeof(LV_DataSortKey), LV_DataSort);
+	for (UINT i = 0; i < count; ++i)
+		order[i] = keys[i].row;
+	free(keys);
+	if (lv_attrib.data_order != order) // The Array's length changed since the last sort.
+		free(lv_attrib.data_order);
+	lv_attrib.data_order = order;
+	lv_attrib.data_order_count = count;
+	lv_attrib.sorted_by_col = aColumnIndex;
+	lv_attrib.is_now_sorted_ascending = aSortAscending;
+	InvalidateRect(aControl.hwnd, NULL, FALSE);
+}
+
+
+
 #define MAX_ACCELERATORS 128
 
 void GuiType::UpdateAccelerators(UserMenu &aMenu)
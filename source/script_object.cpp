@@ -1490,7 +1490,7 @@ void Object::OwnProps(ResultToken &aResultToken, int aID, int aFlags, ExprTokenT
 void Map::__Enum(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount)
 {
 	_o_return(new IndexEnumerator(this, ParamIndexToOptionalInt(0, 0)
-		, static_cast<IndexEnumerator::Callback>(&Map::GetEnumItem)));
+		, static_cast<IndexEnumerator::Callback>(&Map::GetEnumItem), true));
 }
 
 void Object::HasOwnProp(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount)
@@ -2458,7 +2458,7 @@ void Array::Invoke(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType
 
 	case M___Enum:
 		_o_return(new IndexEnumerator(this, ParamIndexToOptionalInt(0, 0)
-			, static_cast<IndexEnumerator::Callback>(&Array::GetEnumItem)));
+			, static_cast<IndexEnumerator::Callback>(&Array::GetEnumItem), true));
 	}
 }
 
@@ -3223,8 +3223,10 @@ BufferObject *BufferObject::Create(void *aData, size_t aSize)
 ObjectMember BufferObject::sMembers[] =
 {
 	Object_Method(__New, 0, 2),
+	Object_Method1(Find, 1, 2),
 	Object_Property_get(Ptr),
-	Object_Property_get_set(Size)
+	Object_Property_get_set(Size),
+	Object_Method1(View, 1, 3)
 };
 
 void BufferObject::Invoke(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount)
@@ -3281,12 +3283,31 @@ void ClipboardAll::__New(ResultToken &aResultToken, int aID, int aFlags, ExprTok
 {
 	void *data;
 	size_t size;
+	// In case of explicit call to __New:
+	Unlink();
+	free(mFormat);
+	mFormat = nullptr;
+	mFormatCount = 0;
+	mSequence = 0;
 	if (!aParamCount)
 	{
 		// Retrieve clipboard contents.
 		if (!Var::GetClipboardAll(&data, &size))
 			_o_return_FAIL;
 	}
+	else if (!ParamIndexToObject(0) && !ParamIndexIsNumeric(0)
+		&& !_tcsicmp(ParamIndexToString(0, _f_number_buf), _T("Lazy")))
+	{
+		// Defer retrieval of the clipboard contents until they are needed.
+		if (!ParamIndexIsOmitted(1))
+			_o_throw_param(1);
+		free(mData);
+		mData = nullptr;
+		mSize = 0;
+		if (!InitLazy())
+			_o_return_FAIL;
+		return;
+	}
 	else
 	{
 		// Use caller-supplied data.
@@ -3324,6 +3345,276 @@ void ClipboardAll::__New(ResultToken &aResultToken, int aID, int aFlags, ExprTok
 }
 
 
+ResultType ClipboardAll::InitLazy()
+// Records which formats are on the clipboard, but not their data.  This avoids both the cost
+// of copying large contents which may never be used and forcing the owner to render formats
+// which it has placed on the clipboard with delayed rendering.
+{
+	DWORD sequence = GetClipboardSequenceNumber();
+	if (!sequence) // No access to the window station's clipboard sequence number, so changes can't be detected.
+		return Var::GetClipboardAll(&mData, &mSize);
+	if (!g_clip.Open())
+		return g_script.RuntimeError(CANT_OPEN_CLIPBOARD_READ);
+	UINT max_count = (UINT)CountClipboardFormats(), count = 0;
+	UINT *format_list = nullptr;
+	if (max_count && !(format_list = (UINT *)malloc(max_count * sizeof(UINT))))
+	{
+		g_clip.Close();
+		return MemoryError();
+	}
+	// Omit the same formats as Var::GetClipboardAll(), so that Formats is consistent before and
+	// after the data is copied.  See there for comments.
+	UINT format, dib_format_to_omit = 0;
+	for (format = 0; count < max_count && (format = EnumClipboardFormats(format)); )
+	{
+		switch (format)
+		{
+		case CF_BITMAP:
+		case CF_ENHMETAFILE:
+		case CF_DSPENHMETAFILE:
+		case CF_TEXT:
+		case CF_OEMTEXT:
+			continue;
+		}
+		if (format == dib_format_to_omit)
+			continue;
+		if (!dib_format_to_omit)
+		{
+			if (format == CF_DIB)
+				dib_format_to_omit = CF_DIBV5;
+			else if (format == CF_DIBV5)
+				dib_format_to_omit = CF_DIB;
+		}
+		format_list[count++] = format;
+	}
+	g_clip.Close();
+	if (!count) // Empty clipboard, so nothing to defer.
+	{
+		free(format_list);
+		return OK;
+	}
+	mFormat = format_list;
+	mFormatCount = count;
+	mSequence = sequence;
+	mNextLazy = sLazyList;
+	sLazyList = this;
+	return OK;
+}
+
+
+void ClipboardAll::Unlink()
+// Stops tracking this snapshot, either because its data has been copied or because the
+// clipboard has changed, in which case mSequence remains set so that Materialize() fails.
+{
+	for (ClipboardAll **link = &sLazyList; *link; link = &(*link)->mNextLazy)
+	{
+		if (*link == this)
+		{
+			*link = mNextLazy;
+			break;
+		}
+	}
+	mNextLazy = nullptr;
+}
+
+
+void ClipboardAll::Adopt(void *aData, size_t aSize)
+{
+	Unlink();
+	free(mFormat);
+	mFormat = nullptr;
+	mFormatCount = 0;
+	mSequence = 0;
+	mData = aData;
+	mSize = aSize;
+}
+
+
+ClipboardAll::~ClipboardAll()
+{
+	Unlink();
+	free(mFormat);
+}
+
+
+ResultType ClipboardAll::Materialize()
+// Copies the clipboard contents if this is a lazy snapshot which hasn't been copied yet.
+{
+	if (!mSequence)
+		return OK;
+	if (mSequence != GetClipboardSequenceNumber())
+	{
+		Unlink();
+		return g_script.RuntimeError(ERR_CLIPBOARD_CHANGED);
+	}
+	void *data;
+	size_t size;
+	if (!Var::GetClipboardAll(&data, &size))
+		return FAIL;
+	if (mSequence != GetClipboardSequenceNumber()) // Changed while the data was being copied.
+	{
+		free(data);
+		Unlink();
+		return g_script.RuntimeError(ERR_CLIPBOARD_CHANGED);
+	}
+	Adopt(data, size);
+	return OK;
+}
+
+
+ResultType ClipboardAll::MaterializeAll()
+// Called prior to the script changing the clipboard, so that lazy snapshots of the current
+// contents aren't lost.  Contents which were replaced by some other program are already lost.
+{
+	DWORD sequence = GetClipboardSequenceNumber();
+	ClipboardAll *source = nullptr;
+	while (ClipboardAll *cba = sLazyList)
+	{
+		if (cba->mSequence != sequence)
+			cba->Unlink();
+		else if (source)
+		{
+			// Duplicate the data already copied for an earlier snapshot of the same contents.
+			void *data = nullptr;
+			if (source->mSize && !(data = malloc(source->mSize)))
+				return MemoryError();
+			memcpy(data, source->mData, source->mSize);
+			cba->Adopt(data, source->mSize);
+		}
+		else
+		{
+			if (!cba->Materialize())
+				return FAIL;
+			source = cba;
+		}
+	}
+	return OK;
+}
+
+
+bool ClipboardAll::NextFormat(size_t &aOffset, UINT &aFormat, BYTE *&aData, UINT &aSize)
+// Steps through the (UINT format, UINT size, data) items of copied clipboard contents.
+{
+	const size_t header_size = sizeof(UINT) + sizeof(UINT);
+	if (mSize < header_size || aOffset > mSize - header_size)
+		return false;
+	BYTE *item = (BYTE *)mData + aOffset;
+	if (  !(aFormat = *(UINT *)item)  ) // Terminator.
+		return false;
+	aSize = *(UINT *)(item + sizeof(UINT));
+	aData = item + header_size;
+	if (aSize > mSize - aOffset - header_size) // Incomplete or corrupted data.
+		return false;
+	aOffset += header_size + aSize;
+	return true;
+}
+
+
+void ClipboardAll::Invoke(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount)
+{
+	if (aID == P_Formats)
+	{
+		auto formats = Array::Create();
+		if (!formats)
+			_o_throw_oom;
+		if (mSequence)
+		{
+			for (UINT i = 0; i < mFormatCount; ++i)
+				formats->Append((__int64)mFormat[i]);
+		}
+		else
+		{
+			UINT format, size;
+			BYTE *data;
+			for (size_t offset = 0; NextFormat(offset, format, data, size); )
+				formats->Append((__int64)format);
+		}
+		_o_return(formats);
+	}
+	if (!Materialize())
+		_o_return_FAIL;
+	BufferObject::Invoke(aResultToken, aID, aFlags, aParam, aParamCount);
+}
+
+
+void ClipboardAll::Find(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount)
+{
+	if (!Materialize())
+		_o_return_FAIL;
+	BufferObject::Find(aResultToken, aID, aFlags, aParam, aParamCount);
+}
+
+
+void ClipboardAll::View(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount)
+{
+	if (!Materialize())
+		_o_return_FAIL;
+	BufferObject::View(aResultToken, aID, aFlags, aParam, aParamCount);
+}
+
+
+void ClipboardAll::GetFormat(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount)
+// Returns a Buffer containing the data of one format, or "" if it is not present.
+{
+	Throw_if_Param_NaN(0);
+	UINT format = (UINT)ParamIndexToInt64(0);
+	void *data = nullptr;
+	size_t size = 0;
+	if (IsCurrent())
+	{
+		// Copy only the requested format, leaving the rest of the snapshot pending.
+		UINT i;
+		for (i = 0; i < mFormatCount && mFormat[i] != format; ++i);
+		if (i == mFormatCount)
+			_o_return_empty;
+		if (!g_clip.Open())
+			_o_throw(CANT_OPEN_CLIPBOARD_READ);
+		BOOL null_is_okay;
+		HGLOBAL hglobal = g_clip.GetClipboardDataTimeout(format, &null_is_okay);
+		if (!hglobal && !null_is_okay)
+		{
+			g_clip.Close();
+			_o_return_empty;
+		}
+		if (hglobal && (size = GlobalSize(hglobal)))
+		{
+			LPVOID hglobal_locked = GlobalLock(hglobal);
+			if (hglobal_locked && (data = malloc(size)))
+				memcpy(data, hglobal_locked, size);
+			if (hglobal_locked)
+				GlobalUnlock(hglobal);
+			else
+				size = 0; // Treat it the same as Var::GetClipboardAll() would, as though empty.
+		}
+		g_clip.Close();
+		if (size && !data)
+			_o_throw_oom;
+	}
+	else
+	{
+		if (!Materialize())
+			_o_return_FAIL;
+		UINT item_format, item_size;
+		BYTE *item_data;
+		bool found = false;
+		for (size_t offset = 0; !found && NextFormat(offset, item_format, item_data, item_size); )
+			found = item_format == format;
+		if (!found)
+			_o_return_empty;
+		if (item_size && !(data = malloc(size = item_size)))
+			_o_throw_oom;
+		memcpy(data, item_data, size);
+	}
+	auto buf = BufferObject::Create(data, size);
+	if (!buf)
+	{
+		free(data);
+		_o_throw_oom;
+	}
+	_o_return(buf);
+}
+
+
 Object *ClipboardAll::Create()
 {
 	auto obj = new ClipboardAll();
@@ -3334,7 +3625,13 @@ Object *ClipboardAll::Create()
 
 ObjectMember ClipboardAll::sMembers[]
 {
-	Object_Method1(__New, 0, 2)
+	Object_Method1(__New, 0, 2),
+	Object_Method1(Find, 1, 2),
+	Object_Property_get(Formats),
+	Object_Method1(GetFormat, 1, 1),
+	Object_Property_get(Ptr),
+	Object_Property_get_set(Size),
+	Object_Method1(View, 1, 3)
 };
 
 
@@ -3453,6 +3750,8 @@ void Object::CreateRootPrototypes()
 			{_T("ClipboardAll"), &ClipboardAll::sPrototype, NewObject<ClipboardAll>
 				, ClipboardAll::sMembers, _countof(ClipboardAll::sMembers)}
 		}},
+		{_T("BufferView"), &BufferView::sPrototype, no_ctor
+			, BufferView::sMembers, BufferView::sMemberCount},
 		{_T("Class"), &Object::sClassPrototype, {Class_New, 0, 2, true}},
 		{_T("Error"), &ErrorPrototype::Error, no_ctor, sErrorMembers, _countof(sErrorMembers), {
 			{_T("MemoryError"), &ErrorPrototype::Memory},
@@ -3475,6 +3774,9 @@ void Object::CreateRootPrototypes()
 		{_T("Func"), &Func::sPrototype, no_ctor, Func::sMembers, _countof(Func::sMembers), {
 			{_T("BoundFunc"), &BoundFunc::sPrototype},
 			{_T("Closure"), &Closure::sPrototype},
+#ifdef ENABLE_DLLCALL
+			{_T("DllProto"), &DllProto::sPrototype, {DllProto_Call, 2, 2, true}},
+#endif
 			{_T("Enumerator"), &EnumBase::sPrototype}
 		}},
 		{_T("Gui"), &GuiType::sPrototype, NewObject<GuiType>
@@ -3488,7 +3790,9 @@ void Object::CreateRootPrototypes()
 			{_T("MenuBar"), &UserMenu::sBarPrototype, NewObject<UserMenu::Bar>}
 		}},
 		{_T("RegExMatchInfo"), &RegExMatchObject::sPrototype, no_ctor
-			, RegExMatchObject::sMembers, _countof(RegExMatchObject::sMembers)}
+			, RegExMatchObject::sMembers, _countof(RegExMatchObject::sMembers)},
+		{_T("ScreenSnapshot"), &ScreenSnapshot::sPrototype, NewObject<ScreenSnapshot>
+			, ScreenSnapshot::sMembers, ScreenSnapshot::sMemberCount}
 	});
 
 	// Parameter counts are specified for static Call in the following classes
@@ -3516,6 +3820,9 @@ void Object::CreateRootPrototypes()
 	GuiControlType::DefineControlClasses();
 	DefineComPrototypeMembers();
 	DefineFileClass();
+	DefineFileTaskClass();
+	DefineJSONClass();
+	DefineWorkerClass();
 
 	// Permit Object.Call to construct Error objects.
 	ErrorPrototype::Error->mFlags &= ~NativeClassPrototype;
@@ -3538,6 +3845,7 @@ Object *EnumBase::sPrototype;
 
 Object *BufferObject::sPrototype;
 Object *ClipboardAll::sPrototype;
+ClipboardAll *ClipboardAll::sLazyList;
 
 Object *RegExMatchObject::sPrototype;
 
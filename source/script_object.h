@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "MdType.h"
+#include "BufferKernels.h"
 
 #define INVOKE_TYPE			(aFlags & IT_BITMASK)
 #define IS_INVOKE_SET		(aFlags & IT_SET)
@@ -574,6 +575,8 @@ public:
 #ifdef CONFIG_DEBUGGER
 	friend class Debugger;
 #endif
+	friend class JSON;
+	friend class Worker;
 };
 
 
@@ -645,6 +648,9 @@ public:
 	static ObjectMember sMembers[];
 	static Object *sPrototype;
 	void Invoke(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount);
+
+	friend class JSON;
+	friend class Worker;
 };
 
 
@@ -774,6 +780,22 @@ public:
 
 	ResultType SetItems(ExprTokenType *aParam[], int aParamCount);
 
+	// Retrieves the key and value at aIndex, in enumeration order.
+	bool ItemAt(index_t aIndex, ExprTokenType &aKey, ExprTokenType &aValue)
+	{
+		if (aIndex >= mCount)
+			return false;
+		auto &item = mItem[aIndex];
+		if (aIndex >= mKeyOffsetString)
+			aKey.SetValue(item.key.s);
+		else if (aIndex >= mKeyOffsetObject)
+			aKey.SetValue(item.key.p);
+		else
+			aKey.SetValue(item.key.i);
+		item.ToToken(aValue);
+		return true;
+	}
+
 	// Methods callable by script.
 	void __Item(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount);
 	void Set(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount);
@@ -788,6 +810,9 @@ public:
 
 	static ObjectMember sMembers[];
 	static Object *sPrototype;
+
+	friend class JSON;
+	friend class Worker;
 };
 
 
@@ -882,12 +907,78 @@ public:
 	static Object *sPrototype;
 	static BufferObject *Create(void *aData = nullptr, size_t aSize = 0);
 	void Invoke(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount);
+	void Find(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount);
+	void View(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount);
 
 	static void *sVTable;
 	static bool IsInstanceExact(IObject *aObj) { return *(void **)aObj == sVTable; } // Benchmarked a little faster than aObj->IsOfType(BufferObject::sPrototype);
 };
 
 
+//
+// BufferView: Indexed access to a range of numbers of one type within a Buffer.
+//
+
+class BufferView : public Object
+{
+	BufferObject *mBuffer;
+	size_t mOffset; // In bytes.
+	size_t mLength; // In elements; ignored if !mFixedLength.
+	NumKind mKind;
+	bool mFixedLength; // If false, the view extends to the end of the buffer, even as it is resized.
+
+	BufferView(BufferObject *aBuffer, NumKind aKind, size_t aOffset, size_t aLength, bool aFixedLength)
+		: mBuffer(aBuffer), mOffset(aOffset), mLength(aLength), mKind(aKind), mFixedLength(aFixedLength)
+	{
+		mBuffer->AddRef();
+		SetBase(sPrototype);
+	}
+
+	size_t ElementSize() { return NumKindSize(mKind); }
+	FResult CheckBounds();
+	FResult GetRange(optl<__int64> aStart, optl<__int64> aCount, int aStartArg, BYTE *&aData, size_t &aItemCount);
+	FResult GetItem(__int64 aIndex, BYTE *&aItem);
+	FResult TokenToNum(ExprTokenType &aToken, NumValue &aValue);
+	void NumToToken(NumValue aValue, ResultToken &aToken);
+	FResult Reduce(NumValue (*aOp)(const void *, size_t, NumKind), optl<__int64> aStart, optl<__int64> aCount, ResultToken &aRetVal);
+
+public:
+	~BufferView() { mBuffer->Release(); }
+
+	static Object *sPrototype;
+	static ObjectMemberMd sMembers[];
+	static int sMemberCount;
+
+	static bool ParseType(LPCTSTR aType, NumKind &aKind);
+	static BufferView *Create(BufferObject *aBuffer, NumKind aKind, size_t aOffset, size_t aLength, bool aFixedLength)
+	{
+		return new BufferView(aBuffer, aKind, aOffset, aLength, aFixedLength);
+	}
+
+	size_t Length();
+
+	FResult __Enum(optl<int> aVarCount, IObject *&aRetVal);
+	FResult get___Item(__int64 aIndex, ResultToken &aRetVal);
+	FResult set___Item(ExprTokenType &aValue, __int64 aIndex);
+	FResult Assign(IObject *aValues, optl<__int64> aStart);
+	FResult CopyWithin(__int64 aTarget, __int64 aStart, optl<__int64> aCount);
+	FResult Fill(ExprTokenType &aValue, optl<__int64> aStart, optl<__int64> aCount);
+	FResult Max(optl<__int64> aStart, optl<__int64> aCount, ResultToken &aRetVal);
+	FResult Min(optl<__int64> aStart, optl<__int64> aCount, ResultToken &aRetVal);
+	FResult Sum(optl<__int64> aStart, optl<__int64> aCount, ResultToken &aRetVal);
+	FResult ToArray(optl<__int64> aStart, optl<__int64> aCount, IObject *&aRetVal);
+
+	FResult get_Buffer(IObject *&aRetVal) { mBuffer->AddRef(); aRetVal = mBuffer; return OK; }
+	FResult get_Length(UINT_PTR &aRetVal) { aRetVal = Length(); return OK; }
+	FResult get_Offset(UINT_PTR &aRetVal) { aRetVal = mOffset; return OK; }
+	FResult get_Ptr(UINT_PTR &aRetVal);
+	FResult get_Size(UINT_PTR &aRetVal);
+	FResult get_Type(StrRet &aRetVal);
+
+	ResultType GetEnumItem(UINT &aIndex, Var *, Var *, int);
+};
+
+
 //
 // ClipboardAll: Represents a blob of clipboard data (all formats retrieved from clipboard).
 //
@@ -895,19 +986,52 @@ public:
 class ClipboardAll : public BufferObject
 {
 private:
+	// Lazy snapshots record only the clipboard's sequence number and format list, deferring
+	// the copy until the data is needed.  mSequence is non-zero only while the copy is pending.
+	DWORD mSequence = 0;
+	UINT *mFormat = nullptr;
+	UINT mFormatCount = 0;
+	ClipboardAll *mNextLazy = nullptr;
+	static ClipboardAll *sLazyList;
+
 	ClipboardAll() : BufferObject() {}
+	ResultType InitLazy();
+	void Unlink();
+	void Adopt(void *aData, size_t aSize);
+	bool NextFormat(size_t &aOffset, UINT &aFormat, BYTE *&aData, UINT &aSize);
 
 public:
 	static ObjectMember sMembers[];
 	static Object *sPrototype;
 	static Object *Create();
+
+	~ClipboardAll();
+
+	bool IsPending() { return mSequence != 0; }
+	bool IsCurrent() { return mSequence && mSequence == GetClipboardSequenceNumber(); }
+	ResultType Materialize();
+	static ResultType MaterializeAll();
+
+	enum MemberID
+	{
+		P_Ptr = BufferObject::P_Ptr,
+		P_Size = BufferObject::P_Size,
+		P_Formats
+	};
 	void __New(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount);
+	void Invoke(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount);
+	void Find(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount);
+	void View(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount);
+	void GetFormat(ResultToken &aResultToken, int aID, int aFlags, ExprTokenType *aParam[], int aParamCount);
 };
 
 
 
 void DefineComPrototypeMembers();
 void DefineFileClass();
+void DefineFileTaskClass();
+void DefineJSONClass();
+void DefineWorkerClass();
 
 
 
@@ -3261,7 +3261,9 @@ int FTOA(double aValue, LPTSTR aBuf, int aBufSize)
 // Numbers printed in scientific notation may not contain a decimal point.
 // Caller must ensure there is sufficient buffer size to avoid truncating the output.
 {
-	int result = sntprintf(aBuf, aBufSize, _T("%.17g"), aValue);
+	int result = aBufSize >= FLOAT17G_BUF_SIZE ? FormatFloat17g(aValue, aBuf) : -1;
+	if (result < 0) // Not handled by the fast path (such as for inf/nan), or the buffer is unusually small.
+		result = sntprintf(aBuf, aBufSize, _T("%.17g"), aValue);
 	
 	// the 'g' specifier might cause the result to lack a decimal point. 
 	// If the number is not written in scientific notation, and lacks a decimal point,
@@ -3370,6 +3372,27 @@ BOOLEAN __stdcall GenRandom(PVOID RandomBuffer, ULONG RandomBufferLength)
 
 
 
+double GetTickCountPrecise()
+// Returns the number of milliseconds since the system started, like GetTickCount64() but based on
+// the performance counter, so it has sub-microsecond resolution rather than that of the system tick.
+// The counter is monotonic and consistent across processors on all supported OSes.
+{
+	static LONGLONG sFrequency = 0;
+	if (!sFrequency)
+	{
+		LARGE_INTEGER freq;
+		QueryPerformanceFrequency(&freq); // Never fails on XP and later.
+		sFrequency = freq.QuadPart;
+	}
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	// Split into whole seconds and the remainder to avoid losing precision once the
+	// counter exceeds the 53 bits which a double can represent exactly.
+	return (now.QuadPart / sFrequency) * 1000.0 + (now.QuadPart % sFrequency) * 1000.0 / sFrequency;
+}
+
+
+
 #if defined(_MSC_VER) && defined(_DEBUG)
 void OutputDebugStringFormat(LPCTSTR fmt, ...)
 {
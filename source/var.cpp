@@ -470,6 +470,8 @@ ResultType Var::GetClipboardAll(void **aData, size_t *aDataSize)
 
 ResultType Var::SetClipboardAll(void *aData, size_t aDataSize)
 {
+	if (!ClipboardAll::MaterializeAll())
+		return FAIL;
 	if (!g_clip.Open())
 		return g_script.RuntimeError(CANT_OPEN_CLIPBOARD_WRITE);
 	EmptyClipboard(); // Failure is not checked for since it's probably impossible under these conditions.
@@ -595,6 +597,11 @@ ResultType Var::AssignString(LPCTSTR aBuf, VarSizeType aLength, bool aExactSize)
 	// will be ended.
 	// Another reason is that it seems more consistent with other causes of failure, such as for `x := 0/0`.
 
+	// SimpleHeap memory this var has outgrown.  SimpleHeap::Free() leaves it intact until no threads are
+	// running, since aBuf or the caller (such as Append() when aBuf is NULL) may still be reading from it.
+	char *outgrown_mem = NULL;
+	size_t outgrown_size = 0;
+
 	if (space_needed_in_bytes > mByteCapacity)
 	{
 		size_t new_size; // Use a new name, rather than overloading space_needed, for maintainability.
@@ -625,10 +632,15 @@ ResultType Var::AssignString(LPCTSTR aBuf, VarSizeType aLength, bool aExactSize)
 						new_size = _TSIZE(MAX_ALLOC_SIMPLE);
 				}
 				// In the case of mHowAllocated==ALLOC_SIMPLE, the following will allocate another block
-				// from SimpleHeap even though the var already had one. This is by design because it can
-				// happen only a limited number of times per variable. See comments further above for details.
+				// from SimpleHeap even though the var already had one.  The old block is returned to
+				// SimpleHeap further below so that other variables can reuse it once it is safe to do so.
 				if (   !(new_mem = (char *) SimpleHeap::Malloc(new_size))   )
 					return MemoryError(); // Leave all var members unchanged so that they're consistent with each other.
+				if (mHowAllocated == ALLOC_SIMPLE && mByteCapacity)
+				{
+					outgrown_mem = mByteContents;
+					outgrown_size = mByteCapacity;
+				}
 				mHowAllocated = ALLOC_SIMPLE;  // In case it was previously ALLOC_NONE. This step must be done only after the alloc succeeded.
 				break;
 			}
@@ -691,6 +703,11 @@ ResultType Var::AssignString(LPCTSTR aBuf, VarSizeType aLength, bool aExactSize)
 				// Below is necessary because it might have fallen through from case ALLOC_SIMPLE.
 				// This step must be done only after the alloc succeeded (because otherwise, we want to keep it
 				// set to ALLOC_SIMPLE (fall-through), if that's what it was).
+				if (mHowAllocated == ALLOC_SIMPLE && mByteCapacity)
+				{
+					outgrown_mem = mByteContents;
+					outgrown_size = mByteCapacity;
+				}
 				mHowAllocated = ALLOC_MALLOC;
 			}
 			break;
@@ -737,6 +754,9 @@ ResultType Var::AssignString(LPCTSTR aBuf, VarSizeType aLength, bool aExactSize)
 		mAttrib |= VAR_ATTRIB_VIRTUAL_OPEN;
 	}
 
+	if (outgrown_mem)
+		SimpleHeap::Free(outgrown_mem, outgrown_size);
+
 	// Writing to union is safe because above already ensured that "this" isn't an alias.
 	mByteLength = aLength * sizeof(TCHAR); // aLength was verified accurate higher above.
 
@@ -920,7 +940,8 @@ void Var::Free(int aWhenToFree)
 		// The last step above would be a problem because the 2nd ALLOC_SIMPLE can't
 		// reclaim the spot in SimpleHeap that had been in use by the first.  In other
 		// words, when a var makes the transition from ALLOC_SIMPLE to ALLOC_MALLOC,
-		// its ALLOC_SIMPLE memory is lost to the system until the program exits.
+		// its ALLOC_SIMPLE memory is given up (to SimpleHeap's free lists, where only
+		// another small allocation can reuse it) until the program exits.
 		// But since this loss occurs at most once per distinct variable name,
 		// it's not considered a memory leak because the loss can't exceed a fixed
 		// amount regardless of how long the program runs.  The reason for all of this
@@ -20,6 +20,7 @@ GNU General Public License for more details.
 #include "application.h" // for MsgSleep()
 #include "psapi.h" // for ahk_exe
 #include <dwmapi.h>
+#include "WindowAttribCache.h"
 
 
 HWND WinActivate(global_struct &aSettings, LPTSTR aTitle, LPTSTR aText, LPTSTR aExcludeTitle, LPTSTR aExcludeText
@@ -1519,28 +1520,70 @@ void WindowSearch::SetCriteria(global_struct &aSettings, WinGroup &aGroup)
 
 
 
+// The Win32 side of WindowAttribCache.
+struct Win32WindowInfo : WindowInfoSource
+{
+	DWORD ThreadProcessID(HWND aWnd, DWORD &aPID) override
+	{
+		return GetWindowThreadProcessId(aWnd, &aPID);
+	}
+	void ClassName(HWND aWnd, LPTSTR aBuf, int aBufSize) override
+	{
+		if (!GetClassName(aWnd, aBuf, aBufSize))
+			*aBuf = '\0';
+	}
+	void ProcessName(DWORD aPID, LPTSTR aBuf, DWORD aBufSize, bool aNameOnly) override
+	{
+		GetProcessName(aPID, aBuf, aBufSize, aNameOnly); // Sets aBuf to "" on failure.
+	}
+};
+static Win32WindowInfo sWin32WindowInfo;
+static WindowAttribCache<WINDOW_CLASS_SIZE, MAX_PATH> sWindowAttribCache;
+
+static void GetWindowAttributes(HWND aWnd, DWORD aWhich, bool aPathIsNameOnly
+	, DWORD &aPID, LPTSTR aClass, LPTSTR aPath)
+// Retrieves the attributes indicated by aWhich (CRITERION_PID, CRITERION_CLASS and/or CRITERION_PATH).
+// aClass must have room for WINDOW_CLASS_SIZE chars and aPath for MAX_PATH chars.
+{
+	DWORD pid = sWindowAttribCache.Get(sWin32WindowInfo, aWnd
+		, (aWhich & CRITERION_CLASS) ? aClass : NULL, (aWhich & CRITERION_PATH) ? aPath : NULL, aPathIsNameOnly);
+	if (aWhich & CRITERION_PID)
+		aPID = pid;
+}
+
+
+
 void WindowSearch::UpdateCandidateAttributes()
 // This function must be kept thread-safe because it may be called (indirectly) by hook thread too.
+// Attributes which were already retrieved for the current candidate are not retrieved again, so
+// that evaluating several sets of criteria against one window (such as for each WindowSpec of a
+// WinGroup) retrieves each attribute at most once.
 {
 	// Nothing to do until SetCandidate() is called with a non-NULL candidate and SetCriteria()
 	// has been called for the first time (otherwise, mCriterionExcludeTitle and other things
 	// are not yet initialized:
 	if (!mCandidateParent || !mCriteria)
 		return;
-	if ((mCriteria & CRITERION_TITLE) || *mCriterionExcludeTitle) // Need the window's title in both these cases.
+	if (((mCriteria & CRITERION_TITLE) || *mCriterionExcludeTitle) // Need the window's title in both these cases.
+		&& !(mCandidateFetched & CRITERION_TITLE))
+	{
 		if (!GetWindowText(mCandidateParent, mCandidateTitle, _countof(mCandidateTitle)))
 			*mCandidateTitle = '\0'; // Failure or blank title is okay.
-	if (mCriteria & CRITERION_PID) // In which case mCriterionPID should already be filled in, though it might be an explicitly specified zero.
-		GetWindowThreadProcessId(mCandidateParent, &mCandidatePID);
-	if (mCriteria & CRITERION_PATH)
+		mCandidateFetched |= CRITERION_TITLE;
+	}
+	// For CRITERION_PID, mCriterionPID should already be filled in, though it might be an explicitly specified zero.
+	DWORD need = mCriteria & (CRITERION_PID | CRITERION_CLASS | CRITERION_PATH);
+	if ((need & CRITERION_PATH) && mCandidatePathIsNameOnly != mCriterionPathIsNameOnly)
+		mCandidateFetched &= ~CRITERION_PATH; // Path was retrieved in the other format.
+	if (need &= ~mCandidateFetched)
 	{
-		DWORD dwPid;
-		if (GetWindowThreadProcessId(mCandidateParent, &dwPid))
-			if (!GetProcessName(dwPid, mCandidatePath, _countof(mCandidatePath), mCriterionPathIsNameOnly))
-				*mCandidatePath = '\0';
+		bool path_is_name_only = (need & CRITERION_PATH) && mCriterionPathIsNameOnly;
+		GetWindowAttributes(mCandidateParent, need, path_is_name_only
+			, mCandidatePID, mCandidateClass, mCandidatePath);
+		mCandidateFetched |= need;
+		if (need & CRITERION_PATH)
+			mCandidatePathIsNameOnly = path_is_name_only;
 	}
-	if (mCriteria & CRITERION_CLASS)
-		GetClassName(mCandidateParent, mCandidateClass, _countof(mCandidateClass)); // Limit to WINDOW_CLASS_SIZE in this case since that's the maximum that can be searched.
 	// Nothing to do for these:
 	//CRITERION_GROUP:    Can't be pre-processed at this stage.
 	//CRITERION_ID:       It is mCandidateParent, which has already been set by SetCandidate().
@@ -124,6 +124,8 @@ public:
 	TCHAR mCandidateTitle[WINDOW_TEXT_SIZE];  // For storing title or class name of the given mCandidateParent.
 	TCHAR mCandidateClass[WINDOW_CLASS_SIZE]; // Must not share mem with mCandidateTitle because even if ahk_class is in effect, ExcludeTitle can also be in effect.
 	TCHAR mCandidatePath[MAX_PATH]; // MAX_PATH vs. T_MAX_PATH because it currently seems to be impossible to run an executable with a longer path (in Windows 10.0.16299).
+	DWORD mCandidateFetched;        // Which of the above (CRITERION_TITLE/PID/CLASS/PATH) are valid for mCandidateParent.
+	bool mCandidatePathIsNameOnly;  // Whether mCandidatePath is just the name, as for mCriterionPathIsNameOnly.
 
 
 	void SetCandidate(HWND aWnd) // Must be kept thread-safe since it may be called indirectly by the hook thread.
@@ -132,6 +134,7 @@ public:
 		if (mCandidateParent != aWnd)
 		{
 			mCandidateParent = aWnd;
+			mCandidateFetched = 0;
 			UpdateCandidateAttributes(); // In case mCandidateParent isn't NULL, update the PID/Class/etc. based on what was set above.
 		}
 	}
@@ -148,7 +151,7 @@ public:
 		, mCriterionBuf(NULL), mCriterionBufSize(0)
 		, mFoundCount(0), mFoundParent(NULL) // Must be initialized here since none of the member functions is allowed to do it.
 		, mFoundChild(NULL) // ControlExist() relies upon this.
-		, mCandidateParent(NULL)
+		, mCandidateParent(NULL), mCandidateFetched(0)
 		// The following must be initialized because it's the object user's responsibility to override
 		// them in those relatively rare cases when they need to be.  WinGroup::ActUponAll() and
 		// WinGroup::Deactivate() (and probably other callers) rely on these attributes being retained
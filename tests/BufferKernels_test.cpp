@@ -0,0 +1,176 @@
+﻿#include "stdafx.h"
+#include "BufferKernels.h"
+#include "test.h"
+#include <math.h>
+#include <vector>
+
+// Each kernel is checked against a simple element-by-element loop, at every alignment and with
+// counts which aren't multiples of the SSE2 vector width.
+
+static UINT sSeed = 1;
+
+static UINT Random(UINT aRange)
+{
+	sSeed = sSeed * 1103515245 + 12345;
+	return (sSeed >> 8) % aRange;
+}
+
+static const NumKind sKinds[] = { NumKind::Int8, NumKind::UInt8, NumKind::Int16, NumKind::UInt16
+	, NumKind::Int32, NumKind::UInt32, NumKind::Int64, NumKind::Float32, NumKind::Float64 };
+
+static void TestLoadStore()
+{
+	BYTE buf[8];
+	NumValue v;
+	v.i = 300;
+	NumStore(buf, NumKind::UInt8, v);
+	CHECK(NumLoad(buf, NumKind::UInt8).i == 44); // Truncated.
+	v.i = -1;
+	NumStore(buf, NumKind::Int16, v);
+	CHECK(NumLoad(buf, NumKind::Int16).i == -1);
+	CHECK(NumLoad(buf, NumKind::UInt16).i == 0xFFFF);
+	CHECK(NumLoad(buf, NumKind::Int8).i == -1);
+	NumStore(buf, NumKind::Int32, v);
+	CHECK(NumLoad(buf, NumKind::UInt32).i == 0xFFFFFFFF);
+	v.i = INT64_MIN;
+	NumStore(buf, NumKind::Int64, v);
+	CHECK(NumLoad(buf, NumKind::Int64).i == INT64_MIN);
+	v.d = 0.1;
+	NumStore(buf, NumKind::Float32, v);
+	CHECK(NumLoad(buf, NumKind::Float32).d == (double)0.1f);
+	NumStore(buf, NumKind::Float64, v);
+	CHECK(NumLoad(buf, NumKind::Float64).d == 0.1);
+	for (auto kind : sKinds)
+		CHECK(NumKindIsFloat(kind) == (kind == NumKind::Float32 || kind == NumKind::Float64));
+}
+
+static void TestArithmetic()
+{
+	// Extra room so that the data can start at any offset, as a BufferView can.
+	std::vector<BYTE> buf(8 * 40 + 10);
+	for (int round = 0; round < 20000; ++round)
+	{
+		NumKind kind = sKinds[Random(_countof(sKinds))];
+		size_t size = NumKindSize(kind), count = Random(40);
+		BYTE *data = buf.data() + 1 + Random(8); // 1+ to leave a guard byte in front.
+		bool is_float = NumKindIsFloat(kind);
+		for (size_t i = 0; i < count; ++i)
+		{
+			NumValue v;
+			if (is_float)
+				v.d = (double)(int)(Random(2001) - 1000); // Integers, so that sums are exact in any order.
+			else
+				v.i = (__int64)((UINT64)Random(0x10000) << Random(56) ^ ((UINT64)0 - Random(2)));
+			NumStore(data + i * size, kind, v);
+		}
+
+		__int64 isum = 0;
+		double dsum = 0;
+		NumValue lo = {0}, hi = {0};
+		for (size_t i = 0; i < count; ++i)
+		{
+			NumValue v = NumLoad(data + i * size, kind);
+			if (is_float)
+			{
+				dsum += v.d;
+				if (!i || v.d < lo.d) lo = v;
+				if (!i || v.d > hi.d) hi = v;
+			}
+			else
+			{
+				isum = (__int64)((UINT64)isum + (UINT64)v.i);
+				if (!i || v.i < lo.i) lo = v;
+				if (!i || v.i > hi.i) hi = v;
+			}
+		}
+		NumValue sum = NumSum(data, count, kind);
+		CHECK(is_float ? sum.d == dsum : sum.i == isum);
+		if (count)
+		{
+			CHECK(is_float ? NumMin(data, count, kind).d == lo.d : NumMin(data, count, kind).i == lo.i);
+			CHECK(is_float ? NumMax(data, count, kind).d == hi.d : NumMax(data, count, kind).i == hi.i);
+		}
+
+		// Fill, leaving the bytes either side untouched.
+		NumValue fill;
+		if (is_float)
+			fill.d = -2.5;
+		else
+			fill.i = -(__int64)Random(1000);
+		data[-1] = 0xAB;
+		data[count * size] = 0xCD;
+		NumFill(data, count, kind, fill);
+		BYTE expected[8];
+		NumStore(expected, kind, fill); // Converted to the element type.
+		for (size_t i = 0; i < count; ++i)
+			CHECK(!memcmp(data + i * size, expected, size));
+		CHECK(data[-1] == 0xAB);
+		CHECK(data[count * size] == 0xCD);
+	}
+
+	// Integer sums wrap around, as the script's own arithmetic does.
+	INT64 big[] = { INT64_MAX, 1 };
+	CHECK(NumSum(big, 2, NumKind::Int64).i == INT64_MIN);
+	UINT32 u32[] = { 0xFFFFFFFF, 0xFFFFFFFF };
+	CHECK(NumSum(u32, 2, NumKind::UInt32).i == 0x1FFFFFFFE);
+	CHECK(NumSum(u32, 0, NumKind::UInt32).i == 0);
+	CHECK(NumSum(u32, 0, NumKind::Float64).d == 0);
+}
+
+static void TestFloatEdges()
+{
+	// Fractions are summed as doubles, even for Float32.
+	float f[9];
+	for (auto &x : f)
+		x = 0.1f;
+	double expected = 0;
+	for (auto x : f)
+		expected += x;
+	CHECK(fabs(NumSum(f, 9, NumKind::Float32).d - expected) < 1e-12);
+
+	// Infinities take part in comparisons normally.
+	double d[] = { 1, -INFINITY, 3, 4, INFINITY, 6, 7 };
+	CHECK(NumMin(d, _countof(d), NumKind::Float64).d == -INFINITY);
+	CHECK(NumMax(d, _countof(d), NumKind::Float64).d == INFINITY);
+	CHECK(NumMin(d, 1, NumKind::Float64).d == 1);
+}
+
+static void TestFindBytes()
+{
+	std::vector<BYTE> hay(100), needle(12);
+	for (int round = 0; round < 50000; ++round)
+	{
+		size_t hay_size = Random(100), needle_size = Random(13);
+		UINT alphabet = 1 + Random(4); // Few distinct bytes, so that partial matches are common.
+		for (auto &b : hay)
+			b = (BYTE)Random(alphabet);
+		for (auto &b : needle)
+			b = (BYTE)Random(alphabet);
+		ptrdiff_t expected = -1;
+		for (size_t i = 0; needle_size <= hay_size && i <= hay_size - needle_size; ++i)
+			if (!memcmp(hay.data() + i, needle.data(), needle_size))
+			{
+				expected = (ptrdiff_t)i;
+				break;
+			}
+		CHECK(FindBytes(hay.data(), hay_size, needle.data(), needle_size) == expected);
+	}
+	CHECK(FindBytes("abc", 3, "", 0) == 0);
+	CHECK(FindBytes("", 0, "a", 1) == -1);
+	CHECK(FindBytes("abc", 3, "abcd", 4) == -1);
+	// A match which ends exactly at the end of a long haystack.
+	std::vector<BYTE> zeros(1000);
+	zeros[998] = 1, zeros[999] = 2;
+	BYTE tail[] = { 0, 1, 2 };
+	CHECK(FindBytes(zeros.data(), zeros.size(), tail, 3) == 997);
+}
+
+int main()
+{
+	TestLoadStore();
+	TestArithmetic();
+	TestFloatEdges();
+	TestFindBytes();
+	puts("BufferKernels: all tests passed");
+	return 0;
+}
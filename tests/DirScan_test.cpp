@@ -0,0 +1,190 @@
+﻿#include "stdafx.h"
+#include "DirScan.h"
+#include "test.h"
+#include <algorithm>
+#include <dirent.h>
+#include <ftw.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// Scans a real directory tree with various numbers of threads, buffer sizes and depth limits,
+// and checks that the records arrive in the same order as a sequential walk.
+
+struct Record
+{
+	char name[256];
+	bool is_dir;
+};
+typedef DirScan<Record> Scan;
+
+static std::string sRoot;
+
+
+static std::vector<Record> ListDir(const std::string &aPath, bool aDirsOnly)
+// Returns the entries of aPath sorted by name, so that the order is the same on every call.
+{
+	std::vector<Record> list;
+	DIR *dir = opendir(aPath.c_str());
+	CHECK(dir);
+	while (dirent *entry = readdir(dir))
+	{
+		if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+			continue;
+		Record rec;
+		strcpy(rec.name, entry->d_name);
+		rec.is_dir = entry->d_type == DT_DIR;
+		if (rec.is_dir || !aDirsOnly)
+			list.push_back(rec);
+	}
+	closedir(dir);
+	std::sort(list.begin(), list.end(), [](const Record &a, const Record &b) { return strcmp(a.name, b.name) < 0; });
+	return list;
+}
+
+
+class PosixLister : public Scan::Lister
+{
+	struct Handle
+	{
+		std::vector<Record> subdirs, records;
+		size_t next_subdir = 0, next_record = 0;
+	};
+
+	static std::string PathOf(Scan::Dir &aDir)
+	{
+		return aDir.mParent ? PathOf(*aDir.mParent) + "/" + aDir.mEntry.name : sRoot;
+	}
+
+public:
+	void *Open(Scan::Dir &aDir, bool aWantSubdirs) override
+	{
+		auto handle = new Handle;
+		std::string path = PathOf(aDir);
+		// Like Loop Files, every entry (including subdirectories) is a record.
+		handle->records = ListDir(path, false);
+		if (aWantSubdirs)
+			handle->subdirs = ListDir(path, true);
+		return handle;
+	}
+
+	DirScanItem Read(void *aHandle, Record &aRecord) override
+	{
+		auto &handle = *(Handle *)aHandle;
+		if (handle.next_subdir < handle.subdirs.size())
+		{
+			aRecord = handle.subdirs[handle.next_subdir++];
+			return DIRSCAN_ITEM_SUBDIR;
+		}
+		if (handle.next_record < handle.records.size())
+		{
+			aRecord = handle.records[handle.next_record++];
+			return DIRSCAN_ITEM_RECORD;
+		}
+		return DIRSCAN_ITEM_END;
+	}
+
+	void Close(void *aHandle) override
+	{
+		delete (Handle *)aHandle;
+	}
+};
+
+
+static void MakeTree(const std::string &aPath, int aDepth, unsigned &aSeed)
+{
+	auto rand = [&aSeed] { return (aSeed = aSeed * 1103515245 + 12345) >> 16; };
+	int files = rand() % 20, dirs = aDepth < 4 ? rand() % 7 : 0;
+	for (int i = 0; i < files; ++i)
+	{
+		std::string file = aPath + "/f" + std::to_string(i);
+		FILE *fp = fopen(file.c_str(), "w");
+		CHECK(fp);
+		fclose(fp);
+	}
+	for (int i = 0; i < dirs; ++i)
+	{
+		std::string dir = aPath + "/d" + std::to_string(i);
+		CHECK(!mkdir(dir.c_str(), 0700));
+		MakeTree(dir, aDepth + 1, aSeed);
+	}
+}
+
+
+static void WalkTree(const std::string &aPath, const std::string &aRelPath, int aDepth, int aMaxDepth
+	, std::vector<std::string> &aOut)
+{
+	for (auto &rec : ListDir(aPath, false))
+		aOut.push_back(aRelPath + rec.name);
+	if (aMaxDepth && aDepth >= aMaxDepth)
+		return;
+	for (auto &rec : ListDir(aPath, true))
+		WalkTree(aPath + "/" + rec.name, aRelPath + rec.name + "/", aDepth + 1, aMaxDepth, aOut);
+}
+
+
+static std::vector<std::string> ScanTree(PosixLister &aLister, UINT aThreads, UINT aMaxRecords, int aMaxDepth)
+{
+	std::vector<std::string> out, parents;
+	std::string rel_path;
+	Scan scan(aLister, aThreads, aMaxRecords, aMaxDepth);
+	Record rec;
+	for (DirScanEvent event; (event = scan.Next(rec)) != DIRSCAN_END; )
+	{
+		switch (event)
+		{
+		case DIRSCAN_RECORD:
+			out.push_back(rel_path + rec.name);
+			break;
+		case DIRSCAN_ENTER:
+			CHECK(rec.is_dir);
+			parents.push_back(rel_path);
+			rel_path += std::string(rec.name) + "/";
+			break;
+		case DIRSCAN_LEAVE:
+			CHECK(!parents.empty());
+			rel_path = parents.back();
+			parents.pop_back();
+			break;
+		case DIRSCAN_END: // Excluded by the loop condition.
+			break;
+		}
+	}
+	CHECK(parents.empty());
+	return out;
+}
+
+
+int main()
+{
+	char root[] = "/tmp/DirScan_test.XXXXXX";
+	CHECK(mkdtemp(root));
+	sRoot = root;
+	unsigned seed = 1;
+	MakeTree(sRoot, 0, seed);
+
+	PosixLister lister;
+	for (int max_depth : {0, 1, 3})
+	{
+		std::vector<std::string> expected;
+		WalkTree(sRoot, "", 0, max_depth, expected);
+		CHECK(!expected.empty());
+		for (UINT threads : {0, 1, 4, 16})
+			for (UINT max_records : {1, 64, 100000})
+				CHECK(ScanTree(lister, threads, max_records, max_depth) == expected);
+
+		// Stopping early must not leak or hang, regardless of how far the workers have read ahead.
+		for (int stop_after = 0; stop_after < 500; stop_after += 37)
+		{
+			Scan scan(lister, 4, 64, max_depth);
+			Record rec;
+			for (int i = 0; i < stop_after && scan.Next(rec) != DIRSCAN_END; ++i);
+		}
+	}
+
+	nftw(root, [](const char *aPath, const struct stat *, int, FTW *) { return remove(aPath); }, 16, FTW_DEPTH | FTW_PHYS);
+	puts("DirScan: all tests passed");
+	return 0;
+}
@@ -0,0 +1,132 @@
+﻿#include "test.h"
+#include "DispIDCache.h"
+
+
+static UINT sHits, sMisses; // Counter values at the last call to Counted().
+
+// Returns the number of hits and misses since the last call.
+static void Counted(UINT &aHits, UINT &aMisses)
+{
+	aHits = DispIDCache::sHits - sHits;
+	aMisses = DispIDCache::sMisses - sMisses;
+	sHits = DispIDCache::sHits;
+	sMisses = DispIDCache::sMisses;
+}
+
+// Simulates ComObject::Invoke(): looks up aName in the cache, falling back to aDispID.
+static bool Lookup(DispIDCachePtr &aCache, LPCTSTR aName, DISPID aDispID)
+{
+	DISPID dispid;
+	if (aCache.Find(aName, dispid))
+	{
+		CHECK(dispid == aDispID);
+		return true;
+	}
+	aCache.Add(aName, aDispID);
+	return false;
+}
+
+
+static void TestCreation()
+{
+	UINT hits, misses;
+	Counted(hits, misses);
+	
+	DispIDCachePtr once;
+	CHECK(!Lookup(once, _T("Value"), 1));
+	CHECK(!once.IsCreated());
+
+	DispIDCachePtr distinct;
+	CHECK(!Lookup(distinct, _T("Value"), 1));
+	CHECK(!Lookup(distinct, _T("Text"), 2));
+	CHECK(!distinct.IsCreated());
+	
+	DispIDCachePtr repeated;
+	CHECK(!Lookup(repeated, _T("Value"), 1));
+	CHECK(!Lookup(repeated, _T("Value"), 1));
+	CHECK(repeated.IsCreated());
+	CHECK(Lookup(repeated, _T("Value"), 1));
+	
+	// Alternating between members must also create the cache.
+	DispIDCachePtr alternating;
+	CHECK(!Lookup(alternating, _T("Value"), 1));
+	CHECK(!Lookup(alternating, _T("Text"), 2));
+	CHECK(!Lookup(alternating, _T("Value"), 1));
+	CHECK(alternating.IsCreated());
+	CHECK(Lookup(alternating, _T("Value"), 1));
+	CHECK(!Lookup(alternating, _T("Text"), 2)); // Seen before the cache existed, so not cached yet.
+	CHECK(Lookup(alternating, _T("Text"), 2));
+
+	Counted(hits, misses);
+	CHECK(hits == 3);
+	CHECK(misses == 9);
+}
+
+static void TestFindAddRemove()
+{
+	DispIDCache cache;
+	DISPID dispid = 0;
+	CHECK(!cache.Find(_T("a"), dispid));
+	cache.Add(_T("a"), 10);
+	cache.Add(_T("b"), 20);
+	cache.Add(_T("c"), 30);
+	CHECK(cache.Find(_T("b"), dispid) && dispid == 20);
+	CHECK(!cache.Find(_T("B"), dispid)); // Case-sensitive.
+	
+	// Removing an entry from the middle must leave the others reachable.
+	cache.Remove(_T("a"));
+	CHECK(!cache.Find(_T("a"), dispid));
+	CHECK(cache.Find(_T("b"), dispid) && dispid == 20);
+	CHECK(cache.Find(_T("c"), dispid) && dispid == 30);
+	cache.Remove(_T("c"));
+	cache.Remove(_T("x")); // Not present.
+	CHECK(cache.Find(_T("b"), dispid) && dispid == 20);
+	CHECK(!cache.Find(_T("c"), dispid));
+
+	// Re-adding a removed name gives it the new DISPID.
+	cache.Add(_T("a"), 11);
+	CHECK(cache.Find(_T("a"), dispid) && dispid == 11);
+}
+
+static void TestEviction()
+{
+	DispIDCache cache;
+	TCHAR name[] = _T("m0");
+	for (int i = 0; i < 8; ++i)
+	{
+		name[1] = '0' + i;
+		cache.Add(name, i);
+	}
+	DISPID dispid;
+	for (int i = 0; i < 8; ++i)
+	{
+		name[1] = '0' + i;
+		CHECK(cache.Find(name, dispid) && dispid == i);
+	}
+	// The ninth and tenth names replace the oldest entries.
+	cache.Add(_T("m8"), 8);
+	cache.Add(_T("m9"), 9);
+	CHECK(!cache.Find(_T("m0"), dispid));
+	CHECK(!cache.Find(_T("m1"), dispid));
+	CHECK(cache.Find(_T("m2"), dispid) && dispid == 2);
+	CHECK(cache.Find(_T("m8"), dispid) && dispid == 8);
+	CHECK(cache.Find(_T("m9"), dispid) && dispid == 9);
+}
+
+static void TestHashName()
+{
+	CHECK(DispIDCache::HashName(_T("")) != 0);
+	CHECK(DispIDCache::HashName(_T("Value")) == DispIDCache::HashName(_T("Value")));
+	CHECK(DispIDCache::HashName(_T("Value")) != DispIDCache::HashName(_T("value")));
+}
+
+
+int main()
+{
+	TestCreation();
+	TestFindAddRemove();
+	TestEviction();
+	TestHashName();
+	puts("DispIDCache: all tests passed");
+	return 0;
+}
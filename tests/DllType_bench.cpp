@@ -0,0 +1,38 @@
+﻿#include "stdafx.h"
+#include "DllType.h"
+#include <chrono>
+#include <stdio.h>
+
+// Measures how long it takes to parse each parameter type, which DllCall does for every
+// parameter of every call (DllProto does it only once).  Not run by ctest; run DllType_bench directly.
+
+typedef std::chrono::steady_clock Clock;
+
+int main()
+{
+	static LPCTSTR types[] = {
+		_T("Int"), _T("UInt"), _T("Int64"), _T("Ptr"), _T("UPtr"), _T("Ptr*"), _T("Str"),
+		_T("WStr"), _T("Double"), _T("Float"), _T("Short"), _T("UChar"), _T("Int *"), _T("Bogus"),
+	};
+	const int iterations = 2000000;
+	int checksum = 0; // Prevents the loop from being optimized away.
+	for (auto type : types)
+	{
+		DYNAPARM p = {};
+		auto start = Clock::now();
+		for (int i = 0; i < iterations; ++i)
+		{
+			ConvertDllArgType(type, p);
+			checksum += p.type + p.passed_by_address;
+		}
+		double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+		printf("%-8s %6.1f ns\n", type, ns);
+	}
+	DYNAPARM p = {};
+	auto start = Clock::now();
+	for (int i = 0; i < iterations; ++i)
+		checksum += ConvertDllReturnType(_T("CDecl Double"), p) + p.type;
+	double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+	printf("%-8s %6.1f ns (return type \"CDecl Double\")\n", "", ns);
+	return checksum == 0; // Never 0, so this always succeeds.
+}
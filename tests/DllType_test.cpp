@@ -0,0 +1,133 @@
+﻿#include "stdafx.h"
+#include "DllType.h"
+#include "test.h"
+
+static const DllArgTypes PTR = sizeof(void *) == 8 ? DLL_ARG_INT64 : DLL_ARG_INT;
+
+static DYNAPARM Arg(LPCTSTR aType)
+{
+	DYNAPARM p = {};
+	ConvertDllArgType(aType, p);
+	return p;
+}
+
+static DYNAPARM Ret(LPCTSTR aType, int *aCallMode = nullptr)
+{
+	DYNAPARM p = {};
+	int call_mode = ConvertDllReturnType(aType, p);
+	if (aCallMode)
+		*aCallMode = call_mode;
+	return p;
+}
+
+static void TestTypeNames()
+{
+	static const struct { LPCTSTR name; DllArgTypes type; } names[] = {
+		{_T("Int"), DLL_ARG_INT}, {_T("Int64"), DLL_ARG_INT64}, {_T("Short"), DLL_ARG_SHORT},
+		{_T("Char"), DLL_ARG_CHAR}, {_T("Float"), DLL_ARG_FLOAT}, {_T("Double"), DLL_ARG_DOUBLE},
+		{_T("Str"), DLL_ARG_STR}, {_T("AStr"), DLL_ARG_ASTR}, {_T("WStr"), DLL_ARG_WSTR},
+		{_T("Ptr"), PTR}, {_T("int"), DLL_ARG_INT}, {_T("INT64"), DLL_ARG_INT64}, {_T("ptr"), PTR},
+	};
+	for (auto &n : names)
+	{
+		DYNAPARM p = Arg(n.name);
+		CHECK(p.type == n.type);
+		CHECK(!p.passed_by_address && !p.is_unsigned);
+		CHECK(p.is_ptr == (n.type == PTR && (*n.name == 'P' || *n.name == 'p')));
+	}
+	// Anything which isn't exactly a type name is invalid, including whitespace around it.
+	static LPCTSTR invalid[] = {
+		_T(""), _T("U"), _T("In"), _T("Inte"), _T("Int32"), _T("Int6"), _T("Int644"), _T(" Int"),
+		_T("Int "), _T("Pint"), _T("Pointer"), _T("Strs"), _T("Void"), _T("HRESULT"), _T("*"),
+		_T("Int*x"), _T("Int**"), _T("IntPP"), _T("Int                                         *"),
+	};
+	for (auto name : invalid)
+		CHECK(Arg(name).type == DLL_ARG_INVALID);
+}
+
+static void TestModifiers()
+{
+	DYNAPARM p = Arg(_T("UInt"));
+	CHECK(p.type == DLL_ARG_INT && p.is_unsigned && !p.passed_by_address);
+	p = Arg(_T("uchar"));
+	CHECK(p.type == DLL_ARG_CHAR && p.is_unsigned);
+	p = Arg(_T("UPtr"));
+	CHECK(p.type == PTR && p.is_unsigned && !p.is_ptr); // Only "Ptr" can be given an object with a Ptr property.
+	p = Arg(_T("UStr")); // The prefix is permitted for any type.
+	CHECK(p.type == DLL_ARG_STR && p.is_unsigned);
+
+	static LPCTSTR by_address[] = {
+		_T("Int*"), _T("IntP"), _T("Intp"), _T("Int *"), _T("Int\t*"), _T("Int  P"), _T("Int* "),
+	};
+	for (auto name : by_address)
+	{
+		p = Arg(name);
+		CHECK(p.type == DLL_ARG_INT && p.passed_by_address && !p.is_unsigned);
+	}
+	p = Arg(_T("UInt64*"));
+	CHECK(p.type == DLL_ARG_INT64 && p.passed_by_address && p.is_unsigned);
+	p = Arg(_T("PtrP"));
+	CHECK(p.type == PTR && p.passed_by_address && p.is_ptr);
+	p = Arg(_T("Ptr*"));
+	CHECK(p.type == PTR && p.passed_by_address && p.is_ptr);
+	p = Arg(_T("Double*"));
+	CHECK(p.type == DLL_ARG_DOUBLE && p.passed_by_address);
+}
+
+static void TestReturnTypes()
+{
+	int call_mode;
+	DYNAPARM p = Ret(_T("Int"), &call_mode);
+	CHECK(p.type == DLL_ARG_INT && call_mode == 0);
+	p = Ret(_T("CDecl"), &call_mode);
+	CHECK(p.type == DLL_ARG_INT && call_mode == DC_CALL_CDECL);
+	p = Ret(_T("cdecl  UShort"), &call_mode);
+	CHECK(p.type == DLL_ARG_SHORT && p.is_unsigned && call_mode == DC_CALL_CDECL);
+	p = Ret(_T("HRESULT"), &call_mode);
+	CHECK(p.type == DLL_ARG_INT && p.is_hresult && call_mode == 0);
+	p = Ret(_T("CDecl HResult"), &call_mode);
+	CHECK(p.type == DLL_ARG_INT && p.is_hresult && call_mode == DC_CALL_CDECL);
+	p = Ret(_T("Double"), &call_mode);
+	CHECK(p.type == DLL_ARG_DOUBLE && call_mode == DC_RETVAL_MATH8);
+	p = Ret(_T("CDecl Float"), &call_mode);
+	CHECK(p.type == DLL_ARG_FLOAT && call_mode == (DC_CALL_CDECL | DC_RETVAL_MATH4));
+	p = Ret(_T("Double*"), &call_mode);
+	CHECK(p.type == DLL_ARG_DOUBLE && p.passed_by_address && call_mode == 0); // An address isn't returned in ST.
+	CHECK(Ret(_T("")).type == DLL_ARG_INVALID); // e.g. a pure number, which TokenToString() gives as "".
+	CHECK(Ret(_T("CDecl Void")).type == DLL_ARG_INVALID);
+	CHECK(Ret(_T("HRESULT*")).type == DLL_ARG_INVALID);
+	CHECK(Ret(_T("CDeclInt")).type == DLL_ARG_INT); // Whitespace after CDecl has always been optional.
+}
+
+static void TestIntValue()
+{
+	DYNAPARM p = Arg(_T("Int"));
+	CHECK(DllIntValue(p, -1) == -1);
+	CHECK(DllIntValue(p, 0x7FFFFFFF) == 0x7FFFFFFF);
+	p = Arg(_T("UInt"));
+	CHECK(DllIntValue(p, -1) == 0xFFFFFFFFLL);
+	p = Arg(_T("Short"));
+	CHECK(DllIntValue(p, 0xFFFF) == -1);
+	CHECK(DllIntValue(p, 0x12347FFF) == 0x7FFF); // Bits beyond the type's width are ignored.
+	CHECK(DllIntValue(p, 0x8000) == -0x8000);
+	p = Arg(_T("UShort"));
+	CHECK(DllIntValue(p, -1) == 0xFFFF);
+	CHECK(DllIntValue(p, 0x10001) == 1);
+	p = Arg(_T("Char"));
+	CHECK(DllIntValue(p, 0xFF) == -1);
+	CHECK(DllIntValue(p, 0x17F) == 0x7F);
+	CHECK(DllIntValue(p, 0x80) == -0x80);
+	p = Arg(_T("UChar*")); // Output parameters are handled the same way.
+	CHECK(DllIntValue(p, -1) == 0xFF);
+	CHECK(DllIntValue(p, 0x100) == 0);
+}
+
+int main()
+{
+	TestTypeNames();
+	TestModifiers();
+	TestReturnTypes();
+	TestIntValue();
+	puts("DllType: all tests passed");
+	return 0;
+}
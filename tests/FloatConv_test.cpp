@@ -0,0 +1,151 @@
+﻿#include "stdafx.h"
+#include "FloatConv.h"
+#include "test.h"
+#include <math.h>
+#include <stdint.h>
+
+// The fast paths must agree exactly with the CRT whenever they handle a value, which is checked
+// against a large deterministic sample of doubles as well as the usual edge cases.
+
+static UINT64 sRandom = 0x9E3779B97F4A7C15;
+
+static UINT64 Random()
+{
+	sRandom ^= sRandom << 13;
+	sRandom ^= sRandom >> 7;
+	sRandom ^= sRandom << 17;
+	return sRandom;
+}
+
+static double FromBits(UINT64 aBits)
+{
+	double d;
+	memcpy(&d, &aBits, sizeof(d));
+	return d;
+}
+
+static UINT64 ToBits(double aValue)
+{
+	UINT64 bits;
+	memcpy(&bits, &aValue, sizeof(bits));
+	return bits;
+}
+
+static bool CheckFormat(double aValue)
+{
+	char buf[FLOAT17G_BUF_SIZE], expected[64];
+	int length = FormatFloat17g(aValue, buf);
+	if (length < 0)
+		return false;
+	snprintf(expected, sizeof(expected), "%.17g", aValue);
+	if (strcmp(buf, expected) || length != (int)strlen(expected))
+		fprintf(stderr, "FormatFloat17g(%a): expected \"%s\", got \"%s\"\n", aValue, expected, buf);
+	CHECK(!strcmp(buf, expected) && length == (int)strlen(expected));
+	return true;
+}
+
+static bool CheckParse(const char *aText)
+{
+	double value;
+	if (!ParseFloatFast(aText, value))
+		return false;
+	double expected = strtod(aText, nullptr);
+	if (ToBits(value) != ToBits(expected))
+		fprintf(stderr, "ParseFloatFast(\"%s\"): expected %a, got %a\n", aText, expected, value);
+	CHECK(ToBits(value) == ToBits(expected));
+	return true;
+}
+
+static void TestFormat()
+{
+	static const double edge[] = {
+		0.0, -0.0, 1.0, -1.0, 0.1, 0.5, 1.0 / 3, 2.0 / 3, 100.0, 1e15, 1e16, 1e17, 1e21, 1e22, 1e23,
+		123456789012345678.0, 9007199254740993.0, 0.30000000000000004, 1e-5, 1e-7, 5e-324, 1e-320,
+		2.2250738585072009e-308, 2.2250738585072014e-308, 1.7976931348623157e308, 4.9406564584124654e-324,
+	};
+	for (double d : edge)
+	{
+		CHECK(CheckFormat(d));
+		CHECK(CheckFormat(-d));
+	}
+	CHECK(FormatFloat17g(INFINITY, nullptr) == -1);
+	CHECK(FormatFloat17g(-INFINITY, nullptr) == -1);
+	CHECK(FormatFloat17g(NAN, nullptr) == -1);
+
+	int handled = 0;
+	const int count = 1000000;
+	for (int i = 0; i < count; ++i)
+	{
+		UINT64 bits = Random();
+		if ((bits >> 52 & 0x7FF) == 0x7FF)
+			continue;
+		handled += CheckFormat(FromBits(bits));
+		handled += CheckFormat((double)(INT64)(bits >> (bits & 63))); // Integers of every magnitude.
+		handled += CheckFormat((double)(bits % 100000) / 1000); // Short decimals, as typically found in scripts.
+	}
+	CHECK(handled > count * 3 * 99 / 100); // The CRT should be needed only rarely.
+}
+
+static void TestParse()
+{
+	static const char *valid[] = {
+		"0", "-0", "+0", "0.0", "1", "-1", "1.5", ".5", "5.", "00012", "0.1", "0.30000000000000004",
+		"123.456e-7", "1e22", "1e23", "1E-5", "1e+10", "9007199254740993", "9999999999999999999",
+		"2.2250738585072011e-308", "4.9406564584124654e-324", "1.7976931348623157e308", "1e-400",
+		"1.5abc", "2e", "2e+", "3.25e2x",
+	};
+	for (auto s : valid)
+		CHECK(CheckParse(s));
+	// These need the CRT.
+	static const char *crt[] = {
+		"", " 1", "\t1", "-", ".", "e5", "0x10", "0X1p3", "inf", "-nan", "18446744073709551615",
+		"0.12345678901234567890",
+	};
+	for (auto s : crt)
+	{
+		double value;
+		CHECK(!ParseFloatFast(s, value));
+	}
+	CheckParse("1e400"); // Overflow may go either way, but must agree with the CRT if handled.
+	CheckParse("-1e400");
+
+	int handled = 0;
+	const int count = 500000;
+	char buf[64];
+	for (int i = 0; i < count; ++i)
+	{
+		UINT64 bits = Random();
+		if ((bits >> 52 & 0x7FF) == 0x7FF)
+			continue;
+		double d = FromBits(bits);
+		snprintf(buf, sizeof(buf), "%.17g", d);
+		handled += CheckParse(buf);
+		snprintf(buf, sizeof(buf), "%.15g", d);
+		handled += CheckParse(buf);
+		snprintf(buf, sizeof(buf), "%.*f", (int)(bits % 8), (double)(bits % 1000000) / 7);
+		handled += CheckParse(buf);
+	}
+	CHECK(handled > count * 3 * 99 / 100);
+}
+
+static void TestRoundTrip()
+{
+	char buf[FLOAT17G_BUF_SIZE];
+	for (int i = 0; i < 200000; ++i)
+	{
+		double d = FromBits(Random()), parsed;
+		if (FormatFloat17g(d, buf) < 0)
+			continue;
+		if (ParseFloatFast(buf, parsed))
+			CHECK(ToBits(parsed) == ToBits(d));
+	}
+}
+
+int main()
+{
+	TestFormat();
+	TestParse();
+	TestRoundTrip();
+	puts("FloatConv: all tests passed");
+	return 0;
+}
@@ -0,0 +1,113 @@
+﻿#include "stdafx.h"
+#include "HotstringTrie.h"
+#include "test.h"
+#include <ctype.h>
+#include <string>
+#include <vector>
+
+// The trie must find exactly the hotstrings whose abbreviation, case-folded, ends the buffer (or
+// ends it just before a typed end-char), in ascending order.  This is checked against brute force.
+
+static std::vector<std::string> sAbbrev;
+
+static LPCTSTR Abbrev(HotstringIDType aID, int &aLength)
+{
+	aLength = (int)sAbbrev[aID].length();
+	return sAbbrev[aID].c_str();
+}
+
+static TCHAR Fold(TCHAR aChar)
+{
+	return (TCHAR)tolower((unsigned char)aChar);
+}
+
+static bool EndsWith(const std::string &aBuf, size_t aEnd, const std::string &aAbbrev)
+{
+	if (aAbbrev.length() > aEnd)
+		return false;
+	for (size_t i = 0; i < aAbbrev.length(); ++i)
+		if (Fold(aBuf[aEnd - aAbbrev.length() + i]) != Fold(aAbbrev[i]))
+			return false;
+	return true;
+}
+
+static std::vector<HotstringIDType> BruteForce(const std::string &aBuf, bool aEndCharTyped)
+{
+	std::vector<HotstringIDType> found;
+	for (HotstringIDType u = 0; u < sAbbrev.size(); ++u)
+		if (EndsWith(aBuf, aBuf.length(), sAbbrev[u])
+			|| (aEndCharTyped && aBuf.length() && EndsWith(aBuf, aBuf.length() - 1, sAbbrev[u])))
+			found.push_back(u);
+	return found;
+}
+
+static std::vector<HotstringIDType> Find(HotstringTrie &aTrie, const std::string &aBuf, bool aEndCharTyped, int aMax = HS_TRIE_MAX_CANDIDATES)
+{
+	HotstringIDType candidate[HS_TRIE_MAX_CANDIDATES];
+	int count = aTrie.FindCandidates(aBuf.c_str(), (int)aBuf.length(), aEndCharTyped, candidate, aMax);
+	if (count < 0)
+		return {HS_TRIE_NONE};
+	return std::vector<HotstringIDType>(candidate, candidate + count);
+}
+
+static void TestExamples()
+{
+	sAbbrev = {"btw", "BTW", "tw", "w", "brb", "btw", "xbtw", "omw"};
+	HotstringTrie *trie = HotstringTrie::Create((HotstringIDType)sAbbrev.size(), Abbrev, Fold);
+	CHECK(trie && trie->Count() == sAbbrev.size());
+	CHECK(Find(*trie, "by the way btw", false) == std::vector<HotstringIDType>({0, 1, 2, 3, 5}));
+	CHECK(Find(*trie, "xBtW", false) == std::vector<HotstringIDType>({0, 1, 2, 3, 5, 6}));
+	CHECK(Find(*trie, "btw ", false).empty());
+	CHECK(Find(*trie, "btw ", true) == std::vector<HotstringIDType>({0, 1, 2, 3, 5}));
+	// Both walks find "w", but it is listed once.
+	CHECK(Find(*trie, "ww", true) == std::vector<HotstringIDType>({3}));
+	CHECK(Find(*trie, "omw.", true) == std::vector<HotstringIDType>({3, 7}));
+	CHECK(Find(*trie, "", false).empty());
+	CHECK(Find(*trie, "b", true).empty());
+	// Too many candidates means the caller must check every hotstring.
+	CHECK(Find(*trie, "btw", false, 4) == std::vector<HotstringIDType>({HS_TRIE_NONE}));
+	CHECK(Find(*trie, "btw", false, 5).size() == 5);
+	delete trie;
+}
+
+static void TestRandom()
+{
+	UINT seed = 12345;
+	auto random = [&seed](UINT aRange) { seed = seed * 1103515245 + 12345; return (seed >> 16) % aRange; };
+	static const char alphabet[] = "abcAB .";
+	for (int round = 0; round < 20; ++round)
+	{
+		sAbbrev.clear();
+		for (int i = 0, count = 1 + random(400); i < count; ++i)
+		{
+			std::string s;
+			for (int n = 1 + random(5); n; --n)
+				s += alphabet[random(sizeof(alphabet) - 1)];
+			sAbbrev.push_back(s);
+		}
+		HotstringTrie *trie = HotstringTrie::Create((HotstringIDType)sAbbrev.size(), Abbrev, Fold);
+		CHECK(trie);
+		for (int i = 0; i < 2000; ++i)
+		{
+			std::string buf;
+			for (int n = random(12); n; --n)
+				buf += alphabet[random(sizeof(alphabet) - 1)];
+			bool end_char = !buf.empty() && (buf.back() == ' ' || buf.back() == '.');
+			auto expected = BruteForce(buf, end_char);
+			auto found = Find(*trie, buf, end_char);
+			if (expected.size() > HS_TRIE_MAX_CANDIDATES)
+				CHECK(found == std::vector<HotstringIDType>({HS_TRIE_NONE}));
+			else
+				CHECK(found == expected);
+		}
+		delete trie;
+	}
+}
+
+int main()
+{
+	TestExamples();
+	TestRandom();
+	puts("HotstringTrie: all tests passed");
+	return 0;
+}
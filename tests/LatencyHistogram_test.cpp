@@ -0,0 +1,80 @@
+﻿#include "stdafx.h"
+#include "LatencyHistogram.h"
+#include "test.h"
+
+static void CheckBucket(UINT64 aValue)
+{
+	int bucket = LatencyHistogram::BucketOf(aValue);
+	CHECK(bucket >= 0 && bucket < LatencyHistogram::BUCKET_COUNT);
+	// The value is within the bucket's bounds.
+	CHECK(LatencyHistogram::BucketUpperBound(bucket) >= aValue);
+	CHECK(bucket == 0 || LatencyHistogram::BucketUpperBound(bucket - 1) < aValue);
+	// The bucket is no wider than 1/8 of the values in it.
+	UINT64 lower = bucket ? LatencyHistogram::BucketUpperBound(bucket - 1) + 1 : 0;
+	CHECK(LatencyHistogram::BucketUpperBound(bucket) - lower <= lower / 8);
+}
+
+static void TestBuckets()
+{
+	for (UINT64 v = 0; v < 100000; ++v)
+		CheckBucket(v);
+	for (int bit = 0; bit < 64; ++bit)
+	{
+		UINT64 power = 1ULL << bit;
+		CheckBucket(power);
+		CheckBucket(power - 1);
+		CheckBucket(power + 1);
+		CheckBucket(power | (power >> 1));
+	}
+	UINT64 x = 88172645463325252ULL;
+	for (int i = 0; i < 1000000; ++i)
+	{
+		x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+		CheckBucket(x >> (x & 63));
+	}
+	CHECK(LatencyHistogram::BucketOf(~0ULL) == LatencyHistogram::BUCKET_COUNT - 1);
+	CHECK(LatencyHistogram::BucketUpperBound(LatencyHistogram::BUCKET_COUNT - 1) == ~0ULL);
+	// Buckets are contiguous and in ascending order.
+	for (int b = 1; b < LatencyHistogram::BUCKET_COUNT; ++b)
+		CHECK(LatencyHistogram::BucketOf(LatencyHistogram::BucketUpperBound(b - 1) + 1) == b);
+}
+
+static void TestPercentiles()
+{
+	static LatencyHistogram h; // Static since it's too big for some test runners' default stack.
+	CHECK(h.Count() == 0 && h.Max() == 0 && h.Mean() == 0);
+	CHECK(h.ValueAtPercentile(50) == 0);
+
+	for (UINT64 v = 1; v <= 1000; ++v)
+		h.Record(v);
+	CHECK(h.Count() == 1000 && h.Max() == 1000 && h.Mean() == 500);
+	static const double percentiles[] = {1, 10, 50, 90, 99, 99.9};
+	for (double p : percentiles)
+	{
+		UINT64 exact = (UINT64)(p * 10 + 0.5), reported = h.ValueAtPercentile(p);
+		CHECK(reported >= exact && reported <= exact + exact / 8);
+	}
+	CHECK(h.ValueAtPercentile(0) == 1); // The lowest value, whose bucket holds only that.
+	CHECK(h.ValueAtPercentile(100) == 1000); // Capped at the maximum recorded value.
+
+	// A few outliers don't affect the median, but are reported at the top.
+	for (int i = 0; i < 5; ++i)
+		h.Record(10000000);
+	CHECK(h.ValueAtPercentile(50) <= 563);
+	CHECK(h.ValueAtPercentile(100) == 10000000);
+
+	h.Reset();
+	CHECK(h.Count() == 0 && h.Max() == 0 && h.ValueAtPercentile(99) == 0);
+	h.Record(0);
+	CHECK(h.Count() == 1 && h.ValueAtPercentile(50) == 0);
+	h.Record(~0ULL);
+	CHECK(h.Max() == ~0ULL && h.ValueAtPercentile(100) == ~0ULL);
+}
+
+int main()
+{
+	TestBuckets();
+	TestPercentiles();
+	puts("LatencyHistogram: all tests passed");
+	return 0;
+}
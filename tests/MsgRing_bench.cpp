@@ -0,0 +1,232 @@
+﻿#include "stdafx.h"
+#include "MsgRing.h"
+#include <algorithm>
+#include <chrono>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Measures message throughput and round-trip latency between two processes sharing a pair of
+// rings, which is how Worker uses them.  eventfd stands in for the events Worker waits on.
+// Not run by ctest; run MsgRing_bench directly.
+
+typedef std::chrono::steady_clock Clock;
+
+static double SecondsSince(Clock::time_point aStart)
+{
+	return std::chrono::duration<double>(Clock::now() - aStart).count();
+}
+
+struct Channel
+{
+	MsgRing ring;
+	int data_ready, space_ready;
+};
+
+static void Signal(int aFd)
+{
+	uint64_t one = 1;
+	if (write(aFd, &one, sizeof(one)) != sizeof(one))
+		_exit(2);
+}
+
+static void Wait(int aFd)
+{
+	uint64_t count;
+	if (read(aFd, &count, sizeof(count)) != sizeof(count))
+		_exit(2);
+}
+
+
+static const uint16_t sKeyId[] = {'i', 'd'}, sKeyName[] = {'n', 'a', 'm', 'e'}, sKeyValues[] = {'v', 'a', 'l', 'u', 'e', 's'};
+static const uint16_t sName[] = {'i', 't', 'e', 'm', '-', 'n', 'a', 'm', 'e'};
+
+static void Encode(MsgBuffer &aBuf, int64_t aId)
+// Writes Map("id", aId, "name", "item-name", "values", [1.5, aId, -3]) as Worker would.
+{
+	aBuf.Clear();
+	aBuf.WriteByte(MSG_MAP); aBuf.WriteVarUInt(3);
+	aBuf.WriteByte(MSG_STRING); aBuf.WriteString(sKeyId, 2);
+	aBuf.WriteByte(MSG_INTEGER); aBuf.WriteInt(aId);
+	aBuf.WriteByte(MSG_STRING); aBuf.WriteString(sKeyName, 4);
+	aBuf.WriteByte(MSG_STRING); aBuf.WriteString(sName, 9);
+	aBuf.WriteByte(MSG_STRING); aBuf.WriteString(sKeyValues, 6);
+	aBuf.WriteByte(MSG_ARRAY); aBuf.WriteVarUInt(3);
+	aBuf.WriteByte(MSG_FLOAT); aBuf.WriteDouble(1.5);
+	aBuf.WriteByte(MSG_INTEGER); aBuf.WriteInt(aId);
+	aBuf.WriteByte(MSG_INTEGER); aBuf.WriteInt(-3);
+}
+
+static bool Decode(MsgReader &aReader, int64_t &aSum)
+// Reads one value, copying strings out as Worker would, and adds up the integers.
+{
+	uint8_t tag;
+	uint64_t count;
+	int64_t i;
+	double d;
+	const void *text;
+	size_t length;
+	uint16_t copy[64];
+	if (!aReader.ReadByte(tag))
+		return false;
+	switch (tag)
+	{
+	case MSG_STRING:
+		if (!aReader.ReadString(text, length))
+			return false;
+		memcpy(copy, text, std::min<size_t>(length, 64) * 2);
+		return true;
+	case MSG_INTEGER:
+		if (!aReader.ReadInt(i))
+			return false;
+		aSum += i;
+		return true;
+	case MSG_FLOAT:
+		return aReader.ReadDouble(d);
+	case MSG_ARRAY:
+		if (!aReader.ReadVarUInt(count))
+			return false;
+		while (count--)
+			if (!Decode(aReader, aSum))
+				return false;
+		return true;
+	case MSG_MAP:
+		if (!aReader.ReadVarUInt(count))
+			return false;
+		while (count--)
+			if (!Decode(aReader, aSum) || !Decode(aReader, aSum))
+				return false;
+		return true;
+	}
+	return false;
+}
+
+
+static void Send(Channel &aChannel, const void *aData, size_t aSize)
+{
+	size_t written = 0;
+	while (!aChannel.ring.Write(aData, aSize, written))
+	{
+		if (aChannel.ring.TakeWakeRequest())
+			Signal(aChannel.data_ready);
+		aChannel.ring.RequestSpace();
+		if (aChannel.ring.Write(aData, aSize, written))
+			break;
+		if (aChannel.ring.TakeWakeRequest())
+			Signal(aChannel.data_ready);
+		Wait(aChannel.space_ready);
+	}
+	if (aChannel.ring.TakeWakeRequest())
+		Signal(aChannel.data_ready);
+}
+
+static void Receive(Channel &aChannel, MsgBuffer &aMsg, bool aPoll)
+// Waits for a message.  If aPoll is true, yields the CPU instead of blocking while the ring is empty.
+{
+	aMsg.Clear();
+	for (;;)
+	{
+		bool complete = aChannel.ring.Read(aMsg);
+		if (aChannel.ring.TakeSpaceRequest())
+			Signal(aChannel.space_ready);
+		if (complete)
+			return;
+		if (aPoll)
+			sched_yield();
+		else if (aChannel.ring.PrepareToWait())
+			Wait(aChannel.data_ready);
+	}
+}
+
+
+int main()
+{
+	const uint32_t capacity = 1 << 20;
+	const int small_count = 2000000, large_count = 2000, round_trips = 50000;
+	const size_t large_size = 1 << 20;
+
+	// Two rings in shared memory: to_child and to_parent.
+	size_t stride = (MsgRing::SizeFor(capacity) + 4095) & ~(size_t)4095;
+	auto mem = (uint8_t *)mmap(nullptr, stride * 2, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+		return 1;
+	Channel to_child, to_parent;
+	for (auto channel : {&to_child, &to_parent})
+	{
+		channel->data_ready = eventfd(0, 0);
+		channel->space_ready = eventfd(0, 0);
+	}
+	if (!to_child.ring.Create(mem, capacity) || !to_parent.ring.Create(mem + stride, capacity))
+		return 1;
+
+	pid_t pid = fork();
+	if (!pid)
+	{
+		MsgBuffer msg;
+		int64_t sum = 0;
+		for (int i = 0; i < small_count; ++i)
+		{
+			Receive(to_child, msg, false);
+			MsgReader reader(msg.Data(), msg.Length());
+			if (!Decode(reader, sum) || !reader.AtEnd())
+				_exit(1);
+		}
+		Send(to_parent, &sum, sizeof(sum));
+		for (int i = 0; i < large_count; ++i)
+			Receive(to_child, msg, false);
+		Send(to_parent, &sum, sizeof(sum));
+		for (int poll = 0; poll < 2; ++poll)
+			for (int i = 0; i < round_trips; ++i)
+			{
+				Receive(to_child, msg, poll);
+				Send(to_parent, msg.Data(), msg.Length());
+			}
+		_exit(0);
+	}
+
+	MsgBuffer msg, reply;
+	auto start = Clock::now();
+	for (int i = 0; i < small_count; ++i)
+	{
+		Encode(msg, i);
+		Send(to_child, msg.Data(), msg.Length());
+	}
+	Receive(to_parent, reply, false);
+	double elapsed = SecondsSince(start);
+	printf("small: %d messages of %zu bytes (Map with nested Array), encode+send+decode: %.2f M/s, %.0f ns each\n"
+		, small_count, msg.Length(), small_count / elapsed / 1e6, elapsed / small_count * 1e9);
+
+	std::vector<uint8_t> large(large_size, 'x');
+	start = Clock::now();
+	for (int i = 0; i < large_count; ++i)
+		Send(to_child, large.data(), large.size());
+	Receive(to_parent, reply, false);
+	elapsed = SecondsSince(start);
+	printf("large: %d messages of %zu KiB through a %u KiB ring: %.2f GB/s\n"
+		, large_count, large_size / 1024, capacity / 1024, (double)large_count * large_size / elapsed / 1e9);
+
+	for (int poll = 0; poll < 2; ++poll)
+	{
+		std::vector<double> latency(round_trips);
+		for (int i = 0; i < round_trips; ++i)
+		{
+			Encode(msg, i);
+			auto sent = Clock::now();
+			Send(to_child, msg.Data(), msg.Length());
+			Receive(to_parent, reply, poll);
+			latency[i] = SecondsSince(sent) * 1e6;
+		}
+		std::sort(latency.begin(), latency.end());
+		printf("round trip (%s): median %.2f us, p99 %.2f us\n", poll ? "polling" : "blocking on eventfd"
+			, latency[round_trips / 2], latency[round_trips * 99 / 100]);
+	}
+
+	int status;
+	waitpid(pid, &status, 0);
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
@@ -0,0 +1,184 @@
+﻿#include "stdafx.h"
+#include "MsgRing.h"
+#include "test.h"
+#include <condition_variable>
+#include <math.h>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// An auto-reset event, standing in for the events which Worker uses to wake each side.
+class Event
+{
+	std::mutex mLock;
+	std::condition_variable mCond;
+	bool mSet = false;
+
+public:
+	void Set()
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mSet = true;
+		mCond.notify_one();
+	}
+
+	bool Wait()
+	{
+		std::unique_lock<std::mutex> lock(mLock);
+		// A lost wake-up would otherwise hang the test.
+		if (!mCond.wait_for(lock, std::chrono::seconds(10), [this] { return mSet; }))
+			return false;
+		mSet = false;
+		return true;
+	}
+};
+
+
+static void TestSerialization()
+{
+	const uint64_t uints[] = {0, 1, 127, 128, 16383, 16384, UINT32_MAX, UINT64_MAX};
+	const int64_t ints[] = {0, 1, -1, 63, -64, 64, INT32_MIN, INT64_MIN, INT64_MAX};
+	const double doubles[] = {0.0, -0.0, 1.5, -2.25, 1e308, 5e-324, INFINITY, NAN};
+	const uint16_t text[] = {'h', 'i', 0xD83D, 0xDE00, 0};
+
+	MsgBuffer buf;
+	for (auto u : uints)
+		CHECK(buf.WriteVarUInt(u));
+	for (auto i : ints)
+		CHECK(buf.WriteInt(i));
+	for (auto d : doubles)
+		CHECK(buf.WriteDouble(d));
+	CHECK(buf.WriteString(text, 5));
+	CHECK(buf.WriteString(text, 0));
+	CHECK(buf.WriteByte(MSG_MAP));
+
+	// A small number takes a single byte, whether positive or negative.
+	MsgBuffer small;
+	CHECK(small.WriteInt(-64) && small.WriteVarUInt(127) && small.Length() == 2);
+
+	MsgReader reader(buf.Data(), buf.Length());
+	for (auto u : uints)
+	{
+		uint64_t value;
+		CHECK(reader.ReadVarUInt(value) && value == u);
+	}
+	for (auto i : ints)
+	{
+		int64_t value;
+		CHECK(reader.ReadInt(value) && value == i);
+	}
+	for (auto d : doubles)
+	{
+		double value;
+		CHECK(reader.ReadDouble(value));
+		CHECK(isnan(d) ? isnan(value) : value == d && signbit(value) == signbit(d));
+	}
+	const void *str;
+	size_t length;
+	CHECK(reader.ReadString(str, length) && length == 5 && !memcmp(str, text, sizeof(text)));
+	CHECK(reader.ReadString(str, length) && length == 0);
+	uint8_t tag;
+	CHECK(reader.ReadByte(tag) && tag == MSG_MAP);
+	CHECK(reader.AtEnd() && !reader.ReadByte(tag));
+
+	// Every truncation of a value is detected rather than read past the end.
+	MsgBuffer one;
+	CHECK(one.WriteString(text, 5));
+	for (size_t n = 0; n < one.Length(); ++n)
+	{
+		MsgReader truncated(one.Data(), n);
+		CHECK(!truncated.ReadString(str, length));
+	}
+
+	buf.Clear();
+	CHECK(buf.Append("abcdef", 6));
+	buf.Erase(2);
+	CHECK(buf.Length() == 4 && !memcmp(buf.Data(), "cdef", 4));
+}
+
+
+static void TestOpen()
+{
+	std::vector<uint64_t> mem(MsgRing::SizeFor(1024) / 8 + 1);
+	MsgRing writer, reader;
+	CHECK(!reader.Open(mem.data(), mem.size() * 8)); // Not created yet.
+	CHECK(!writer.Create(mem.data(), 1000)); // Not a power of two.
+	CHECK(!writer.Create(mem.data(), MsgRing::MIN_CAPACITY / 2));
+	CHECK(writer.Create(mem.data(), 1024));
+	CHECK(!reader.Open(mem.data(), MsgRing::SizeFor(1024) - 1));
+	CHECK(reader.Open(mem.data(), mem.size() * 8));
+	CHECK(writer.IsEmpty());
+}
+
+
+static void TestTransfer(uint32_t aCapacity, size_t aMaxMessage, int aCount)
+// Sends messages of random sizes (including many larger than the ring) from one thread to
+// another, with each side waiting for the other as Worker does, and checks their contents.
+{
+	std::vector<uint64_t> mem(MsgRing::SizeFor(aCapacity) / 8 + 1);
+	MsgRing writer, reader;
+	CHECK(writer.Create(mem.data(), aCapacity) && reader.Open(mem.data(), mem.size() * 8));
+	Event data_ready, space_ready;
+
+	std::thread thread([&] {
+		std::mt19937 rng(aCapacity);
+		std::vector<uint8_t> msg;
+		for (int i = 0; i < aCount; ++i)
+		{
+			msg.resize(rng() % (aMaxMessage + 1));
+			for (size_t k = 0; k < msg.size(); ++k)
+				msg[k] = uint8_t(i + k);
+			size_t written = 0;
+			while (!writer.Write(msg.data(), msg.size(), written))
+			{
+				// The reader may be waiting for the rest of a fragmented message.
+				if (writer.TakeWakeRequest())
+					data_ready.Set();
+				writer.RequestSpace();
+				if (writer.Write(msg.data(), msg.size(), written))
+					break;
+				if (writer.TakeWakeRequest())
+					data_ready.Set();
+				CHECK(space_ready.Wait());
+			}
+			if (writer.TakeWakeRequest())
+				data_ready.Set();
+		}
+	});
+
+	std::mt19937 rng(aCapacity);
+	MsgBuffer msg;
+	for (int i = 0; i < aCount; ++i)
+	{
+		size_t length = rng() % (aMaxMessage + 1);
+		msg.Clear();
+		for (;;)
+		{
+			bool complete = reader.Read(msg);
+			if (reader.TakeSpaceRequest())
+				space_ready.Set();
+			if (complete)
+				break;
+			if (reader.PrepareToWait())
+				CHECK(data_ready.Wait());
+		}
+		CHECK(msg.Length() == length);
+		for (size_t k = 0; k < length; ++k)
+			CHECK(msg.Data()[k] == uint8_t(i + k));
+	}
+	thread.join();
+	CHECK(writer.IsEmpty());
+}
+
+
+int main()
+{
+	TestSerialization();
+	TestOpen();
+	TestTransfer(MsgRing::MIN_CAPACITY, 1500, 20000);
+	TestTransfer(1 << 16, 1 << 18, 2000);
+	TestTransfer(1 << 16, 100, 200000);
+	puts("MsgRing: all tests passed");
+	return 0;
+}
@@ -0,0 +1,157 @@
+﻿#include "stdafx.h"
+#include "PixelMatch.h"
+#include "test.h"
+#include <vector>
+
+// The SSE2 kernels are checked against straightforward per-pixel comparisons on random images,
+// at every alignment and with counts which aren't multiples of four.
+
+static UINT sSeed = 1;
+
+static UINT Random(UINT aRange)
+{
+	sSeed = sSeed * 1103515245 + 12345;
+	return (sSeed >> 8) % aRange;
+}
+
+static bool Matches(DWORD aPixel, DWORD aColor, int aVariation)
+{
+	for (int shift = 0; shift < 24; shift += 8)
+	{
+		int diff = (int)(aPixel >> shift & 0xFF) - (int)(aColor >> shift & 0xFF);
+		if (diff > aVariation || -diff > aVariation)
+			return false;
+	}
+	return true;
+}
+
+static DWORD RandomPixel()
+{
+	// Few distinct colors, so that there are plenty of matches.  The high byte varies, but is ignored.
+	static const DWORD palette[] = {0x000000, 0xFFFFFF, 0x102030, 0x112233, 0x808080, 0x7F7F80, 0xFF0000};
+	return palette[Random(_countof(palette))] | Random(256) << 24;
+}
+
+static void TestFindPixel()
+{
+	std::vector<DWORD> pixel(64 + 3);
+	for (int round = 0; round < 20000; ++round)
+	{
+		for (auto &p : pixel)
+			p = RandomPixel();
+		int offset = Random(4), count = Random(64);
+		const DWORD *start = pixel.data() + offset;
+		DWORD color = RandomPixel();
+		int variation = Random(4) ? Random(20) : Random(256);
+		int first = -1, last = -1;
+		for (int i = 0; i < count; ++i)
+			if (Matches(start[i], color, variation))
+			{
+				if (first == -1)
+					first = i;
+				last = i;
+			}
+		CHECK(FindPixel(start, count, color, variation) == first);
+		CHECK(FindPixelReverse(start, count, color, variation) == last);
+	}
+	DWORD one = 0x0A141E;
+	CHECK(FindPixel(&one, 1, 0x0B151F, 0) == -1);
+	CHECK(FindPixel(&one, 1, 0x0B151F, 1) == 0);
+	CHECK(FindPixel(&one, 1, 0x0A1428, 9) == -1); // Each component is compared separately.
+	CHECK(FindPixel(&one, 1, 0x0A1428, 10) == 0);
+	CHECK(FindPixel(&one, 1, 0xFFFFFF, 255) == 0);
+	CHECK(FindPixel(&one, 0, 0x0A141E, 0) == -1);
+	CHECK(FindPixelReverse(&one, 0, 0x0A141E, 0) == -1);
+}
+
+// Returns whether the pattern matches at (aX, aY), given which of its pixels are transparent.
+static bool PatternMatchesAt(const std::vector<DWORD> &aScreen, int aStride, const std::vector<DWORD> &aImage
+	, const std::vector<bool> &aTransparent, int aWidth, int aHeight, int aX, int aY, int aVariation)
+{
+	for (int y = 0; y < aHeight; ++y)
+		for (int x = 0; x < aWidth; ++x)
+			if (!aTransparent[y * aWidth + x]
+				&& !Matches(aScreen[(aY + y) * aStride + aX + x], aImage[y * aWidth + x], aVariation))
+				return false;
+	return true;
+}
+
+static void TestPattern()
+{
+	for (int round = 0; round < 3000; ++round)
+	{
+		int screen_w = 1 + Random(40), screen_h = 1 + Random(20), stride = screen_w + Random(5);
+		std::vector<DWORD> screen(stride * screen_h);
+		for (auto &p : screen)
+			p = Random(3) ? 0x000000 : RandomPixel(); // Mostly black, so that small images recur.
+		int w = 1 + Random(7), h = 1 + Random(4);
+		if (w > screen_w || h > screen_h || Random(10) == 0)
+			w = w + Random(3), h = h + Random(3); // Sometimes too big to fit anywhere.
+		std::vector<DWORD> image(w * h), mask(w * h);
+		std::vector<bool> transparent(w * h);
+		int variation = Random(3) ? 0 : Random(30);
+		DWORD trans_color = Random(2) ? 0xFFFFFFFF : 0xFF0000; // 0xFFFFFFFF disables it.
+		bool use_mask = Random(3) == 0;
+		// Copy the image from somewhere on the screen (when it fits), so that there is at least one match.
+		int src_x = w <= screen_w ? Random(screen_w - w + 1) : 0, src_y = h <= screen_h ? Random(screen_h - h + 1) : 0;
+		for (int y = 0; y < h; ++y)
+			for (int x = 0; x < w; ++x)
+			{
+				int i = y * w + x;
+				image[i] = w <= screen_w && h <= screen_h && Random(8) ? screen[(src_y + y) * stride + src_x + x] : RandomPixel();
+				mask[i] = use_mask && Random(5) == 0;
+				transparent[i] = mask[i] || (image[i] & 0xFFFFFF) == trans_color;
+			}
+		PixelPattern pattern;
+		CHECK(pattern.Init(image.data(), use_mask ? mask.data() : nullptr, w, h, trans_color, variation));
+
+		// Enumerate every match, as ImageSearch would to find them all.
+		std::vector<int> expected, found;
+		for (int y = 0; y + h <= screen_h; ++y)
+			for (int x = 0; x + w <= screen_w; ++x)
+				if (PatternMatchesAt(screen, stride, image, transparent, w, h, x, y, variation))
+					expected.push_back(y * stride + x);
+		for (int i = pattern.FindIn(screen.data(), screen_w, screen_h, stride); i != -1
+			; i = pattern.FindIn(screen.data(), screen_w, screen_h, stride, i + 1))
+			found.push_back(i);
+		CHECK(found == expected);
+	}
+}
+
+static void TestEdgeCases()
+{
+	DWORD screen[4 * 3] = {
+		1, 2, 3, 4,
+		5, 6, 7, 8,
+		1, 2, 3, 4,
+	};
+	DWORD image[] = {2, 3};
+	PixelPattern pattern;
+	CHECK(pattern.Init(image, nullptr, 2, 1, 0xFFFFFFFF, 0));
+	CHECK(pattern.FindIn(screen, 4, 3, 4) == 1);
+	CHECK(pattern.FindIn(screen, 4, 3, 4, 2) == 9);
+	CHECK(pattern.FindIn(screen, 4, 3, 4, 10) == -1);
+	CHECK(pattern.FindIn(screen, 4, 3, 4, -1) == -1);
+	CHECK(pattern.FindIn(screen, 2, 3, 4) == -1); // Doesn't fit in a narrower area.
+	CHECK(pattern.FindIn(screen, 3, 3, 4) == 1);
+
+	DWORD clear[] = {9, 9};
+	PixelPattern transparent;
+	CHECK(transparent.Init(clear, nullptr, 1, 2, 9, 0));
+	CHECK(transparent.FindIn(screen, 4, 3, 4) == 0); // Matches anywhere.
+	CHECK(transparent.FindIn(screen, 4, 3, 4, 5) == 5);
+	CHECK(transparent.FindIn(screen, 4, 3, 4, 8) == -1); // Not enough rows left below.
+
+	PixelPattern empty;
+	CHECK(empty.Init(nullptr, nullptr, 0, 0, 0xFFFFFFFF, 0));
+	CHECK(empty.FindIn(screen, 4, 3, 4) == 0);
+}
+
+int main()
+{
+	TestFindPixel();
+	TestPattern();
+	TestEdgeCases();
+	puts("PixelMatch: all tests passed");
+	return 0;
+}
@@ -0,0 +1,95 @@
+﻿#include "stdafx.h"
+#include "SafeArrayLayout.h"
+#include "test.h"
+#include <vector>
+
+// Offsets are checked against the column-major order which SAFEARRAY uses, by counting through the
+// items with the leftmost index varying fastest, as SafeArrayGetElement() would address them.
+
+static UINT sSeed = 1;
+
+static UINT Random(UINT aRange)
+{
+	sSeed = sSeed * 1103515245 + 12345;
+	return (sSeed >> 8) % aRange;
+}
+
+// Visits each item in nested order (the first dimension outermost), as ComObjArray's ToArray()
+// does when it builds an Array of Arrays, and records each item's offset.
+static void Walk(const SafeArrayLayout &aLayout, UINT aDim, size_t aOffset, std::vector<size_t> &aVisited)
+{
+	for (ULONG i = 0; i < aLayout.count[aDim]; ++i)
+	{
+		size_t offset = aOffset + i * aLayout.stride[aDim];
+		if (aDim + 1 < aLayout.dims)
+			Walk(aLayout, aDim + 1, offset, aVisited);
+		else
+			aVisited.push_back(offset);
+	}
+}
+
+static void TestOffsets()
+{
+	for (int round = 0; round < 2000; ++round)
+	{
+		UINT dims = 1 + Random(SafeArrayLayout::MAX_DIMS);
+		ULONG count[SafeArrayLayout::MAX_DIMS];
+		size_t expected_total = 1;
+		for (UINT d = 0; d < dims; ++d)
+		{
+			count[d] = Random(dims > 4 ? 3 : 6) + (Random(20) ? 1 : 0); // Occasionally empty.
+			expected_total *= count[d];
+		}
+		SafeArrayLayout layout;
+		size_t total = layout.Init(dims, count);
+		CHECK(total == expected_total);
+		CHECK(layout.dims == dims);
+
+		// Count through the indices column-major; the offset of each item is its position in that order.
+		ULONG index[SafeArrayLayout::MAX_DIMS] = {0};
+		std::vector<size_t> item_at(total); // Nested-order position -> expected offset.
+		for (size_t n = 0; n < total; ++n)
+		{
+			CHECK(layout.Offset(index) == n);
+			size_t nested = 0; // Position of this item when the first dimension is outermost.
+			for (UINT d = 0; d < dims; ++d)
+				nested = nested * count[d] + index[d];
+			item_at[nested] = n;
+			for (UINT d = 0; d < dims && ++index[d] == count[d]; ++d)
+				index[d] = 0;
+		}
+		std::vector<size_t> visited;
+		Walk(layout, 0, 0, visited);
+		CHECK(visited == item_at);
+	}
+}
+
+static void TestKnownLayouts()
+{
+	// A 2x3 array, as ComObjArray(VarType, [[a, b, c], [d, e, f]]) creates: [row, column].
+	ULONG count[] = { 2, 3 };
+	SafeArrayLayout layout;
+	CHECK(layout.Init(2, count) == 6);
+	CHECK(layout.stride[0] == 1 && layout.stride[1] == 2);
+	ULONG b[] = { 0, 1 }, d[] = { 1, 0 }, f[] = { 1, 2 };
+	CHECK(layout.Offset(b) == 2); // Memory order: a d b e c f.
+	CHECK(layout.Offset(d) == 1);
+	CHECK(layout.Offset(f) == 5);
+
+	ULONG one[] = { 7 }, six[] = { 6 };
+	CHECK(layout.Init(1, one) == 7);
+	CHECK(layout.Offset(six) == 6);
+
+	ULONG many[SafeArrayLayout::MAX_DIMS + 1] = { 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+	CHECK(layout.Init(0, many) == 0 && layout.dims == 0);
+	CHECK(layout.Init(SafeArrayLayout::MAX_DIMS + 1, many) == 0 && layout.dims == 0);
+	CHECK(layout.Init(SafeArrayLayout::MAX_DIMS, many) == 1);
+}
+
+int main()
+{
+	TestOffsets();
+	TestKnownLayouts();
+	puts("SafeArrayLayout: all tests passed");
+	return 0;
+}
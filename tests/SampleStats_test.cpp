@@ -0,0 +1,83 @@
+﻿#include "stdafx.h"
+#include "SampleStats.h"
+#include "test.h"
+#include <vector>
+
+// Percentiles are checked against the definition of nearest rank: the smallest sample which at
+// least the given percentage of samples are less than or equal to.
+
+static UINT sSeed = 1;
+
+static UINT Random(UINT aRange)
+{
+	sSeed = sSeed * 1103515245 + 12345;
+	return (sSeed >> 8) % aRange;
+}
+
+static double NearestRank(const std::vector<double> &aSorted, int aPercentile)
+{
+	size_t n = aSorted.size();
+	for (size_t i = 0; i < n; ++i)
+		if ((i + 1) * 100 >= aPercentile * n) // At least aPercentile% are <= aSorted[i].
+			return aSorted[i];
+	return aSorted[n - 1];
+}
+
+static void TestPercentile()
+{
+	for (int round = 0; round < 2000; ++round)
+	{
+		std::vector<double> sample(1 + Random(300));
+		for (auto &s : sample)
+			s = Random(50); // Duplicates are common.
+		SampleStats stats;
+		stats.Compute(sample.data(), sample.size()); // Sorts it.
+		for (size_t i = 1; i < sample.size(); ++i)
+			CHECK(sample[i - 1] <= sample[i]);
+		for (int p = 0; p <= 100; ++p)
+			CHECK(SampleStats::Percentile(sample.data(), sample.size(), p) == NearestRank(sample, p));
+		CHECK(stats.p99 == NearestRank(sample, 99));
+	}
+	double one = 5;
+	CHECK(SampleStats::Percentile(&one, 1, 0) == 5);
+	CHECK(SampleStats::Percentile(&one, 1, 100) == 5);
+	CHECK(SampleStats::Percentile(&one, 0, 50) == 0);
+}
+
+static void TestSummary()
+{
+	double odd[] = { 9, 1, 5, 3, 7 };
+	SampleStats stats;
+	stats.Compute(odd, _countof(odd));
+	CHECK(stats.minimum == 1);
+	CHECK(stats.maximum == 9);
+	CHECK(stats.median == 5);
+	CHECK(stats.mean == 5);
+	CHECK(stats.p99 == 9);
+
+	double even[] = { 4, 1, 3, 2 };
+	stats.Compute(even, _countof(even));
+	CHECK(stats.median == 2.5); // The midpoint of the middle two.
+	CHECK(stats.mean == 2.5);
+
+	// 100 samples: p99 is the 99th smallest, so a single outlier doesn't affect it.
+	std::vector<double> sample(100, 1.0);
+	sample[37] = 1000;
+	sample[0] = 2;
+	stats.Compute(sample.data(), sample.size());
+	CHECK(stats.p99 == 2);
+	CHECK(stats.maximum == 1000);
+	CHECK(stats.median == 1);
+
+	double single = 42;
+	stats.Compute(&single, 1);
+	CHECK(stats.minimum == 42 && stats.median == 42 && stats.p99 == 42 && stats.mean == 42 && stats.maximum == 42);
+}
+
+int main()
+{
+	TestPercentile();
+	TestSummary();
+	puts("SampleStats: all tests passed");
+	return 0;
+}
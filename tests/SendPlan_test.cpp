@@ -0,0 +1,131 @@
+﻿#include "stdafx.h"
+#include "SendPlan.h"
+#include "test.h"
+#include <string>
+
+// A fake German (QWERTZ) layout: letters need Shift when upper-case, and some punctuation needs
+// AltGr, which the system reports as LCtrl+RAlt.
+#define ALTGR (MOD_LCONTROL | MOD_RALT)
+
+static bool sLastFallback;
+
+static vk_type FakeCharToVK(TCHAR aChar, modLR_type *aMods, bool aEnableAZFallback)
+{
+	sLastFallback = aEnableAZFallback;
+	if (aChar >= 'a' && aChar <= 'z')
+		return (vk_type)(aChar - 'a' + 'A');
+	if (aChar >= 'A' && aChar <= 'Z')
+	{
+		*aMods |= MOD_LSHIFT;
+		return (vk_type)aChar;
+	}
+	if ((aChar >= '0' && aChar <= '9') || aChar == ' ')
+		return (vk_type)aChar;
+	switch (aChar)
+	{
+	case '\n': return 0x0D; // VK_RETURN, as CharToVKAndModifiers() gives for both \n and \r.
+	case '!': *aMods |= MOD_LSHIFT; return '1';
+	case '{': *aMods |= ALTGR; return '7';
+	case '[': *aMods |= ALTGR; return '8';
+	case ']': *aMods |= ALTGR; return '9';
+	case '}': *aMods |= ALTGR; return '0';
+	case '@': *aMods |= ALTGR; return 'Q';
+	case '|': *aMods |= ALTGR; return 0xE2; // VK_OEM_102
+	}
+	return 0; // e.g. '^' is a dead key on this layout, so Send types it by other means.
+}
+
+static std::string ModsText(modLR_type aMods)
+{
+	std::string s;
+	for (int i = 0; i < MODLR_COUNT; ++i)
+		if (aMods & (1 << i))
+			s.append(MODLR_STRING + i * 2, 2);
+	return s;
+}
+
+// Plans each character of aText as SendKeys would for plain text, and renders the plan as
+// space-separated keys: modifiers in <^>! form, the VK in hex, then "/" and any kept-down modifiers.
+static std::string Plan(LPCTSTR aText, bool aRaw = true, modLR_type aPersistentMods = 0)
+{
+	std::string plan;
+	char buf[8];
+	for (LPCTSTR cp = aText; *cp; ++cp)
+	{
+		SendTextKey key = PlanTextKey(cp, aRaw, 0, aPersistentMods, FakeCharToVK);
+		if (!plan.empty())
+			plan += ' ';
+		plan += ModsText(key.mods);
+		snprintf(buf, sizeof(buf), "%02X", key.vk);
+		plan += buf;
+		if (key.keep_down)
+			plan += "/" + ModsText(key.keep_down);
+	}
+	return plan;
+}
+
+static void TestGolden()
+{
+	static const struct { LPCTSTR text; const char *plan; } golden[] = {
+		{_T("abc"), "41 42 43"},
+		{_T("Ab!"), "<+41 42 <+31"},
+		// AltGr stays down (RAlt only; LCtrl's release is deferred by SendKey anyway) through the run.
+		{_T("{[]}"), "<^>!37/>! <^>!38/>! <^>!39/>! <^>!30"},
+		{_T("a@@b"), "41 <^>!51/>! <^>!51 42"},
+		{_T("@A"), "<^>!51 <+41"}, // Shift alone shares nothing with AltGr.
+		{_T("x|\n"), "58 <^>!E2 0D"},
+		{_T("[^]"), "<^>!38 00 <^>!39"}, // No key for the next character, so nothing is kept.
+		{_T("@"), "<^>!51"},
+		{_T(""), ""},
+	};
+	for (auto &g : golden)
+	{
+		std::string plan = Plan(g.text);
+		if (plan != g.plan)
+			fprintf(stderr, "\"%s\": expected \"%s\", got \"%s\"\n", g.text, g.plan, plan.c_str());
+		CHECK(plan == g.plan);
+	}
+}
+
+static void TestSendSyntax()
+{
+	// Outside of raw mode, a following ^+!#{} is syntax, so the key can't be assumed to be next.
+	CHECK(Plan(_T("@@"), false) == "<^>!51/>! <^>!51");
+	SendTextKey key = PlanTextKey(_T("@{Enter}"), false, 0, 0, FakeCharToVK);
+	CHECK(key.vk == 'Q' && key.mods == ALTGR && !key.keep_down);
+	key = PlanTextKey(_T("@!a"), false, 0, 0, FakeCharToVK);
+	CHECK(!key.keep_down);
+	key = PlanTextKey(_T("@{"), true, 0, 0, FakeCharToVK); // In raw mode, { is just another AltGr character.
+	CHECK(key.keep_down == MOD_RALT);
+
+	// A ^+!# prefix is passed in as aMods and combined with what the character needs.
+	key = PlanTextKey(_T("a"), false, MOD_LALT, 0, FakeCharToVK);
+	CHECK(key.vk == 'A' && key.mods == MOD_LALT && !key.keep_down);
+	key = PlanTextKey(_T("aB"), false, MOD_LALT, 0, FakeCharToVK);
+	CHECK(key.mods == MOD_LALT && !key.keep_down); // The next character doesn't get the prefix.
+	key = PlanTextKey(_T("@b"), false, MOD_LWIN, 0, FakeCharToVK);
+	CHECK(key.mods == (MOD_LWIN | ALTGR) && !key.keep_down);
+}
+
+static void TestAZFallback()
+{
+	// The a-z fallback is only for shortcuts such as ^a: it needs modifiers and isn't used in raw mode.
+	PlanTextKey(_T("a"), false, 0, 0, FakeCharToVK);
+	CHECK(sLastFallback == false);
+	PlanTextKey(_T("a"), false, MOD_LCONTROL, 0, FakeCharToVK);
+	CHECK(sLastFallback == true);
+	PlanTextKey(_T("a"), false, 0, MOD_LSHIFT, FakeCharToVK);
+	CHECK(sLastFallback == true);
+	PlanTextKey(_T("a"), true, MOD_LCONTROL, MOD_LSHIFT, FakeCharToVK);
+	CHECK(sLastFallback == false);
+	CHECK(Plan(_T("@@"), true, MOD_LSHIFT) == "<^>!51/>! <^>!51");
+}
+
+int main()
+{
+	TestGolden();
+	TestSendSyntax();
+	TestAZFallback();
+	puts("SendPlan: all tests passed");
+	return 0;
+}
@@ -0,0 +1,81 @@
+﻿#include "stdafx.h"
+#include "SequencedTextCache.h"
+#include "test.h"
+#include <string>
+
+// Simulates A_Clipboard reads against a clipboard whose sequence number changes with each write.
+
+static bool Get(SequencedTextCache &aCache, DWORD aSequence, std::string &aText)
+{
+	LPCTSTR text;
+	size_t length;
+	if (!aCache.Get(aSequence, text, length))
+		return false;
+	CHECK(text[length] == '\0');
+	aText.assign(text, length);
+	return true;
+}
+
+static void TestValidity()
+{
+	SequencedTextCache cache(100);
+	std::string text;
+	CHECK(!Get(cache, 0, text)); // Nothing cached yet.
+	CHECK(!Get(cache, 1, text));
+
+	cache.Set(5, "hello", 5);
+	CHECK(Get(cache, 5, text) && text == "hello");
+	CHECK(Get(cache, 5, text) && text == "hello"); // Reusable any number of times.
+	CHECK(!Get(cache, 6, text)); // The clipboard changed.
+	CHECK(!Get(cache, 0, text)); // The sequence number couldn't be retrieved.
+
+	cache.Set(6, "bye", 3);
+	CHECK(!Get(cache, 5, text));
+	CHECK(Get(cache, 6, text) && text == "bye");
+
+	cache.Set(0, "x", 1); // Invalid sequence number: nothing is cached.
+	CHECK(!Get(cache, 0, text));
+	CHECK(!Get(cache, 6, text)); // The previous text is discarded too.
+
+	cache.Set(7, "", 0);
+	CHECK(Get(cache, 7, text) && text.empty());
+
+	cache.Set(8, "ab\0cd", 5); // Length is explicit, so embedded nulls are retained.
+	CHECK(Get(cache, 8, text) && text == std::string("ab\0cd", 5));
+}
+
+static void TestMaxLength()
+{
+	SequencedTextCache cache(10);
+	std::string text, longest(10, 'a'), too_long(11, 'b');
+	cache.Set(1, longest.c_str(), longest.size());
+	CHECK(Get(cache, 1, text) && text == longest);
+	cache.Set(2, too_long.c_str(), too_long.size());
+	CHECK(!Get(cache, 2, text));
+	CHECK(!Get(cache, 1, text));
+}
+
+static void TestSizes()
+{
+	// Growing and shrinking the text must always give back exactly what was stored.
+	SequencedTextCache cache(1 << 20);
+	std::string text;
+	DWORD sequence = 1;
+	for (size_t length : {0, 1, 15, 16, 17, 1000, 999, 400, 3, 70000, 10, 0, 500})
+	{
+		std::string s(length, '\0');
+		for (size_t i = 0; i < length; ++i)
+			s[i] = (char)('a' + (i + sequence) % 26);
+		cache.Set(++sequence, s.c_str(), s.size());
+		CHECK(Get(cache, sequence, text) && text == s);
+	}
+}
+
+int main()
+{
+	TestValidity();
+	TestMaxLength();
+	TestSizes();
+	puts("SequencedTextCache: all tests passed");
+	return 0;
+}
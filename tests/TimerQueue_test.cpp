@@ -0,0 +1,153 @@
+﻿#include "test.h"
+#include "TimerQueue.h"
+#include <random>
+
+
+// A periodic timer driven by a fake clock, as in CheckScriptTimers().
+struct FakeTimer : TimerQueueItem
+{
+	UINT64 period = 0;
+	UINT runs = 0, last_check = 0;
+	UINT64 late_max = 0;
+};
+
+
+// Checks that every item is queued at its own index and isn't due before its parent.
+static void CheckHeap(TimerQueue &aQueue, FakeTimer *aTimer, int aCount)
+{
+	UINT queued = 0;
+	for (int i = 0; i < aCount; ++i)
+		if (aTimer[i].IsQueued())
+			++queued;
+	CHECK(queued == aQueue.Count());
+	TimerQueueItem *top = aQueue.Peek();
+	for (int i = 0; i < aCount; ++i)
+		if (aTimer[i].IsQueued())
+			CHECK(top && top->mDue <= aTimer[i].mDue);
+}
+
+
+static void TestOrder()
+{
+	TimerQueue queue;
+	FakeTimer timer[100];
+	std::mt19937 rng(1);
+	for (auto &t : timer)
+		CHECK(queue.Schedule(&t, rng() % 1000 + 1));
+	CHECK(queue.Count() == 100);
+	CHECK(!queue.PopDue(0));
+	
+	// Items come out in order of due time, and only once due.
+	UINT64 prev = 0;
+	int popped = 0;
+	for (UINT64 now = 0; now < 1000; now += 50)
+	{
+		while (TimerQueueItem *item = queue.PopDue(now))
+		{
+			CHECK(item->mDue <= now);
+			CHECK(item->mDue >= prev);
+			CHECK(!item->IsQueued());
+			prev = item->mDue;
+			++popped;
+		}
+		CHECK(!queue.IsDue(now));
+	}
+	CHECK(popped + queue.Count() == 100);
+}
+
+static void TestRescheduleAndCancel()
+{
+	TimerQueue queue;
+	const int count = 200;
+	FakeTimer timer[count];
+	std::mt19937 rng(2);
+	for (int op = 0; op < 20000; ++op)
+	{
+		FakeTimer &t = timer[rng() % count];
+		switch (rng() % 3)
+		{
+		case 0: CHECK(queue.Schedule(&t, rng() % 10000)); break; // Insert, or move earlier or later.
+		case 1: queue.Cancel(&t); CHECK(!t.IsQueued()); break;
+		case 2: queue.Cancel(&t); break; // Cancelling an item which isn't queued does nothing.
+		}
+		CheckHeap(queue, timer, count);
+	}
+	// Remaining items are still popped in order.
+	UINT64 prev = 0;
+	while (TimerQueueItem *item = queue.PopDue(~0ULL))
+	{
+		CHECK(item->mDue >= prev);
+		prev = item->mDue;
+	}
+	CHECK(!queue.Count() && !queue.Peek());
+}
+
+static void TestFindDue()
+{
+	TimerQueue queue;
+	FakeTimer timer[64];
+	for (int i = 0; i < 64; ++i)
+		queue.Schedule(&timer[i], 1000 + i * 10);
+	
+	// Only due items are passed to the predicate, even if none of them satisfy it.
+	int visited = 0;
+	CHECK(!queue.FindDue(1095, [&](TimerQueueItem *aItem) { CHECK(aItem->mDue <= 1095); ++visited; return false; }));
+	CHECK(visited == 10);
+	CHECK(!queue.FindDue(999, [](TimerQueueItem *) { return true; }));
+	
+	// The earliest item which satisfies the predicate is returned.
+	auto odd = [&](TimerQueueItem *aItem) { return ((FakeTimer *)aItem - timer) % 2 == 1; };
+	CHECK(queue.FindDue(5000, odd) == &timer[1]);
+	queue.Cancel(&timer[1]);
+	CHECK(queue.FindDue(5000, odd) == &timer[3]);
+	queue.Schedule(&timer[63], 0);
+	CHECK(queue.FindDue(5000, odd) == &timer[63]);
+	CHECK(queue.Count() == 63);
+}
+
+// Runs timers with periods from 0 to 49 against a fake clock which advances by 1 each step,
+// launching due timers in the same way as CheckScriptTimers().
+static void TestFakeClock()
+{
+	TimerQueue queue;
+	const int count = 50;
+	FakeTimer timer[count];
+	UINT64 now = 1000;
+	for (int i = 0; i < count; ++i)
+	{
+		timer[i].period = i;
+		queue.Schedule(&timer[i], now + i);
+	}
+	const UINT steps = 10000;
+	for (UINT check = 1; check <= steps; ++check, ++now)
+	{
+		auto can_launch = [check](TimerQueueItem *aItem) { return ((FakeTimer *)aItem)->last_check != check; };
+		while (auto *t = (FakeTimer *)queue.FindDue(now, can_launch))
+		{
+			if (t->late_max < now - t->mDue)
+				t->late_max = now - t->mDue;
+			++t->runs;
+			t->last_check = check;
+			queue.Schedule(t, now + t->period);
+		}
+	}
+	for (int i = 0; i < count; ++i)
+	{
+		// A period of 0 runs once per check, the same as a period of 1.  Others first run after
+		// one period, at the check numbered period + 1.
+		UINT expected = i ? (steps - 1) / i : steps;
+		CHECK(timer[i].runs == expected);
+		CHECK(timer[i].late_max == (i ? 0 : 1)); // Period 0 is always due, but can't run twice per check.
+	}
+}
+
+
+int main()
+{
+	TestOrder();
+	TestRescheduleAndCancel();
+	TestFindDue();
+	TestFakeClock();
+	puts("TimerQueue: all tests passed");
+	return 0;
+}
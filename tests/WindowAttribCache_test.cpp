@@ -0,0 +1,195 @@
+﻿#include "stdafx.h"
+#include "WindowAttribCache.h"
+#include "test.h"
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A fake list of windows and processes, which counts how often the cache has to consult it.
+struct FakeWindows : WindowInfoSource
+{
+	struct Window { DWORD tid, pid; std::string class_name; };
+	std::map<HWND, Window> windows;
+	std::map<DWORD, std::string> processes; // PID -> full path.
+	std::atomic<int> class_lookups {0}, process_lookups {0}; // Atomic for TestThreads().
+
+	DWORD ThreadProcessID(HWND aWnd, DWORD &aPID) override
+	{
+		auto it = windows.find(aWnd);
+		if (it == windows.end())
+			return 0;
+		aPID = it->second.pid;
+		return it->second.tid;
+	}
+	void ClassName(HWND aWnd, LPTSTR aBuf, int aBufSize) override
+	{
+		++class_lookups;
+		auto it = windows.find(aWnd);
+		snprintf(aBuf, aBufSize, "%s", it == windows.end() ? "" : it->second.class_name.c_str());
+	}
+	void ProcessName(DWORD aPID, LPTSTR aBuf, DWORD aBufSize, bool aNameOnly) override
+	{
+		++process_lookups;
+		auto it = processes.find(aPID);
+		std::string path = it == processes.end() ? "" : it->second;
+		if (aNameOnly)
+			path = path.substr(path.rfind('\\') + 1);
+		snprintf(aBuf, aBufSize, "%s", path.c_str());
+	}
+};
+
+typedef WindowAttribCache<32, 64> Cache;
+
+static HWND Wnd(UINT_PTR aValue) { return (HWND)aValue; }
+
+static void AddDesktop(FakeWindows &fake)
+{
+	fake.windows[Wnd(0x10010)] = {100, 1000, "Notepad"};
+	fake.windows[Wnd(0x10012)] = {100, 1000, "Edit"};
+	fake.windows[Wnd(0x20020)] = {200, 2000, "CabinetWClass"};
+	fake.processes[1000] = "C:\\Windows\\notepad.exe";
+	fake.processes[2000] = "C:\\Windows\\explorer.exe";
+}
+
+static void TestCaching()
+{
+	FakeWindows fake;
+	AddDesktop(fake);
+	static Cache cache;
+	TCHAR cls[32], path[64];
+	CHECK(cache.Get(fake, Wnd(0x10010), cls, path, false) == 1000);
+	CHECK(!strcmp(cls, "Notepad") && !strcmp(path, "C:\\Windows\\notepad.exe"));
+	CHECK(fake.class_lookups == 1 && fake.process_lookups == 1);
+	for (int i = 0; i < 3; ++i)
+	{
+		*cls = *path = '\0';
+		CHECK(cache.Get(fake, Wnd(0x10010), cls, path, false) == 1000);
+		CHECK(!strcmp(cls, "Notepad") && !strcmp(path, "C:\\Windows\\notepad.exe"));
+	}
+	CHECK(fake.class_lookups == 1 && fake.process_lookups == 1);
+
+	// A cached full path can produce the name, but not the reverse.
+	CHECK(cache.Get(fake, Wnd(0x10010), nullptr, path, true) == 1000);
+	CHECK(!strcmp(path, "notepad.exe") && fake.process_lookups == 1);
+	CHECK(cache.Get(fake, Wnd(0x20020), nullptr, path, true) == 2000);
+	CHECK(!strcmp(path, "explorer.exe") && fake.process_lookups == 2);
+	CHECK(cache.Get(fake, Wnd(0x20020), nullptr, path, false) == 2000);
+	CHECK(!strcmp(path, "C:\\Windows\\explorer.exe") && fake.process_lookups == 3);
+
+	// Attributes are fetched only when asked for, and the PID alone never needs a lookup.
+	CHECK(cache.Get(fake, Wnd(0x10012), nullptr, nullptr, false) == 1000);
+	CHECK(cache.Get(fake, Wnd(0x10012), cls, nullptr, false) == 1000);
+	CHECK(!strcmp(cls, "Edit") && fake.class_lookups == 2 && fake.process_lookups == 3);
+	CHECK(cache.Get(fake, Wnd(0x20020), cls, nullptr, false) == 2000);
+	CHECK(!strcmp(cls, "CabinetWClass") && fake.class_lookups == 3);
+	CHECK(cache.Get(fake, Wnd(0x20020), cls, path, false) == 2000);
+	CHECK(fake.class_lookups == 3 && fake.process_lookups == 3);
+}
+
+static void TestValidation()
+{
+	FakeWindows fake;
+	AddDesktop(fake);
+	static Cache cache;
+	TCHAR cls[32], path[64];
+	cache.Get(fake, Wnd(0x10010), cls, path, false);
+
+	// A destroyed window has no attributes, even though they are still cached.
+	fake.windows.erase(Wnd(0x10010));
+	CHECK(cache.Get(fake, Wnd(0x10010), cls, path, false) == 0);
+	CHECK(!*cls && !*path && fake.class_lookups == 1 && fake.process_lookups == 1);
+
+	// A new window with the same HWND but another owner doesn't get the old window's attributes.
+	fake.windows[Wnd(0x10010)] = {200, 2000, "CabinetWClass"};
+	CHECK(cache.Get(fake, Wnd(0x10010), cls, path, false) == 2000);
+	CHECK(!strcmp(cls, "CabinetWClass") && !strcmp(path, "C:\\Windows\\explorer.exe"));
+	CHECK(fake.class_lookups == 2 && fake.process_lookups == 2);
+	// Only the thread differing is enough.
+	fake.windows[Wnd(0x10010)] = {201, 2000, "Shell_TrayWnd"};
+	CHECK(cache.Get(fake, Wnd(0x10010), cls, nullptr, false) == 2000);
+	CHECK(!strcmp(cls, "Shell_TrayWnd") && fake.class_lookups == 3);
+}
+
+static void TestFailureNotCached()
+{
+	FakeWindows fake;
+	AddDesktop(fake);
+	static Cache cache;
+	TCHAR path[64];
+	fake.processes.erase(1000); // e.g. access denied for an elevated process.
+	CHECK(cache.Get(fake, Wnd(0x10010), nullptr, path, false) == 1000);
+	CHECK(!*path && fake.process_lookups == 1);
+	fake.processes[1000] = "C:\\Windows\\notepad.exe";
+	CHECK(cache.Get(fake, Wnd(0x10010), nullptr, path, false) == 1000);
+	CHECK(!strcmp(path, "C:\\Windows\\notepad.exe") && fake.process_lookups == 2);
+	CHECK(cache.Get(fake, Wnd(0x10010), nullptr, path, false) == 1000);
+	CHECK(fake.process_lookups == 2);
+}
+
+static void TestManyWindows()
+{
+	// More windows than entries: colliding windows replace each other, but never return the wrong attributes.
+	FakeWindows fake;
+	const int count = 1000;
+	for (int i = 0; i < count; ++i)
+	{
+		fake.windows[Wnd(0x10000 + i * 2)] = {(DWORD)(100 + i), (DWORD)(1000 + i % 7), "Class" + std::to_string(i)};
+		fake.processes[1000 + i % 7] = "C:\\App\\app" + std::to_string(i % 7) + ".exe";
+	}
+	static Cache cache;
+	for (int pass = 0; pass < 3; ++pass)
+		for (int i = 0; i < count; ++i)
+		{
+			TCHAR cls[32], path[64];
+			CHECK(cache.Get(fake, Wnd(0x10000 + i * 2), cls, path, true) == (DWORD)(1000 + i % 7));
+			CHECK(cls == "Class" + std::to_string(i));
+			CHECK(path == "app" + std::to_string(i % 7) + ".exe");
+		}
+	// Windows created in succession get consecutive HWNDs, which map to distinct entries.
+	int lookups = fake.class_lookups;
+	for (int pass = 0; pass < 3; ++pass)
+		for (int i = 0; i < 64; ++i)
+		{
+			TCHAR cls[32];
+			cache.Get(fake, Wnd(0x10000 + i * 2), cls, nullptr, false);
+			CHECK(cls == "Class" + std::to_string(i));
+		}
+	CHECK(fake.class_lookups == lookups + 64);
+}
+
+static void TestThreads()
+{
+	// Several threads searching at once, as the hook thread and the main thread might.
+	FakeWindows fake;
+	AddDesktop(fake);
+	static Cache cache;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+		threads.emplace_back([&fake]() {
+			for (int i = 0; i < 20000; ++i)
+			{
+				TCHAR cls[32], path[64];
+				HWND wnd = Wnd(i & 1 ? 0x10010 : 0x20020);
+				DWORD pid = cache.Get(fake, wnd, cls, path, i % 3 == 0);
+				CHECK(pid == (i & 1 ? 1000u : 2000u));
+				CHECK(!strcmp(cls, i & 1 ? "Notepad" : "CabinetWClass"));
+				CHECK(!strcmp(path, i & 1 ? (i % 3 == 0 ? "notepad.exe" : "C:\\Windows\\notepad.exe")
+					: (i % 3 == 0 ? "explorer.exe" : "C:\\Windows\\explorer.exe")));
+			}
+		});
+	for (auto &t : threads)
+		t.join();
+}
+
+int main()
+{
+	TestCaching();
+	TestValidation();
+	TestFailureNotCached();
+	TestManyWindows();
+	TestThreads();
+	puts("WindowAttribCache: all tests passed");
+	return 0;
+}
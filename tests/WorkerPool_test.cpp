@@ -0,0 +1,183 @@
+﻿#include "stdafx.h"
+#include "WorkerPool.h"
+#include "test.h"
+#include <chrono>
+#include <vector>
+
+// Stands in for the owner's message queue: the pool's notifications are counted, and the owner
+// waits for one before calling GetEvent(), as it would for a posted message.
+struct Owner
+{
+	std::mutex lock;
+	std::condition_variable cv;
+	int pending = 0;
+
+	static void Notify(void *aParam)
+	{
+		auto &owner = *(Owner *)aParam;
+		std::lock_guard<std::mutex> guard(owner.lock);
+		++owner.pending;
+		owner.cv.notify_one();
+	}
+
+	bool Wait(int aTimeout = 5000)
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		if (!cv.wait_for(guard, std::chrono::milliseconds(aTimeout), [this] { return pending > 0; }))
+			return false;
+		--pending;
+		return true;
+	}
+};
+
+
+struct CountJob : WorkerJob
+{
+	std::atomic<int> &mRuns;
+	int mSteps;
+	int mProgressEvents = 0, mDoneEvents = 0;
+
+	CountJob(std::atomic<int> &aRuns, int aSteps) : mRuns(aRuns), mSteps(aSteps) {}
+
+	void Run(WorkerPool &aPool) override
+	{
+		for (int i = 0; i < mSteps; ++i)
+			aPool.PostProgress(this);
+		++mRuns;
+	}
+};
+
+
+static void TestCompletion()
+{
+	Owner owner;
+	std::atomic<int> runs {0};
+	std::vector<CountJob *> jobs;
+	{
+		WorkerPool pool(4, Owner::Notify, &owner);
+		for (int i = 0; i < 200; ++i)
+		{
+			jobs.push_back(new CountJob(runs, i % 7));
+			pool.Submit(jobs.back());
+		}
+		int done = 0;
+		while (done < 200)
+		{
+			CHECK(owner.Wait());
+			WorkerEventSource *source;
+			UINT events;
+			// Each notification is for exactly one source.
+			CHECK(pool.GetEvent(source, events));
+			auto &job = *static_cast<CountJob *>(source);
+			CHECK(!job.mDoneEvents); // Nothing is reported after completion.
+			if (events & WORKER_EVENT_PROGRESS)
+				++job.mProgressEvents;
+			if (events & WORKER_EVENT_DONE)
+			{
+				++job.mDoneEvents;
+				++done;
+			}
+		}
+		CHECK(!owner.Wait(50)); // No notification is left over once the queue is empty.
+	}
+	CHECK(runs == 200);
+	for (auto job : jobs)
+	{
+		CHECK(job->mDoneEvents == 1);
+		// Progress reports may be coalesced, but never exceed the number posted.
+		CHECK(job->mProgressEvents <= job->mSteps);
+		delete job;
+	}
+}
+
+
+struct WaitJob : WorkerJob
+{
+	void Run(WorkerPool &) override
+	{
+		while (!IsCanceled())
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+};
+
+
+static void TestCancel()
+{
+	Owner owner;
+	WorkerPool pool(1, Owner::Notify, &owner);
+	WaitJob job;
+	pool.Submit(&job);
+	CHECK(!owner.Wait(50));
+	job.Cancel();
+	CHECK(owner.Wait());
+	WorkerEventSource *source;
+	UINT events;
+	CHECK(pool.GetEvent(source, events));
+	CHECK(source == &job && events == WORKER_EVENT_DONE);
+}
+
+
+static void TestRequeueAndForget()
+{
+	Owner owner;
+	WorkerPool pool(1, Owner::Notify, &owner);
+	WorkerEventSource a, b, c;
+	pool.PostData(&a);
+	pool.PostData(&b);
+	pool.PostData(&a); // Coalesced with the first.
+	CHECK(owner.Wait());
+	CHECK(!owner.Wait(10)); // Only one notification until the owner responds.
+
+	WorkerEventSource *source;
+	UINT events;
+	CHECK(pool.GetEvent(source, events) && source == &a && events == WORKER_EVENT_DATA);
+	CHECK(owner.Wait()); // Notified again, since b is pending.
+	pool.Requeue(&a, WORKER_EVENT_DATA);
+	CHECK(pool.GetEvent(source, events) && source == &a); // Requeued events come first.
+	CHECK(owner.Wait());
+
+	pool.PostData(&c);
+	pool.Forget(&b);
+	CHECK(pool.GetEvent(source, events) && source == &c);
+	CHECK(!pool.GetEvent(source, events));
+
+	// After GetEvent() returns false, the next event notifies again.
+	pool.PostData(&a);
+	CHECK(owner.Wait());
+	pool.Forget(&a);
+	CHECK(!pool.GetEvent(source, events));
+}
+
+
+static void TestAbandon()
+{
+	// Jobs which haven't started when the pool is destroyed are never run.
+	Owner owner;
+	std::atomic<int> runs {0};
+	WaitJob blocker;
+	CountJob queued(runs, 0);
+	std::thread canceler;
+	{
+		WorkerPool pool(1, Owner::Notify, &owner);
+		pool.Submit(&blocker);
+		pool.Submit(&queued);
+		// Let the destructor's join() complete, after it has had time to stop the pool.
+		canceler = std::thread([&blocker] {
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			blocker.Cancel();
+		});
+	}
+	canceler.join();
+	CHECK(runs == 0);
+}
+
+
+int main()
+{
+	TestCompletion();
+	TestCancel();
+	TestRequeueAndForget();
+	TestAbandon();
+	puts("WorkerPool: all tests passed");
+	return 0;
+}
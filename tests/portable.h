@@ -0,0 +1,45 @@
+﻿#pragma once
+// Included ahead of each source file when building the portable modules outside of Windows,
+// in place of the types which windows.h would otherwise provide.
+
+#include <stdint.h>
+#include <stddef.h>
+typedef unsigned char BYTE;
+typedef unsigned char UCHAR;
+typedef unsigned short USHORT;
+typedef unsigned int UINT;
+typedef unsigned int DWORD;
+typedef unsigned long ULONG;
+typedef signed char INT8;
+typedef unsigned char UINT8;
+typedef short INT16;
+typedef unsigned short UINT16;
+typedef int INT32;
+typedef unsigned int UINT32;
+typedef long long INT64;
+typedef unsigned long long UINT64;
+typedef uintptr_t UINT_PTR;
+#define __int64 long long
+#define _countof(a) (sizeof(a) / sizeof((a)[0]))
+#include <assert.h>
+#define ASSERT(expr) assert(expr)
+
+// Strings are tested as ANSI (char), as in a non-UNICODE build.
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+typedef char TCHAR;
+typedef unsigned char TBYTE;
+typedef TCHAR *LPTSTR;
+typedef const TCHAR *LPCTSTR;
+#define _T(x) x
+#define _tcscmp strcmp
+#define _tcsdup strdup
+#define _tcslen strlen
+#define _tcschr strchr
+#define _tcsicmp strcasecmp
+#define _tcsnicmp strncasecmp
+#define _tcspbrk strpbrk
+
+typedef long DISPID;
+typedef struct HWND__ *HWND;
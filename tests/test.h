@@ -0,0 +1,6 @@
+﻿#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+
+// Reports a failed condition and exits, so that ctest shows the test as failed.
+#define CHECK(cond) ((cond) ? (void)0 : (fprintf(stderr, "%s(%d): CHECK failed: %s\n", __FILE__, __LINE__, #cond), exit(1)))